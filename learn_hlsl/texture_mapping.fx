@@ -1,5 +1,8 @@
 /***** Resources *****/
+// -- permutation key; the default can be overridden by the compiler defines
+#ifndef SHOULD_FLIP_TEXTU_Y
 #define SHOULD_FLIP_TEXTU_Y 1
+#endif
 
 cbuffer cbuf_per_obj {
 	float4x4 wvp : WORLDVIEWPROJECTION <
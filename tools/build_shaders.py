@@ -0,0 +1,329 @@
+#!/usr/bin/env python3
+# NOTE(omid): Offline shader build (Linux-hosted, DXC). Compiles every entry point of
+#   win32_frame_buffering/shaders/*.hlsl   (VertexShader_* / PixelShader_* functions,
+#                                           "// permutation <stage>: <key> <count>" lines)
+#   learn_hlsl/*.fx                        (entry points taken from the technique passes)
+# to DXIL (and optionally SPIR-V), keeps the reflection of each one, and packs
+# everything into one archive the runtime maps with no compilation (shader_archive.h).
+#
+# Incremental: every object is keyed by a hash of its source, the files it includes,
+# defines, entry, target, dxc arguments and dxc version. Objects whose key did not
+# change are reused from the build directory, and the archive is only rewritten when
+# something changed.
+#
+# Effect files (.fx) are not valid input for DXC; a stripped copy without techniques,
+# state objects and annotations is compiled instead.
+#
+# usage: tools/build_shaders.py [--dxc PATH] [--out FILE] [--spirv] [--jobs N]
+
+import argparse
+import concurrent.futures
+import hashlib
+import itertools
+import json
+import os
+import re
+import struct
+import subprocess
+import sys
+
+REPO_ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# -- must match shader_archive.h
+ARCHIVE_MAGIC = 0x52414853      # 'SHAR'
+ARCHIVE_VERSION = 1
+HEADER_FORMAT = '<IIIIQQ'       # magic, version, entry_count, flags, strings_offset, strings_size
+ENTRY_FORMAT = '<QIIIIQIIQQII'  # lookup_hash, name, entry, target, defines (string offsets),
+                                # dxil_offset, dxil_size, reflection_size, reflection_offset,
+                                # spirv_offset, spirv_size, pad
+ARCHIVE_FLAG_SPIRV = 1
+MANIFEST_VERSION = 1
+
+STAGE_OF_PREFIX = {'VertexShader_': 'vs', 'PixelShader_': 'ps', 'ComputeShader_': 'cs'}
+
+
+def fnv1a64(data, h=14695981039346656037):
+    for b in data:
+        h ^= b
+        h = (h * 1099511628211) & 0xffffffffffffffff
+    return h
+
+
+def canonical_defines(defines):
+    return ';'.join('%s=%s' % (name, value) for name, value in sorted(defines))
+
+
+def lookup_hash(name, entry, stage, defines):
+    key = b''.join(s.encode() + b'\0' for s in (name, entry, stage, canonical_defines(defines)))
+    return fnv1a64(key)
+
+
+class Job:
+    def __init__(self, source, name, entry, stage, defines, strip_fx):
+        self.source = source            # absolute path
+        self.name = name                # what the runtime asks for, e.g. shaders/cbuffer_shader.hlsl
+        self.entry = entry
+        self.stage = stage
+        self.defines = defines          # [(name, value)]
+        self.strip_fx = strip_fx
+        self.key = None
+        self.dxil = self.reflection = self.spirv = None
+
+
+# -- discovery -------------------------------------------------------------------------------------
+
+def hlsl_jobs(path, name):
+    text = open(path, encoding='utf-8', errors='replace').read()
+    keys = {}
+    for stage, key, count in re.findall(r'^//\s*permutation\s+(\w+)\s*:\s*(\w+)\s+(\d+)', text, re.M):
+        keys.setdefault(stage, []).append((key, int(count)))
+    jobs = []
+    for prefix, stage in STAGE_OF_PREFIX.items():
+        for entry in sorted(set(re.findall(r'^\s*(%s\w+)\s*\(' % prefix, text, re.M))):
+            stage_keys = keys.get(stage, [])
+            ranges = [range(count) for _, count in stage_keys]
+            for values in itertools.product(*ranges):
+                defines = [(k, str(v)) for (k, _), v in zip(stage_keys, values)]
+                jobs.append(Job(path, name, entry, stage, defines, False))
+    return jobs
+
+
+def fx_jobs(path, name):
+    text = open(path, encoding='utf-8', errors='replace').read()
+    found = set(re.findall(r'CompileShader\s*\(\s*(vs|ps|gs|hs|ds|cs)_\d_\d\s*,\s*(\w+)\s*\(\s*\)\s*\)', text))
+    return [Job(path, name, entry, stage, [], True) for stage, entry in sorted(found)]
+
+
+def discover(roots):
+    jobs = []
+    for root, pattern, maker in roots:
+        directory = os.path.join(root, pattern[0])
+        if not os.path.isdir(directory):
+            continue
+        for file_name in sorted(os.listdir(directory)):
+            if file_name.endswith(pattern[1]):
+                path = os.path.join(directory, file_name)
+                jobs += maker(path, os.path.relpath(path, root).replace(os.sep, '/'))
+    return jobs
+
+
+# -- effect stripping ------------------------------------------------------------------------------
+
+def remove_blocks(text, head_pattern):
+    """removes 'head { ... }' (braces matched) plus a trailing ';'"""
+    out = []
+    pos = 0
+    for m in re.finditer(head_pattern, text):
+        if m.start() < pos:
+            continue
+        depth = 0
+        i = m.end() - 1
+        while i < len(text):
+            if text[i] == '{':
+                depth += 1
+            elif text[i] == '}':
+                depth -= 1
+                if depth == 0:
+                    break
+            i += 1
+        end = i + 1
+        tail = re.match(r'\s*;', text[end:])
+        if tail:
+            end += tail.end()
+        out.append(text[pos:m.start()])
+        out.append(m.group('keep') + ';' if 'keep' in m.groupdict() and m.group('keep') else '')
+        pos = end
+    out.append(text[pos:])
+    return ''.join(out)
+
+
+def strip_effect(text):
+    text = remove_blocks(text, r'\btechnique(?:10|11)?\s+\w+\s*\{')
+    text = remove_blocks(text, r'\b(?:RasterizerState|BlendState|DepthStencilState)\s+\w+\s*\{')
+    text = remove_blocks(text, r'\b(?P<keep>SamplerState\s+\w+)\s*\{')
+    # -- annotations: < type name = value; ... >
+    text = re.sub(r'<(?:\s*\w+\s+\w+\s*=\s*[^;<>]*;)+\s*>', '', text)
+    # -- effect semantics on constant buffer members (WORLDVIEWPROJECTION, ...)
+    def strip_member_semantics(m):
+        return re.sub(r'(\w+(?:\s*\[\s*\d+\s*\])?)\s*:\s*[A-Za-z_]\w*\s*;', r'\1;', m.group(0))
+    text = re.sub(r'\bcbuffer\s+\w+[^{]*\{[^}]*\}', strip_member_semantics, text)
+    return text
+
+
+# -- hashing / compiling ---------------------------------------------------------------------------
+
+def hash_source_tree(path, h, depth=0):
+    h.update(path.encode() + b'\0')
+    try:
+        text = open(path, 'rb').read()
+    except OSError:
+        h.update(b'<missing>')
+        return
+    h.update(text)
+    if depth >= 16:
+        return
+    for include in re.findall(rb'^\s*#\s*include\s*["<]([^">]+)[">]', text, re.M):
+        hash_source_tree(os.path.join(os.path.dirname(path), include.decode()), h, depth + 1)
+
+
+def dxc_version(dxc):
+    try:
+        out = subprocess.run([dxc, '--version'], capture_output=True, text=True, check=False)
+        return (out.stdout or out.stderr).strip()
+    except OSError:
+        sys.exit('build_shaders: cannot run dxc (%s); install it or pass --dxc' % dxc)
+
+
+def dxc_arguments(job, shader_model, source_path):
+    target = '%s_%s' % (job.stage, shader_model)
+    args = ['-T', target, '-E', job.entry, '-O3', '-I', os.path.dirname(job.source)]
+    for name, value in job.defines:
+        args += ['-D', '%s=%s' % (name, value)]
+    return args + [source_path]
+
+
+def job_key(job, shader_model, version, spirv):
+    h = hashlib.sha256()
+    hash_source_tree(job.source, h)
+    h.update(json.dumps([job.entry, job.stage, job.defines, shader_model, version, spirv, job.strip_fx]).encode())
+    return h.hexdigest()[:32]
+
+
+def compile_job(job, dxc, shader_model, obj_dir, spirv):
+    source = job.source
+    if job.strip_fx:
+        source = os.path.join(obj_dir, job.key + '.stripped.hlsl')
+        with open(source, 'w', encoding='utf-8') as f:
+            f.write(strip_effect(open(job.source, encoding='utf-8', errors='replace').read()))
+    base = os.path.join(obj_dir, job.key)
+    args = dxc_arguments(job, shader_model, source)
+    cmd = [dxc] + args[:-1] + ['-Fo', base + '.dxil', '-Fre', base + '.refl', '-Qstrip_reflect', args[-1]]
+    result = subprocess.run(cmd, capture_output=True, text=True)
+    if result.returncode != 0:
+        return '%s %s %s:\n%s' % (job.name, job.entry, canonical_defines(job.defines), result.stderr)
+    if spirv:
+        cmd = [dxc, '-spirv'] + args[:-1] + ['-Fo', base + '.spv', args[-1]]
+        result = subprocess.run(cmd, capture_output=True, text=True)
+        if result.returncode != 0:
+            return '%s %s (spir-v):\n%s' % (job.name, job.entry, result.stderr)
+    return None
+
+
+# -- archive ---------------------------------------------------------------------------------------
+
+def write_archive(path, jobs, spirv):
+    jobs = sorted(jobs, key=lambda j: lookup_hash(j.name, j.entry, j.stage, j.defines))
+    strings = bytearray()
+    string_offsets = {}
+
+    def string(s):
+        if s not in string_offsets:
+            string_offsets[s] = len(strings)
+            strings.extend(s.encode() + b'\0')
+        return string_offsets[s]
+
+    header_size = struct.calcsize(HEADER_FORMAT)
+    entry_size = struct.calcsize(ENTRY_FORMAT)
+    blob = bytearray()
+    blob_base = header_size + entry_size * len(jobs)
+    entries = bytearray()
+
+    def add_blob(data):
+        if not data:
+            return 0, 0
+        while (blob_base + len(blob)) % 16:
+            blob.append(0)
+        offset = blob_base + len(blob)
+        blob.extend(data)
+        return offset, len(data)
+
+    for job in jobs:
+        dxil_offset, dxil_size = add_blob(job.dxil)
+        reflection_offset, reflection_size = add_blob(job.reflection)
+        spirv_offset, spirv_size = add_blob(job.spirv)
+        entries += struct.pack(
+            ENTRY_FORMAT, lookup_hash(job.name, job.entry, job.stage, job.defines),
+            string(job.name), string(job.entry), string(job.stage), string(canonical_defines(job.defines)),
+            dxil_offset, dxil_size, reflection_size, reflection_offset, spirv_offset, spirv_size, 0)
+    strings_offset = blob_base + len(blob)
+    header = struct.pack(HEADER_FORMAT, ARCHIVE_MAGIC, ARCHIVE_VERSION, len(jobs),
+                         ARCHIVE_FLAG_SPIRV if spirv else 0, strings_offset, len(strings))
+    temp = path + '.tmp'
+    with open(temp, 'wb') as f:
+        f.write(header + entries + blob + strings)
+    os.replace(temp, path)
+
+
+def read(path):
+    try:
+        return open(path, 'rb').read()
+    except OSError:
+        return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description='offline DXC shader build')
+    parser.add_argument('--dxc', default=os.environ.get('DXC', 'dxc'))
+    parser.add_argument('--out', default=os.path.join(REPO_ROOT, 'win32_frame_buffering', 'shaders.pak'))
+    parser.add_argument('--build-dir', default=os.path.join(REPO_ROOT, 'build', 'shaders'))
+    parser.add_argument('--shader-model', default='6_0')
+    parser.add_argument('--spirv', action='store_true', help='also emit SPIR-V')
+    parser.add_argument('--jobs', type=int, default=os.cpu_count() or 1)
+    parser.add_argument('--force', action='store_true', help='ignore the manifest and rebuild everything')
+    args = parser.parse_args()
+
+    roots = [
+        (os.path.join(REPO_ROOT, 'win32_frame_buffering'), ('shaders', '.hlsl'), hlsl_jobs),
+        (REPO_ROOT, ('learn_hlsl', '.fx'), fx_jobs),
+    ]
+    jobs = discover(roots)
+    obj_dir = os.path.join(args.build_dir, 'obj')
+    os.makedirs(obj_dir, exist_ok=True)
+    manifest_path = os.path.join(args.build_dir, 'manifest.json')
+    manifest = {}
+    if not args.force:
+        try:
+            manifest = json.load(open(manifest_path))
+        except (OSError, ValueError):
+            manifest = {}
+    if manifest.get('version') != MANIFEST_VERSION:
+        manifest = {'version': MANIFEST_VERSION, 'keys': []}
+
+    version = dxc_version(args.dxc)
+    stale = []
+    for job in jobs:
+        job.key = job_key(job, args.shader_model, version, args.spirv)
+        base = os.path.join(obj_dir, job.key)
+        if not (os.path.exists(base + '.dxil') and (not args.spirv or os.path.exists(base + '.spv'))):
+            stale.append(job)
+
+    errors = []
+    with concurrent.futures.ThreadPoolExecutor(max_workers=max(1, args.jobs)) as pool:
+        for error in pool.map(lambda j: compile_job(j, args.dxc, args.shader_model, obj_dir, args.spirv), stale):
+            if error:
+                errors.append(error)
+    for error in errors:
+        print(error, file=sys.stderr)
+    if errors:
+        print('build_shaders: %d of %d compiles failed' % (len(errors), len(stale)), file=sys.stderr)
+        return 1
+
+    keys = sorted(job.key for job in jobs)
+    if not stale and manifest.get('keys') == keys and os.path.exists(args.out):
+        print('build_shaders: %d shaders up to date' % len(jobs))
+        return 0
+    for job in jobs:
+        base = os.path.join(obj_dir, job.key)
+        job.dxil = read(base + '.dxil')
+        job.reflection = read(base + '.refl')
+        job.spirv = read(base + '.spv') if args.spirv else None
+    write_archive(args.out, jobs, args.spirv)
+    manifest['keys'] = keys
+    with open(manifest_path, 'w') as f:
+        json.dump(manifest, f, indent=1)
+    print('build_shaders: %d compiled, %d reused, archive %s' % (len(stale), len(jobs) - len(stale), args.out))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,104 @@
+#pragma once
+
+// NOTE(omid): Hands out stable slot indices into the bindless descriptor range.
+// A slot keeps its index for as long as it is alive (shaders receive the index
+// as a root constant, so it must never move). Released slots are only reused
+// once the fence of the last frame that could have referenced them completed;
+// until then they wait in a FIFO (fence values are monotonic). Reuse is LIFO so
+// recently touched descriptors stay warm.
+// This header only depends on the C runtime.
+
+#include "common_macros.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BINDLESS_INDEX_NONE     0xffffffff
+
+struct BindlessRetiredSlot {
+    uint32_t                        index;
+    uint64_t                        fence_value;
+};
+struct BindlessIndexAllocator {
+    uint32_t                        capacity;
+    uint32_t                        bump;               // slots [bump, capacity) were never handed out
+
+    uint32_t *                      free_stack;
+    uint32_t                        free_count;
+
+    BindlessRetiredSlot *           retired;            // ring buffer, oldest first
+    uint32_t                        retired_head;
+    uint32_t                        retired_count;
+
+    // -- stats
+    uint32_t                        live;
+    uint32_t                        high_water;
+    uint32_t                        failed;
+};
+
+static void
+bindless_index_allocator_init (BindlessIndexAllocator * allocator, uint32_t capacity) {
+    ::memset(allocator, 0, sizeof(*allocator));
+    allocator->capacity = capacity;
+    allocator->free_stack = reinterpret_cast<uint32_t *>(::malloc(sizeof(uint32_t) * capacity));
+    allocator->retired = reinterpret_cast<BindlessRetiredSlot *>(::malloc(sizeof(BindlessRetiredSlot) * capacity));
+    SIMPLE_ASSERT(allocator->free_stack && allocator->retired);
+}
+static void
+bindless_index_allocator_destroy (BindlessIndexAllocator * allocator) {
+    ::free(allocator->free_stack);
+    ::free(allocator->retired);
+    ::memset(allocator, 0, sizeof(*allocator));
+}
+// -- move retired slots whose fence has completed to the free stack
+static void
+bindless_index_collect (BindlessIndexAllocator * allocator, uint64_t completed_fence_value) {
+    while (allocator->retired_count > 0) {
+        BindlessRetiredSlot * oldest = &allocator->retired[allocator->retired_head];
+        if (oldest->fence_value > completed_fence_value)
+            break;
+        allocator->free_stack[allocator->free_count++] = oldest->index;
+        allocator->retired_head = (allocator->retired_head + 1) % allocator->capacity;
+        --allocator->retired_count;
+    }
+}
+static uint32_t
+bindless_index_allocate (BindlessIndexAllocator * allocator, uint64_t completed_fence_value) {
+    bindless_index_collect(allocator, completed_fence_value);
+
+    uint32_t ret = BINDLESS_INDEX_NONE;
+    if (allocator->free_count > 0)
+        ret = allocator->free_stack[--allocator->free_count];
+    else if (allocator->bump < allocator->capacity)
+        ret = allocator->bump++;
+
+    if (BINDLESS_INDEX_NONE == ret) {
+        ++allocator->failed;
+        return ret;
+    }
+    ++allocator->live;
+    if (allocator->live > allocator->high_water)
+        allocator->high_water = allocator->live;
+    return ret;
+}
+// -- fence_value: signaled after the last submission that may read the slot
+static void
+bindless_index_release (BindlessIndexAllocator * allocator, uint32_t index, uint64_t fence_value) {
+    SIMPLE_ASSERT(index < allocator->bump && allocator->live > 0);
+    SIMPLE_ASSERT(allocator->retired_count < allocator->capacity);
+    uint32_t tail = (allocator->retired_head + allocator->retired_count) % allocator->capacity;
+    allocator->retired[tail].index = index;
+    allocator->retired[tail].fence_value = fence_value;
+    ++allocator->retired_count;
+    --allocator->live;
+}
+static void
+bindless_index_print_stats (BindlessIndexAllocator const * allocator) {
+    ::printf(
+        "Bindless slots: %u live (high water %u) of %u, %u retired, %u free, %u failed\n",
+        allocator->live, allocator->high_water, allocator->capacity,
+        allocator->retired_count, allocator->free_count, allocator->failed
+    );
+}
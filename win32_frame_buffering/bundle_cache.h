@@ -0,0 +1,306 @@
+#pragma once
+
+// NOTE(omid): Bundles recorded lazily and cached by a hash of everything they
+// record: root signature, pso, vertex buffer views, topology and draw arguments.
+// Static geometry then costs a single ExecuteBundle per object per frame.
+// Bundle allocators come from the CommandAllocatorPool; evicted or invalidated
+// bundles may still be referenced by in-flight command lists, so they are only
+// released after the fence value of their last use has completed. The retired
+// list is swept against the last completed fence the cache saw before it grows.
+
+#include "common_macros.h"
+
+#define BUNDLE_CACHE_CAPACITY               64
+#define BUNDLE_CACHE_SLOT_COUNT             (2 * BUNDLE_CACHE_CAPACITY)     // must be power of two
+#define BUNDLE_CACHE_MAX_VERTEX_BUFFERS     4
+#define BUNDLE_CACHE_EMPTY_SLOT             0xffffffff
+
+struct BundleKey {
+    ID3D12RootSignature *           root_signature;
+    ID3D12PipelineState *           pso;
+    D3D_PRIMITIVE_TOPOLOGY          topology;
+    UINT                            vb_count;
+    D3D12_VERTEX_BUFFER_VIEW        vb_views [BUNDLE_CACHE_MAX_VERTEX_BUFFERS];
+    UINT                            vertex_count_per_instance;
+    UINT                            instance_count;
+    UINT                            start_vertex;
+    UINT                            start_instance;
+};
+struct BundleCacheEntry {
+    BundleKey                       key;
+    UINT64                          hash;
+    ID3D12GraphicsCommandList *     bundle;
+    ID3D12CommandAllocator *        allocator;
+    UINT64                          last_used_frame;
+    UINT64                          last_used_fence_value;
+    bool                            used;
+};
+struct RetiredBundle {
+    ID3D12GraphicsCommandList *     bundle;
+    UINT64                          fence_value;
+};
+struct BundleCacheStats {
+    UINT64                          hits;
+    UINT64                          misses;
+    UINT64                          evictions;
+    UINT64                          invalidations;
+};
+struct BundleCache {
+    ID3D12Device *                  device;
+    CommandAllocatorPool *          allocator_pool;
+
+    BundleCacheEntry                entries [BUNDLE_CACHE_CAPACITY];
+    UINT                            slots [BUNDLE_CACHE_SLOT_COUNT];     // hash -> entry index (open addressing)
+
+    RetiredBundle *                 retired;
+    UINT                            retired_count;
+    UINT                            retired_capacity;
+    UINT64                          completed_fence_value;  // last value passed to get/next_frame
+
+    UINT64                          frame;
+    BundleCacheStats                stats;
+};
+
+// -- a key must be zero-initialized before filling it, so padding bytes hash deterministically
+static BundleKey
+bundle_key_make (
+    ID3D12RootSignature * root_signature, ID3D12PipelineState * pso, D3D_PRIMITIVE_TOPOLOGY topology,
+    UINT vb_count, D3D12_VERTEX_BUFFER_VIEW const * vb_views,
+    UINT vertex_count_per_instance, UINT instance_count, UINT start_vertex, UINT start_instance
+) {
+    SIMPLE_ASSERT(vb_count <= BUNDLE_CACHE_MAX_VERTEX_BUFFERS);
+    BundleKey key;
+    ::memset(&key, 0, sizeof(key));
+    key.root_signature = root_signature;
+    key.pso = pso;
+    key.topology = topology;
+    key.vb_count = vb_count;
+    for (UINT i = 0; i < vb_count; ++i)
+        key.vb_views[i] = vb_views[i];
+    key.vertex_count_per_instance = vertex_count_per_instance;
+    key.instance_count = instance_count;
+    key.start_vertex = start_vertex;
+    key.start_instance = start_instance;
+    return key;
+}
+static UINT64
+bundle_key_hash (BundleKey const * key) {
+    return fnv1a_64(key, sizeof(*key), FNV1A_64_SEED);
+}
+static void
+bundle_cache_init (BundleCache * cache, ID3D12Device * device, CommandAllocatorPool * allocator_pool) {
+    ::memset(cache, 0, sizeof(*cache));
+    cache->device = device;
+    cache->allocator_pool = allocator_pool;
+    for (UINT i = 0; i < BUNDLE_CACHE_SLOT_COUNT; ++i)
+        cache->slots[i] = BUNDLE_CACHE_EMPTY_SLOT;
+    cache->retired = (RetiredBundle *)::malloc(BUNDLE_CACHE_SLOT_COUNT * sizeof(RetiredBundle));
+    cache->retired_capacity = cache->retired ? BUNDLE_CACHE_SLOT_COUNT : 0;
+}
+static void
+bundle_cache_rebuild_slots (BundleCache * cache) {
+    for (UINT i = 0; i < BUNDLE_CACHE_SLOT_COUNT; ++i)
+        cache->slots[i] = BUNDLE_CACHE_EMPTY_SLOT;
+    for (UINT e = 0; e < BUNDLE_CACHE_CAPACITY; ++e) {
+        if (!cache->entries[e].used)
+            continue;
+        UINT slot = (UINT)(cache->entries[e].hash & (BUNDLE_CACHE_SLOT_COUNT - 1));
+        while (cache->slots[slot] != BUNDLE_CACHE_EMPTY_SLOT)
+            slot = (slot + 1) & (BUNDLE_CACHE_SLOT_COUNT - 1);
+        cache->slots[slot] = e;
+    }
+}
+// -- release retired bundles whose last submission has completed
+static void
+bundle_cache_collect (BundleCache * cache, UINT64 completed_fence_value) {
+    UINT i = 0;
+    while (i < cache->retired_count) {
+        if (cache->retired[i].fence_value <= completed_fence_value) {
+            cache->retired[i].bundle->Release();
+            cache->retired[i] = cache->retired[--cache->retired_count];
+        } else {
+            ++i;
+        }
+    }
+}
+// -- drop an entry; its bundle and allocator are recycled once the gpu is done with them.
+// Returns false (and leaves the entry live) if the retired list is full and cannot grow.
+static bool
+bundle_cache_remove_entry (BundleCache * cache, UINT entry_index) {
+    BundleCacheEntry * entry = &cache->entries[entry_index];
+    SIMPLE_ASSERT(entry->used);
+
+    if (cache->retired_count == cache->retired_capacity)
+        bundle_cache_collect(cache, cache->completed_fence_value);
+    if (cache->retired_count == cache->retired_capacity) {
+        UINT capacity = cache->retired_capacity ? 2 * cache->retired_capacity : BUNDLE_CACHE_SLOT_COUNT;
+        RetiredBundle * retired = (RetiredBundle *)::realloc(cache->retired, capacity * sizeof(RetiredBundle));
+        if (nullptr == retired)
+            return false;
+        cache->retired = retired;
+        cache->retired_capacity = capacity;
+    }
+    cache->retired[cache->retired_count].bundle = entry->bundle;
+    cache->retired[cache->retired_count].fence_value = entry->last_used_fence_value;
+    ++cache->retired_count;
+    command_allocator_pool_release(cache->allocator_pool, D3D12_COMMAND_LIST_TYPE_BUNDLE, entry->allocator, entry->last_used_fence_value);
+
+    ::memset(entry, 0, sizeof(*entry));
+    return true;
+}
+static UINT
+bundle_cache_find (BundleCache * cache, BundleKey const * key, UINT64 hash) {
+    UINT slot = (UINT)(hash & (BUNDLE_CACHE_SLOT_COUNT - 1));
+    while (cache->slots[slot] != BUNDLE_CACHE_EMPTY_SLOT) {
+        BundleCacheEntry * entry = &cache->entries[cache->slots[slot]];
+        if (entry->hash == hash && 0 == ::memcmp(&entry->key, key, sizeof(*key)))
+            return cache->slots[slot];
+        slot = (slot + 1) & (BUNDLE_CACHE_SLOT_COUNT - 1);
+    }
+    return BUNDLE_CACHE_EMPTY_SLOT;
+}
+static UINT
+bundle_cache_evict_lru (BundleCache * cache) {
+    UINT victim = 0;
+    for (UINT e = 1; e < BUNDLE_CACHE_CAPACITY; ++e) {
+        if (cache->entries[e].last_used_frame < cache->entries[victim].last_used_frame)
+            victim = e;
+    }
+    if (!bundle_cache_remove_entry(cache, victim))
+        return BUNDLE_CACHE_EMPTY_SLOT;
+    ++cache->stats.evictions;
+    return victim;
+}
+static void
+bundle_cache_record (BundleCache * cache, BundleCacheEntry * entry, UINT64 completed_fence_value) {
+    BundleKey const * key = &entry->key;
+    entry->allocator = command_allocator_pool_acquire(cache->allocator_pool, D3D12_COMMAND_LIST_TYPE_BUNDLE, completed_fence_value);
+    CHECK_AND_FAIL(cache->device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_BUNDLE, entry->allocator, key->pso, IID_PPV_ARGS(&entry->bundle)));
+    entry->bundle->SetGraphicsRootSignature(key->root_signature);
+    entry->bundle->IASetPrimitiveTopology(key->topology);
+    entry->bundle->IASetVertexBuffers(0, key->vb_count, key->vb_views);
+    entry->bundle->DrawInstanced(key->vertex_count_per_instance, key->instance_count, key->start_vertex, key->start_instance);
+    CHECK_AND_FAIL(entry->bundle->Close());
+}
+// NOTE(omid): Returns a closed bundle for key, recording it on first use.
+// fence_value is the value the current frame will signal once submitted,
+// completed_fence_value is the fence's current completed value.
+// Returns nullptr if the cache is full and its victim could not be retired.
+static ID3D12GraphicsCommandList *
+bundle_cache_get (BundleCache * cache, BundleKey const * key, UINT64 fence_value, UINT64 completed_fence_value) {
+    cache->completed_fence_value = completed_fence_value;
+    UINT64 hash = bundle_key_hash(key);
+    UINT index = bundle_cache_find(cache, key, hash);
+    if (index != BUNDLE_CACHE_EMPTY_SLOT) {
+        ++cache->stats.hits;
+    } else {
+        ++cache->stats.misses;
+        bundle_cache_collect(cache, completed_fence_value);
+
+        // -- find a free entry or evict the least recently used one
+        for (index = 0; index < BUNDLE_CACHE_CAPACITY; ++index) {
+            if (!cache->entries[index].used)
+                break;
+        }
+        if (index == BUNDLE_CACHE_CAPACITY) {
+            index = bundle_cache_evict_lru(cache);
+            if (index == BUNDLE_CACHE_EMPTY_SLOT)
+                return nullptr;
+            bundle_cache_rebuild_slots(cache);
+        }
+
+        BundleCacheEntry * entry = &cache->entries[index];
+        entry->key = *key;
+        entry->hash = hash;
+        entry->used = true;
+        bundle_cache_record(cache, entry, completed_fence_value);
+
+        UINT slot = (UINT)(hash & (BUNDLE_CACHE_SLOT_COUNT - 1));
+        while (cache->slots[slot] != BUNDLE_CACHE_EMPTY_SLOT)
+            slot = (slot + 1) & (BUNDLE_CACHE_SLOT_COUNT - 1);
+        cache->slots[slot] = index;
+    }
+    BundleCacheEntry * entry = &cache->entries[index];
+    entry->last_used_frame = cache->frame;
+    entry->last_used_fence_value = fence_value;
+    return entry->bundle;
+}
+// -- call once per frame so LRU ordering advances
+static void
+bundle_cache_next_frame (BundleCache * cache, UINT64 completed_fence_value) {
+    ++cache->frame;
+    cache->completed_fence_value = completed_fence_value;
+    bundle_cache_collect(cache, completed_fence_value);
+}
+// NOTE(omid): Invalidate every bundle that reads from the gpu address range
+// [buffer_location, buffer_location + size), e.g. when a vertex buffer is replaced.
+static UINT
+bundle_cache_invalidate_buffer (BundleCache * cache, D3D12_GPU_VIRTUAL_ADDRESS buffer_location, UINT64 size) {
+    UINT removed = 0;
+    for (UINT e = 0; e < BUNDLE_CACHE_CAPACITY; ++e) {
+        BundleCacheEntry * entry = &cache->entries[e];
+        if (!entry->used)
+            continue;
+        for (UINT v = 0; v < entry->key.vb_count; ++v) {
+            D3D12_VERTEX_BUFFER_VIEW const * view = &entry->key.vb_views[v];
+            if (view->BufferLocation < buffer_location + size && buffer_location < view->BufferLocation + view->SizeInBytes) {
+                if (bundle_cache_remove_entry(cache, e))
+                    ++removed;
+                break;
+            }
+        }
+    }
+    if (removed > 0) {
+        bundle_cache_rebuild_slots(cache);
+        cache->stats.invalidations += removed;
+    }
+    return removed;
+}
+// -- invalidate every bundle recorded with the given pso and/or root signature (nullptr matches nothing)
+static UINT
+bundle_cache_invalidate_pipeline (BundleCache * cache, ID3D12PipelineState * pso, ID3D12RootSignature * root_signature) {
+    UINT removed = 0;
+    for (UINT e = 0; e < BUNDLE_CACHE_CAPACITY; ++e) {
+        BundleCacheEntry * entry = &cache->entries[e];
+        if (!entry->used)
+            continue;
+        if ((pso && entry->key.pso == pso) || (root_signature && entry->key.root_signature == root_signature)) {
+            if (bundle_cache_remove_entry(cache, e))
+                ++removed;
+        }
+    }
+    if (removed > 0) {
+        bundle_cache_rebuild_slots(cache);
+        cache->stats.invalidations += removed;
+    }
+    return removed;
+}
+static void
+bundle_cache_print_stats (BundleCache * cache) {
+    UINT live = 0;
+    for (UINT e = 0; e < BUNDLE_CACHE_CAPACITY; ++e)
+        live += cache->entries[e].used ? 1 : 0;
+    ::printf(
+        "Bundle cache: %u live, %llu hits, %llu misses, %llu evictions, %llu invalidations\n",
+        live, (unsigned long long)cache->stats.hits, (unsigned long long)cache->stats.misses,
+        (unsigned long long)cache->stats.evictions, (unsigned long long)cache->stats.invalidations
+    );
+}
+// -- caller must make sure the gpu is idle; allocators go back to the pool
+static void
+bundle_cache_destroy (BundleCache * cache) {
+    for (UINT e = 0; e < BUNDLE_CACHE_CAPACITY; ++e) {
+        BundleCacheEntry * entry = &cache->entries[e];
+        if (!entry->used)
+            continue;
+        entry->bundle->Release();
+        command_allocator_pool_release(cache->allocator_pool, D3D12_COMMAND_LIST_TYPE_BUNDLE, entry->allocator, entry->last_used_fence_value);
+        ::memset(entry, 0, sizeof(*entry));
+    }
+    for (UINT i = 0; i < cache->retired_count; ++i)
+        cache->retired[i].bundle->Release();
+    ::free(cache->retired);
+    cache->retired = nullptr;
+    cache->retired_count = 0;
+    cache->retired_capacity = 0;
+}
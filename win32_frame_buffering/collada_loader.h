@@ -0,0 +1,1052 @@
+#pragma once
+
+// NOTE(omid): Streaming COLLADA (1.4) importer for the FX Composer scenes in
+// learn_hlsl (Document1.dae). The file is read in fixed-size chunks and tokenized
+// SAX-style: tags are reported as start / end events and the numeric text of
+// float_array, p, vcount and the node transforms is parsed straight out of the read
+// buffer, so the document is never held in memory and no DOM or text copies are
+// built. A token cut by the end of a chunk is moved to the front of the buffer
+// before the next read.
+//
+// What it understands:
+//   geometry/mesh     sources (float_array + accessor stride), vertices,
+//                     triangles / polygons / polylist (fan-triangulated)
+//   visual_scene      nested nodes with matrix / translate / scale / rotate, and
+//                     instance_geometry; scene/instance_visual_scene picks the active one
+//
+// Output is flat: one vertex array and one index array for all meshes (indices are
+// relative to the mesh's first vertex, for base-vertex draws) plus a node list with
+// local and world matrices. Matrices keep COLLADA's layout: row-major, column
+// vectors (translation in the last column). Index tuples are de-duplicated per mesh,
+// so a position shared with different normals / uvs becomes separate vertices.
+// This header only depends on the C runtime.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define COLLADA_CHUNK_SIZE          (256 * 1024)
+#define COLLADA_MAX_NAME            64
+#define COLLADA_MAX_ATTRIBUTES      16
+#define COLLADA_MAX_ATTRIBUTE_VALUE 128
+#define COLLADA_MAX_SOURCES         16
+#define COLLADA_MAX_INPUTS          8
+#define COLLADA_MAX_NODE_DEPTH      32
+#define COLLADA_NONE                0xffffffffu
+
+// =========================================================================================================
+// -- xml tokenizer over a chunked file
+
+enum XmlEvent : uint32_t {
+    XmlEvent_Start = 0,
+    XmlEvent_End,
+    XmlEvent_Eof,
+    XmlEvent_Error,
+};
+struct XmlStream {
+    FILE *                          file;
+    char *                          buffer;
+    size_t                          capacity;
+    size_t                          pos;
+    size_t                          end;
+    bool                            eof;
+    bool                            error;
+    uint64_t                        bytes_read;
+    uint32_t                        refills;
+
+    // -- current tag (copied out of the buffer, valid until the next event)
+    char                            name [COLLADA_MAX_NAME];
+    char                            attribute_names [COLLADA_MAX_ATTRIBUTES][COLLADA_MAX_NAME];
+    char                            attribute_values [COLLADA_MAX_ATTRIBUTES][COLLADA_MAX_ATTRIBUTE_VALUE];
+    uint32_t                        attribute_count;
+    bool                            self_closing;
+    bool                            pending_end;        // end event owed for a self-closing tag
+};
+
+static bool
+xml_stream_open (XmlStream * xml, char const * path, size_t chunk_size) {
+    ::memset(xml, 0, sizeof(*xml));
+    xml->file = ::fopen(path, "rb");
+    if (!xml->file)
+        return false;
+    xml->capacity = chunk_size;
+    xml->buffer = reinterpret_cast<char *>(::malloc(chunk_size));
+    if (!xml->buffer) {
+        ::fclose(xml->file);
+        xml->file = nullptr;
+        return false;
+    }
+    return true;
+}
+static void
+xml_stream_close (XmlStream * xml) {
+    if (xml->file)
+        ::fclose(xml->file);
+    ::free(xml->buffer);
+    xml->file = nullptr;
+    xml->buffer = nullptr;
+}
+// -- keeps [pos, end), moves it to the front and reads behind it; false if nothing new arrived
+static bool
+xml_refill (XmlStream * xml) {
+    if (xml->eof)
+        return false;
+    size_t keep = xml->end - xml->pos;
+    if (keep == xml->capacity) {
+        xml->error = true;      // a single token larger than the buffer
+        return false;
+    }
+    ::memmove(xml->buffer, xml->buffer + xml->pos, keep);
+    xml->pos = 0;
+    xml->end = keep;
+    size_t got = ::fread(xml->buffer + keep, 1, xml->capacity - keep, xml->file);
+    xml->end += got;
+    xml->bytes_read += got;
+    ++xml->refills;
+    if (got < xml->capacity - keep)
+        xml->eof = true;
+    return got > 0;
+}
+static bool
+xml_is_space (char c) {
+    return ' ' == c || '\n' == c || '\r' == c || '\t' == c;
+}
+static void
+xml_copy (char * dst, size_t dst_size, char const * begin, char const * end) {
+    size_t len = (size_t)(end - begin);
+    if (len >= dst_size)
+        len = dst_size - 1;
+    ::memcpy(dst, begin, len);
+    dst[len] = '\0';
+}
+// -- finds needle at or after pos, refilling as needed; returns its offset from pos or SIZE_MAX
+static size_t
+xml_find (XmlStream * xml, char const * needle) {
+    size_t needle_len = ::strlen(needle);
+    size_t from = 0;
+    for (;;) {
+        size_t avail = xml->end - xml->pos;
+        for (size_t i = from; i + needle_len <= avail; ) {
+            char const * hit = reinterpret_cast<char const *>(::memchr(xml->buffer + xml->pos + i, needle[0], avail - i));
+            if (!hit)
+                break;
+            i = (size_t)(hit - (xml->buffer + xml->pos));
+            if (i + needle_len <= avail && 0 == ::memcmp(hit, needle, needle_len))
+                return i;
+            ++i;
+        }
+        // -- offsets stay relative to pos across the refill
+        from = avail >= needle_len ? avail - needle_len + 1 : 0;
+        if (!xml_refill(xml))
+            return SIZE_MAX;
+    }
+}
+static char const *
+xml_attribute (XmlStream const * xml, char const * name) {
+    for (uint32_t i = 0; i < xml->attribute_count; ++i) {
+        if (0 == ::strcmp(xml->attribute_names[i], name))
+            return xml->attribute_values[i];
+    }
+    return nullptr;
+}
+static uint32_t
+xml_attribute_uint (XmlStream const * xml, char const * name, uint32_t fallback) {
+    char const * value = xml_attribute(xml, name);
+    return value ? (uint32_t)::strtoul(value, nullptr, 10) : fallback;
+}
+// NOTE(omid): Text between tags is skipped here; elements whose text matters read
+// it with xml_text_token right after their start event.
+static XmlEvent
+xml_next (XmlStream * xml) {
+    if (xml->pending_end) {
+        xml->pending_end = false;
+        xml->self_closing = false;
+        return XmlEvent_End;
+    }
+    for (;;) {
+        // -- skip text up to the next '<'
+        char const * lt = nullptr;
+        while (nullptr == (lt = reinterpret_cast<char const *>(::memchr(xml->buffer + xml->pos, '<', xml->end - xml->pos)))) {
+            xml->pos = xml->end;
+            if (!xml_refill(xml))
+                return xml->error ? XmlEvent_Error : XmlEvent_Eof;
+        }
+        xml->pos = (size_t)(lt - xml->buffer);
+
+        // -- the whole tag must be in the buffer
+        if (xml->end - xml->pos < 4 && !xml->eof)
+            xml_refill(xml);
+        char const * tag = xml->buffer + xml->pos;
+        size_t avail = xml->end - xml->pos;
+        if (avail >= 4 && 0 == ::memcmp(tag, "<!--", 4)) {
+            size_t close = xml_find(xml, "-->");
+            if (SIZE_MAX == close)
+                return XmlEvent_Error;
+            xml->pos += close + 3;
+            continue;
+        }
+        size_t close = xml_find(xml, ">");
+        if (SIZE_MAX == close)
+            return XmlEvent_Error;
+        tag = xml->buffer + xml->pos;
+        char const * tag_end = tag + close;     // at '>'
+        xml->pos += close + 1;
+        if ('?' == tag[1] || '!' == tag[1])
+            continue;       // declaration / doctype
+
+        xml->attribute_count = 0;
+        xml->self_closing = false;
+        if ('/' == tag[1]) {
+            char const * name_end = tag + 2;
+            while (name_end < tag_end && !xml_is_space(*name_end))
+                ++name_end;
+            xml_copy(xml->name, sizeof(xml->name), tag + 2, name_end);
+            return XmlEvent_End;
+        }
+        if ('/' == tag_end[-1]) {
+            xml->self_closing = true;
+            xml->pending_end = true;
+            --tag_end;
+        }
+        char const * c = tag + 1;
+        char const * name_end = c;
+        while (name_end < tag_end && !xml_is_space(*name_end))
+            ++name_end;
+        xml_copy(xml->name, sizeof(xml->name), c, name_end);
+        c = name_end;
+        for (;;) {
+            while (c < tag_end && xml_is_space(*c))
+                ++c;
+            if (c >= tag_end)
+                break;
+            char const * attribute_name = c;
+            while (c < tag_end && '=' != *c && !xml_is_space(*c))
+                ++c;
+            char const * attribute_name_end = c;
+            while (c < tag_end && '"' != *c && '\'' != *c)
+                ++c;
+            if (c >= tag_end)
+                return XmlEvent_Error;
+            char quote = *c++;
+            char const * value = c;
+            while (c < tag_end && quote != *c)
+                ++c;
+            if (c >= tag_end)
+                return XmlEvent_Error;
+            if (xml->attribute_count < COLLADA_MAX_ATTRIBUTES) {
+                xml_copy(xml->attribute_names[xml->attribute_count], COLLADA_MAX_NAME, attribute_name, attribute_name_end);
+                xml_copy(xml->attribute_values[xml->attribute_count], COLLADA_MAX_ATTRIBUTE_VALUE, value, c);
+                ++xml->attribute_count;
+            }
+            ++c;
+        }
+        return XmlEvent_Start;
+    }
+}
+// -- next whitespace-separated token of the element's text; false at the closing '<' (or on error)
+static bool
+xml_text_token (XmlStream * xml, char const ** out_begin, char const ** out_end) {
+    if (xml->self_closing)
+        return false;
+    for (;;) {
+        while (xml->pos < xml->end && xml_is_space(xml->buffer[xml->pos]))
+            ++xml->pos;
+        if (xml->pos == xml->end) {
+            if (!xml_refill(xml))
+                return false;
+            continue;
+        }
+        if ('<' == xml->buffer[xml->pos])
+            return false;
+        size_t i = xml->pos;
+        while (i < xml->end && !xml_is_space(xml->buffer[i]) && '<' != xml->buffer[i])
+            ++i;
+        if (i == xml->end && !xml->eof) {
+            // -- the token may continue in the next chunk
+            if (!xml_refill(xml) && xml->error)
+                return false;
+            continue;
+        }
+        *out_begin = xml->buffer + xml->pos;
+        *out_end = xml->buffer + i;
+        xml->pos = i;
+        return true;
+    }
+}
+
+// =========================================================================================================
+// -- number parsing
+
+// NOTE(omid): SWAR digit handling: eight ASCII digits are validated and converted
+// in a few 64-bit operations instead of eight multiply-adds (little-endian loads).
+static uint64_t
+collada_load8 (char const * p) {
+    uint64_t v;
+    ::memcpy(&v, p, sizeof(v));
+    return v;
+}
+static bool
+collada_is_eight_digits (uint64_t v) {
+    return 0 == (((v & 0xF0F0F0F0F0F0F0F0ull) | (((v + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) ^ 0x3333333333333333ull);
+}
+static uint32_t
+collada_parse_eight_digits (uint64_t v) {
+    v -= 0x3030303030303030ull;
+    v = (v * 10) + (v >> 8);
+    v = (((v & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) +
+         (((v >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+    return (uint32_t)v;
+}
+// -- digits into mantissa (up to 19 significant), counting the ones that did not fit
+static char const *
+collada_parse_digits (char const * p, char const * end, uint64_t * mantissa, int * significant, int * dropped) {
+    while (end - p >= 8 && *significant + 8 <= 19 && collada_is_eight_digits(collada_load8(p))) {
+        *mantissa = *mantissa * 100000000ull + collada_parse_eight_digits(collada_load8(p));
+        if (*mantissa)
+            *significant += 8;
+        p += 8;
+    }
+    for (; p < end && (unsigned)(*p - '0') < 10; ++p) {
+        if (*significant < 19) {
+            *mantissa = *mantissa * 10 + (uint64_t)(*p - '0');
+            if (*mantissa)
+                ++*significant;
+        } else {
+            ++*dropped;
+        }
+    }
+    return p;
+}
+// NOTE(omid): Not correctly rounded in every case, but exact for the usual
+// "-1.63752e-008" style values: up to 19 digits are gathered into an integer and
+// scaled once by an exact power of ten.
+static bool
+collada_parse_float (char const * p, char const * end, float * out) {
+    static double const powers [] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    bool negative = false;
+    if (p < end && ('-' == *p || '+' == *p))
+        negative = '-' == *p++;
+    char const * digits_begin = p;
+    uint64_t mantissa = 0;
+    int significant = 0, dropped = 0;
+    p = collada_parse_digits(p, end, &mantissa, &significant, &dropped);
+    int exponent = dropped;
+    if (p < end && '.' == *p) {
+        ++p;
+        int dropped_before = dropped;
+        char const * fraction_begin = p;
+        p = collada_parse_digits(p, end, &mantissa, &significant, &dropped);
+        // -- every fraction digit that made it into the mantissa shifts the point
+        exponent -= (int)(p - fraction_begin) - (dropped - dropped_before);
+    }
+    if (p == digits_begin)
+        return false;
+    if (p < end && ('e' == *p || 'E' == *p)) {
+        ++p;
+        bool negative_exponent = false;
+        if (p < end && ('-' == *p || '+' == *p))
+            negative_exponent = '-' == *p++;
+        if (p == end)
+            return false;
+        int e = 0;
+        for (; p < end && (unsigned)(*p - '0') < 10; ++p)
+            e = e < 10000 ? e * 10 + (*p - '0') : e;
+        exponent += negative_exponent ? -e : e;
+    }
+    if (p != end)
+        return false;
+    double value = (double)mantissa;
+    if (0 == mantissa)
+        value = 0.0;
+    else if (exponent >= 0 && exponent <= 22)
+        value *= powers[exponent];
+    else if (exponent < 0 && exponent >= -22)
+        value /= powers[-exponent];
+    else
+        value *= ::pow(10.0, (double)exponent);
+    *out = (float)(negative ? -value : value);
+    return true;
+}
+static bool
+collada_parse_uint (char const * p, char const * end, uint32_t * out) {
+    uint64_t value = 0;
+    if (p == end)
+        return false;
+    if (end - p >= 8 && collada_is_eight_digits(collada_load8(p))) {
+        value = collada_parse_eight_digits(collada_load8(p));
+        p += 8;
+    }
+    for (; p < end; ++p) {
+        if ((unsigned)(*p - '0') >= 10)
+            return false;
+        value = value * 10 + (uint64_t)(*p - '0');
+        if (value > 0xffffffffull)
+            return false;
+    }
+    *out = (uint32_t)value;
+    return true;
+}
+
+// =========================================================================================================
+// -- scene
+
+struct ColladaVertex {
+    float                           position [3];
+    float                           normal [3];
+    float                           uv [2];
+};
+struct ColladaMesh {
+    char                            id [COLLADA_MAX_NAME];
+    char                            name [COLLADA_MAX_NAME];
+    char                            material [COLLADA_MAX_NAME];   // of the first primitive group
+    uint32_t                        first_vertex;
+    uint32_t                        vertex_count;
+    uint32_t                        first_index;
+    uint32_t                        index_count;    // indices are relative to first_vertex
+    float                           bounds_min [3];
+    float                           bounds_max [3];
+};
+struct ColladaNode {
+    char                            id [COLLADA_MAX_NAME];
+    char                            name [COLLADA_MAX_NAME];
+    char                            geometry_url [COLLADA_MAX_NAME];
+    uint32_t                        scene;
+    uint32_t                        parent;         // COLLADA_NONE for roots
+    uint32_t                        mesh;           // COLLADA_NONE if the node instances nothing
+    float                           local [16];     // row-major, column vectors
+    float                           world [16];
+};
+struct ColladaVisualScene {
+    char                            id [COLLADA_MAX_NAME];
+    char                            name [COLLADA_MAX_NAME];
+    uint32_t                        first_node;
+    uint32_t                        node_count;
+};
+struct ColladaStats {
+    uint64_t                        bytes;
+    uint32_t                        refills;
+    uint64_t                        floats_parsed;
+    uint64_t                        indices_parsed;
+    uint32_t                        polygons;
+    uint32_t                        triangles;
+};
+struct ColladaScene {
+    ColladaVertex *                 vertices;
+    uint32_t                        vertex_count;
+    uint32_t                        vertex_capacity;
+    uint32_t *                      indices;
+    uint32_t                        index_count;
+    uint32_t                        index_capacity;
+    ColladaMesh *                   meshes;
+    uint32_t                        mesh_count;
+    uint32_t                        mesh_capacity;
+    ColladaNode *                   nodes;
+    uint32_t                        node_count;
+    uint32_t                        node_capacity;
+    ColladaVisualScene *            visual_scenes;
+    uint32_t                        visual_scene_count;
+    uint32_t                        visual_scene_capacity;
+    uint32_t                        active_scene;
+    ColladaStats                    stats;
+};
+
+// -- grows *data to hold at least needed elements (doubling); false when out of memory
+static bool
+collada_reserve (void ** data, uint32_t * capacity, uint64_t needed, size_t element_size) {
+    if (needed <= *capacity)
+        return true;
+    if (needed > 0xffffffffull)
+        return false;
+    uint64_t new_capacity = *capacity ? *capacity : 64;
+    while (new_capacity < needed)
+        new_capacity *= 2;
+    if (new_capacity > 0xffffffffull)
+        new_capacity = 0xffffffffull;
+    void * grown = ::realloc(*data, (size_t)new_capacity * element_size);
+    if (!grown)
+        return false;
+    *data = grown;
+    *capacity = (uint32_t)new_capacity;
+    return true;
+}
+#define COLLADA_RESERVE(array, capacity, needed) \
+    collada_reserve(reinterpret_cast<void **>(&(array)), &(capacity), (needed), sizeof(*(array)))
+
+static void
+collada_matrix_identity (float * m) {
+    ::memset(m, 0, 16 * sizeof(float));
+    m[0] = m[5] = m[10] = m[15] = 1.0f;
+}
+// -- out = a * b (row-major); out may alias a or b
+static void
+collada_matrix_multiply (float const * a, float const * b, float * out) {
+    float r [16];
+    for (int row = 0; row < 4; ++row) {
+        for (int col = 0; col < 4; ++col) {
+            r[row * 4 + col] =
+                a[row * 4 + 0] * b[0 * 4 + col] + a[row * 4 + 1] * b[1 * 4 + col] +
+                a[row * 4 + 2] * b[2 * 4 + col] + a[row * 4 + 3] * b[3 * 4 + col];
+        }
+    }
+    ::memcpy(out, r, sizeof(r));
+}
+
+enum ColladaSemantic : uint32_t {
+    ColladaSemantic_Position = 0,
+    ColladaSemantic_Normal,
+    ColladaSemantic_Texcoord,
+    ColladaSemantic_Vertex,
+    ColladaSemantic_Other,
+};
+enum ColladaPrimitive : uint32_t {
+    ColladaPrimitive_Triangles = 0,
+    ColladaPrimitive_Polygons,
+    ColladaPrimitive_Polylist,
+};
+struct ColladaSource {
+    char                            id [COLLADA_MAX_NAME];
+    uint32_t                        first;          // into ColladaImport::floats
+    uint32_t                        count;
+    uint32_t                        stride;
+};
+struct ColladaInput {
+    ColladaSemantic                 semantic;
+    uint32_t                        offset;
+    uint32_t                        set;
+    char                            source [COLLADA_MAX_NAME];  // without the '#'
+};
+// -- parser state; scratch arrays are reused across geometries
+struct ColladaImport {
+    XmlStream                       xml;
+    ColladaScene *                  scene;
+
+    bool                            in_geometry;
+    bool                            in_vertices;
+    bool                            in_primitive;
+    ColladaMesh *                   mesh;
+
+    ColladaSource                   sources [COLLADA_MAX_SOURCES];
+    uint32_t                        source_count;
+    float *                         floats;
+    uint32_t                        float_count;
+    uint32_t                        float_capacity;
+
+    ColladaInput                    vertex_inputs [COLLADA_MAX_INPUTS];
+    uint32_t                        vertex_input_count;
+    char                            vertices_id [COLLADA_MAX_NAME];
+
+    ColladaPrimitive                primitive;
+    ColladaInput                    inputs [COLLADA_MAX_INPUTS];
+    uint32_t                        input_count;
+    uint32_t *                      prim_indices;
+    uint32_t                        prim_index_count;
+    uint32_t                        prim_index_capacity;
+    uint32_t *                      prim_sizes;     // corners per polygon (polygons / polylist)
+    uint32_t                        prim_size_count;
+    uint32_t                        prim_size_capacity;
+
+    // -- per mesh (position, normal, uv) index tuple -> vertex, open addressing
+    uint32_t *                      tuples;
+    uint32_t                        tuple_capacity;
+    uint32_t *                      table;
+    uint32_t                        table_size;     // power of two
+    uint32_t                        table_used;
+
+    uint32_t                        node_stack [COLLADA_MAX_NODE_DEPTH];
+    uint32_t                        node_depth;
+    bool                            in_visual_scene;
+    char                            active_scene_url [COLLADA_MAX_NAME];
+};
+
+static ColladaSemantic
+collada_semantic (char const * name) {
+    if (!name)                              return ColladaSemantic_Other;
+    if (0 == ::strcmp(name, "POSITION"))    return ColladaSemantic_Position;
+    if (0 == ::strcmp(name, "NORMAL"))      return ColladaSemantic_Normal;
+    if (0 == ::strcmp(name, "TEXCOORD"))    return ColladaSemantic_Texcoord;
+    if (0 == ::strcmp(name, "VERTEX"))      return ColladaSemantic_Vertex;
+    return ColladaSemantic_Other;
+}
+static void
+collada_read_input (XmlStream const * xml, ColladaInput * input) {
+    char const * source = xml_attribute(xml, "source");
+    input->semantic = collada_semantic(xml_attribute(xml, "semantic"));
+    input->offset = xml_attribute_uint(xml, "offset", 0);
+    input->set = xml_attribute_uint(xml, "set", 0);
+    ::snprintf(input->source, sizeof(input->source), "%s", source ? ('#' == source[0] ? source + 1 : source) : "");
+}
+static ColladaSource const *
+collada_find_source (ColladaImport const * import, char const * id) {
+    for (uint32_t i = 0; i < import->source_count; ++i) {
+        if (0 == ::strcmp(import->sources[i].id, id))
+            return &import->sources[i];
+    }
+    return nullptr;
+}
+// -- reads the element's numbers into floats[float_count...]; returns how many
+static bool
+collada_read_floats (ColladaImport * import, uint32_t * out_count) {
+    XmlStream * xml = &import->xml;
+    char const * begin = nullptr;
+    char const * end = nullptr;
+    uint32_t count = 0;
+    while (xml_text_token(xml, &begin, &end)) {
+        if (!COLLADA_RESERVE(import->floats, import->float_capacity, (uint64_t)import->float_count + 1))
+            return false;
+        if (!collada_parse_float(begin, end, &import->floats[import->float_count]))
+            return false;
+        ++import->float_count;
+        ++count;
+    }
+    import->scene->stats.floats_parsed += count;
+    *out_count = count;
+    return !xml->error;
+}
+static bool
+collada_read_uints (ColladaImport * import, uint32_t ** data, uint32_t * count, uint32_t * capacity, uint32_t * out_read) {
+    XmlStream * xml = &import->xml;
+    char const * begin = nullptr;
+    char const * end = nullptr;
+    uint32_t read = 0;
+    while (xml_text_token(xml, &begin, &end)) {
+        if (!COLLADA_RESERVE(*data, *capacity, (uint64_t)*count + 1))
+            return false;
+        if (!collada_parse_uint(begin, end, &(*data)[*count]))
+            return false;
+        ++*count;
+        ++read;
+    }
+    import->scene->stats.indices_parsed += read;
+    if (out_read)
+        *out_read = read;
+    return !xml->error;
+}
+static uint32_t
+collada_tuple_hash (uint32_t const * t) {
+    uint32_t h = t[0] * 0x9E3779B1u;
+    h ^= t[1] * 0x85EBCA77u + (h << 6) + (h >> 2);
+    h ^= t[2] * 0xC2B2AE3Du + (h << 6) + (h >> 2);
+    return h;
+}
+static bool
+collada_rehash (ColladaImport * import, uint32_t new_size) {
+    uint32_t * table = reinterpret_cast<uint32_t *>(::malloc(new_size * sizeof(uint32_t)));
+    if (!table)
+        return false;
+    ::memset(table, 0xff, new_size * sizeof(uint32_t));
+    uint32_t vertex_count = import->mesh ? import->mesh->vertex_count : 0;
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        uint32_t slot = collada_tuple_hash(&import->tuples[v * 3]) & (new_size - 1);
+        while (COLLADA_NONE != table[slot])
+            slot = (slot + 1) & (new_size - 1);
+        table[slot] = v;
+    }
+    ::free(import->table);
+    import->table = table;
+    import->table_size = new_size;
+    return true;
+}
+// -- (position, normal, uv) source indices -> mesh-relative vertex index, adding the vertex if new
+static bool
+collada_emit_vertex (
+    ColladaImport * import, uint32_t const * tuple,
+    ColladaSource const * positions, ColladaSource const * normals, ColladaSource const * uvs, uint32_t * out_index
+) {
+    ColladaMesh * mesh = import->mesh;
+    ColladaScene * scene = import->scene;
+    if ((mesh->vertex_count + 1) * 2 > import->table_size && !collada_rehash(import, import->table_size ? import->table_size * 2 : 1024))
+        return false;
+    uint32_t slot = collada_tuple_hash(tuple) & (import->table_size - 1);
+    for (;;) {
+        uint32_t v = import->table[slot];
+        if (COLLADA_NONE == v)
+            break;
+        uint32_t const * t = &import->tuples[v * 3];
+        if (t[0] == tuple[0] && t[1] == tuple[1] && t[2] == tuple[2]) {
+            *out_index = v;
+            return true;
+        }
+        slot = (slot + 1) & (import->table_size - 1);
+    }
+    if (!COLLADA_RESERVE(import->tuples, import->tuple_capacity, ((uint64_t)mesh->vertex_count + 1) * 3) ||
+        !COLLADA_RESERVE(scene->vertices, scene->vertex_capacity, (uint64_t)scene->vertex_count + 1)
+    ) {
+        return false;
+    }
+    uint32_t v = mesh->vertex_count++;
+    ::memcpy(&import->tuples[v * 3], tuple, 3 * sizeof(uint32_t));
+    import->table[slot] = v;
+
+    ColladaVertex * vertex = &scene->vertices[scene->vertex_count++];
+    ::memset(vertex, 0, sizeof(*vertex));
+    float const * data = import->floats;
+    for (uint32_t c = 0; c < 3 && c < positions->stride; ++c)
+        vertex->position[c] = data[positions->first + tuple[0] * positions->stride + c];
+    if (normals) {
+        for (uint32_t c = 0; c < 3 && c < normals->stride; ++c)
+            vertex->normal[c] = data[normals->first + tuple[1] * normals->stride + c];
+    }
+    if (uvs) {
+        for (uint32_t c = 0; c < 2 && c < uvs->stride; ++c)
+            vertex->uv[c] = data[uvs->first + tuple[2] * uvs->stride + c];
+    }
+    *out_index = v;
+    return true;
+}
+// NOTE(omid): Resolves each corner's index tuple through the inputs (VERTEX stands
+// for everything <vertices> lists) and fan-triangulates every polygon.
+static bool
+collada_finish_primitive (ColladaImport * import) {
+    ColladaScene * scene = import->scene;
+    uint32_t stride = 0;
+    for (uint32_t i = 0; i < import->input_count; ++i) {
+        if (import->inputs[i].offset + 1 > stride)
+            stride = import->inputs[i].offset + 1;
+    }
+    // -- source and tuple offset per attribute
+    ColladaSource const * src [3] = {};
+    uint32_t offset [3] = {};
+    for (uint32_t i = 0; i < import->input_count; ++i) {
+        ColladaInput const * input = &import->inputs[i];
+        if (ColladaSemantic_Vertex == input->semantic) {
+            if (0 != ::strcmp(input->source, import->vertices_id))
+                return false;
+            for (uint32_t v = 0; v < import->vertex_input_count; ++v) {
+                ColladaInput const * vertex_input = &import->vertex_inputs[v];
+                if (vertex_input->semantic <= ColladaSemantic_Texcoord && !src[vertex_input->semantic]) {
+                    src[vertex_input->semantic] = collada_find_source(import, vertex_input->source);
+                    offset[vertex_input->semantic] = input->offset;
+                }
+            }
+        } else if (input->semantic <= ColladaSemantic_Texcoord && 0 == input->set) {
+            src[input->semantic] = collada_find_source(import, input->source);
+            offset[input->semantic] = input->offset;
+        }
+    }
+    if (0 == stride || !src[ColladaSemantic_Position] || 0 == src[ColladaSemantic_Position]->stride)
+        return false;
+    if (import->prim_index_count % stride)
+        return false;
+
+    uint32_t corner_count = import->prim_index_count / stride;
+    uint32_t polygon_count = ColladaPrimitive_Triangles == import->primitive ? corner_count / 3 : import->prim_size_count;
+    uint32_t corner = 0;
+    for (uint32_t p = 0; p < polygon_count; ++p) {
+        uint32_t size = ColladaPrimitive_Triangles == import->primitive ? 3 : import->prim_sizes[p];
+        if (corner + size > corner_count)
+            return false;
+        uint32_t first = COLLADA_NONE, previous = COLLADA_NONE;
+        for (uint32_t k = 0; k < size; ++k) {
+            uint32_t const * raw = &import->prim_indices[(corner + k) * stride];
+            uint32_t tuple [3];
+            for (uint32_t a = 0; a < 3; ++a) {
+                tuple[a] = src[a] ? raw[offset[a]] : 0;
+                if (src[a] && (uint64_t)(tuple[a] + 1) * src[a]->stride > src[a]->count)
+                    return false;       // index past the end of its source
+            }
+            uint32_t index = 0;
+            if (!collada_emit_vertex(import, tuple, src[0], src[1], src[2], &index))
+                return false;
+            if (0 == k) {
+                first = index;
+            } else if (k >= 2) {
+                if (!COLLADA_RESERVE(scene->indices, scene->index_capacity, (uint64_t)scene->index_count + 3))
+                    return false;
+                scene->indices[scene->index_count++] = first;
+                scene->indices[scene->index_count++] = previous;
+                scene->indices[scene->index_count++] = index;
+                import->mesh->index_count += 3;
+                ++scene->stats.triangles;
+            }
+            previous = index;
+        }
+        corner += size;
+        ++scene->stats.polygons;
+    }
+    return true;
+}
+static void
+collada_finish_mesh (ColladaImport * import) {
+    ColladaMesh * mesh = import->mesh;
+    ColladaVertex const * vertices = import->scene->vertices + mesh->first_vertex;
+    for (uint32_t c = 0; c < 3; ++c) {
+        mesh->bounds_min[c] = mesh->vertex_count ? vertices[0].position[c] : 0.0f;
+        mesh->bounds_max[c] = mesh->bounds_min[c];
+    }
+    for (uint32_t v = 1; v < mesh->vertex_count; ++v) {
+        for (uint32_t c = 0; c < 3; ++c) {
+            mesh->bounds_min[c] = vertices[v].position[c] < mesh->bounds_min[c] ? vertices[v].position[c] : mesh->bounds_min[c];
+            mesh->bounds_max[c] = vertices[v].position[c] > mesh->bounds_max[c] ? vertices[v].position[c] : mesh->bounds_max[c];
+        }
+    }
+}
+static bool
+collada_on_start (ColladaImport * import) {
+    XmlStream * xml = &import->xml;
+    ColladaScene * scene = import->scene;
+    char const * name = xml->name;
+
+    if (import->in_geometry) {
+        if (0 == ::strcmp(name, "source")) {
+            if (import->source_count == COLLADA_MAX_SOURCES)
+                return false;
+            ColladaSource * source = &import->sources[import->source_count++];
+            ::memset(source, 0, sizeof(*source));
+            ::snprintf(source->id, sizeof(source->id), "%s", xml_attribute(xml, "id") ? xml_attribute(xml, "id") : "");
+            source->stride = 1;
+        } else if (0 == ::strcmp(name, "float_array") && import->source_count > 0) {
+            ColladaSource * source = &import->sources[import->source_count - 1];
+            source->first = import->float_count;
+            return collada_read_floats(import, &source->count);
+        } else if (0 == ::strcmp(name, "accessor") && import->source_count > 0) {
+            import->sources[import->source_count - 1].stride = xml_attribute_uint(xml, "stride", 1);
+        } else if (0 == ::strcmp(name, "vertices")) {
+            import->in_vertices = true;
+            import->vertex_input_count = 0;
+            ::snprintf(import->vertices_id, sizeof(import->vertices_id), "%s", xml_attribute(xml, "id") ? xml_attribute(xml, "id") : "");
+        } else if (0 == ::strcmp(name, "triangles") || 0 == ::strcmp(name, "polygons") || 0 == ::strcmp(name, "polylist")) {
+            import->in_primitive = true;
+            import->primitive =
+                't' == name[0] ? ColladaPrimitive_Triangles :
+                0 == ::strcmp(name, "polygons") ? ColladaPrimitive_Polygons : ColladaPrimitive_Polylist;
+            import->input_count = 0;
+            import->prim_index_count = 0;
+            import->prim_size_count = 0;
+            char const * material = xml_attribute(xml, "material");
+            if (material && '\0' == import->mesh->material[0])
+                ::snprintf(import->mesh->material, sizeof(import->mesh->material), "%s", material);
+        } else if (0 == ::strcmp(name, "input")) {
+            if (import->in_primitive && import->input_count < COLLADA_MAX_INPUTS)
+                collada_read_input(xml, &import->inputs[import->input_count++]);
+            else if (import->in_vertices && import->vertex_input_count < COLLADA_MAX_INPUTS)
+                collada_read_input(xml, &import->vertex_inputs[import->vertex_input_count++]);
+        } else if (0 == ::strcmp(name, "vcount") && import->in_primitive) {
+            return collada_read_uints(import, &import->prim_sizes, &import->prim_size_count, &import->prim_size_capacity, nullptr);
+        } else if (0 == ::strcmp(name, "p") && import->in_primitive) {
+            uint32_t read = 0;
+            if (!collada_read_uints(import, &import->prim_indices, &import->prim_index_count, &import->prim_index_capacity, &read))
+                return false;
+            if (ColladaPrimitive_Polygons == import->primitive) {
+                // -- one <p> per polygon; its size is known once the stride is
+                uint32_t stride = 0;
+                for (uint32_t i = 0; i < import->input_count; ++i)
+                    stride = import->inputs[i].offset + 1 > stride ? import->inputs[i].offset + 1 : stride;
+                if (0 == stride || !COLLADA_RESERVE(import->prim_sizes, import->prim_size_capacity, (uint64_t)import->prim_size_count + 1))
+                    return false;
+                import->prim_sizes[import->prim_size_count++] = read / stride;
+            }
+        }
+        return true;
+    }
+    if (0 == ::strcmp(name, "geometry")) {
+        if (!COLLADA_RESERVE(scene->meshes, scene->mesh_capacity, (uint64_t)scene->mesh_count + 1))
+            return false;
+        import->mesh = &scene->meshes[scene->mesh_count++];
+        ::memset(import->mesh, 0, sizeof(*import->mesh));
+        ::snprintf(import->mesh->id, sizeof(import->mesh->id), "%s", xml_attribute(xml, "id") ? xml_attribute(xml, "id") : "");
+        ::snprintf(import->mesh->name, sizeof(import->mesh->name), "%s", xml_attribute(xml, "name") ? xml_attribute(xml, "name") : "");
+        import->mesh->first_vertex = scene->vertex_count;
+        import->mesh->first_index = scene->index_count;
+        import->in_geometry = true;
+        import->source_count = 0;
+        import->float_count = 0;
+        import->table_used = 0;
+        if (import->table)
+            ::memset(import->table, 0xff, import->table_size * sizeof(uint32_t));
+        return true;
+    }
+    if (0 == ::strcmp(name, "visual_scene")) {
+        if (!COLLADA_RESERVE(scene->visual_scenes, scene->visual_scene_capacity, (uint64_t)scene->visual_scene_count + 1))
+            return false;
+        ColladaVisualScene * visual_scene = &scene->visual_scenes[scene->visual_scene_count++];
+        ::memset(visual_scene, 0, sizeof(*visual_scene));
+        ::snprintf(visual_scene->id, sizeof(visual_scene->id), "%s", xml_attribute(xml, "id") ? xml_attribute(xml, "id") : "");
+        ::snprintf(visual_scene->name, sizeof(visual_scene->name), "%s", xml_attribute(xml, "name") ? xml_attribute(xml, "name") : "");
+        visual_scene->first_node = scene->node_count;
+        import->in_visual_scene = true;
+        return true;
+    }
+    if (import->in_visual_scene && 0 == ::strcmp(name, "node")) {
+        if (import->node_depth == COLLADA_MAX_NODE_DEPTH || !COLLADA_RESERVE(scene->nodes, scene->node_capacity, (uint64_t)scene->node_count + 1))
+            return false;
+        uint32_t index = scene->node_count++;
+        ColladaNode * node = &scene->nodes[index];
+        ::memset(node, 0, sizeof(*node));
+        ::snprintf(node->id, sizeof(node->id), "%s", xml_attribute(xml, "id") ? xml_attribute(xml, "id") : "");
+        ::snprintf(node->name, sizeof(node->name), "%s", xml_attribute(xml, "name") ? xml_attribute(xml, "name") : "");
+        node->scene = scene->visual_scene_count - 1;
+        node->parent = import->node_depth ? import->node_stack[import->node_depth - 1] : COLLADA_NONE;
+        node->mesh = COLLADA_NONE;
+        collada_matrix_identity(node->local);
+        import->node_stack[import->node_depth++] = index;
+        ++scene->visual_scenes[node->scene].node_count;
+        return true;
+    }
+    if (import->node_depth > 0) {
+        ColladaNode * node = &scene->nodes[import->node_stack[import->node_depth - 1]];
+        bool is_matrix = 0 == ::strcmp(name, "matrix");
+        bool is_translate = 0 == ::strcmp(name, "translate");
+        bool is_scale = 0 == ::strcmp(name, "scale");
+        bool is_rotate = 0 == ::strcmp(name, "rotate");
+        if (is_matrix || is_translate || is_scale || is_rotate) {
+            // -- transform elements compose in document order: local = local * T
+            uint32_t first = import->float_count, count = 0;
+            if (!collada_read_floats(import, &count))
+                return false;
+            float const * v = import->floats + first;
+            float t [16];
+            collada_matrix_identity(t);
+            if (is_matrix && 16 == count) {
+                ::memcpy(t, v, sizeof(t));
+            } else if (is_translate && 3 == count) {
+                t[3] = v[0];
+                t[7] = v[1];
+                t[11] = v[2];
+            } else if (is_scale && 3 == count) {
+                t[0] = v[0];
+                t[5] = v[1];
+                t[10] = v[2];
+            } else if (is_rotate && 4 == count) {
+                float len = ::sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+                float x = len > 0.0f ? v[0] / len : 0.0f, y = len > 0.0f ? v[1] / len : 0.0f, z = len > 0.0f ? v[2] / len : 1.0f;
+                float a = v[3] * 3.14159265358979f / 180.0f, c = ::cosf(a), s = ::sinf(a), k = 1.0f - c;
+                t[0] = x * x * k + c;       t[1] = x * y * k - z * s;   t[2] = x * z * k + y * s;
+                t[4] = y * x * k + z * s;   t[5] = y * y * k + c;       t[6] = y * z * k - x * s;
+                t[8] = z * x * k - y * s;   t[9] = z * y * k + x * s;   t[10] = z * z * k + c;
+            } else {
+                return false;
+            }
+            import->float_count = first;
+            collada_matrix_multiply(node->local, t, node->local);
+        } else if (0 == ::strcmp(name, "instance_geometry")) {
+            char const * url = xml_attribute(xml, "url");
+            ::snprintf(node->geometry_url, sizeof(node->geometry_url), "%s", url ? ('#' == url[0] ? url + 1 : url) : "");
+        }
+        return true;
+    }
+    if (0 == ::strcmp(name, "instance_visual_scene")) {
+        char const * url = xml_attribute(xml, "url");
+        ::snprintf(import->active_scene_url, sizeof(import->active_scene_url), "%s", url ? ('#' == url[0] ? url + 1 : url) : "");
+    }
+    return true;
+}
+static bool
+collada_on_end (ColladaImport * import) {
+    char const * name = import->xml.name;
+    ColladaScene * scene = import->scene;
+    if (import->in_geometry) {
+        if (0 == ::strcmp(name, "vertices")) {
+            import->in_vertices = false;
+        } else if (import->in_primitive && (0 == ::strcmp(name, "triangles") || 0 == ::strcmp(name, "polygons") || 0 == ::strcmp(name, "polylist"))) {
+            import->in_primitive = false;
+            return collada_finish_primitive(import);
+        } else if (0 == ::strcmp(name, "geometry")) {
+            collada_finish_mesh(import);
+            import->in_geometry = false;
+            import->mesh = nullptr;
+        }
+        return true;
+    }
+    if (0 == ::strcmp(name, "node") && import->node_depth > 0) {
+        --import->node_depth;
+    } else if (0 == ::strcmp(name, "visual_scene")) {
+        import->in_visual_scene = false;
+    }
+    (void)scene;
+    return true;
+}
+static void
+collada_scene_destroy (ColladaScene * scene) {
+    ::free(scene->vertices);
+    ::free(scene->indices);
+    ::free(scene->meshes);
+    ::free(scene->nodes);
+    ::free(scene->visual_scenes);
+    ::memset(scene, 0, sizeof(*scene));
+}
+// -- false on an unreadable or malformed file (the scene is left empty)
+static bool
+collada_scene_load (ColladaScene * scene, char const * path) {
+    ::memset(scene, 0, sizeof(*scene));
+    ColladaImport * import = reinterpret_cast<ColladaImport *>(::calloc(1, sizeof(ColladaImport)));
+    if (!import)
+        return false;
+    import->scene = scene;
+    bool opened = xml_stream_open(&import->xml, path, COLLADA_CHUNK_SIZE);
+    bool ok = opened;
+    while (ok) {
+        XmlEvent event = xml_next(&import->xml);
+        if (XmlEvent_Eof == event)
+            break;
+        if (XmlEvent_Error == event)
+            ok = false;
+        else if (XmlEvent_Start == event)
+            ok = collada_on_start(import);
+        else
+            ok = collada_on_end(import);
+    }
+    ok = ok && !import->xml.error && !import->in_geometry && 0 == import->node_depth;
+    if (!opened)
+        ::printf("collada: cannot open %s\n", path);
+    else if (!ok)
+        ::printf("collada: %s is not a scene this importer understands (near byte %llu)\n", path, (unsigned long long)import->xml.bytes_read);
+    scene->stats.bytes = import->xml.bytes_read;
+    scene->stats.refills = import->xml.refills;
+    xml_stream_close(&import->xml);
+
+    if (ok) {
+        // -- instance_geometry may name geometries defined later in the file
+        for (uint32_t n = 0; n < scene->node_count; ++n) {
+            ColladaNode * node = &scene->nodes[n];
+            for (uint32_t m = 0; m < scene->mesh_count && COLLADA_NONE == node->mesh && node->geometry_url[0]; ++m) {
+                if (0 == ::strcmp(scene->meshes[m].id, node->geometry_url))
+                    node->mesh = m;
+            }
+            // -- parents precede their children
+            if (COLLADA_NONE == node->parent)
+                ::memcpy(node->world, node->local, sizeof(node->world));
+            else
+                collada_matrix_multiply(scene->nodes[node->parent].world, node->local, node->world);
+        }
+        for (uint32_t s = 0; s < scene->visual_scene_count; ++s) {
+            if (0 == ::strcmp(scene->visual_scenes[s].id, import->active_scene_url))
+                scene->active_scene = s;
+        }
+    }
+    ::free(import->floats);
+    ::free(import->prim_indices);
+    ::free(import->prim_sizes);
+    ::free(import->tuples);
+    ::free(import->table);
+    ::free(import);
+    if (!ok) {
+        ColladaStats stats = scene->stats;
+        collada_scene_destroy(scene);
+        scene->stats = stats;
+    }
+    return ok;
+}
+// -- parse_ms is measured by the caller (whatever clock it uses)
+static void
+collada_scene_print_stats (ColladaScene const * scene, char const * path, double parse_ms) {
+    double mb = (double)scene->stats.bytes / (1024.0 * 1024.0);
+    ::printf(
+        "COLLADA %s: %.2f MiB in %.2f ms (%.1f MiB/s), %llu floats, %llu indices, %u chunks\n",
+        path, mb, parse_ms, parse_ms > 0.0 ? mb / (parse_ms * 1e-3) : 0.0,
+        (unsigned long long)scene->stats.floats_parsed, (unsigned long long)scene->stats.indices_parsed, scene->stats.refills
+    );
+    uint32_t instanced = 0;
+    for (uint32_t n = 0; n < scene->node_count; ++n)
+        instanced += COLLADA_NONE != scene->nodes[n].mesh ? 1 : 0;
+    ::printf(
+        "COLLADA %s: %u meshes, %u vertices, %u triangles (from %u polygons), %u nodes (%u with geometry) in %u scenes, active \"%s\"\n",
+        path, scene->mesh_count, scene->vertex_count, scene->index_count / 3, scene->stats.polygons,
+        scene->node_count, instanced, scene->visual_scene_count,
+        scene->visual_scene_count ? scene->visual_scenes[scene->active_scene].name : ""
+    );
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+// NOTE(omid): A pool of command allocators bucketed by command list type.
+// Allocators are handed out with acquire, tagged with the fence value of the
+// submission that used them on release, and only recycled (Reset) once that
+// fence has completed. The pool grows on demand; its per-type arrays double when
+// full (the bundle cache may hold many bundle allocators).
+// Since fence values are monotonic, retired allocators form a FIFO per type.
+
+#include "common_macros.h"
+
+#define ALLOCATOR_POOL_INITIAL_PER_TYPE 16
+#define ALLOCATOR_POOL_TYPE_COUNT       4       // DIRECT, BUNDLE, COMPUTE, COPY
+
+struct RetiredAllocator {
+    ID3D12CommandAllocator *        allocator;
+    UINT64                          fence_value;
+};
+struct CommandAllocatorBucket {
+    // -- the three arrays below hold capacity entries; free and retired
+    // allocators are a subset of created, so they never outgrow it
+    UINT                            capacity;
+
+    // -- every allocator this bucket ever created (owned by the pool)
+    ID3D12CommandAllocator **       created;
+    UINT                            created_count;
+
+    // -- allocators ready to be handed out (already reset)
+    ID3D12CommandAllocator **       free_list;
+    UINT                            free_count;
+
+    // -- allocators waiting for their fence (ring buffer, oldest first)
+    RetiredAllocator *              retired;
+    UINT                            retired_head;
+    UINT                            retired_count;
+
+    // -- allocators handed out and not yet released
+    UINT                            in_use_count;
+
+    // -- stats
+    UINT                            high_water;         // max live allocators (in_use + retired) ever
+    UINT                            window_high_water;  // max live allocators since last trim
+};
+struct CommandAllocatorPool {
+    ID3D12Device *                  device;
+    CommandAllocatorBucket          buckets [ALLOCATOR_POOL_TYPE_COUNT];
+};
+
+static char const *
+command_list_type_name (D3D12_COMMAND_LIST_TYPE type) {
+    switch (type) {
+        case D3D12_COMMAND_LIST_TYPE_DIRECT:    return "direct";
+        case D3D12_COMMAND_LIST_TYPE_BUNDLE:    return "bundle";
+        case D3D12_COMMAND_LIST_TYPE_COMPUTE:   return "compute";
+        case D3D12_COMMAND_LIST_TYPE_COPY:      return "copy";
+        default:                                return "unknown";
+    }
+}
+static CommandAllocatorBucket *
+command_allocator_pool_bucket (CommandAllocatorPool * pool, D3D12_COMMAND_LIST_TYPE type) {
+    SIMPLE_ASSERT((UINT)type < ALLOCATOR_POOL_TYPE_COUNT);
+    return &pool->buckets[(UINT)type];
+}
+static void
+command_allocator_pool_init (CommandAllocatorPool * pool, ID3D12Device * device) {
+    *pool = {};
+    pool->device = device;
+}
+// -- double the bucket's arrays; the retired ring is unrolled so its head is 0 again
+static bool
+command_allocator_bucket_grow (CommandAllocatorBucket * bucket) {
+    UINT capacity = bucket->capacity ? bucket->capacity * 2 : ALLOCATOR_POOL_INITIAL_PER_TYPE;
+    ID3D12CommandAllocator ** created = reinterpret_cast<ID3D12CommandAllocator **>(::malloc(capacity * sizeof(*created)));
+    ID3D12CommandAllocator ** free_list = reinterpret_cast<ID3D12CommandAllocator **>(::malloc(capacity * sizeof(*free_list)));
+    RetiredAllocator * retired = reinterpret_cast<RetiredAllocator *>(::malloc(capacity * sizeof(*retired)));
+    if (!created || !free_list || !retired) {
+        ::free(created);
+        ::free(free_list);
+        ::free(retired);
+        return false;
+    }
+    if (bucket->created_count)
+        ::memcpy(created, bucket->created, bucket->created_count * sizeof(*created));
+    if (bucket->free_count)
+        ::memcpy(free_list, bucket->free_list, bucket->free_count * sizeof(*free_list));
+    for (UINT i = 0; i < bucket->retired_count; ++i)
+        retired[i] = bucket->retired[(bucket->retired_head + i) % bucket->capacity];
+    ::free(bucket->created);
+    ::free(bucket->free_list);
+    ::free(bucket->retired);
+    bucket->created = created;
+    bucket->free_list = free_list;
+    bucket->retired = retired;
+    bucket->retired_head = 0;
+    bucket->capacity = capacity;
+    return true;
+}
+// -- move every retired allocator whose fence has completed back to the free list
+static void
+command_allocator_pool_recycle (CommandAllocatorPool * pool, D3D12_COMMAND_LIST_TYPE type, UINT64 completed_fence_value) {
+    CommandAllocatorBucket * bucket = command_allocator_pool_bucket(pool, type);
+    while (bucket->retired_count > 0) {
+        RetiredAllocator * oldest = &bucket->retired[bucket->retired_head];
+        if (oldest->fence_value > completed_fence_value)
+            break;
+
+        // Command list allocators can only be reset when the associated
+        // command lists have finished execution on the GPU
+        CHECK_AND_FAIL(oldest->allocator->Reset());
+        bucket->free_list[bucket->free_count++] = oldest->allocator;
+
+        bucket->retired_head = (bucket->retired_head + 1) % bucket->capacity;
+        --bucket->retired_count;
+    }
+}
+static ID3D12CommandAllocator *
+command_allocator_pool_acquire (CommandAllocatorPool * pool, D3D12_COMMAND_LIST_TYPE type, UINT64 completed_fence_value) {
+    CommandAllocatorBucket * bucket = command_allocator_pool_bucket(pool, type);
+    command_allocator_pool_recycle(pool, type, completed_fence_value);
+
+    ID3D12CommandAllocator * ret = nullptr;
+    if (bucket->free_count > 0) {
+        ret = bucket->free_list[--bucket->free_count];
+    } else {
+        // -- nothing is ready: grow the pool
+        if (bucket->created_count == bucket->capacity) {
+            bool grown = command_allocator_bucket_grow(bucket);
+            SIMPLE_ASSERT(grown);
+        }
+        CHECK_AND_FAIL(pool->device->CreateCommandAllocator(type, IID_PPV_ARGS(&ret)));
+        bucket->created[bucket->created_count++] = ret;
+    }
+    ++bucket->in_use_count;
+
+    UINT live = bucket->in_use_count + bucket->retired_count;
+    if (live > bucket->high_water)
+        bucket->high_water = live;
+    if (live > bucket->window_high_water)
+        bucket->window_high_water = live;
+
+    return ret;
+}
+// -- hand an allocator back; it becomes reusable once fence reaches fence_value
+static void
+command_allocator_pool_release (CommandAllocatorPool * pool, D3D12_COMMAND_LIST_TYPE type, ID3D12CommandAllocator * allocator, UINT64 fence_value) {
+    CommandAllocatorBucket * bucket = command_allocator_pool_bucket(pool, type);
+    SIMPLE_ASSERT(bucket->in_use_count > 0);
+    SIMPLE_ASSERT(bucket->retired_count < bucket->capacity);     // only created allocators come back
+
+    UINT tail = (bucket->retired_head + bucket->retired_count) % bucket->capacity;
+    bucket->retired[tail].allocator = allocator;
+    bucket->retired[tail].fence_value = fence_value;
+    ++bucket->retired_count;
+    --bucket->in_use_count;
+}
+// NOTE(omid): Release idle allocators beyond what was needed since the last trim,
+// so a single bursty frame doesn't keep its allocator memory pinned forever.
+// Call it periodically (e.g. once every few hundred frames).
+static void
+command_allocator_pool_trim (CommandAllocatorPool * pool) {
+    for (UINT t = 0; t < ALLOCATOR_POOL_TYPE_COUNT; ++t) {
+        CommandAllocatorBucket * bucket = &pool->buckets[t];
+        UINT live = bucket->in_use_count + bucket->retired_count;
+        UINT keep = bucket->window_high_water > live ? bucket->window_high_water - live : 0;
+        while (bucket->free_count > keep) {
+            ID3D12CommandAllocator * victim = bucket->free_list[--bucket->free_count];
+            // -- remove from created list (swap with last)
+            for (UINT i = 0; i < bucket->created_count; ++i) {
+                if (bucket->created[i] == victim) {
+                    bucket->created[i] = bucket->created[--bucket->created_count];
+                    break;
+                }
+            }
+            victim->Release();
+        }
+        bucket->window_high_water = live;
+    }
+}
+static void
+command_allocator_pool_print_stats (CommandAllocatorPool * pool) {
+    ::printf("Command allocator pool:\n");
+    for (UINT t = 0; t < ALLOCATOR_POOL_TYPE_COUNT; ++t) {
+        CommandAllocatorBucket * bucket = &pool->buckets[t];
+        if (0 == bucket->created_count && 0 == bucket->high_water)
+            continue;
+        ::printf(
+            "\t%-8s created: %u, free: %u, in-flight: %u, in-use: %u, high-water: %u\n",
+            command_list_type_name((D3D12_COMMAND_LIST_TYPE)t),
+            bucket->created_count, bucket->free_count, bucket->retired_count,
+            bucket->in_use_count, bucket->high_water
+        );
+    }
+}
+// -- caller must make sure the gpu is idle
+static void
+command_allocator_pool_destroy (CommandAllocatorPool * pool) {
+    for (UINT t = 0; t < ALLOCATOR_POOL_TYPE_COUNT; ++t) {
+        CommandAllocatorBucket * bucket = &pool->buckets[t];
+        for (UINT i = 0; i < bucket->created_count; ++i)
+            bucket->created[i]->Release();
+        ::free(bucket->created);
+        ::free(bucket->free_list);
+        ::free(bucket->retired);
+    }
+    *pool = {};
+}
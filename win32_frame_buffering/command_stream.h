@@ -0,0 +1,446 @@
+#pragma once
+
+// NOTE(omid): A compact CPU-side command stream. Commands are recorded as tagged
+// packets laid out back to back in one linear arena (4-byte aligned, header +
+// payload) and replayed later into a real command list (see command_stream_replay.h).
+// Packets never hold pointers: pipeline objects, heaps and resources are referred
+// to by small integer ids which are resolved at replay time through a bindings
+// table. That keeps the stream trivially serializable, so a frame can be written
+// to disk, inspected offline and replayed.
+// This header only depends on the C runtime, so recording can be built and
+// measured without d3d12.
+
+#include "common_macros.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COMMAND_STREAM_MAGIC            0x53444d43      // 'CMDS'
+#define COMMAND_STREAM_VERSION          1
+#define COMMAND_STREAM_MAX_ROOT_CONSTANTS   16
+#define COMMAND_STREAM_NO_RESOURCE          0xffffffff
+
+enum CommandPacketType : uint16_t {
+    CommandPacket_SetPipelineState = 0,
+    CommandPacket_SetRootSignature,
+    CommandPacket_SetViewport,
+    CommandPacket_SetScissor,
+    CommandPacket_SetDescriptorHeap,
+    CommandPacket_SetRootDescriptorTable,
+    CommandPacket_SetRootConstants,
+    CommandPacket_SetPrimitiveTopology,
+    CommandPacket_SetVertexBuffer,
+    CommandPacket_SetRenderTarget,
+    CommandPacket_ClearRenderTarget,
+    CommandPacket_Transition,
+    CommandPacket_Draw,
+    CommandPacket_ExecuteBundle,
+    CommandPacket_ExecuteIndirect,
+
+    CommandPacket_COUNT
+};
+struct CommandPacketHeader {
+    uint16_t                        type;
+    uint16_t                        size;           // header + payload, in bytes
+};
+struct CmdSetPipelineState {
+    CommandPacketHeader             header;
+    uint32_t                        pso_id;
+};
+struct CmdSetRootSignature {
+    CommandPacketHeader             header;
+    uint32_t                        root_signature_id;
+};
+struct CmdSetViewport {
+    CommandPacketHeader             header;
+    float                           top_left_x, top_left_y, width, height, min_depth, max_depth;
+};
+struct CmdSetScissor {
+    CommandPacketHeader             header;
+    int32_t                         left, top, right, bottom;
+};
+struct CmdSetDescriptorHeap {
+    CommandPacketHeader             header;
+    uint32_t                        heap_id;
+};
+struct CmdSetRootDescriptorTable {
+    CommandPacketHeader             header;
+    uint32_t                        root_parameter_index;
+    uint32_t                        heap_id;
+    uint32_t                        descriptor_index;
+};
+struct CmdSetRootConstants {
+    CommandPacketHeader             header;
+    uint32_t                        root_parameter_index;
+    uint32_t                        dest_offset;
+    uint32_t                        count;
+    // -- followed by count uint32_t values
+};
+struct CmdSetPrimitiveTopology {
+    CommandPacketHeader             header;
+    uint32_t                        topology;
+};
+struct CmdSetVertexBuffer {
+    CommandPacketHeader             header;
+    uint32_t                        slot;
+    uint32_t                        resource_id;
+    uint32_t                        offset;
+    uint32_t                        size;
+    uint32_t                        stride;
+};
+struct CmdSetRenderTarget {
+    CommandPacketHeader             header;
+    uint32_t                        heap_id;
+    uint32_t                        descriptor_index;
+};
+struct CmdClearRenderTarget {
+    CommandPacketHeader             header;
+    uint32_t                        heap_id;
+    uint32_t                        descriptor_index;
+    float                           color [4];
+};
+struct CmdTransition {
+    CommandPacketHeader             header;
+    uint32_t                        resource_id;
+    uint32_t                        subresource;
+    uint32_t                        state_before;
+    uint32_t                        state_after;
+};
+struct CmdDraw {
+    CommandPacketHeader             header;
+    uint32_t                        vertex_count_per_instance;
+    uint32_t                        instance_count;
+    uint32_t                        start_vertex;
+    uint32_t                        start_instance;
+};
+struct CmdExecuteBundle {
+    CommandPacketHeader             header;
+    uint32_t                        bundle_id;
+};
+struct CmdExecuteIndirect {
+    CommandPacketHeader             header;
+    uint32_t                        command_signature_id;
+    uint32_t                        max_command_count;
+    uint32_t                        argument_resource_id;
+    uint32_t                        argument_offset;
+    uint32_t                        count_resource_id;          // COMMAND_STREAM_NO_RESOURCE for none
+    uint32_t                        count_offset;
+};
+
+struct CommandStream {
+    uint8_t *                       base;
+    uint64_t                        size;
+    uint64_t                        capacity;
+    uint32_t                        packet_count;
+    uint32_t                        type_counts [CommandPacket_COUNT];
+};
+struct CommandStreamFileHeader {
+    uint32_t                        magic;
+    uint32_t                        version;
+    uint32_t                        packet_count;
+    uint32_t                        reserved;
+    uint64_t                        size;
+};
+
+static char const *
+command_packet_name (uint16_t type) {
+    switch (type) {
+        case CommandPacket_SetPipelineState:        return "SetPipelineState";
+        case CommandPacket_SetRootSignature:        return "SetRootSignature";
+        case CommandPacket_SetViewport:             return "SetViewport";
+        case CommandPacket_SetScissor:              return "SetScissor";
+        case CommandPacket_SetDescriptorHeap:       return "SetDescriptorHeap";
+        case CommandPacket_SetRootDescriptorTable:  return "SetRootDescriptorTable";
+        case CommandPacket_SetRootConstants:        return "SetRootConstants";
+        case CommandPacket_SetPrimitiveTopology:    return "SetPrimitiveTopology";
+        case CommandPacket_SetVertexBuffer:         return "SetVertexBuffer";
+        case CommandPacket_SetRenderTarget:         return "SetRenderTarget";
+        case CommandPacket_ClearRenderTarget:       return "ClearRenderTarget";
+        case CommandPacket_Transition:              return "Transition";
+        case CommandPacket_Draw:                    return "Draw";
+        case CommandPacket_ExecuteBundle:           return "ExecuteBundle";
+        case CommandPacket_ExecuteIndirect:         return "ExecuteIndirect";
+        default:                                    return "Unknown";
+    }
+}
+// -- smallest valid packet of each type (SetRootConstants adds its values on top)
+static uint32_t
+command_packet_min_size (uint16_t type) {
+    switch (type) {
+        case CommandPacket_SetPipelineState:        return sizeof(CmdSetPipelineState);
+        case CommandPacket_SetRootSignature:        return sizeof(CmdSetRootSignature);
+        case CommandPacket_SetViewport:             return sizeof(CmdSetViewport);
+        case CommandPacket_SetScissor:              return sizeof(CmdSetScissor);
+        case CommandPacket_SetDescriptorHeap:       return sizeof(CmdSetDescriptorHeap);
+        case CommandPacket_SetRootDescriptorTable:  return sizeof(CmdSetRootDescriptorTable);
+        case CommandPacket_SetRootConstants:        return sizeof(CmdSetRootConstants);
+        case CommandPacket_SetPrimitiveTopology:    return sizeof(CmdSetPrimitiveTopology);
+        case CommandPacket_SetVertexBuffer:         return sizeof(CmdSetVertexBuffer);
+        case CommandPacket_SetRenderTarget:         return sizeof(CmdSetRenderTarget);
+        case CommandPacket_ClearRenderTarget:       return sizeof(CmdClearRenderTarget);
+        case CommandPacket_Transition:              return sizeof(CmdTransition);
+        case CommandPacket_Draw:                    return sizeof(CmdDraw);
+        case CommandPacket_ExecuteBundle:           return sizeof(CmdExecuteBundle);
+        case CommandPacket_ExecuteIndirect:         return sizeof(CmdExecuteIndirect);
+        default:                                    return 0xffffffff;
+    }
+}
+static void
+command_stream_init (CommandStream * stream, uint64_t initial_capacity) {
+    ::memset(stream, 0, sizeof(*stream));
+    stream->base = initial_capacity ? reinterpret_cast<uint8_t *>(::malloc(initial_capacity)) : nullptr;
+    SIMPLE_ASSERT(stream->base || 0 == initial_capacity);
+    stream->capacity = initial_capacity;
+}
+static void
+command_stream_destroy (CommandStream * stream) {
+    ::free(stream->base);
+    ::memset(stream, 0, sizeof(*stream));
+}
+// -- rewind without giving memory back; call once per recorded frame
+static void
+command_stream_reset (CommandStream * stream) {
+    stream->size = 0;
+    stream->packet_count = 0;
+    ::memset(stream->type_counts, 0, sizeof(stream->type_counts));
+}
+// -- reserve a packet of size bytes (rounded up to 4) and fill in its header
+static void *
+command_stream_push (CommandStream * stream, uint16_t type, uint32_t size) {
+    size = (size + 3u) & ~3u;
+    SIMPLE_ASSERT(size <= 0xffff);
+    if (stream->size + size > stream->capacity) {
+        uint64_t new_capacity = stream->capacity * 2 > 64 ? stream->capacity * 2 : 64;
+        while (new_capacity < stream->size + size)
+            new_capacity *= 2;
+        stream->base = reinterpret_cast<uint8_t *>(::realloc(stream->base, new_capacity));
+        SIMPLE_ASSERT(stream->base);
+        stream->capacity = new_capacity;
+    }
+    CommandPacketHeader * header = reinterpret_cast<CommandPacketHeader *>(stream->base + stream->size);
+    header->type = type;
+    header->size = (uint16_t)size;
+    stream->size += size;
+    ++stream->packet_count;
+    ++stream->type_counts[type];
+    return header;
+}
+#define COMMAND_STREAM_PUSH(stream, Type, packet_type) \
+    reinterpret_cast<Type *>(command_stream_push((stream), (packet_type), sizeof(Type)))
+
+// -- recording helpers (arguments mirror the ID3D12GraphicsCommandList calls)
+static void
+cmd_set_pipeline_state (CommandStream * stream, uint32_t pso_id) {
+    CmdSetPipelineState * cmd = COMMAND_STREAM_PUSH(stream, CmdSetPipelineState, CommandPacket_SetPipelineState);
+    cmd->pso_id = pso_id;
+}
+static void
+cmd_set_root_signature (CommandStream * stream, uint32_t root_signature_id) {
+    CmdSetRootSignature * cmd = COMMAND_STREAM_PUSH(stream, CmdSetRootSignature, CommandPacket_SetRootSignature);
+    cmd->root_signature_id = root_signature_id;
+}
+static void
+cmd_set_viewport (CommandStream * stream, float x, float y, float width, float height, float min_depth, float max_depth) {
+    CmdSetViewport * cmd = COMMAND_STREAM_PUSH(stream, CmdSetViewport, CommandPacket_SetViewport);
+    cmd->top_left_x = x;
+    cmd->top_left_y = y;
+    cmd->width = width;
+    cmd->height = height;
+    cmd->min_depth = min_depth;
+    cmd->max_depth = max_depth;
+}
+static void
+cmd_set_scissor (CommandStream * stream, int32_t left, int32_t top, int32_t right, int32_t bottom) {
+    CmdSetScissor * cmd = COMMAND_STREAM_PUSH(stream, CmdSetScissor, CommandPacket_SetScissor);
+    cmd->left = left;
+    cmd->top = top;
+    cmd->right = right;
+    cmd->bottom = bottom;
+}
+static void
+cmd_set_descriptor_heap (CommandStream * stream, uint32_t heap_id) {
+    CmdSetDescriptorHeap * cmd = COMMAND_STREAM_PUSH(stream, CmdSetDescriptorHeap, CommandPacket_SetDescriptorHeap);
+    cmd->heap_id = heap_id;
+}
+static void
+cmd_set_root_descriptor_table (CommandStream * stream, uint32_t root_parameter_index, uint32_t heap_id, uint32_t descriptor_index) {
+    CmdSetRootDescriptorTable * cmd = COMMAND_STREAM_PUSH(stream, CmdSetRootDescriptorTable, CommandPacket_SetRootDescriptorTable);
+    cmd->root_parameter_index = root_parameter_index;
+    cmd->heap_id = heap_id;
+    cmd->descriptor_index = descriptor_index;
+}
+static void
+cmd_set_root_constants (CommandStream * stream, uint32_t root_parameter_index, uint32_t dest_offset, uint32_t count, void const * values) {
+    SIMPLE_ASSERT(count <= COMMAND_STREAM_MAX_ROOT_CONSTANTS);
+    CmdSetRootConstants * cmd = reinterpret_cast<CmdSetRootConstants *>(
+        command_stream_push(stream, CommandPacket_SetRootConstants, sizeof(CmdSetRootConstants) + count * sizeof(uint32_t))
+    );
+    cmd->root_parameter_index = root_parameter_index;
+    cmd->dest_offset = dest_offset;
+    cmd->count = count;
+    ::memcpy(cmd + 1, values, count * sizeof(uint32_t));
+}
+static void
+cmd_set_primitive_topology (CommandStream * stream, uint32_t topology) {
+    CmdSetPrimitiveTopology * cmd = COMMAND_STREAM_PUSH(stream, CmdSetPrimitiveTopology, CommandPacket_SetPrimitiveTopology);
+    cmd->topology = topology;
+}
+static void
+cmd_set_vertex_buffer (CommandStream * stream, uint32_t slot, uint32_t resource_id, uint32_t offset, uint32_t size, uint32_t stride) {
+    CmdSetVertexBuffer * cmd = COMMAND_STREAM_PUSH(stream, CmdSetVertexBuffer, CommandPacket_SetVertexBuffer);
+    cmd->slot = slot;
+    cmd->resource_id = resource_id;
+    cmd->offset = offset;
+    cmd->size = size;
+    cmd->stride = stride;
+}
+static void
+cmd_set_render_target (CommandStream * stream, uint32_t heap_id, uint32_t descriptor_index) {
+    CmdSetRenderTarget * cmd = COMMAND_STREAM_PUSH(stream, CmdSetRenderTarget, CommandPacket_SetRenderTarget);
+    cmd->heap_id = heap_id;
+    cmd->descriptor_index = descriptor_index;
+}
+static void
+cmd_clear_render_target (CommandStream * stream, uint32_t heap_id, uint32_t descriptor_index, float const color [4]) {
+    CmdClearRenderTarget * cmd = COMMAND_STREAM_PUSH(stream, CmdClearRenderTarget, CommandPacket_ClearRenderTarget);
+    cmd->heap_id = heap_id;
+    cmd->descriptor_index = descriptor_index;
+    ::memcpy(cmd->color, color, sizeof(cmd->color));
+}
+static void
+cmd_transition (CommandStream * stream, uint32_t resource_id, uint32_t subresource, uint32_t state_before, uint32_t state_after) {
+    CmdTransition * cmd = COMMAND_STREAM_PUSH(stream, CmdTransition, CommandPacket_Transition);
+    cmd->resource_id = resource_id;
+    cmd->subresource = subresource;
+    cmd->state_before = state_before;
+    cmd->state_after = state_after;
+}
+static void
+cmd_draw (CommandStream * stream, uint32_t vertex_count_per_instance, uint32_t instance_count, uint32_t start_vertex, uint32_t start_instance) {
+    CmdDraw * cmd = COMMAND_STREAM_PUSH(stream, CmdDraw, CommandPacket_Draw);
+    cmd->vertex_count_per_instance = vertex_count_per_instance;
+    cmd->instance_count = instance_count;
+    cmd->start_vertex = start_vertex;
+    cmd->start_instance = start_instance;
+}
+static void
+cmd_execute_bundle (CommandStream * stream, uint32_t bundle_id) {
+    CmdExecuteBundle * cmd = COMMAND_STREAM_PUSH(stream, CmdExecuteBundle, CommandPacket_ExecuteBundle);
+    cmd->bundle_id = bundle_id;
+}
+static void
+cmd_execute_indirect (
+    CommandStream * stream, uint32_t command_signature_id, uint32_t max_command_count,
+    uint32_t argument_resource_id, uint32_t argument_offset, uint32_t count_resource_id, uint32_t count_offset
+) {
+    CmdExecuteIndirect * cmd = COMMAND_STREAM_PUSH(stream, CmdExecuteIndirect, CommandPacket_ExecuteIndirect);
+    cmd->command_signature_id = command_signature_id;
+    cmd->max_command_count = max_command_count;
+    cmd->argument_resource_id = argument_resource_id;
+    cmd->argument_offset = argument_offset;
+    cmd->count_resource_id = count_resource_id;
+    cmd->count_offset = count_offset;
+}
+// -- walk a stream: for (CommandPacketHeader * p = first; p; p = next(stream, p))
+static CommandPacketHeader const *
+command_stream_first (CommandStream const * stream) {
+    return stream->size > 0 ? reinterpret_cast<CommandPacketHeader const *>(stream->base) : nullptr;
+}
+static CommandPacketHeader const *
+command_stream_next (CommandStream const * stream, CommandPacketHeader const * packet) {
+    uint8_t const * next = reinterpret_cast<uint8_t const *>(packet) + packet->size;
+    return next < stream->base + stream->size ? reinterpret_cast<CommandPacketHeader const *>(next) : nullptr;
+}
+static bool
+command_stream_write_file (CommandStream const * stream, char const * path) {
+    bool ret = false;
+    FILE * file = ::fopen(path, "wb");
+    if (file) {
+        CommandStreamFileHeader file_header = {};
+        file_header.magic = COMMAND_STREAM_MAGIC;
+        file_header.version = COMMAND_STREAM_VERSION;
+        file_header.packet_count = stream->packet_count;
+        file_header.size = stream->size;
+        ret = 1 == ::fwrite(&file_header, sizeof(file_header), 1, file);
+        if (ret && stream->size > 0)
+            ret = 1 == ::fwrite(stream->base, (size_t)stream->size, 1, file);
+        ::fclose(file);
+    }
+    return ret;
+}
+// NOTE(omid): A packet at offset is only trusted when its header fits, its size is
+// 4-aligned, covers its type's struct (and, for root constants, the values it
+// claims to carry) and does not run past the end of the stream.
+static bool
+command_stream_packet_valid (CommandStream const * stream, uint64_t offset) {
+    if (stream->size - offset < sizeof(CommandPacketHeader))
+        return false;
+    CommandPacketHeader const * packet = reinterpret_cast<CommandPacketHeader const *>(stream->base + offset);
+    if (packet->type >= CommandPacket_COUNT || 0 != packet->size % 4 ||
+        packet->size < command_packet_min_size(packet->type) || packet->size > stream->size - offset)
+        return false;
+    if (CommandPacket_SetRootConstants == packet->type) {
+        CmdSetRootConstants const * cmd = reinterpret_cast<CmdSetRootConstants const *>(packet);
+        if (cmd->count > COMMAND_STREAM_MAX_ROOT_CONSTANTS || packet->size < sizeof(CmdSetRootConstants) + cmd->count * sizeof(uint32_t))
+            return false;
+    }
+    return true;
+}
+// -- stream must be initialized; validates every packet while reading
+static bool
+command_stream_read_file (CommandStream * stream, char const * path) {
+    bool ret = false;
+    FILE * file = ::fopen(path, "rb");
+    if (file) {
+        CommandStreamFileHeader file_header = {};
+        if (1 == ::fread(&file_header, sizeof(file_header), 1, file) &&
+            COMMAND_STREAM_MAGIC == file_header.magic && COMMAND_STREAM_VERSION == file_header.version
+        ) {
+            command_stream_reset(stream);
+            ret = true;
+            if (file_header.size > stream->capacity) {
+                // -- a bogus size fails the read instead of the process
+                uint8_t * grown = reinterpret_cast<uint8_t *>(::realloc(stream->base, (size_t)file_header.size));
+                ret = nullptr != grown;
+                if (grown) {
+                    stream->base = grown;
+                    stream->capacity = file_header.size;
+                }
+            }
+            ret = ret && (0 == file_header.size || 1 == ::fread(stream->base, (size_t)file_header.size, 1, file));
+            stream->size = ret ? file_header.size : 0;
+
+            // -- rebuild stats and reject malformed packets
+            for (uint64_t offset = 0; ret && offset < stream->size;) {
+                if (!command_stream_packet_valid(stream, offset)) {
+                    ret = false;
+                    break;
+                }
+                CommandPacketHeader const * packet = reinterpret_cast<CommandPacketHeader const *>(stream->base + offset);
+                ++stream->packet_count;
+                ++stream->type_counts[packet->type];
+                offset += packet->size;
+            }
+            ret = ret && stream->packet_count == file_header.packet_count;
+            if (!ret)
+                command_stream_reset(stream);
+        }
+        ::fclose(file);
+    }
+    return ret;
+}
+static void
+command_stream_print_stats (CommandStream const * stream) {
+    ::printf(
+        "Command stream: %u packets, %llu bytes (%.1f bytes/packet), capacity %llu\n",
+        stream->packet_count, (unsigned long long)stream->size,
+        stream->packet_count ? (double)stream->size / (double)stream->packet_count : 0.0,
+        (unsigned long long)stream->capacity
+    );
+    for (uint16_t t = 0; t < CommandPacket_COUNT; ++t) {
+        if (stream->type_counts[t] > 0)
+            ::printf("\t%-24s x%u\n", command_packet_name(t), stream->type_counts[t]);
+    }
+}
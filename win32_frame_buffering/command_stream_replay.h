@@ -0,0 +1,154 @@
+#pragma once
+
+// NOTE(omid): Translates a CommandStream into ID3D12GraphicsCommandList calls.
+// Ids stored in the packets index into the bindings table, which the app fills
+// (and may re-point every frame, e.g. the current back buffer or bundle).
+
+#include "command_stream.h"
+
+#define COMMAND_STREAM_MAX_PSOS             16
+#define COMMAND_STREAM_MAX_ROOT_SIGNATURES  16
+#define COMMAND_STREAM_MAX_HEAPS            8
+#define COMMAND_STREAM_MAX_RESOURCES        64
+#define COMMAND_STREAM_MAX_BUNDLES          64
+#define COMMAND_STREAM_MAX_COMMAND_SIGNATURES   8
+
+struct CommandStreamBindings {
+    ID3D12PipelineState *           psos [COMMAND_STREAM_MAX_PSOS];
+    ID3D12RootSignature *           root_signatures [COMMAND_STREAM_MAX_ROOT_SIGNATURES];
+    ID3D12DescriptorHeap *          heaps [COMMAND_STREAM_MAX_HEAPS];
+    UINT                            heap_increments [COMMAND_STREAM_MAX_HEAPS];
+    ID3D12Resource *                resources [COMMAND_STREAM_MAX_RESOURCES];
+    ID3D12GraphicsCommandList *     bundles [COMMAND_STREAM_MAX_BUNDLES];
+    ID3D12CommandSignature *        command_signatures [COMMAND_STREAM_MAX_COMMAND_SIGNATURES];
+};
+
+static D3D12_CPU_DESCRIPTOR_HANDLE
+command_stream_cpu_handle (CommandStreamBindings const * bindings, uint32_t heap_id, uint32_t descriptor_index) {
+    SIMPLE_ASSERT(heap_id < COMMAND_STREAM_MAX_HEAPS && bindings->heaps[heap_id]);
+    D3D12_CPU_DESCRIPTOR_HANDLE ret = bindings->heaps[heap_id]->GetCPUDescriptorHandleForHeapStart();
+    ret.ptr += (SIZE_T)descriptor_index * bindings->heap_increments[heap_id];
+    return ret;
+}
+static D3D12_GPU_DESCRIPTOR_HANDLE
+command_stream_gpu_handle (CommandStreamBindings const * bindings, uint32_t heap_id, uint32_t descriptor_index) {
+    SIMPLE_ASSERT(heap_id < COMMAND_STREAM_MAX_HEAPS && bindings->heaps[heap_id]);
+    D3D12_GPU_DESCRIPTOR_HANDLE ret = bindings->heaps[heap_id]->GetGPUDescriptorHandleForHeapStart();
+    ret.ptr += (UINT64)descriptor_index * bindings->heap_increments[heap_id];
+    return ret;
+}
+static void
+command_stream_replay (CommandStream const * stream, CommandStreamBindings const * bindings, ID3D12GraphicsCommandList * cmd_list) {
+    for (CommandPacketHeader const * packet = command_stream_first(stream); packet; packet = command_stream_next(stream, packet)) {
+        switch (packet->type) {
+            case CommandPacket_SetPipelineState: {
+                CmdSetPipelineState const * cmd = reinterpret_cast<CmdSetPipelineState const *>(packet);
+                SIMPLE_ASSERT(cmd->pso_id < COMMAND_STREAM_MAX_PSOS);
+                cmd_list->SetPipelineState(bindings->psos[cmd->pso_id]);
+            } break;
+            case CommandPacket_SetRootSignature: {
+                CmdSetRootSignature const * cmd = reinterpret_cast<CmdSetRootSignature const *>(packet);
+                SIMPLE_ASSERT(cmd->root_signature_id < COMMAND_STREAM_MAX_ROOT_SIGNATURES);
+                cmd_list->SetGraphicsRootSignature(bindings->root_signatures[cmd->root_signature_id]);
+            } break;
+            case CommandPacket_SetViewport: {
+                CmdSetViewport const * cmd = reinterpret_cast<CmdSetViewport const *>(packet);
+                D3D12_VIEWPORT viewport = {};
+                viewport.TopLeftX = cmd->top_left_x;
+                viewport.TopLeftY = cmd->top_left_y;
+                viewport.Width = cmd->width;
+                viewport.Height = cmd->height;
+                viewport.MinDepth = cmd->min_depth;
+                viewport.MaxDepth = cmd->max_depth;
+                cmd_list->RSSetViewports(1, &viewport);
+            } break;
+            case CommandPacket_SetScissor: {
+                CmdSetScissor const * cmd = reinterpret_cast<CmdSetScissor const *>(packet);
+                D3D12_RECT rect = {};
+                rect.left = cmd->left;
+                rect.top = cmd->top;
+                rect.right = cmd->right;
+                rect.bottom = cmd->bottom;
+                cmd_list->RSSetScissorRects(1, &rect);
+            } break;
+            case CommandPacket_SetDescriptorHeap: {
+                CmdSetDescriptorHeap const * cmd = reinterpret_cast<CmdSetDescriptorHeap const *>(packet);
+                SIMPLE_ASSERT(cmd->heap_id < COMMAND_STREAM_MAX_HEAPS);
+                ID3D12DescriptorHeap * heaps [] = {bindings->heaps[cmd->heap_id]};
+                cmd_list->SetDescriptorHeaps(ARRAY_COUNT(heaps), heaps);
+            } break;
+            case CommandPacket_SetRootDescriptorTable: {
+                CmdSetRootDescriptorTable const * cmd = reinterpret_cast<CmdSetRootDescriptorTable const *>(packet);
+                cmd_list->SetGraphicsRootDescriptorTable(
+                    cmd->root_parameter_index, command_stream_gpu_handle(bindings, cmd->heap_id, cmd->descriptor_index)
+                );
+            } break;
+            case CommandPacket_SetRootConstants: {
+                CmdSetRootConstants const * cmd = reinterpret_cast<CmdSetRootConstants const *>(packet);
+                cmd_list->SetGraphicsRoot32BitConstants(cmd->root_parameter_index, cmd->count, cmd + 1, cmd->dest_offset);
+            } break;
+            case CommandPacket_SetPrimitiveTopology: {
+                CmdSetPrimitiveTopology const * cmd = reinterpret_cast<CmdSetPrimitiveTopology const *>(packet);
+                cmd_list->IASetPrimitiveTopology((D3D_PRIMITIVE_TOPOLOGY)cmd->topology);
+            } break;
+            case CommandPacket_SetVertexBuffer: {
+                CmdSetVertexBuffer const * cmd = reinterpret_cast<CmdSetVertexBuffer const *>(packet);
+                SIMPLE_ASSERT(cmd->resource_id < COMMAND_STREAM_MAX_RESOURCES && bindings->resources[cmd->resource_id]);
+                D3D12_VERTEX_BUFFER_VIEW vb_view = {};
+                vb_view.BufferLocation = bindings->resources[cmd->resource_id]->GetGPUVirtualAddress() + cmd->offset;
+                vb_view.SizeInBytes = cmd->size;
+                vb_view.StrideInBytes = cmd->stride;
+                cmd_list->IASetVertexBuffers(cmd->slot, 1, &vb_view);
+            } break;
+            case CommandPacket_SetRenderTarget: {
+                CmdSetRenderTarget const * cmd = reinterpret_cast<CmdSetRenderTarget const *>(packet);
+                D3D12_CPU_DESCRIPTOR_HANDLE rtv_handle = command_stream_cpu_handle(bindings, cmd->heap_id, cmd->descriptor_index);
+                cmd_list->OMSetRenderTargets(1, &rtv_handle, FALSE, nullptr);
+            } break;
+            case CommandPacket_ClearRenderTarget: {
+                CmdClearRenderTarget const * cmd = reinterpret_cast<CmdClearRenderTarget const *>(packet);
+                D3D12_CPU_DESCRIPTOR_HANDLE rtv_handle = command_stream_cpu_handle(bindings, cmd->heap_id, cmd->descriptor_index);
+                cmd_list->ClearRenderTargetView(rtv_handle, cmd->color, 0, nullptr);
+            } break;
+            case CommandPacket_Transition: {
+                CmdTransition const * cmd = reinterpret_cast<CmdTransition const *>(packet);
+                SIMPLE_ASSERT(cmd->resource_id < COMMAND_STREAM_MAX_RESOURCES && bindings->resources[cmd->resource_id]);
+                D3D12_RESOURCE_BARRIER barrier = {};
+                barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+                barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+                barrier.Transition.pResource = bindings->resources[cmd->resource_id];
+                barrier.Transition.Subresource = cmd->subresource;
+                barrier.Transition.StateBefore = (D3D12_RESOURCE_STATES)cmd->state_before;
+                barrier.Transition.StateAfter = (D3D12_RESOURCE_STATES)cmd->state_after;
+                cmd_list->ResourceBarrier(1, &barrier);
+            } break;
+            case CommandPacket_Draw: {
+                CmdDraw const * cmd = reinterpret_cast<CmdDraw const *>(packet);
+                cmd_list->DrawInstanced(cmd->vertex_count_per_instance, cmd->instance_count, cmd->start_vertex, cmd->start_instance);
+            } break;
+            case CommandPacket_ExecuteBundle: {
+                CmdExecuteBundle const * cmd = reinterpret_cast<CmdExecuteBundle const *>(packet);
+                SIMPLE_ASSERT(cmd->bundle_id < COMMAND_STREAM_MAX_BUNDLES && bindings->bundles[cmd->bundle_id]);
+                cmd_list->ExecuteBundle(bindings->bundles[cmd->bundle_id]);
+            } break;
+            case CommandPacket_ExecuteIndirect: {
+                CmdExecuteIndirect const * cmd = reinterpret_cast<CmdExecuteIndirect const *>(packet);
+                SIMPLE_ASSERT(cmd->command_signature_id < COMMAND_STREAM_MAX_COMMAND_SIGNATURES);
+                SIMPLE_ASSERT(cmd->argument_resource_id < COMMAND_STREAM_MAX_RESOURCES);
+                ID3D12Resource * count_resource = nullptr;
+                if (cmd->count_resource_id != COMMAND_STREAM_NO_RESOURCE) {
+                    SIMPLE_ASSERT(cmd->count_resource_id < COMMAND_STREAM_MAX_RESOURCES);
+                    count_resource = bindings->resources[cmd->count_resource_id];
+                }
+                cmd_list->ExecuteIndirect(
+                    bindings->command_signatures[cmd->command_signature_id], cmd->max_command_count,
+                    bindings->resources[cmd->argument_resource_id], cmd->argument_offset,
+                    count_resource, cmd->count_offset
+                );
+            } break;
+            default: {
+                SIMPLE_ASSERT(false);
+            } break;
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+// NOTE(omid): Macros and small helpers every header in this sample leans on. Kept free of windows
+// headers so the platform-independent parts (allocators, caches, trackers) build
+// on their own, e.g. in the host tests.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if !defined(SUCCEEDED)
+#define SUCCEEDED(hr)   (((HRESULT)(hr)) >= 0)
+#endif
+#if !defined(FAILED)
+#define FAILED(hr)      (((HRESULT)(hr)) < 0)
+#endif
+#define CHECK_AND_FAIL(hr)                          \
+    if (FAILED(hr)) {                               \
+        ::printf("[ERROR] " #hr "() failed at line %d. \n", __LINE__);   \
+        ::abort();                                  \
+    }                                               \
+
+#define ARRAY_COUNT(arr)            sizeof(arr)/sizeof(arr[0])
+#define SIMPLE_ASSERT(exp) if(!(exp))  {*(int *)0 = 0;}
+
+// -- FNV-1a; chain calls by passing the previous hash as seed
+#define FNV1A_64_SEED               14695981039346656037ull
+static uint64_t
+fnv1a_64 (void const * data, size_t size, uint64_t seed) {
+    uint8_t const * bytes = reinterpret_cast<uint8_t const *>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+// -- whole file into a malloc'ed buffer (caller frees), with a '\0' after the last
+// byte so text can be scanned in place; null if the file can't be opened or read
+static char *
+read_whole_file (char const * path, size_t * out_size) {
+    *out_size = 0;
+    FILE * file = ::fopen(path, "rb");
+    if (!file)
+        return nullptr;
+    ::fseek(file, 0, SEEK_END);
+    long size = ::ftell(file);
+    ::fseek(file, 0, SEEK_SET);
+    char * ret = size >= 0 ? reinterpret_cast<char *>(::malloc((size_t)size + 1)) : nullptr;
+    if (ret && ::fread(ret, 1, (size_t)size, file) != (size_t)size) {
+        ::free(ret);
+        ret = nullptr;
+    }
+    ::fclose(file);
+    if (ret) {
+        ret[size] = '\0';
+        *out_size = (size_t)size;
+    }
+    return ret;
+}
@@ -0,0 +1,363 @@
+#pragma once
+
+// NOTE(omid): Allocates contiguous descriptor ranges out of fixed-size pages of
+// one descriptor heap type. Free space is kept as blocks in segregated free
+// lists: list k holds blocks whose size is in [2^k, 2^(k+1)), and a bitmask of
+// the non-empty lists lets allocate find a big enough block in O(1). Freed
+// ranges are merged with free neighbours through boundary tags (size stored at
+// the block start, start stored at the block end), also O(1).
+// Pages (the actual heaps) come from a callback, so this header only depends on
+// the C runtime and can be exercised with a fake heap.
+
+#include "common_macros.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DESCRIPTOR_ALLOCATOR_MAX_PAGES      16
+#define DESCRIPTOR_SIZE_CLASS_COUNT         32
+#define DESCRIPTOR_NONE                     0xffffffff
+
+// -- what the page callback hands back: the heap (opaque here) and its base addresses
+struct DescriptorPageMemory {
+    void *                          heap;
+    uint64_t                        cpu_base;
+    uint64_t                        gpu_base;           // 0 for cpu-only heaps
+};
+typedef bool (*DescriptorPageCreateFn)(void * user, uint32_t descriptor_count, DescriptorPageMemory * out_memory);
+typedef void (*DescriptorPageDestroyFn)(void * user, DescriptorPageMemory * memory);
+
+struct DescriptorPage {
+    DescriptorPageMemory            memory;
+    // -- per descriptor slot, indexed by offset in the page; only meaningful at free block boundaries
+    uint32_t *                      free_size;          // at a free block's first slot: its size, else 0
+    uint32_t *                      free_start;         // at a free block's last slot: its first slot
+    uint32_t *                      next;               // free list links (global ids), at a free block's first slot
+    uint32_t *                      prev;
+};
+// NOTE(omid): A range of descriptors; carries everything needed to address any
+// descriptor in it without going back to the allocator.
+struct DescriptorHandle {
+    uint64_t                        cpu;
+    uint64_t                        gpu;
+    uint32_t                        id;                 // page * page_size + offset, DESCRIPTOR_NONE if invalid
+    uint32_t                        count;
+    uint32_t                        increment;
+};
+struct DescriptorAllocatorStats {
+    uint32_t                        allocated;          // descriptors currently handed out
+    uint32_t                        high_water;
+    uint32_t                        alloc_calls;
+    uint32_t                        free_calls;
+    uint32_t                        merges;
+    uint32_t                        failed;
+};
+struct DescriptorAllocator {
+    char const *                    name;
+    uint32_t                        page_size;          // descriptors per page
+    uint32_t                        max_pages;
+    uint32_t                        increment;          // bytes between two descriptors
+    DescriptorPageCreateFn          create_page;
+    DescriptorPageDestroyFn         destroy_page;
+    void *                          user;
+
+    DescriptorPage                  pages [DESCRIPTOR_ALLOCATOR_MAX_PAGES];
+    uint32_t                        page_count;
+
+    uint32_t                        heads [DESCRIPTOR_SIZE_CLASS_COUNT];
+    uint32_t                        nonempty_mask;
+    DescriptorAllocatorStats        stats;
+};
+
+static uint32_t
+descriptor_floor_log2 (uint32_t v) {
+    SIMPLE_ASSERT(v > 0);
+    uint32_t ret = 0;
+    while (v >>= 1)
+        ++ret;
+    return ret;
+}
+static uint32_t
+descriptor_ceil_log2 (uint32_t v) {
+    uint32_t ret = descriptor_floor_log2(v);
+    return (v & (v - 1)) ? ret + 1 : ret;
+}
+static uint32_t
+descriptor_lowest_bit (uint32_t mask) {
+    SIMPLE_ASSERT(mask);
+    uint32_t ret = 0;
+    while (0 == (mask & 1u)) {
+        mask >>= 1;
+        ++ret;
+    }
+    return ret;
+}
+static DescriptorPage *
+descriptor_page_of (DescriptorAllocator * allocator, uint32_t id) {
+    SIMPLE_ASSERT(id / allocator->page_size < allocator->page_count);
+    return &allocator->pages[id / allocator->page_size];
+}
+
+// -- free block bookkeeping
+static void
+descriptor_block_insert (DescriptorAllocator * allocator, uint32_t id, uint32_t size) {
+    DescriptorPage * page = descriptor_page_of(allocator, id);
+    uint32_t first = id % allocator->page_size;
+    uint32_t last = first + size - 1;
+    page->free_size[first] = size;
+    page->free_start[last] = first;
+
+    uint32_t size_class = descriptor_floor_log2(size);
+    uint32_t head = allocator->heads[size_class];
+    page->next[first] = head;
+    page->prev[first] = DESCRIPTOR_NONE;
+    if (head != DESCRIPTOR_NONE)
+        descriptor_page_of(allocator, head)->prev[head % allocator->page_size] = id;
+    allocator->heads[size_class] = id;
+    allocator->nonempty_mask |= 1u << size_class;
+}
+static void
+descriptor_block_remove (DescriptorAllocator * allocator, uint32_t id) {
+    DescriptorPage * page = descriptor_page_of(allocator, id);
+    uint32_t first = id % allocator->page_size;
+    uint32_t size = page->free_size[first];
+    SIMPLE_ASSERT(size > 0);
+    uint32_t size_class = descriptor_floor_log2(size);
+
+    uint32_t next = page->next[first];
+    uint32_t prev = page->prev[first];
+    if (prev != DESCRIPTOR_NONE)
+        descriptor_page_of(allocator, prev)->next[prev % allocator->page_size] = next;
+    else
+        allocator->heads[size_class] = next;
+    if (next != DESCRIPTOR_NONE)
+        descriptor_page_of(allocator, next)->prev[next % allocator->page_size] = prev;
+    if (DESCRIPTOR_NONE == allocator->heads[size_class])
+        allocator->nonempty_mask &= ~(1u << size_class);
+
+    page->free_size[first] = 0;
+    page->free_start[first + size - 1] = DESCRIPTOR_NONE;
+}
+
+static bool
+descriptor_allocator_add_page (DescriptorAllocator * allocator) {
+    if (allocator->page_count >= allocator->max_pages)
+        return false;
+    DescriptorPage * page = &allocator->pages[allocator->page_count];
+    ::memset(page, 0, sizeof(*page));
+    if (!allocator->create_page(allocator->user, allocator->page_size, &page->memory))
+        return false;
+
+    size_t array_size = sizeof(uint32_t) * allocator->page_size;
+    page->free_size = reinterpret_cast<uint32_t *>(::malloc(array_size));
+    page->free_start = reinterpret_cast<uint32_t *>(::malloc(array_size));
+    page->next = reinterpret_cast<uint32_t *>(::malloc(array_size));
+    page->prev = reinterpret_cast<uint32_t *>(::malloc(array_size));
+    SIMPLE_ASSERT(page->free_size && page->free_start && page->next && page->prev);
+    ::memset(page->free_size, 0, array_size);
+    ::memset(page->free_start, 0xff, array_size);
+
+    uint32_t page_index = allocator->page_count++;
+    descriptor_block_insert(allocator, page_index * allocator->page_size, allocator->page_size);
+    return true;
+}
+// NOTE(omid): max_pages of 1 gives a single fixed heap, which is what
+// shader-visible heaps need (only one of them can be bound at a time).
+static void
+descriptor_allocator_init (
+    DescriptorAllocator * allocator, char const * name, uint32_t page_size, uint32_t max_pages, uint32_t increment,
+    DescriptorPageCreateFn create_page, DescriptorPageDestroyFn destroy_page, void * user
+) {
+    SIMPLE_ASSERT(page_size > 0 && max_pages > 0 && max_pages <= DESCRIPTOR_ALLOCATOR_MAX_PAGES);
+    ::memset(allocator, 0, sizeof(*allocator));
+    allocator->name = name;
+    allocator->page_size = page_size;
+    allocator->max_pages = max_pages;
+    allocator->increment = increment;
+    allocator->create_page = create_page;
+    allocator->destroy_page = destroy_page;
+    allocator->user = user;
+    for (uint32_t i = 0; i < DESCRIPTOR_SIZE_CLASS_COUNT; ++i)
+        allocator->heads[i] = DESCRIPTOR_NONE;
+
+    // -- first page up front so callers can query the heap right away
+    bool page_added = descriptor_allocator_add_page(allocator);
+    SIMPLE_ASSERT(page_added);
+}
+static void
+descriptor_allocator_destroy (DescriptorAllocator * allocator) {
+    for (uint32_t i = 0; i < allocator->page_count; ++i) {
+        DescriptorPage * page = &allocator->pages[i];
+        if (allocator->destroy_page)
+            allocator->destroy_page(allocator->user, &page->memory);
+        ::free(page->free_size);
+        ::free(page->free_start);
+        ::free(page->next);
+        ::free(page->prev);
+    }
+    ::memset(allocator, 0, sizeof(*allocator));
+}
+static DescriptorHandle
+descriptor_allocate (DescriptorAllocator * allocator, uint32_t count) {
+    DescriptorHandle ret = {};
+    ret.id = DESCRIPTOR_NONE;
+    ++allocator->stats.alloc_calls;
+    if (0 == count || count > allocator->page_size) {
+        ++allocator->stats.failed;
+        return ret;
+    }
+
+    // -- any block in class >= ceil(log2(count)) is big enough
+    uint32_t id = DESCRIPTOR_NONE;
+    uint32_t min_class = descriptor_ceil_log2(count);
+    uint32_t candidates = min_class < 32 ? allocator->nonempty_mask & ~((1u << min_class) - 1u) : 0;
+    if (candidates) {
+        id = allocator->heads[descriptor_lowest_bit(candidates)];
+    } else {
+        // -- the class below may still hold a block that fits (count is not a power of two)
+        uint32_t lower_class = descriptor_floor_log2(count);
+        for (uint32_t it = allocator->heads[lower_class]; it != DESCRIPTOR_NONE;) {
+            DescriptorPage * page = descriptor_page_of(allocator, it);
+            if (page->free_size[it % allocator->page_size] >= count) {
+                id = it;
+                break;
+            }
+            it = page->next[it % allocator->page_size];
+        }
+    }
+    if (DESCRIPTOR_NONE == id) {
+        if (!descriptor_allocator_add_page(allocator)) {
+            ++allocator->stats.failed;
+            return ret;
+        }
+        id = (allocator->page_count - 1) * allocator->page_size;
+    }
+
+    // -- take the front of the block, give the tail back
+    DescriptorPage * page = descriptor_page_of(allocator, id);
+    uint32_t block_size = page->free_size[id % allocator->page_size];
+    SIMPLE_ASSERT(block_size >= count);
+    descriptor_block_remove(allocator, id);
+    if (block_size > count)
+        descriptor_block_insert(allocator, id + count, block_size - count);
+
+    uint32_t offset = id % allocator->page_size;
+    ret.cpu = page->memory.cpu_base + (uint64_t)offset * allocator->increment;
+    ret.gpu = page->memory.gpu_base ? page->memory.gpu_base + (uint64_t)offset * allocator->increment : 0;
+    ret.id = id;
+    ret.count = count;
+    ret.increment = allocator->increment;
+
+    allocator->stats.allocated += count;
+    if (allocator->stats.allocated > allocator->stats.high_water)
+        allocator->stats.high_water = allocator->stats.allocated;
+    return ret;
+}
+static void
+descriptor_free (DescriptorAllocator * allocator, DescriptorHandle * handle) {
+    if (DESCRIPTOR_NONE == handle->id)
+        return;
+    ++allocator->stats.free_calls;
+    SIMPLE_ASSERT(allocator->stats.allocated >= handle->count);
+    allocator->stats.allocated -= handle->count;
+
+    DescriptorPage * page = descriptor_page_of(allocator, handle->id);
+    uint32_t page_base = handle->id - handle->id % allocator->page_size;
+    uint32_t first = handle->id % allocator->page_size;
+    uint32_t size = handle->count;
+
+    // -- merge with the free block right after
+    uint32_t after = first + size;
+    if (after < allocator->page_size && page->free_size[after] > 0) {
+        uint32_t after_size = page->free_size[after];
+        descriptor_block_remove(allocator, page_base + after);
+        size += after_size;
+        ++allocator->stats.merges;
+    }
+    // -- merge with the free block right before
+    if (first > 0 && page->free_start[first - 1] != DESCRIPTOR_NONE) {
+        uint32_t before = page->free_start[first - 1];
+        uint32_t before_size = page->free_size[before];
+        descriptor_block_remove(allocator, page_base + before);
+        first = before;
+        size += before_size;
+        ++allocator->stats.merges;
+    }
+    descriptor_block_insert(allocator, page_base + first, size);
+
+    handle->id = DESCRIPTOR_NONE;
+    handle->count = 0;
+}
+static uint64_t
+descriptor_cpu_at (DescriptorHandle const * handle, uint32_t index) {
+    SIMPLE_ASSERT(index < handle->count);
+    return handle->cpu + (uint64_t)index * handle->increment;
+}
+static uint64_t
+descriptor_gpu_at (DescriptorHandle const * handle, uint32_t index) {
+    SIMPLE_ASSERT(index < handle->count && handle->gpu);
+    return handle->gpu + (uint64_t)index * handle->increment;
+}
+// -- view of part of a range (e.g. one slot of a big bindless range); never pass it to descriptor_free
+static DescriptorHandle
+descriptor_sub_range (DescriptorHandle const * handle, uint32_t first, uint32_t count) {
+    SIMPLE_ASSERT(first + count <= handle->count);
+    DescriptorHandle ret = *handle;
+    ret.cpu = handle->cpu + (uint64_t)first * handle->increment;
+    ret.gpu = handle->gpu ? handle->gpu + (uint64_t)first * handle->increment : 0;
+    ret.id = handle->id + first;
+    ret.count = count;
+    return ret;
+}
+// -- heap the handle lives in (as returned by the page callback)
+static void *
+descriptor_heap_of (DescriptorAllocator * allocator, DescriptorHandle const * handle) {
+    return descriptor_page_of(allocator, handle->id)->memory.heap;
+}
+// -- index of the handle's first descriptor relative to its heap start
+static uint32_t
+descriptor_heap_offset (DescriptorAllocator const * allocator, DescriptorHandle const * handle) {
+    return handle->id % allocator->page_size;
+}
+// NOTE(omid): Walks every page and free list and checks the bookkeeping agrees;
+// returns the number of free descriptors found, or DESCRIPTOR_NONE on corruption.
+static uint32_t
+descriptor_allocator_validate (DescriptorAllocator * allocator) {
+    uint32_t free_in_lists = 0;
+    for (uint32_t c = 0; c < DESCRIPTOR_SIZE_CLASS_COUNT; ++c) {
+        bool nonempty = allocator->heads[c] != DESCRIPTOR_NONE;
+        if (nonempty != (0 != (allocator->nonempty_mask & (1u << c))))
+            return DESCRIPTOR_NONE;
+        uint32_t prev = DESCRIPTOR_NONE;
+        for (uint32_t it = allocator->heads[c]; it != DESCRIPTOR_NONE;) {
+            DescriptorPage * page = descriptor_page_of(allocator, it);
+            uint32_t first = it % allocator->page_size;
+            uint32_t size = page->free_size[first];
+            if (0 == size || descriptor_floor_log2(size) != c || page->prev[first] != prev)
+                return DESCRIPTOR_NONE;
+            if (page->free_start[first + size - 1] != first)
+                return DESCRIPTOR_NONE;
+            // -- two free blocks must never touch (they would have been merged)
+            uint32_t after = first + size;
+            if (after < allocator->page_size && page->free_size[after] > 0)
+                return DESCRIPTOR_NONE;
+            free_in_lists += size;
+            prev = it;
+            it = page->next[first];
+        }
+    }
+    if (free_in_lists + allocator->stats.allocated != allocator->page_count * allocator->page_size)
+        return DESCRIPTOR_NONE;
+    return free_in_lists;
+}
+static void
+descriptor_allocator_print_stats (DescriptorAllocator const * allocator) {
+    DescriptorAllocatorStats const * s = &allocator->stats;
+    ::printf(
+        "Descriptor allocator (%s): %u pages x %u, %u allocated (high water %u), %u allocs, %u frees, %u merges, %u failed\n",
+        allocator->name, allocator->page_count, allocator->page_size, s->allocated, s->high_water,
+        s->alloc_calls, s->free_calls, s->merges, s->failed
+    );
+}
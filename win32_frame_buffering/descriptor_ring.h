@@ -0,0 +1,157 @@
+#pragma once
+
+// NOTE(omid): Per-frame descriptor tables built by copying. Persistent descriptors
+// live in cpu-only staging heaps (cheap to create, never bound); every frame the
+// tables a draw needs are copied into a linear region of the shader-visible heap.
+// The region is split into one segment per frame in flight, and a segment is
+// reused only after the fence of the frame that last filled it has completed.
+// Copies are not issued one by one: tables allocated back to back are
+// contiguous in the destination, so a whole batch goes out as a single
+// CopyDescriptors call (one destination range, one source range per table entry).
+
+#include "descriptor_allocator.h"
+
+#define DESCRIPTOR_RING_MAX_PENDING     256     // source ranges per CopyDescriptors batch
+
+struct DescriptorRingSegment {
+    uint32_t                        begin;          // relative to the ring range
+    uint32_t                        end;
+    UINT64                          fence_value;    // signaled when the gpu is done with the segment
+};
+struct DescriptorRingStats {
+    UINT64                          frames;
+    UINT64                          tables;
+    UINT64                          descriptors_copied;
+    UINT64                          copy_calls;
+    UINT                            max_descriptors_per_frame;
+    UINT                            overflows;
+    // -- current frame
+    UINT                            frame_descriptors;
+};
+struct DescriptorRing {
+    ID3D12Device *                  device;
+    D3D12_DESCRIPTOR_HEAP_TYPE      type;
+    DescriptorHandle                range;          // shader-visible descriptors owned by the ring
+    uint32_t                        heap_offset;    // of range, relative to its heap start
+
+    DescriptorRingSegment           segments [FRAME_COUNT];
+    uint32_t                        current;        // segment being filled
+    uint32_t                        head;           // next free descriptor, relative to the ring range
+
+    // -- batch of copies not yet issued
+    D3D12_CPU_DESCRIPTOR_HANDLE     pending_src_starts [DESCRIPTOR_RING_MAX_PENDING];
+    UINT                            pending_src_sizes [DESCRIPTOR_RING_MAX_PENDING];
+    UINT                            pending_src_count;
+    uint32_t                        pending_dest_begin;
+    UINT                            pending_dest_size;
+
+    DescriptorRingStats             stats;
+};
+
+static void
+descriptor_ring_init (
+    DescriptorRing * ring, ID3D12Device * device, D3D12_DESCRIPTOR_HEAP_TYPE type,
+    DescriptorHandle const * range, uint32_t heap_offset
+) {
+    ::memset(ring, 0, sizeof(*ring));
+    ring->device = device;
+    ring->type = type;
+    ring->range = *range;
+    ring->heap_offset = heap_offset;
+    uint32_t segment_size = range->count / FRAME_COUNT;
+    SIMPLE_ASSERT(segment_size > 0 && range->gpu);
+    for (uint32_t i = 0; i < FRAME_COUNT; ++i) {
+        ring->segments[i].begin = i * segment_size;
+        ring->segments[i].end = (i + 1) * segment_size;
+    }
+}
+// -- issue every pending copy as one CopyDescriptors call
+static void
+descriptor_ring_flush (DescriptorRing * ring) {
+    if (0 == ring->pending_src_count)
+        return;
+    D3D12_CPU_DESCRIPTOR_HANDLE dest_start = {};
+    dest_start.ptr = (SIZE_T)descriptor_cpu_at(&ring->range, ring->pending_dest_begin);
+    UINT dest_size = ring->pending_dest_size;
+    ring->device->CopyDescriptors(
+        1, &dest_start, &dest_size,
+        ring->pending_src_count, ring->pending_src_starts, ring->pending_src_sizes,
+        ring->type
+    );
+    ++ring->stats.copy_calls;
+    ring->stats.descriptors_copied += ring->pending_dest_size;
+
+    ring->pending_src_count = 0;
+    ring->pending_dest_size = 0;
+    ring->pending_dest_begin = ring->head;
+}
+// -- start filling the segment of frame_index; its previous contents must be retired
+static void
+descriptor_ring_begin_frame (DescriptorRing * ring, uint32_t frame_index, UINT64 completed_fence_value) {
+    SIMPLE_ASSERT(frame_index < FRAME_COUNT);
+    DescriptorRingSegment * segment = &ring->segments[frame_index];
+    SIMPLE_ASSERT(segment->fence_value <= completed_fence_value);
+    ring->current = frame_index;
+    ring->head = segment->begin;
+    ring->pending_dest_begin = segment->begin;
+    ring->stats.frame_descriptors = 0;
+}
+// NOTE(omid): Copies count staging ranges back to back into the current segment and
+// returns the resulting table (a shader-visible range). The copy itself is deferred
+// until the next flush, which must happen before the table is set on a command
+// list: with static descriptors (the root signature 1.1 default) the descriptors
+// have to be valid at SetGraphicsRootDescriptorTable time, not only at execute.
+static DescriptorHandle
+descriptor_ring_build_table (DescriptorRing * ring, DescriptorHandle const * sources, uint32_t count) {
+    DescriptorHandle ret = {};
+    ret.id = DESCRIPTOR_NONE;
+
+    uint32_t table_size = 0;
+    for (uint32_t i = 0; i < count; ++i)
+        table_size += sources[i].count;
+    DescriptorRingSegment * segment = &ring->segments[ring->current];
+    if (0 == table_size || ring->head + table_size > segment->end) {
+        ++ring->stats.overflows;
+        return ret;
+    }
+    if (ring->pending_src_count + count > DESCRIPTOR_RING_MAX_PENDING)
+        descriptor_ring_flush(ring);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        SIMPLE_ASSERT(sources[i].id != DESCRIPTOR_NONE);
+        ring->pending_src_starts[ring->pending_src_count].ptr = (SIZE_T)sources[i].cpu;
+        ring->pending_src_sizes[ring->pending_src_count] = sources[i].count;
+        ++ring->pending_src_count;
+    }
+    ret = descriptor_sub_range(&ring->range, ring->head, table_size);
+    ring->head += table_size;
+    ring->pending_dest_size += table_size;
+
+    ++ring->stats.tables;
+    ring->stats.frame_descriptors += table_size;
+    return ret;
+}
+// -- table position relative to the heap start (what root descriptor tables are set with)
+static uint32_t
+descriptor_ring_heap_offset (DescriptorRing const * ring, DescriptorHandle const * table) {
+    return ring->heap_offset + (table->id - ring->range.id);
+}
+// -- fence_value: signaled once the frame that used this segment is done on the gpu
+static void
+descriptor_ring_end_frame (DescriptorRing * ring, UINT64 fence_value) {
+    descriptor_ring_flush(ring);
+    ring->segments[ring->current].fence_value = fence_value;
+    ++ring->stats.frames;
+    if (ring->stats.frame_descriptors > ring->stats.max_descriptors_per_frame)
+        ring->stats.max_descriptors_per_frame = ring->stats.frame_descriptors;
+}
+static void
+descriptor_ring_print_stats (DescriptorRing const * ring) {
+    DescriptorRingStats const * s = &ring->stats;
+    double frames = s->frames > 0 ? (double)s->frames : 1.0;
+    ::printf(
+        "Descriptor ring: %.2f descriptors copied/frame (max %u), %.2f tables/frame, %.2f CopyDescriptors calls/frame, %u overflows\n",
+        (double)s->descriptors_copied / frames, s->max_descriptors_per_frame,
+        (double)s->tables / frames, (double)s->copy_calls / frames, s->overflows
+    );
+}
@@ -0,0 +1,262 @@
+#pragma once
+
+// NOTE(omid): A queue of draw packets, each carrying a 64-bit sort key:
+//
+//   63        56 55          44 43                  24 23                  0
+//  |   layer    |    pso id    |  material / table   |        depth        |
+//
+// Before recording, the (key, index) pairs are sorted with an LSD radix sort
+// (8 passes of 8 bits, passes whose byte is identical for every key are skipped),
+// split across threads for large queues. Translation into the command stream
+// then only emits pipeline / root signature / descriptor table / vertex buffer
+// changes when they differ from the previous draw.
+
+#include "command_stream.h"
+
+#include <thread>
+#include <barrier>
+
+#define DRAW_QUEUE_MAX_THREADS              8
+#define DRAW_QUEUE_PARALLEL_THRESHOLD       (64 * 1024)     // below this a single thread is faster
+#define DRAW_QUEUE_NO_STATE                 0xffffffff
+
+struct DrawPacket {
+    uint32_t                        pso_id;
+    uint32_t                        root_signature_id;
+    // -- material: one descriptor table
+    uint32_t                        table_root_index;
+    uint32_t                        table_heap_id;
+    uint32_t                        table_descriptor_index;
+    // -- geometry
+    uint32_t                        topology;
+    uint32_t                        vb_resource_id;
+    uint32_t                        vb_offset;
+    uint32_t                        vb_size;
+    uint32_t                        vb_stride;
+    uint32_t                        vertex_count_per_instance;
+    uint32_t                        instance_count;
+    uint32_t                        start_vertex;
+    uint32_t                        start_instance;
+};
+struct DrawSortItem {
+    uint64_t                        key;
+    uint32_t                        index;
+    uint32_t                        padding;
+};
+struct DrawStateChanges {
+    uint32_t                        pso;
+    uint32_t                        root_signature;
+    uint32_t                        descriptor_table;
+    uint32_t                        vertex_buffer;
+    uint32_t                        topology;
+};
+struct DrawQueueStats {
+    uint32_t                        draw_count;
+    DrawStateChanges                unsorted;       // state changes if submitted in push order
+    DrawStateChanges                sorted;         // state changes actually recorded
+};
+struct DrawQueue {
+    DrawPacket *                    packets;
+    DrawSortItem *                  items;
+    DrawSortItem *                  scratch;
+    uint32_t                        count;
+    uint32_t                        capacity;
+    uint32_t                        thread_count;
+    DrawQueueStats                  stats;
+};
+
+static uint64_t
+draw_sort_key_make (uint32_t layer, uint32_t pso_id, uint32_t material_id, float depth01) {
+    SIMPLE_ASSERT(layer < (1u << 8) && pso_id < (1u << 12) && material_id < (1u << 20));
+    depth01 = depth01 < 0.0f ? 0.0f : (depth01 > 1.0f ? 1.0f : depth01);
+    uint64_t depth = (uint64_t)(depth01 * (float)((1u << 24) - 1));
+    return ((uint64_t)layer << 56) | ((uint64_t)pso_id << 44) | ((uint64_t)material_id << 24) | depth;
+}
+static void
+draw_queue_init (DrawQueue * queue, uint32_t capacity, uint32_t thread_count) {
+    ::memset(queue, 0, sizeof(*queue));
+    queue->packets = reinterpret_cast<DrawPacket *>(::malloc(sizeof(DrawPacket) * capacity));
+    queue->items = reinterpret_cast<DrawSortItem *>(::malloc(sizeof(DrawSortItem) * capacity));
+    queue->scratch = reinterpret_cast<DrawSortItem *>(::malloc(sizeof(DrawSortItem) * capacity));
+    SIMPLE_ASSERT(queue->packets && queue->items && queue->scratch);
+    queue->capacity = capacity;
+    queue->thread_count = thread_count < 1 ? 1 : (thread_count > DRAW_QUEUE_MAX_THREADS ? DRAW_QUEUE_MAX_THREADS : thread_count);
+}
+static void
+draw_queue_destroy (DrawQueue * queue) {
+    ::free(queue->packets);
+    ::free(queue->items);
+    ::free(queue->scratch);
+    ::memset(queue, 0, sizeof(*queue));
+}
+static void
+draw_queue_reset (DrawQueue * queue) {
+    queue->count = 0;
+}
+static void
+draw_queue_push (DrawQueue * queue, uint64_t sort_key, DrawPacket const * packet) {
+    SIMPLE_ASSERT(queue->count < queue->capacity);
+    queue->packets[queue->count] = *packet;
+    queue->items[queue->count].key = sort_key;
+    queue->items[queue->count].index = queue->count;
+    queue->items[queue->count].padding = 0;
+    ++queue->count;
+}
+
+// -- one thread's share of the radix sort; every participant runs all 8 passes in lockstep
+struct RadixSortShared {
+    DrawSortItem *                  buffers [2];
+    uint32_t                        count;
+    uint32_t                        thread_count;
+    uint32_t                        histograms [DRAW_QUEUE_MAX_THREADS][256];
+    bool                            skip_pass;
+    std::barrier<> *                sync;
+};
+static void
+radix_sort_worker (RadixSortShared * shared, uint32_t thread_index) {
+    uint32_t chunk = (shared->count + shared->thread_count - 1) / shared->thread_count;
+    uint32_t begin = thread_index * chunk;
+    uint32_t end = begin + chunk < shared->count ? begin + chunk : shared->count;
+    if (begin > end)
+        begin = end;
+
+    uint32_t src = 0;
+    for (uint32_t pass = 0; pass < 8; ++pass) {
+        uint32_t shift = pass * 8;
+        DrawSortItem const * in = shared->buffers[src];
+        DrawSortItem * out = shared->buffers[src ^ 1];
+
+        // -- 1. histogram of this thread's chunk
+        uint32_t * histogram = shared->histograms[thread_index];
+        ::memset(histogram, 0, sizeof(shared->histograms[0]));
+        for (uint32_t i = begin; i < end; ++i)
+            ++histogram[(in[i].key >> shift) & 0xff];
+        shared->sync->arrive_and_wait();
+
+        // -- 2. exclusive prefix sum over (digit, thread), done once
+        if (0 == thread_index) {
+            shared->skip_pass = false;
+            uint32_t sum = 0;
+            for (uint32_t d = 0; d < 256; ++d) {
+                uint32_t digit_total = 0;
+                for (uint32_t t = 0; t < shared->thread_count; ++t) {
+                    uint32_t c = shared->histograms[t][d];
+                    shared->histograms[t][d] = sum;
+                    sum += c;
+                    digit_total += c;
+                }
+                if (digit_total == shared->count)
+                    shared->skip_pass = true;      // every key has the same byte here
+            }
+        }
+        shared->sync->arrive_and_wait();
+
+        // -- 3. stable scatter
+        if (!shared->skip_pass) {
+            for (uint32_t i = begin; i < end; ++i)
+                out[histogram[(in[i].key >> shift) & 0xff]++] = in[i];
+            src ^= 1;
+        }
+        shared->sync->arrive_and_wait();
+    }
+    // -- make sure the result ends up in buffers[0]
+    if (src != 0) {
+        for (uint32_t i = begin; i < end; ++i)
+            shared->buffers[0][i] = shared->buffers[1][i];
+    }
+}
+static void
+draw_queue_sort (DrawQueue * queue) {
+    if (queue->count < 2)
+        return;
+
+    uint32_t thread_count = queue->count >= DRAW_QUEUE_PARALLEL_THRESHOLD ? queue->thread_count : 1;
+    std::barrier<> sync((ptrdiff_t)thread_count);
+
+    RadixSortShared shared = {};
+    shared.buffers[0] = queue->items;
+    shared.buffers[1] = queue->scratch;
+    shared.count = queue->count;
+    shared.thread_count = thread_count;
+    shared.sync = &sync;
+
+    std::thread workers [DRAW_QUEUE_MAX_THREADS];
+    for (uint32_t t = 1; t < thread_count; ++t)
+        workers[t] = std::thread(radix_sort_worker, &shared, t);
+    radix_sort_worker(&shared, 0);
+    for (uint32_t t = 1; t < thread_count; ++t)
+        workers[t].join();
+}
+// -- walk packets in the given order, optionally recording them, and count state changes
+static DrawStateChanges
+draw_queue_walk (DrawQueue const * queue, DrawSortItem const * order, uint32_t bound_root_signature_id, CommandStream * stream) {
+    DrawStateChanges changes = {};
+    uint32_t root_signature_id = bound_root_signature_id;
+    uint32_t pso_id = DRAW_QUEUE_NO_STATE;
+    uint32_t topology = DRAW_QUEUE_NO_STATE;
+    DrawPacket const * table_owner = nullptr;      // draw whose descriptor table is bound
+    DrawPacket const * vb_owner = nullptr;         // draw whose vertex buffer is bound
+    for (uint32_t i = 0; i < queue->count; ++i) {
+        DrawPacket const * draw = &queue->packets[order ? order[i].index : i];
+        if (root_signature_id != draw->root_signature_id) {
+            root_signature_id = draw->root_signature_id;
+            table_owner = nullptr;     // changing the root signature invalidates all root arguments
+            ++changes.root_signature;
+            if (stream)
+                cmd_set_root_signature(stream, draw->root_signature_id);
+        }
+        if (pso_id != draw->pso_id) {
+            pso_id = draw->pso_id;
+            ++changes.pso;
+            if (stream)
+                cmd_set_pipeline_state(stream, draw->pso_id);
+        }
+        if (!table_owner || table_owner->table_root_index != draw->table_root_index ||
+            table_owner->table_heap_id != draw->table_heap_id || table_owner->table_descriptor_index != draw->table_descriptor_index
+        ) {
+            table_owner = draw;
+            ++changes.descriptor_table;
+            if (stream)
+                cmd_set_root_descriptor_table(stream, draw->table_root_index, draw->table_heap_id, draw->table_descriptor_index);
+        }
+        if (topology != draw->topology) {
+            topology = draw->topology;
+            ++changes.topology;
+            if (stream)
+                cmd_set_primitive_topology(stream, draw->topology);
+        }
+        if (!vb_owner || vb_owner->vb_resource_id != draw->vb_resource_id || vb_owner->vb_offset != draw->vb_offset ||
+            vb_owner->vb_size != draw->vb_size || vb_owner->vb_stride != draw->vb_stride
+        ) {
+            vb_owner = draw;
+            ++changes.vertex_buffer;
+            if (stream)
+                cmd_set_vertex_buffer(stream, 0, draw->vb_resource_id, draw->vb_offset, draw->vb_size, draw->vb_stride);
+        }
+        if (stream)
+            cmd_draw(stream, draw->vertex_count_per_instance, draw->instance_count, draw->start_vertex, draw->start_instance);
+    }
+    return changes;
+}
+// NOTE(omid): Sort the queue and record it into stream with redundant state elided.
+// The caller is responsible for heaps, viewport, scissor and render targets, and
+// passes the root signature it already bound for the pass (or DRAW_QUEUE_NO_STATE),
+// so root arguments it set up are not invalidated by a redundant SetGraphicsRootSignature.
+static void
+draw_queue_submit (DrawQueue * queue, CommandStream * stream, uint32_t bound_root_signature_id) {
+    queue->stats.draw_count = queue->count;
+    queue->stats.unsorted = draw_queue_walk(queue, nullptr, bound_root_signature_id, nullptr);
+    draw_queue_sort(queue);
+    queue->stats.sorted = draw_queue_walk(queue, queue->items, bound_root_signature_id, stream);
+}
+static void
+draw_queue_print_stats (DrawQueue const * queue) {
+    DrawStateChanges const * u = &queue->stats.unsorted;
+    DrawStateChanges const * s = &queue->stats.sorted;
+    ::printf("Draw queue: %u draws (last frame), state changes unsorted -> sorted:\n", queue->stats.draw_count);
+    ::printf("\tpso: %u -> %u\n", u->pso, s->pso);
+    ::printf("\troot signature: %u -> %u\n", u->root_signature, s->root_signature);
+    ::printf("\tdescriptor table: %u -> %u\n", u->descriptor_table, s->descriptor_table);
+    ::printf("\tvertex buffer: %u -> %u\n", u->vertex_buffer, s->vertex_buffer);
+    ::printf("\ttopology: %u -> %u\n", u->topology, s->topology);
+}
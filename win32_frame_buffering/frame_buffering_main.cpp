@@ -14,15 +14,9 @@
 #error "Define at most one."
 #endif
 
-#define SUCCEEDED(hr)   (((HRESULT)(hr)) >= 0)
 //#define SUCCEEDED_OPERATION(hr)   (((HRESULT)(hr)) == S_OK)
-#define FAILED(hr)      (((HRESULT)(hr)) < 0)
 //#define FAILED_OPERATION(hr)      (((HRESULT)(hr)) != S_OK)
-#define CHECK_AND_FAIL(hr)                          \
-    if (FAILED(hr)) {                               \
-        ::printf("[ERROR] " #hr "() failed at line %d. \n", __LINE__);   \
-        ::abort();                                  \
-    }                                               \
+#include "common_macros.h"
 
 #if defined(_DEBUG)
 #define ENABLE_DEBUG_LAYER 1
@@ -32,8 +26,28 @@
 
 bool global_running;
 
-#define ARRAY_COUNT(arr)            sizeof(arr)/sizeof(arr[0])
-#define SIMPLE_ASSERT(exp) if(!(exp))  {*(int *)0 = 0;}
+#include "command_allocator_pool.h"
+#include "bundle_cache.h"
+#include "resource_state_tracker.h"
+#include "command_stream_replay.h"
+#include "draw_queue.h"
+#include "indirect_args.h"
+#include "descriptor_allocator.h"
+#include "bindless_index_allocator.h"
+#include "view_cache.h"
+#include "descriptor_ring.h"
+#include "pso_cache.h"
+#include "shader_permutations.h"
+#include "shader_watcher.h"
+#include "shader_reflection.h"
+#include "collada_loader.h"
+#include "mesh_optimizer.h"
+#include "vertex_compression.h"
+#include "mesh_lod.h"
+#include "meshlet_builder.h"
+#include "mesh_container.h"
+#include "index_buffer.h"
+#include "frustum_cull.h"
 
 // In this sample we overload the meaning of FrameCount to mean both the maximum
 // number of frames that will be queued to the GPU at a time, as well as the number
@@ -45,11 +59,143 @@ bool global_running;
 // may result in noticeable latency in your app.
 #define FRAME_COUNT 2
 
+// -- write the first recorded frame's command stream to disk for offline inspection/replay
+#define DUMP_COMMAND_STREAM 0
+
+// -- time the cpu-side hot paths (indirect packing, frustum culling) once at startup
+#define RUN_STARTUP_BENCHMARKS 0
+
+// -- how the quad reaches the command list
+#define QUAD_SUBMIT_BUNDLE          0   // cached bundle
+#define QUAD_SUBMIT_DRAW_QUEUE      1   // sorted draw queue, redundant state elided
+#define QUAD_SUBMIT_INDIRECT        2   // ExecuteIndirect over a cpu-packed argument buffer
+#define QUAD_SUBMIT_MODE            QUAD_SUBMIT_BUNDLE
+
+// -- bindless: shaders index one big descriptor range with root-constant indices
+// (shader model 5.1 unbounded ranges, needs resource binding tier 2)
+#define USE_BINDLESS                0
+#define BINDLESS_MAX_DESCRIPTORS    4096
+#define ROOT_PARAM_MATERIAL         1   // bindless only: texture / constants indices
+// -- non-bindless: views live in a cpu-only staging heap and each frame's tables
+// are copied into a per-frame ring in the shader-visible heap
+#define USE_DESCRIPTOR_RING         1
+#define DESCRIPTOR_RING_SIZE        1024
+#define TABLES_FROM_DESCRIPTOR_RING (USE_BINDLESS == 0 && USE_DESCRIPTOR_RING > 0)
+#if USE_BINDLESS > 0
+#define SRV_CBV_HEAP_SIZE           (256 + BINDLESS_MAX_DESCRIPTORS)
+#else
+#define SRV_CBV_HEAP_SIZE           (256 + DESCRIPTOR_RING_SIZE)
+#endif
+
+// -- draws one frame's indirect argument buffer can hold
+#define INDIRECT_MAX_DRAWS          256
+// -- per frame: INDIRECT_MAX_DRAWS commands followed by the count (kept on its own 256b)
+#define INDIRECT_COUNT_OFFSET       (INDIRECT_MAX_DRAWS * INDIRECT_DRAW_STRIDE)
+#define INDIRECT_FRAME_SIZE         (INDIRECT_COUNT_OFFSET + 256)
+// -- root parameter the indirect commands write their constants to
+#define ROOT_PARAM_DRAW_CONSTANTS   2
+
+// -- compiled pipelines persisted between runs (next to the executable's working dir)
+#define PSO_CACHE_LIBRARY_PATH      "./pso_cache.bin"
+#define PSO_CACHE_INDEX_PATH        "./pso_cache_index.bin"
+// -- compiled shader bytecode, one file per (source + includes, defines, entry, target, flags)
+#define SHADER_CACHE_DIR            "./shader_cache"
+// -- pixel shader permutation keys (indices into ps_wanted_values) and the variants used last run
+#define PS_KEY_FLIP_TEXTU_Y         0
+#define PS_KEY_DEBUG_VIEW           1
+#define PS_KEY_COUNT                2
+#define PS_USAGE_PATH               SHADER_CACHE_DIR "/ps_main.usage"
+// -- precompiled DXIL from tools/build_shaders.py; used instead of runtime compiles when complete
+#define SHADER_ARCHIVE_PATH         "./shaders.pak"
+#define MAX_RETIRED_PSOS            8
+// -- watched for shader hot reload (subdirectories too on windows)
+#define SHADER_WATCH_DIR            "./shaders"
+// -- FX Composer scene (sphere / teapot meshes and their nodes), imported at startup
+#define SCENE_PATH                  "../learn_hlsl/Document1.dae"
+#define SCENE_CONTAINER_PATH        "Document1.mesh"        // SCENE_PATH after import, optimization, LODs and meshlets
+#define SCENE_SHADER_PATH           "./shaders/scene_shader.hlsl"
+#define SCENE_ROOT_CONSTANT_COUNT   24      // clip_from_local + VertexQuantization, per node
+#define SCENE_FOV_Y                 1.0471976f      // 60 degrees
+#define SCENE_LOD_PIXEL_ERROR       1.0f    // coarsest LOD level whose error projects under this many pixels
+
+// NOTE(omid): ids the command stream uses to refer to pipeline objects (see CommandStreamBindings)
+enum StreamPsoId : uint32_t {
+    STREAM_PSO_MAIN = 0,
+};
+enum StreamRootSignatureId : uint32_t {
+    STREAM_ROOT_SIGNATURE_MAIN = 0,
+};
+enum StreamHeapId : uint32_t {
+    STREAM_HEAP_RTV = 0,
+    STREAM_HEAP_SRV_CBV,
+};
+enum StreamResourceId : uint32_t {
+    STREAM_RESOURCE_VERTEX_BUFFER = 0,
+    STREAM_RESOURCE_INDIRECT_ARGS,
+};
+enum StreamBundleId : uint32_t {
+    STREAM_BUNDLE_QUAD = 0,
+};
+enum StreamCommandSignatureId : uint32_t {
+    STREAM_COMMAND_SIGNATURE_DRAW = 0,
+};
+
+// -- pipeline replaced while frames in flight may still use it
+struct RetiredPso {
+    ID3D12PipelineState *           pso;
+    UINT64                          fence_value;
+};
+
+// -- shader hot reload: watch -> compile (build service) -> link (pso on its own thread) -> swap
+enum HotReloadPhase : uint32_t {
+    HotReload_Idle = 0,
+    HotReload_Compiling,
+    HotReload_Linking,
+};
+struct ShaderHotReload {
+    ShaderWatcher                   watcher;
+    bool                            enabled;
+    bool                            pipeline_frozen;    // last reload failed; no variant switches until one succeeds
+    uint64_t                        source_hash;        // shader cache key of the vertex shader (source + includes)
+    char const *                    vs_entry;
+    char const *                    vs_target;
+    UINT                            flags;
+
+    HotReloadPhase                  phase;
+    double                          begin_ms;
+    ShaderBuildJob *                vs_job;
+    ID3DBlob *                      vs_bytecode;        // built, waiting for its pso
+    D3D12_INPUT_ELEMENT_DESC        input_elements [SHADER_REFLECT_MAX_INPUTS];     // regenerated for vs_bytecode
+    UINT                            input_element_count;
+    uint32_t                        ps_index;           // variant rebuilt alongside it
+    std::future<ID3D12PipelineState *> pso_future;
+
+    // -- the scene shader (no variants) rides the same watcher: compile both stages, link, swap scene_pso
+    char const *                    ps_target;
+    uint64_t                        scene_source_hash;
+    HotReloadPhase                  scene_phase;
+    ShaderBuildJob *                scene_jobs [2];     // vertex, pixel
+    ID3DBlob *                      scene_bytecode [2]; // kept until the pso is linked
+    D3D12_INPUT_ELEMENT_DESC        scene_input_elements [SHADER_REFLECT_MAX_INPUTS];
+    std::future<ID3D12PipelineState *> scene_pso_future;
+
+    uint32_t                        reloads;
+    uint32_t                        failures;
+};
+
 struct SceneConstantBuffer {
     DirectX::XMFLOAT4 offset;
-    float padding [60];             // Padding so the constant buffer is 256-byte aligned
+    float position_min [4];         // quad's VertexQuantization, as shaders/vertex_decode.hlsli reads it
+    float position_scale [4];
+    float padding [52];             // Padding so the constant buffer is 256-byte aligned
 };
 static_assert(256 == sizeof(SceneConstantBuffer), "Constant buffer size must be 256b aligned");
+// -- what the descriptor allocator's page callback needs to create a heap
+struct DescriptorPageParams {
+    ID3D12Device *                  device;
+    D3D12_DESCRIPTOR_HEAP_TYPE      type;
+    bool                            shader_visible;
+};
 struct D3DRenderContext {
     
     // Display data
@@ -64,16 +210,84 @@ struct D3DRenderContext {
     IDXGISwapChain *                swapchain;
     ID3D12Device *                  device;
     ID3D12Resource *                render_targets [FRAME_COUNT];
-    ID3D12CommandAllocator *        cmd_allocator [FRAME_COUNT];
-    ID3D12CommandAllocator *        bundle_allocator;
+    CommandAllocatorPool            allocator_pool;
+    ID3D12CommandAllocator *        cmd_allocator;      // allocator of the frame being recorded
     ID3D12CommandQueue *            cmd_queue;
     ID3D12RootSignature *           root_signature;
     ID3D12PipelineState *           pso;
+    RetiredPso                      retired_psos [MAX_RETIRED_PSOS];
+    UINT                            retired_pso_count;
     ID3D12GraphicsCommandList *     direct_cmd_list;
-    ID3D12GraphicsCommandList *     bundle;
+    BundleCache                     bundle_cache;
+    ResourceStateTracker            state_tracker;
+    CommandStream                   cmd_stream;
+    CommandStreamBindings           stream_bindings;
+    UINT64                          stream_record_ticks;
+    UINT64                          stream_recorded_frames;
+    DrawQueue                       draw_queue;
+    ID3D12CommandSignature *        draw_cmd_signature;
+    ID3D12Resource *                indirect_buffer;    // FRAME_COUNT regions of INDIRECT_FRAME_SIZE
+    uint8_t *                       indirect_data_begin_ptr;
+    IndirectVertexBufferView        indirect_vb_table [1];
+    UINT64                          indirect_pack_ticks;
     UINT                            rtv_descriptor_size;
     UINT                            srv_cbv_descriptor_size;
 
+    // NOTE(omid): heaps are owned by the descriptor allocators; rtv_heap / srv_cbv_heap
+    // point at the page the frame's descriptors were allocated from
+    DescriptorPageParams            rtv_page_params;
+    DescriptorPageParams            srv_cbv_page_params;
+    DescriptorAllocator             rtv_allocator;
+    DescriptorAllocator             srv_cbv_allocator;
+    DescriptorHandle                rtv_descriptors;    // FRAME_COUNT contiguous rtvs
+    DescriptorHandle                srv_descriptor;     // texture
+    DescriptorHandle                cbv_descriptor;     // scene constants
+    ViewCache                       view_cache;         // srv/cbv descriptors outside the bindless range
+    DescriptorPageParams            staging_page_params;
+    DescriptorAllocator             staging_allocator;  // cpu-only srv/cbv heap pages
+    DescriptorHandle                ring_range;         // DESCRIPTOR_RING_SIZE slots of srv_cbv_heap
+    DescriptorRing                  descriptor_ring;
+    PsoCache                        pso_cache;
+    ShaderCache                     shader_cache;
+    ShaderArchive                   shader_archive;
+    ShaderBuildService              shader_builds;      // compiles on worker threads
+    ShaderPermutationSet            ps_permutations;
+    uint32_t                        ps_wanted_values [PS_KEY_COUNT];
+    uint32_t                        ps_variant_index;   // variant the current pso was built with
+    uint32_t                        ps_variant_generation;
+    ID3DBlob *                      vertex_shader;      // the one in the current pso
+    VertexLayout const *            vertex_layout;      // vertex struct the input layout is matched to
+    D3D12_INPUT_ELEMENT_DESC        input_elements [SHADER_REFLECT_MAX_INPUTS];
+    UINT                            input_element_count;
+    ShaderHotReload                 hot_reload;
+    ColladaScene                    scene;
+    PackedScene                     packed_scene;       // quantized copy of scene's vertices
+    MeshLodSet                      lods;               // simplified index buffers per scene mesh
+    MeshletSet                      meshlets;           // scene meshes cut into mesh shader sized clusters
+    MeshContainer                   scene_file;         // when mapped, the four above are views into it
+    ID3D12Resource *                scene_buffer;       // gpu streams of the scene, default heap
+    ID3D12Resource *                scene_staging;      // upload heap scene_buffer is copied from, released after setup
+    IndexBatch                      scene_batch;        // R16/R32 index lists of every mesh and LOD level over the packed vertices
+    IndexBatchGpu                   scene_batch_gpu;    // views into scene_buffer
+    uint32_t *                      scene_mesh_draws;   // first draw of each scene mesh; its LOD levels follow
+    CullSet                         scene_cull;         // world bounds of every scene node that instances a mesh
+    uint32_t *                      scene_cull_nodes;   // node of each scene_cull object
+    uint32_t *                      scene_visible;      // scene_cull objects in this frame's frustum (cull_visible_capacity entries)
+    UINT64                          scene_cull_ticks;
+    UINT64                          scene_culled_frames;
+    UINT64                          scene_nodes_drawn;
+    UINT64                          scene_lod_levels;   // summed over the nodes drawn
+    float                           scene_center [3];   // of scene_cull's boxes, where the camera turns around
+    float                           scene_radius;
+    float                           scene_heading;      // camera yaw, radians
+    ID3D12RootSignature *           scene_root_signature;
+    ID3D12PipelineState *           scene_pso;
+    ID3D12DescriptorHeap *          dsv_heap;
+    ID3D12Resource *                depth_buffer;       // scene only; the quad ignores depth
+    BindlessIndexAllocator          bindless_indices;
+    DescriptorHandle                bindless_range;     // BINDLESS_MAX_DESCRIPTORS slots of srv_cbv_heap
+    uint32_t                        texture_bindless_index;
+    uint32_t                        constants_bindless_index;
     ID3D12DescriptorHeap *          rtv_heap;
     // NOTE(omid): Instead of separate descriptor heap use one for both srv and cbv 
     ID3D12DescriptorHeap *          srv_cbv_heap;
@@ -103,6 +317,17 @@ struct TextuVertex {
     DirectX::XMFLOAT3 position;
     DirectX::XMFLOAT2 uv;
 };
+// -- what the input layouts are generated from (see shader_reflection.h)
+static VertexAttribute const color_vertex_attributes [] = {
+    VERTEX_ATTRIBUTE(ColorVertex, position, "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT),
+    VERTEX_ATTRIBUTE(ColorVertex, color, "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT),
+};
+static VertexAttribute const textu_vertex_attributes [] = {
+    VERTEX_ATTRIBUTE(TextuVertex, position, "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT),
+    VERTEX_ATTRIBUTE(TextuVertex, uv, "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT),
+};
+static VertexLayout const color_vertex_layout = VERTEX_LAYOUT(ColorVertex, color_vertex_attributes);
+static VertexLayout const textu_vertex_layout = VERTEX_LAYOUT(TextuVertex, textu_vertex_attributes);
 static HRESULT
 move_to_next_frame (D3DRenderContext * render_ctx) {
     HRESULT ret = E_FAIL;
@@ -145,6 +370,487 @@ wait_for_gpu (D3DRenderContext * render_ctx) {
 
     return ret;
 }
+// -- DescriptorAllocator page callbacks: one ID3D12DescriptorHeap per page
+static bool
+create_descriptor_page (void * user, uint32_t descriptor_count, DescriptorPageMemory * out_memory) {
+    DescriptorPageParams * params = reinterpret_cast<DescriptorPageParams *>(user);
+    D3D12_DESCRIPTOR_HEAP_DESC heap_desc = {};
+    heap_desc.NumDescriptors = descriptor_count;
+    heap_desc.Type = params->type;
+    heap_desc.Flags = params->shader_visible ? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE : D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+    ID3D12DescriptorHeap * heap = nullptr;
+    if (FAILED(params->device->CreateDescriptorHeap(&heap_desc, IID_PPV_ARGS(&heap))))
+        return false;
+    out_memory->heap = heap;
+    out_memory->cpu_base = heap->GetCPUDescriptorHandleForHeapStart().ptr;
+    out_memory->gpu_base = params->shader_visible ? heap->GetGPUDescriptorHandleForHeapStart().ptr : 0;
+    return true;
+}
+static void
+destroy_descriptor_page (void * user, DescriptorPageMemory * memory) {
+    (void)user;
+    reinterpret_cast<ID3D12DescriptorHeap *>(memory->heap)->Release();
+    memory->heap = nullptr;
+}
+static D3D12_CPU_DESCRIPTOR_HANDLE
+descriptor_cpu_handle (DescriptorHandle const * handle, UINT index) {
+    D3D12_CPU_DESCRIPTOR_HANDLE ret = {};
+    ret.ptr = (SIZE_T)descriptor_cpu_at(handle, index);
+    return ret;
+}
+// NOTE(omid): Validates the layout against the command signature rules and creates
+// the matching ID3D12CommandSignature (with the root signature only when the
+// commands change root arguments, as the runtime requires).
+static ID3D12CommandSignature *
+create_command_signature (ID3D12Device * device, ID3D12RootSignature * root_signature, IndirectLayout * layout, UINT byte_stride) {
+    char const * error = indirect_layout_validate(layout, byte_stride);
+    if (error) {
+        ::printf("[ERROR] invalid indirect argument layout: %s\n", error);
+        return nullptr;
+    }
+    D3D12_INDIRECT_ARGUMENT_DESC arg_descs [INDIRECT_MAX_ARGUMENTS] = {};
+    for (uint32_t i = 0; i < layout->argument_count; ++i) {
+        IndirectArgument const * arg = &layout->arguments[i];
+        switch (arg->kind) {
+            case IndirectArgument_Draw: {
+                arg_descs[i].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW;
+            } break;
+            case IndirectArgument_DrawIndexed: {
+                arg_descs[i].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+            } break;
+            case IndirectArgument_VertexBufferView: {
+                arg_descs[i].Type = D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW;
+                arg_descs[i].VertexBuffer.Slot = arg->slot;
+            } break;
+            case IndirectArgument_IndexBufferView: {
+                arg_descs[i].Type = D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW;
+            } break;
+            case IndirectArgument_Constant: {
+                arg_descs[i].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+                arg_descs[i].Constant.RootParameterIndex = arg->root_parameter_index;
+                arg_descs[i].Constant.DestOffsetIn32BitValues = arg->dest_offset;
+                arg_descs[i].Constant.Num32BitValuesToSet = arg->value_count;
+            } break;
+            case IndirectArgument_ConstantBufferView: {
+                arg_descs[i].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT_BUFFER_VIEW;
+                arg_descs[i].ConstantBufferView.RootParameterIndex = arg->root_parameter_index;
+            } break;
+        }
+    }
+    D3D12_COMMAND_SIGNATURE_DESC signature_desc = {};
+    signature_desc.ByteStride = layout->byte_stride;
+    signature_desc.NumArgumentDescs = layout->argument_count;
+    signature_desc.pArgumentDescs = arg_descs;
+    signature_desc.NodeMask = 0;
+
+    ID3D12CommandSignature * ret = nullptr;
+    CHECK_AND_FAIL(device->CreateCommandSignature(
+        &signature_desc, layout->needs_root_signature ? root_signature : nullptr, IID_PPV_ARGS(&ret)
+    ));
+    return ret;
+}
+// -- one-off comparison of the two packing paths on a large synthetic draw list
+static void
+benchmark_indirect_packing (uint32_t draw_count) {
+    IndirectDrawItem * items = reinterpret_cast<IndirectDrawItem *>(::malloc(sizeof(IndirectDrawItem) * draw_count));
+    uint8_t * out = reinterpret_cast<uint8_t *>(::_aligned_malloc((size_t)draw_count * INDIRECT_DRAW_STRIDE, 16));
+    IndirectVertexBufferView vb_table [16] = {};
+    for (uint32_t i = 0; i < ARRAY_COUNT(vb_table); ++i) {
+        vb_table[i].buffer_location = 0x10000ull * (i + 1);
+        vb_table[i].size_in_bytes = 1024;
+        vb_table[i].stride_in_bytes = 20;
+    }
+    for (uint32_t i = 0; i < draw_count; ++i) {
+        ::memset(&items[i], 0, sizeof(items[i]));
+        items[i].vertex_count_per_instance = 36;
+        items[i].instance_count = 1;
+        items[i].start_vertex = i;
+        items[i].constants[0] = i;
+        items[i].vb_index = i % ARRAY_COUNT(vb_table);
+    }
+    LARGE_INTEGER qpc_freq = {}, t0 = {}, t1 = {}, t2 = {};
+    QueryPerformanceFrequency(&qpc_freq);
+    QueryPerformanceCounter(&t0);
+    indirect_pack_draws_scalar(items, draw_count, vb_table, out);
+    QueryPerformanceCounter(&t1);
+    indirect_pack_draws(items, draw_count, vb_table, out);
+    QueryPerformanceCounter(&t2);
+    double scalar_ns = 1e9 * (double)(t1.QuadPart - t0.QuadPart) / (double)qpc_freq.QuadPart / (double)draw_count;
+    double simd_ns = 1e9 * (double)(t2.QuadPart - t1.QuadPart) / (double)qpc_freq.QuadPart / (double)draw_count;
+    ::printf("Indirect packing (%u draws): scalar %.2f ns/draw, sse2 %.2f ns/draw\n", draw_count, scalar_ns, simd_ns);
+    ::_aligned_free(out);
+    ::free(items);
+}
+// -- released once the frame being recorded has completed
+static void
+retire_pso (D3DRenderContext * render_ctx, ID3D12PipelineState * pso) {
+    SIMPLE_ASSERT(render_ctx->retired_pso_count < MAX_RETIRED_PSOS);
+    render_ctx->retired_psos[render_ctx->retired_pso_count].pso = pso;
+    render_ctx->retired_psos[render_ctx->retired_pso_count].fence_value = render_ctx->fence_value[render_ctx->frame_index];
+    ++render_ctx->retired_pso_count;
+}
+// -- frames in flight may still use the old pipeline (and bundles recorded with it)
+static void
+replace_main_pso (D3DRenderContext * render_ctx, ID3D12PipelineState * pso) {
+    retire_pso(render_ctx, render_ctx->pso);
+    bundle_cache_invalidate_pipeline(&render_ctx->bundle_cache, render_ctx->pso, nullptr);
+
+    render_ctx->pso = pso;
+    render_ctx->stream_bindings.psos[STREAM_PSO_MAIN] = pso;
+}
+// NOTE(omid): Switches the main pso to the pixel shader variant ps_wanted_values asks
+// for, once that variant is compiled (the generic one is used until then).
+static void
+update_pixel_shader_variant (D3DRenderContext * render_ctx, D3D12_GRAPHICS_PIPELINE_STATE_DESC const * pso_desc, UINT64 root_signature_hash) {
+    // -- a hot reload in progress swaps the pipeline itself
+    if (render_ctx->hot_reload.phase != HotReload_Idle || render_ctx->hot_reload.pipeline_frozen)
+        return;
+    ShaderPermutationSet * set = &render_ctx->ps_permutations;
+    shader_permutation_poll(set, &render_ctx->shader_builds);
+    uint32_t wanted = shader_permutation_index(set, render_ctx->ps_wanted_values);
+    uint32_t served = SHADER_PERMUTATION_NONE;
+    ID3DBlob * pixel_shader = shader_permutation_get(set, &render_ctx->shader_builds, wanted, &served);
+    // -- stale variants were built against the previous vertex shader; keep the current pso until they rebuild
+    if (nullptr == pixel_shader || !shader_permutation_is_fresh(set, served) ||
+        (served == render_ctx->ps_variant_index && set->variants[served].generation == render_ctx->ps_variant_generation)
+    ) {
+        return;
+    }
+
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = *pso_desc;
+    desc.PS.pShaderBytecode = pixel_shader->GetBufferPointer();
+    desc.PS.BytecodeLength = pixel_shader->GetBufferSize();
+    ID3D12PipelineState * pso = pso_cache_create_graphics(&render_ctx->pso_cache, &desc, root_signature_hash);
+    replace_main_pso(render_ctx, pso);
+    render_ctx->ps_variant_index = served;
+    render_ctx->ps_variant_generation = set->variants[served].generation;
+}
+// -- the scene pso is base (the quad's) with the scene shaders, the packed mesh input
+// layout and depth on; elements receives the layout and must outlive out_desc
+static bool
+scene_pso_desc_make (
+    D3DRenderContext * render_ctx, D3D12_GRAPHICS_PIPELINE_STATE_DESC const * base, ID3DBlob * vertex_shader, ID3DBlob * pixel_shader,
+    D3D12_INPUT_ELEMENT_DESC * elements, UINT max_elements, D3D12_GRAPHICS_PIPELINE_STATE_DESC * out_desc
+) {
+    // -- the scene shader reads positions and normals only; uvs stay in the stream
+    bool ok = true;
+    UINT element_count = 0;
+    ID3D12ShaderReflection * vs_reflection = nullptr;
+    if (shader_reflect_create(vertex_shader->GetBufferPointer(), vertex_shader->GetBufferSize(), &vs_reflection)) {
+        ok = shader_reflect_input_layout(vs_reflection, &packed_mesh_vertex_layout_unorm_uv, elements, max_elements, &element_count);
+        vs_reflection->Release();
+    } else {
+        element_count = vertex_layout_input_elements(&packed_mesh_vertex_layout_unorm_uv, elements, max_elements);
+    }
+
+    *out_desc = *base;
+    out_desc->pRootSignature = render_ctx->scene_root_signature;
+    out_desc->VS.pShaderBytecode = vertex_shader->GetBufferPointer();
+    out_desc->VS.BytecodeLength = vertex_shader->GetBufferSize();
+    out_desc->PS.pShaderBytecode = pixel_shader->GetBufferPointer();
+    out_desc->PS.BytecodeLength = pixel_shader->GetBufferSize();
+    out_desc->InputLayout.pInputElementDescs = elements;
+    out_desc->InputLayout.NumElements = element_count;
+    out_desc->RasterizerState.CullMode = D3D12_CULL_MODE_NONE;     // .dae winding is not to be trusted
+    out_desc->DepthStencilState.DepthEnable = TRUE;
+    out_desc->DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
+    out_desc->DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS;
+    out_desc->DSVFormat = DXGI_FORMAT_D32_FLOAT;
+    return ok;
+}
+// NOTE(omid): Scene shader hot reload, driven by update_shader_hot_reload: a change
+// to SCENE_SHADER_PATH (or what it includes) rebuilds both stages on the build
+// service, links the pso on its own thread and swaps scene_pso between frames.
+// The root signature is kept, so a change to the root constants needs a restart.
+static void
+begin_scene_shader_reload (D3DRenderContext * render_ctx) {
+    ShaderHotReload * reload = &render_ctx->hot_reload;
+    ShaderBuildService * service = &render_ctx->shader_builds;
+    if (nullptr == render_ctx->scene_root_signature)
+        return;
+    ShaderCacheKey key = shader_cache_key(&render_ctx->shader_cache, SCENE_SHADER_PATH, nullptr, "VertexShader_Scene", reload->vs_target, reload->flags);
+    if (!key.valid || key.hash == reload->scene_source_hash)
+        return;
+    reload->scene_jobs[0] = shader_build_submit(service, SCENE_SHADER_PATH, nullptr, "VertexShader_Scene", reload->vs_target, reload->flags);
+    reload->scene_jobs[1] = shader_build_submit(service, SCENE_SHADER_PATH, nullptr, "PixelShader_Scene", reload->ps_target, reload->flags);
+    if (!reload->scene_jobs[0] || !reload->scene_jobs[1]) {
+        for (uint32_t i = 0; i < ARRAY_COUNT(reload->scene_jobs); ++i) {
+            if (reload->scene_jobs[i]) {
+                shader_build_await(reload->scene_jobs[i]);
+                if (reload->scene_jobs[i]->bytecode)
+                    reload->scene_jobs[i]->bytecode->Release();
+                if (reload->scene_jobs[i]->errors)
+                    reload->scene_jobs[i]->errors->Release();
+                shader_build_release(service, reload->scene_jobs[i]);
+                reload->scene_jobs[i] = nullptr;
+            }
+        }
+        ::printf("scene shader hot reload: build service is full, skipped\n");
+        return;
+    }
+    reload->scene_source_hash = key.hash;
+    reload->scene_phase = HotReload_Compiling;
+}
+static void
+update_scene_shader_reload (D3DRenderContext * render_ctx, D3D12_GRAPHICS_PIPELINE_STATE_DESC const * pso_desc) {
+    ShaderHotReload * reload = &render_ctx->hot_reload;
+    ShaderBuildService * service = &render_ctx->shader_builds;
+
+    if (HotReload_Compiling == reload->scene_phase) {
+        if (!shader_build_is_ready(reload->scene_jobs[0]) || !shader_build_is_ready(reload->scene_jobs[1]))
+            return;
+        bool ok = true;
+        for (uint32_t i = 0; i < ARRAY_COUNT(reload->scene_jobs); ++i) {
+            ShaderBuildJob * job = reload->scene_jobs[i];
+            ok = SUCCEEDED(shader_build_await(job)) && nullptr != job->bytecode && ok;
+            reload->scene_bytecode[i] = job->bytecode;
+            if (job->errors) {
+                ::printf("%s: %s\n", SCENE_SHADER_PATH, (char const *)job->errors->GetBufferPointer());
+                job->errors->Release();
+            }
+            shader_build_release(service, job);
+            reload->scene_jobs[i] = nullptr;
+        }
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = {};
+        ok = ok && scene_pso_desc_make(
+            render_ctx, pso_desc, reload->scene_bytecode[0], reload->scene_bytecode[1],
+            reload->scene_input_elements, ARRAY_COUNT(reload->scene_input_elements), &desc
+        );
+        if (!ok) {
+            for (uint32_t i = 0; i < ARRAY_COUNT(reload->scene_bytecode); ++i) {
+                if (reload->scene_bytecode[i])
+                    reload->scene_bytecode[i]->Release();
+                reload->scene_bytecode[i] = nullptr;
+            }
+            ++reload->failures;
+            reload->scene_phase = HotReload_Idle;
+            ::printf("scene shader hot reload: build failed, keeping the current pipeline\n");
+            return;
+        }
+        ID3D12Device * device = render_ctx->device;
+        reload->scene_pso_future = std::async(std::launch::async, [device, desc] () -> ID3D12PipelineState * {
+            ID3D12PipelineState * pso = nullptr;
+            return SUCCEEDED(device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pso))) ? pso : nullptr;
+        });
+        reload->scene_phase = HotReload_Linking;
+        return;
+    }
+
+    if (HotReload_Linking == reload->scene_phase) {
+        if (reload->scene_pso_future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+        ID3D12PipelineState * pso = reload->scene_pso_future.get();
+        reload->scene_phase = HotReload_Idle;
+        for (uint32_t i = 0; i < ARRAY_COUNT(reload->scene_bytecode); ++i) {
+            reload->scene_bytecode[i]->Release();
+            reload->scene_bytecode[i] = nullptr;
+        }
+        if (nullptr == pso) {
+            ++reload->failures;
+            ::printf("scene shader hot reload: pso creation failed, keeping the current pipeline\n");
+            return;
+        }
+        if (render_ctx->scene_pso)
+            retire_pso(render_ctx, render_ctx->scene_pso);
+        render_ctx->scene_pso = pso;
+        ++reload->reloads;
+        ::printf("scene shader hot reload: pipeline swapped\n");
+    }
+}
+// NOTE(omid): Shader hot reload, called once per frame before recording. A settled
+// change under SHADER_WATCH_DIR that alters the shader source (or anything it
+// includes) invalidates the pixel shader variants and rebuilds the vertex shader
+// plus the variant in use on the build service. Once both are in, the pso is
+// created on its own thread (it bypasses the pso cache, which is single-threaded);
+// only the swap happens here, between frames, and the old pso is retired through
+// the fence like a variant switch. A failed compile or link keeps the current
+// pipeline running. Variants other than the one in use rebuild lazily. The same
+// change also rebuilds the scene pipeline (see begin_scene_shader_reload).
+static void
+update_shader_hot_reload (D3DRenderContext * render_ctx, D3D12_GRAPHICS_PIPELINE_STATE_DESC * pso_desc) {
+    ShaderHotReload * reload = &render_ctx->hot_reload;
+    ShaderPermutationSet * set = &render_ctx->ps_permutations;
+    ShaderBuildService * service = &render_ctx->shader_builds;
+    if (!reload->enabled)
+        return;
+
+    update_scene_shader_reload(render_ctx, pso_desc);
+    if (HotReload_Idle == reload->phase) {
+        // -- the next burst waits until the scene pipeline is swapped too
+        if (HotReload_Idle != reload->scene_phase || !shader_watcher_poll(&reload->watcher))
+            return;
+        begin_scene_shader_reload(render_ctx);
+        ShaderCacheKey key = shader_cache_key(&render_ctx->shader_cache, set->path, nullptr, reload->vs_entry, reload->vs_target, reload->flags);
+        if (!key.valid || key.hash == reload->source_hash)
+            return;     // some other file, or saved without changes
+        reload->vs_job = shader_build_submit(service, set->path, nullptr, reload->vs_entry, reload->vs_target, reload->flags);
+        if (!reload->vs_job) {
+            ::printf("shader hot reload: build service is full, skipped\n");
+            return;
+        }
+        reload->source_hash = key.hash;
+        reload->begin_ms = shader_watcher_now_ms();
+        reload->ps_index = render_ctx->ps_variant_index;
+        shader_permutation_invalidate(set);
+        reload->phase = HotReload_Compiling;
+    }
+
+    if (HotReload_Compiling == reload->phase) {
+        shader_permutation_poll(set, service);
+        shader_permutation_request(set, service, reload->ps_index);     // resubmits once an older in-flight compile lands
+        if (!shader_build_is_ready(reload->vs_job) || shader_permutation_is_building(set, reload->ps_index))
+            return;
+        HRESULT hr = shader_build_await(reload->vs_job);
+        ID3DBlob * vertex_shader = reload->vs_job->bytecode;
+        if (reload->vs_job->errors) {
+            ::printf("%s: %s\n", reload->vs_entry, (char const *)reload->vs_job->errors->GetBufferPointer());
+            reload->vs_job->errors->Release();
+        }
+        shader_build_release(service, reload->vs_job);
+        reload->vs_job = nullptr;
+        // -- the inputs may have changed with the source; a layout the vertex struct cannot feed fails the reload
+        bool layout_ok = false;
+        ID3D12ShaderReflection * vs_reflection = nullptr;
+        if (vertex_shader && shader_reflect_create(vertex_shader->GetBufferPointer(), vertex_shader->GetBufferSize(), &vs_reflection)) {
+            layout_ok = shader_reflect_input_layout(
+                vs_reflection, render_ctx->vertex_layout, reload->input_elements, ARRAY_COUNT(reload->input_elements), &reload->input_element_count
+            );
+            vs_reflection->Release();
+        }
+        if (FAILED(hr) || nullptr == vertex_shader || !layout_ok || !shader_permutation_is_fresh(set, reload->ps_index)) {
+            if (vertex_shader)
+                vertex_shader->Release();
+            ++reload->failures;
+            reload->pipeline_frozen = true;
+            reload->phase = HotReload_Idle;
+            ::printf("shader hot reload: build failed, keeping the current pipeline\n");
+            return;
+        }
+        reload->vs_bytecode = vertex_shader;
+        ID3DBlob * pixel_shader = set->variants[reload->ps_index].bytecode;
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = *pso_desc;
+        desc.VS.pShaderBytecode = vertex_shader->GetBufferPointer();
+        desc.VS.BytecodeLength = vertex_shader->GetBufferSize();
+        desc.PS.pShaderBytecode = pixel_shader->GetBufferPointer();
+        desc.PS.BytecodeLength = pixel_shader->GetBufferSize();
+        desc.InputLayout.pInputElementDescs = reload->input_elements;
+        desc.InputLayout.NumElements = reload->input_element_count;
+        ID3D12Device * device = render_ctx->device;
+        reload->pso_future = std::async(std::launch::async, [device, desc] () -> ID3D12PipelineState * {
+            ID3D12PipelineState * pso = nullptr;
+            return SUCCEEDED(device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pso))) ? pso : nullptr;
+        });
+        reload->phase = HotReload_Linking;
+        return;
+    }
+
+    if (HotReload_Linking == reload->phase) {
+        if (reload->pso_future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+        ID3D12PipelineState * pso = reload->pso_future.get();
+        reload->phase = HotReload_Idle;
+        if (nullptr == pso) {
+            reload->vs_bytecode->Release();
+            reload->vs_bytecode = nullptr;
+            ++reload->failures;
+            reload->pipeline_frozen = true;
+            ::printf("shader hot reload: pso creation failed (shader interface changed?), keeping the current pipeline\n");
+            return;
+        }
+        replace_main_pso(render_ctx, pso);
+        render_ctx->vertex_shader->Release();
+        render_ctx->vertex_shader = reload->vs_bytecode;
+        reload->vs_bytecode = nullptr;
+        ::memcpy(render_ctx->input_elements, reload->input_elements, sizeof(render_ctx->input_elements));
+        render_ctx->input_element_count = reload->input_element_count;
+        pso_desc->InputLayout.pInputElementDescs = render_ctx->input_elements;
+        pso_desc->InputLayout.NumElements = render_ctx->input_element_count;
+        ShaderVariant const * variant = &set->variants[reload->ps_index];
+        pso_desc->VS.pShaderBytecode = render_ctx->vertex_shader->GetBufferPointer();
+        pso_desc->VS.BytecodeLength = render_ctx->vertex_shader->GetBufferSize();
+        pso_desc->PS.pShaderBytecode = variant->bytecode->GetBufferPointer();
+        pso_desc->PS.BytecodeLength = variant->bytecode->GetBufferSize();
+        render_ctx->ps_variant_index = reload->ps_index;
+        render_ctx->ps_variant_generation = variant->generation;
+        reload->pipeline_frozen = false;
+        ++reload->reloads;
+        ::printf("shader hot reload: pipeline swapped %.1f ms after the change settled\n", shader_watcher_now_ms() - reload->begin_ms);
+    }
+}
+// -- waits for whatever the reload still has in flight
+static void
+shader_hot_reload_shutdown (D3DRenderContext * render_ctx) {
+    ShaderHotReload * reload = &render_ctx->hot_reload;
+    if (reload->vs_job) {
+        shader_build_await(reload->vs_job);
+        if (reload->vs_job->bytecode)
+            reload->vs_job->bytecode->Release();
+        if (reload->vs_job->errors)
+            reload->vs_job->errors->Release();
+        shader_build_release(&render_ctx->shader_builds, reload->vs_job);
+        reload->vs_job = nullptr;
+    }
+    if (reload->pso_future.valid()) {
+        ID3D12PipelineState * pso = reload->pso_future.get();
+        if (pso)
+            pso->Release();
+    }
+    if (reload->vs_bytecode)
+        reload->vs_bytecode->Release();
+    reload->vs_bytecode = nullptr;
+    reload->phase = HotReload_Idle;
+    for (uint32_t i = 0; i < ARRAY_COUNT(reload->scene_jobs); ++i) {
+        ShaderBuildJob * job = reload->scene_jobs[i];
+        if (job) {
+            shader_build_await(job);
+            if (job->bytecode)
+                job->bytecode->Release();
+            if (job->errors)
+                job->errors->Release();
+            shader_build_release(&render_ctx->shader_builds, job);
+            reload->scene_jobs[i] = nullptr;
+        }
+    }
+    if (reload->scene_pso_future.valid()) {
+        ID3D12PipelineState * pso = reload->scene_pso_future.get();
+        if (pso)
+            pso->Release();
+    }
+    for (uint32_t i = 0; i < ARRAY_COUNT(reload->scene_bytecode); ++i) {
+        if (reload->scene_bytecode[i])
+            reload->scene_bytecode[i]->Release();
+        reload->scene_bytecode[i] = nullptr;
+    }
+    reload->scene_phase = HotReload_Idle;
+    if (reload->enabled)
+        ::printf("Shader hot reload: %u reloads, %u failed\n", reload->reloads, reload->failures);
+    shader_watcher_destroy(&reload->watcher);
+    reload->enabled = false;
+}
+static void
+release_retired_psos (D3DRenderContext * render_ctx, UINT64 completed_fence_value) {
+    UINT i = 0;
+    while (i < render_ctx->retired_pso_count) {
+        if (render_ctx->retired_psos[i].fence_value <= completed_fence_value) {
+            render_ctx->retired_psos[i].pso->Release();
+            render_ctx->retired_psos[i] = render_ctx->retired_psos[--render_ctx->retired_pso_count];
+        } else {
+            ++i;
+        }
+    }
+}
+// NOTE(omid): A pso cannot mix DXIL and DXBC shaders, so the archive is only used
+// when it covers every shader the sample can ask for (and the device runs SM 6.0).
+static bool
+shader_archive_covers (ShaderArchive * archive, ShaderPermutationSet const * ps_set, char const * path, char const * vs_entry, char const * vs_target) {
+    if (!shader_archive_find(archive, path, vs_entry, vs_target, nullptr))
+        return false;
+    for (uint32_t i = 0; i < ps_set->variant_count; ++i) {
+        if (!shader_archive_find(archive, ps_set->path, ps_set->entry, ps_set->target, ps_set->variants[i].defines))
+            return false;
+    }
+    return true;
+}
 static void
 update_constant_buffer(D3DRenderContext * render_ctx) {
     const float translation_speed = 0.003f;
@@ -160,6 +866,80 @@ update_constant_buffer(D3DRenderContext * render_ctx) {
     }
     memcpy(render_ctx->cbv_data_begin_ptr, &render_ctx->constant_buffer_data, sizeof(render_ctx->constant_buffer_data));
 }
+// NOTE(omid): Draws the scene nodes that survive frustum culling straight on the
+// command list, after the replayed stream: the stream has no indexed draws. Each
+// node draws the LOD level mesh_lod_select picks for its projected size. The camera stands near the middle of the scene and turns a
+// little further each frame, so nodes keep leaving and entering the frustum.
+static void
+draw_scene (D3DRenderContext * render_ctx) {
+    if (!render_ctx->scene_pso || !render_ctx->depth_buffer || !render_ctx->scene_buffer || !render_ctx->scene_visible)
+        return;
+    ID3D12GraphicsCommandList * cmd_list = render_ctx->direct_cmd_list;
+    D3D12_CPU_DESCRIPTOR_HANDLE rtv = descriptor_cpu_handle(&render_ctx->rtv_descriptors, render_ctx->frame_index);
+    D3D12_CPU_DESCRIPTOR_HANDLE dsv = render_ctx->dsv_heap->GetCPUDescriptorHandleForHeapStart();
+    cmd_list->OMSetRenderTargets(1, &rtv, FALSE, &dsv);
+    cmd_list->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+    cmd_list->SetGraphicsRootSignature(render_ctx->scene_root_signature);
+    cmd_list->SetPipelineState(render_ctx->scene_pso);
+    index_batch_bind(cmd_list, &render_ctx->scene_batch_gpu);
+
+    render_ctx->scene_heading += 0.005f;
+    float const * center = render_ctx->scene_center;
+    float radius = render_ctx->scene_radius;
+    float direction [3] = {::cosf(render_ctx->scene_heading), 0.0f, ::sinf(render_ctx->scene_heading)};
+    float eye [3], target [3];
+    for (uint32_t c = 0; c < 3; ++c) {
+        eye[c] = center[c] - 0.1f * radius * direction[c];
+        target[c] = center[c] + radius * direction[c];
+    }
+    float view_projection [16];
+    cull_view_projection(eye, target, SCENE_FOV_Y, render_ctx->aspect_ratio, 0.01f * radius, 4.0f * radius, view_projection);
+    float projection_scale = render_ctx->viewport.Height / (2.0f * ::tanf(0.5f * SCENE_FOV_Y));
+
+    // -- a handful of nodes: one thread, boxes
+    LARGE_INTEGER cull_begin = {};
+    QueryPerformanceCounter(&cull_begin);
+    CullFrustum frustum;
+    cull_frustum_from_matrix(view_projection, &frustum);
+    uint32_t visible_count = cull_set_frustum(&render_ctx->scene_cull, &frustum, CullShape_Aabb, render_ctx->scene_visible, 1, true);
+    LARGE_INTEGER cull_end = {};
+    QueryPerformanceCounter(&cull_end);
+    render_ctx->scene_cull_ticks += (UINT64)(cull_end.QuadPart - cull_begin.QuadPart);
+    ++render_ctx->scene_culled_frames;
+    render_ctx->scene_nodes_drawn += visible_count;
+
+    ColladaScene const * scene = &render_ctx->scene;
+    for (uint32_t v = 0; v < visible_count; ++v) {
+        ColladaNode const * node = &scene->nodes[render_ctx->scene_cull_nodes[render_ctx->scene_visible[v]]];
+        if (COLLADA_NONE == render_ctx->scene_mesh_draws[node->mesh])
+            continue;
+        // -- eye to the LOD sphere center, brought into mesh space by the node's largest scale
+        MeshLodChain const * chain = &render_ctx->lods.chains[node->mesh];
+        float const * m = node->world;
+        float to_center_sq = 0.0f, scale = 0.0f;
+        for (uint32_t r = 0; r < 3; ++r) {
+            float world_center = m[r * 4 + 3];
+            for (uint32_t c = 0; c < 3; ++c)
+                world_center += m[r * 4 + c] * chain->center[c];
+            to_center_sq += (world_center - eye[r]) * (world_center - eye[r]);
+            float column = ::sqrtf(m[r] * m[r] + m[4 + r] * m[4 + r] + m[8 + r] * m[8 + r]);
+            scale = column > scale ? column : scale;
+        }
+        float distance = ::sqrtf(to_center_sq) / (scale > 0.0f ? scale : 1.0f);
+        uint32_t level = mesh_lod_select(chain, distance, projection_scale, SCENE_LOD_PIXEL_ERROR);
+        render_ctx->scene_lod_levels += level;
+        // -- clip_from_local, then the mesh's VertexQuantization as the shader declares it
+        float constants [SCENE_ROOT_CONSTANT_COUNT] = {};
+        collada_matrix_multiply(view_projection, node->world, constants);
+        VertexQuantization const * q = &render_ctx->packed_scene.meshes[node->mesh];
+        for (uint32_t c = 0; c < 3; ++c) {
+            constants[16 + c] = q->position_min[c];
+            constants[20 + c] = q->position_scale[c];
+        }
+        cmd_list->SetGraphicsRoot32BitConstants(0, SCENE_ROOT_CONSTANT_COUNT, constants, 0);
+        index_batch_draw(cmd_list, &render_ctx->scene_batch_gpu, &render_ctx->scene_batch, render_ctx->scene_mesh_draws[node->mesh] + level, 1, 0);
+    }
+}
 static HRESULT
 render_stuff (D3DRenderContext * render_ctx) {
     
@@ -167,70 +947,180 @@ render_stuff (D3DRenderContext * render_ctx) {
 
     // Populate command list
     
-    // -- reset cmd_allocator and cmd_list
+    // -- acquire a cmd_allocator and reset cmd_list
     
     // Command list allocators can only be reset when the associated 
-    // command lists have finished execution on the GPU; apps should use 
-    // fences to determine GPU execution progress.
-    CHECK_AND_FAIL(render_ctx->cmd_allocator[render_ctx->frame_index]->Reset());
+    // command lists have finished execution on the GPU; the pool only hands
+    // out allocators whose submission fence has already completed.
+    render_ctx->cmd_allocator = command_allocator_pool_acquire(
+        &render_ctx->allocator_pool, D3D12_COMMAND_LIST_TYPE_DIRECT, render_ctx->fence->GetCompletedValue()
+    );
     
     // However, when ExecuteCommandList() is called on a particular command 
     // list, that command list can then be reset at any time and must be before 
     // re-recording.
-    ret = render_ctx->direct_cmd_list->Reset(render_ctx->cmd_allocator[render_ctx->frame_index], render_ctx->pso);
+    ret = render_ctx->direct_cmd_list->Reset(render_ctx->cmd_allocator, render_ctx->pso);
     CHECK_AND_FAIL(ret);
 
+    // -- indicate that the backbuffer will be used as the render target
+    state_tracker_transition(
+        &render_ctx->state_tracker, render_ctx->render_targets[render_ctx->frame_index],
+        D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, D3D12_RESOURCE_STATE_RENDER_TARGET
+    );
+    state_tracker_flush(&render_ctx->state_tracker, render_ctx->direct_cmd_list);
+
+#if QUAD_SUBMIT_MODE == QUAD_SUBMIT_BUNDLE
+    // -- get (or lazily record) the bundle for the quad; the cache hands it to the stream through the bindings
+    BundleKey quad_key = bundle_key_make(
+        render_ctx->root_signature, render_ctx->pso, D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP,
+        1, &render_ctx->vb_view, 4 /*vertex count*/, 1 /*instance count*/, 0, 0
+    );
+    render_ctx->stream_bindings.bundles[STREAM_BUNDLE_QUAD] = bundle_cache_get(
+        &render_ctx->bundle_cache, &quad_key,
+        render_ctx->fence_value[render_ctx->frame_index], render_ctx->fence->GetCompletedValue()
+    );
+#endif
+
+    // -- record command(s) into the cpu command stream
+    LARGE_INTEGER record_begin = {};
+    QueryPerformanceCounter(&record_begin);
+
+    CommandStream * stream = &render_ctx->cmd_stream;
+    command_stream_reset(stream);
+
     // -- set root_signature, viewport and scissor
-    render_ctx->direct_cmd_list->SetGraphicsRootSignature(render_ctx->root_signature);
-    render_ctx->direct_cmd_list->RSSetViewports(1, &render_ctx->viewport);
-    render_ctx->direct_cmd_list->RSSetScissorRects(1, &render_ctx->scissor_rect);
+    cmd_set_root_signature(stream, STREAM_ROOT_SIGNATURE_MAIN);
+    cmd_set_viewport(
+        stream, render_ctx->viewport.TopLeftX, render_ctx->viewport.TopLeftY,
+        render_ctx->viewport.Width, render_ctx->viewport.Height,
+        render_ctx->viewport.MinDepth, render_ctx->viewport.MaxDepth
+    );
+    cmd_set_scissor(
+        stream, render_ctx->scissor_rect.left, render_ctx->scissor_rect.top,
+        render_ctx->scissor_rect.right, render_ctx->scissor_rect.bottom
+    );
 
     // -- set descriptor heaps and root descriptor table (index 0 for srv, and index 1 for cbv)
-    ID3D12DescriptorHeap * heaps [] = {render_ctx->srv_cbv_heap};
-    render_ctx->direct_cmd_list->SetDescriptorHeaps(ARRAY_COUNT(heaps), heaps);
-    render_ctx->direct_cmd_list->SetGraphicsRootDescriptorTable(0, render_ctx->srv_cbv_heap->GetGPUDescriptorHandleForHeapStart());
-    
-    SIMPLE_ASSERT(render_ctx->srv_cbv_descriptor_size > 0);
-    D3D12_GPU_DESCRIPTOR_HANDLE cbv_gpu_handle = {};
-    cbv_gpu_handle.ptr = render_ctx->srv_cbv_heap->GetGPUDescriptorHandleForHeapStart().ptr + (UINT64)render_ctx->srv_cbv_descriptor_size;
-    render_ctx->direct_cmd_list->SetGraphicsRootDescriptorTable(1, cbv_gpu_handle);
+    cmd_set_descriptor_heap(stream, STREAM_HEAP_SRV_CBV);
+#if USE_BINDLESS > 0
+    // -- one table over the whole bindless range, bound once; a material switch is just a root constant change
+    cmd_set_root_descriptor_table(
+        stream, 0, STREAM_HEAP_SRV_CBV, descriptor_heap_offset(&render_ctx->srv_cbv_allocator, &render_ctx->bindless_range)
+    );
+    uint32_t material_indices [] = {render_ctx->texture_bindless_index, render_ctx->constants_bindless_index};
+    cmd_set_root_constants(stream, ROOT_PARAM_MATERIAL, 0, ARRAY_COUNT(material_indices), material_indices);
+#else
+#if TABLES_FROM_DESCRIPTOR_RING
+    // -- copy this frame's tables from the staging heap into the ring, as one batch
+    DescriptorRing * ring = &render_ctx->descriptor_ring;
+    descriptor_ring_begin_frame(ring, render_ctx->frame_index, render_ctx->fence->GetCompletedValue());
+    DescriptorHandle srv_table = descriptor_ring_build_table(ring, &render_ctx->srv_descriptor, 1);
+    DescriptorHandle cbv_table = descriptor_ring_build_table(ring, &render_ctx->cbv_descriptor, 1);
+    SIMPLE_ASSERT(srv_table.id != DESCRIPTOR_NONE && cbv_table.id != DESCRIPTOR_NONE);
+    // -- the ranges are DATA_STATIC with static descriptors (root signature 1.1 default):
+    // the descriptors must be written before replay sets the tables, not just before execute
+    descriptor_ring_flush(ring);
+    UINT srv_table_index = descriptor_ring_heap_offset(ring, &srv_table);
+    UINT cbv_table_index = descriptor_ring_heap_offset(ring, &cbv_table);
+#else
+    UINT srv_table_index = descriptor_heap_offset(&render_ctx->srv_cbv_allocator, &render_ctx->srv_descriptor);
+    UINT cbv_table_index = descriptor_heap_offset(&render_ctx->srv_cbv_allocator, &render_ctx->cbv_descriptor);
+#endif
+    cmd_set_root_descriptor_table(stream, 0, STREAM_HEAP_SRV_CBV, srv_table_index);
+    cmd_set_root_descriptor_table(stream, 1, STREAM_HEAP_SRV_CBV, cbv_table_index);
+#endif
+
+    // -- render target of the current frame
+    UINT rtv_index = descriptor_heap_offset(&render_ctx->rtv_allocator, &render_ctx->rtv_descriptors) + render_ctx->frame_index;
+    cmd_set_render_target(stream, STREAM_HEAP_RTV, rtv_index);
 
-    // -- indicate that the backbuffer will be used as the render target
-    D3D12_RESOURCE_BARRIER barrier1 = {};
-    barrier1.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-    barrier1.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-    barrier1.Transition.pResource = render_ctx->render_targets[render_ctx->frame_index];
-    barrier1.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-    barrier1.Transition.StateBefore = D3D12_RESOURCE_STATE_PRESENT;
-    barrier1.Transition.StateAfter = D3D12_RESOURCE_STATE_RENDER_TARGET;
-
-    render_ctx->direct_cmd_list->ResourceBarrier(1, &barrier1);
-    
-    // -- get CPU descriptor handle that represents the start of the rtv heap
-    D3D12_CPU_DESCRIPTOR_HANDLE rtv_handle = render_ctx->rtv_heap->GetCPUDescriptorHandleForHeapStart();
-    // -- apply initial offset
-    rtv_handle.ptr = SIZE_T(INT64(rtv_handle.ptr) + INT64(render_ctx->frame_index) * INT64(render_ctx->rtv_descriptor_size));
-    render_ctx->direct_cmd_list->OMSetRenderTargets(1, &rtv_handle, FALSE, nullptr);
-    
-    // -- record command(s)
-    
     // NOTE(omid): We can't use any "clear" method with bundles, so we use the command-list itself to clear rtv
     float clear_colors [] = {0.1f, 0.3f, 0.2f, 1.0f};
-    render_ctx->direct_cmd_list->ClearRenderTargetView(rtv_handle, clear_colors, 0, nullptr);
+    cmd_clear_render_target(stream, STREAM_HEAP_RTV, rtv_index, clear_colors);
+
+#if QUAD_SUBMIT_MODE == QUAD_SUBMIT_DRAW_QUEUE
+    // -- queue the draw(s) with a state sort key; the queue sorts them and elides redundant state
+    draw_queue_reset(&render_ctx->draw_queue);
+    DrawPacket quad_draw = {};
+    quad_draw.pso_id = STREAM_PSO_MAIN;
+    quad_draw.root_signature_id = STREAM_ROOT_SIGNATURE_MAIN;
+    quad_draw.table_root_index = 0;             // srv table (bindless: the whole range)
+    quad_draw.table_heap_id = STREAM_HEAP_SRV_CBV;
+#if USE_BINDLESS > 0
+    quad_draw.table_descriptor_index = descriptor_heap_offset(&render_ctx->srv_cbv_allocator, &render_ctx->bindless_range);
+#else
+    quad_draw.table_descriptor_index = srv_table_index;
+#endif
+    quad_draw.topology = D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP;
+    quad_draw.vb_resource_id = STREAM_RESOURCE_VERTEX_BUFFER;
+    quad_draw.vb_offset = 0;
+    quad_draw.vb_size = render_ctx->vb_view.SizeInBytes;
+    quad_draw.vb_stride = render_ctx->vb_view.StrideInBytes;
+    quad_draw.vertex_count_per_instance = 4;
+    quad_draw.instance_count = 1;
+    draw_queue_push(&render_ctx->draw_queue, draw_sort_key_make(0, STREAM_PSO_MAIN, 0, 0.0f), &quad_draw);
+    draw_queue_submit(&render_ctx->draw_queue, stream, STREAM_ROOT_SIGNATURE_MAIN);
+#elif QUAD_SUBMIT_MODE == QUAD_SUBMIT_INDIRECT
+    // -- pack this frame's draw list into its region of the (upload heap) argument buffer;
+    // the cpu writes the draw count next to the arguments and ExecuteIndirect reads it from there
+    IndirectDrawItem quad_item = {};
+    quad_item.vertex_count_per_instance = 4;
+    quad_item.instance_count = 1;
+    quad_item.vb_index = 0;
+    UINT indirect_frame_offset = render_ctx->frame_index * INDIRECT_FRAME_SIZE;
+    uint8_t * indirect_frame = render_ctx->indirect_data_begin_ptr + indirect_frame_offset;
+    LARGE_INTEGER pack_begin = {};
+    QueryPerformanceCounter(&pack_begin);
+    IndirectDrawBuilder builder = {};
+    indirect_builder_begin(
+        &builder, indirect_frame, reinterpret_cast<uint32_t *>(indirect_frame + INDIRECT_COUNT_OFFSET), INDIRECT_MAX_DRAWS
+    );
+    indirect_builder_add(&builder, &quad_item, 1, render_ctx->indirect_vb_table);
+    indirect_builder_end(&builder);
+    LARGE_INTEGER pack_end = {};
+    QueryPerformanceCounter(&pack_end);
+    render_ctx->indirect_pack_ticks += (UINT64)(pack_end.QuadPart - pack_begin.QuadPart);
+
+    // -- topology is not part of a command signature
+    cmd_set_primitive_topology(stream, D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+    cmd_execute_indirect(
+        stream, STREAM_COMMAND_SIGNATURE_DRAW, INDIRECT_MAX_DRAWS,
+        STREAM_RESOURCE_INDIRECT_ARGS, indirect_frame_offset,
+        STREAM_RESOURCE_INDIRECT_ARGS, indirect_frame_offset + INDIRECT_COUNT_OFFSET
+    );
+#else
+    // -- execute bundle commands (recorded on first use and cached afterwards)
+    cmd_execute_bundle(stream, STREAM_BUNDLE_QUAD);
+#endif
 
-    // -- execute bundle commands
-    render_ctx->direct_cmd_list->ExecuteBundle(render_ctx->bundle);
+    LARGE_INTEGER record_end = {};
+    QueryPerformanceCounter(&record_end);
+    render_ctx->stream_record_ticks += (UINT64)(record_end.QuadPart - record_begin.QuadPart);
+    ++render_ctx->stream_recorded_frames;
 
-    // -- indicate that the backbuffer will now be used to present
-    D3D12_RESOURCE_BARRIER barrier2 = {};
-    barrier2.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-    barrier2.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-    barrier2.Transition.pResource = render_ctx->render_targets[render_ctx->frame_index];
-    barrier2.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-    barrier2.Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
-    barrier2.Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
+#if DUMP_COMMAND_STREAM > 0
+    if (1 == render_ctx->stream_recorded_frames) {
+        if (!command_stream_write_file(stream, "./frame_commands.bin"))
+            ::printf("could not write command stream\n");
+    }
+#endif
+
+    // -- translate the stream into the d3d12 command list
+    SIMPLE_ASSERT(render_ctx->srv_cbv_descriptor_size > 0);
+    command_stream_replay(stream, &render_ctx->stream_bindings, render_ctx->direct_cmd_list);
+    draw_scene(render_ctx);
 
-    render_ctx->direct_cmd_list->ResourceBarrier(1 , &barrier2);
+#if TABLES_FROM_DESCRIPTOR_RING
+    // -- tables were flushed before they were set; this only closes the frame's segment
+    descriptor_ring_end_frame(&render_ctx->descriptor_ring, render_ctx->fence_value[render_ctx->frame_index]);
+#endif
+
+    // -- indicate that the backbuffer will now be used to present
+    state_tracker_transition(
+        &render_ctx->state_tracker, render_ctx->render_targets[render_ctx->frame_index],
+        D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, D3D12_RESOURCE_STATE_PRESENT
+    );
+    state_tracker_flush(&render_ctx->state_tracker, render_ctx->direct_cmd_list);
 
     // -- finish populating command list
     render_ctx->direct_cmd_list->Close();
@@ -238,6 +1128,13 @@ render_stuff (D3DRenderContext * render_ctx) {
     ID3D12CommandList * cmd_lists [] = {render_ctx->direct_cmd_list};
     render_ctx->cmd_queue->ExecuteCommandLists(ARRAY_COUNT(cmd_lists), cmd_lists);
 
+    // -- the allocator is recycled once this frame's fence value is signaled (see move_to_next_frame)
+    command_allocator_pool_release(
+        &render_ctx->allocator_pool, D3D12_COMMAND_LIST_TYPE_DIRECT,
+        render_ctx->cmd_allocator, render_ctx->fence_value[render_ctx->frame_index]
+    );
+    render_ctx->cmd_allocator = nullptr;
+
     render_ctx->swapchain->Present(1 /*sync interval*/, 0 /*present flag*/);
 
     return ret;
@@ -341,6 +1238,309 @@ generate_checkerboard_pattern (
     }
     return ret;
 }
+// -- every scene mesh and its LOD levels as draws over the packed vertices (welded at import,
+// so only the index lists go into the batch)
+static bool
+build_scene_index_batch (D3DRenderContext * render_ctx) {
+    ColladaScene const * scene = &render_ctx->scene;
+    PackedScene const * packed = &render_ctx->packed_scene;
+    MeshLodSet const * lods = &render_ctx->lods;
+    if (0 == scene->mesh_count || packed->vertex_count != scene->vertex_count || lods->chain_count != scene->mesh_count)
+        return false;
+    render_ctx->scene_mesh_draws = reinterpret_cast<uint32_t *>(::malloc(scene->mesh_count * sizeof(uint32_t)));
+    if (!render_ctx->scene_mesh_draws)
+        return false;
+    index_batch_init(&render_ctx->scene_batch, sizeof(PackedMeshVertex));
+    bool ok = true;
+    for (uint32_t m = 0; m < scene->mesh_count && ok; ++m) {
+        ColladaMesh const * mesh = &scene->meshes[m];
+        MeshLodChain const * chain = &lods->chains[m];
+        render_ctx->scene_mesh_draws[m] = COLLADA_NONE;
+        if (0 == mesh->vertex_count || 0 == chain->level_count)
+            continue;       // nothing to draw
+        uint32_t const * lists [MESH_LOD_MAX_LEVELS] = {};
+        uint32_t counts [MESH_LOD_MAX_LEVELS] = {};
+        for (uint32_t l = 0; l < chain->level_count; ++l) {
+            lists[l] = lods->indices + chain->levels[l].first_index;
+            counts[l] = chain->levels[l].index_count;
+        }
+        render_ctx->scene_mesh_draws[m] = index_batch_add_lists(
+            &render_ctx->scene_batch, mesh->first_vertex, mesh->vertex_count, lists, counts, chain->level_count
+        );
+        ok = COLLADA_NONE != render_ctx->scene_mesh_draws[m];
+    }
+    if (!ok) {
+        index_batch_destroy(&render_ctx->scene_batch);
+        ::free(render_ctx->scene_mesh_draws);
+        render_ctx->scene_mesh_draws = nullptr;
+        return false;
+    }
+    index_batch_print_stats(&render_ctx->scene_batch, "scene");
+    return true;
+}
+// -- imports SCENE_PATH and writes its container; true when the container is open (the imported
+// copies are freed then, the scene structs become views into it), false leaves them owned
+static bool
+import_scene (D3DRenderContext * render_ctx) {
+    LARGE_INTEGER scene_freq = {}, scene_t0 = {}, scene_t1 = {};
+    QueryPerformanceFrequency(&scene_freq);
+    QueryPerformanceCounter(&scene_t0);
+    if (!collada_scene_load(&render_ctx->scene, SCENE_PATH))
+        return false;
+    QueryPerformanceCounter(&scene_t1);
+    double scene_ms = 1e3 * (double)(scene_t1.QuadPart - scene_t0.QuadPart) / (double)scene_freq.QuadPart;
+    collada_scene_print_stats(&render_ctx->scene, SCENE_PATH, scene_ms);
+    // -- weld once, before the optimizer, LODs and meshlets see the vertices
+    uint32_t welded = index_weld_scene(&render_ctx->scene);
+    if (COLLADA_NONE != welded)
+        ::printf("Scene weld: %u duplicate vertices removed, %u left\n", welded, render_ctx->scene.vertex_count);
+    mesh_optimize_scene(&render_ctx->scene, 0);
+    mesh_lod_set_create(&render_ctx->scene, &render_ctx->lods, 0);
+    meshlet_set_create(&render_ctx->scene, &render_ctx->meshlets, 0);
+    packed_scene_create(&render_ctx->scene, &render_ctx->packed_scene);
+    if (
+        !build_scene_index_batch(render_ctx) ||
+        !mesh_container_write(
+            SCENE_CONTAINER_PATH, SCENE_PATH, &render_ctx->scene, &render_ctx->packed_scene, &render_ctx->lods, &render_ctx->meshlets,
+            &render_ctx->scene_batch, render_ctx->scene_mesh_draws
+        ) ||
+        !mesh_container_open(&render_ctx->scene_file, SCENE_CONTAINER_PATH, nullptr)
+    ) {
+        return false;
+    }
+    index_batch_destroy(&render_ctx->scene_batch);
+    ::free(render_ctx->scene_mesh_draws);
+    render_ctx->scene_mesh_draws = nullptr;
+    meshlet_set_destroy(&render_ctx->meshlets);
+    mesh_lod_set_destroy(&render_ctx->lods);
+    packed_scene_destroy(&render_ctx->packed_scene);
+    collada_scene_destroy(&render_ctx->scene);
+    return true;
+}
+static void
+release_scene_buffers (D3DRenderContext * render_ctx) {
+    if (render_ctx->scene_buffer) {
+        state_tracker_unregister(&render_ctx->state_tracker, render_ctx->scene_buffer);
+        render_ctx->scene_buffer->Release();
+    }
+    if (render_ctx->scene_staging)
+        render_ctx->scene_staging->Release();
+    render_ctx->scene_buffer = nullptr;
+    render_ctx->scene_staging = nullptr;
+    ::memset(&render_ctx->scene_batch_gpu, 0, sizeof(render_ctx->scene_batch_gpu));
+}
+// -- drops the mapping and everything pointing into it
+static void
+close_scene_container (D3DRenderContext * render_ctx) {
+    release_scene_buffers(render_ctx);
+    mesh_container_close(&render_ctx->scene_file);
+    ::memset(&render_ctx->scene, 0, sizeof(render_ctx->scene));
+    ::memset(&render_ctx->packed_scene, 0, sizeof(render_ctx->packed_scene));
+    ::memset(&render_ctx->lods, 0, sizeof(render_ctx->lods));
+    ::memset(&render_ctx->meshlets, 0, sizeof(render_ctx->meshlets));
+    ::memset(&render_ctx->scene_batch, 0, sizeof(render_ctx->scene_batch));
+    render_ctx->scene_mesh_draws = nullptr;
+}
+// NOTE(omid): The scene's packed vertices and index batch live in a default heap.
+// They are written to scene_staging first: the container's gpu region in one
+// sequential read when it is open, else the imported arrays at aligned offsets.
+// The copy into scene_buffer is recorded on direct_cmd_list, which setup executes
+// and waits for; scene_staging is released after that. False when a buffer can't
+// be created or the read comes up short, with both released.
+static bool
+upload_scene_streams (D3DRenderContext * render_ctx) {
+    MeshContainer const * file = &render_ctx->scene_file;
+    IndexBatch const * batch = &render_ctx->scene_batch;
+    UINT64 offsets [3] = {};    // packed vertices, R16 indices, R32 indices
+    UINT64 size = 0;
+    if (file->base) {
+        offsets[0] = mesh_container_gpu_offset(file, MeshSection_PackedVertices);
+        offsets[1] = mesh_container_gpu_offset(file, MeshSection_Indices16);
+        offsets[2] = mesh_container_gpu_offset(file, MeshSection_Indices32);
+        size = file->header->gpu_size;
+    } else {
+        UINT64 const a = INDEX_BUFFER_ALIGNMENT - 1;
+        offsets[1] = ((UINT64)batch->vertex_count * batch->vertex_stride + a) & ~a;
+        offsets[2] = offsets[1] + (((UINT64)batch->index16_count * sizeof(uint16_t) + a) & ~a);
+        size = offsets[2] + (UINT64)batch->index32_count * sizeof(uint32_t);
+    }
+
+    D3D12_HEAP_PROPERTIES scene_heap_props = {};
+    scene_heap_props.Type = D3D12_HEAP_TYPE_DEFAULT;
+    scene_heap_props.CreationNodeMask = 1U;
+    scene_heap_props.VisibleNodeMask = 1U;
+    D3D12_HEAP_PROPERTIES staging_heap_props = scene_heap_props;
+    staging_heap_props.Type = D3D12_HEAP_TYPE_UPLOAD;
+
+    D3D12_RESOURCE_DESC scene_desc = {};
+    scene_desc.Dimension = D3D12_RESOURCE_DIMENSION::D3D12_RESOURCE_DIMENSION_BUFFER;
+    scene_desc.Width = size;
+    scene_desc.Height = 1;
+    scene_desc.DepthOrArraySize = 1;
+    scene_desc.MipLevels = 1;
+    scene_desc.Format = DXGI_FORMAT_UNKNOWN;
+    scene_desc.SampleDesc.Count = 1;
+    scene_desc.Layout = D3D12_TEXTURE_LAYOUT::D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    scene_desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+    if (
+        FAILED(render_ctx->device->CreateCommittedResource(
+            &scene_heap_props, D3D12_HEAP_FLAG_NONE, &scene_desc,
+            D3D12_RESOURCE_STATE_COPY_DEST,
+            nullptr, IID_PPV_ARGS(&render_ctx->scene_buffer)
+        )) ||
+        FAILED(render_ctx->device->CreateCommittedResource(
+            &staging_heap_props, D3D12_HEAP_FLAG_NONE, &scene_desc,
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr, IID_PPV_ARGS(&render_ctx->scene_staging)
+        ))
+    ) {
+        if (render_ctx->scene_buffer)
+            render_ctx->scene_buffer->Release();
+        render_ctx->scene_buffer = nullptr;
+        render_ctx->scene_staging = nullptr;
+        return false;
+    }
+    state_tracker_register(&render_ctx->state_tracker, render_ctx->scene_buffer, 1, D3D12_RESOURCE_STATE_COPY_DEST);
+
+    uint8_t * scene_data = nullptr;
+    D3D12_RANGE scene_read_range = {};
+    bool streams_read = SUCCEEDED(render_ctx->scene_staging->Map(0, &scene_read_range, reinterpret_cast<void **>(&scene_data)));
+    if (streams_read) {
+        if (file->base) {
+            streams_read = mesh_container_read_gpu_streams(file, scene_data);
+        } else {
+            ::memcpy(scene_data + offsets[0], render_ctx->packed_scene.vertices, (size_t)batch->vertex_count * batch->vertex_stride);
+            ::memcpy(scene_data + offsets[1], batch->indices16, batch->index16_count * sizeof(uint16_t));
+            ::memcpy(scene_data + offsets[2], batch->indices32, batch->index32_count * sizeof(uint32_t));
+        }
+        render_ctx->scene_staging->Unmap(0, nullptr);
+    }
+    if (!streams_read) {
+        release_scene_buffers(render_ctx);
+        return false;
+    }
+    render_ctx->direct_cmd_list->CopyBufferRegion(render_ctx->scene_buffer, 0, render_ctx->scene_staging, 0, size);
+    state_tracker_transition(
+        &render_ctx->state_tracker, render_ctx->scene_buffer, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+        D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER | D3D12_RESOURCE_STATE_INDEX_BUFFER
+    );
+    D3D12_GPU_VIRTUAL_ADDRESS address = render_ctx->scene_buffer->GetGPUVirtualAddress();
+    index_batch_set_views(&render_ctx->scene_batch_gpu, batch, address + offsets[0], address + offsets[1], address + offsets[2]);
+    return true;
+}
+// -- points the scene structs at the open container and uploads its gpu streams
+static bool
+load_scene_streams (D3DRenderContext * render_ctx) {
+    mesh_container_views(
+        &render_ctx->scene_file, &render_ctx->scene, &render_ctx->packed_scene, &render_ctx->lods, &render_ctx->meshlets,
+        &render_ctx->scene_batch, &render_ctx->scene_mesh_draws
+    );
+    return upload_scene_streams(render_ctx);
+}
+// NOTE(omid): The scene has a root signature of its own: one set of root constants
+// per node (SCENE_ROOT_CONSTANT_COUNT, see shaders/scene_shader.hlsl), nothing in
+// a heap. The pso comes from scene_pso_desc_make. False leaves the scene undrawn.
+static bool
+create_scene_pipeline (
+    D3DRenderContext * render_ctx, D3D12_GRAPHICS_PIPELINE_STATE_DESC const * base,
+    char const * vs_target, char const * ps_target, UINT compiler_flags
+) {
+    ShaderBuildJob * vs_job = shader_build_submit(&render_ctx->shader_builds, SCENE_SHADER_PATH, nullptr, "VertexShader_Scene", vs_target, compiler_flags);
+    ShaderBuildJob * ps_job = shader_build_submit(&render_ctx->shader_builds, SCENE_SHADER_PATH, nullptr, "PixelShader_Scene", ps_target, compiler_flags);
+    HRESULT vs_res = shader_build_await(vs_job);
+    HRESULT ps_res = shader_build_await(ps_job);
+    ID3DBlob * blobs [4] = {vs_job->bytecode, ps_job->bytecode, vs_job->errors, ps_job->errors};
+    shader_build_release(&render_ctx->shader_builds, vs_job);
+    shader_build_release(&render_ctx->shader_builds, ps_job);
+    for (uint32_t e = 2; e < 4; ++e) {
+        if (blobs[e])
+            OutputDebugStringA((char *)blobs[e]->GetBufferPointer());
+    }
+
+    D3D12_ROOT_PARAMETER1 root_parameter = {};
+    root_parameter.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+    root_parameter.Constants.ShaderRegister = 0;
+    root_parameter.Constants.RegisterSpace = 0;
+    root_parameter.Constants.Num32BitValues = SCENE_ROOT_CONSTANT_COUNT;
+    root_parameter.ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+    D3D12_VERSIONED_ROOT_SIGNATURE_DESC root_signature_desc = {};
+    root_signature_desc.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
+    root_signature_desc.Desc_1_1.NumParameters = 1;
+    root_signature_desc.Desc_1_1.pParameters = &root_parameter;
+    root_signature_desc.Desc_1_1.Flags =
+        D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT    |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS          |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS        |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS      |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_PIXEL_SHADER_ROOT_ACCESS;
+    ID3DBlob * signature = nullptr;
+    bool ok = SUCCEEDED(vs_res) && SUCCEEDED(ps_res) &&
+        SUCCEEDED(D3D12SerializeVersionedRootSignature(&root_signature_desc, &signature, nullptr)) &&
+        SUCCEEDED(render_ctx->device->CreateRootSignature(
+            0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&render_ctx->scene_root_signature)
+        ));
+
+    if (ok) {
+        D3D12_INPUT_ELEMENT_DESC elements [SHADER_REFLECT_MAX_INPUTS] = {};
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC pso_desc = {};
+        ok = scene_pso_desc_make(render_ctx, base, blobs[0], blobs[1], elements, ARRAY_COUNT(elements), &pso_desc);
+        UINT64 root_signature_hash = fnv1a_64(signature->GetBufferPointer(), signature->GetBufferSize(), FNV1A_64_SEED);
+        if (ok)
+            render_ctx->scene_pso = pso_cache_create_graphics(&render_ctx->pso_cache, &pso_desc, root_signature_hash);
+        ok = ok && nullptr != render_ctx->scene_pso;
+    }
+    if (signature)
+        signature->Release();
+    for (uint32_t b = 0; b < ARRAY_COUNT(blobs); ++b) {
+        if (blobs[b])
+            blobs[b]->Release();
+    }
+    return ok;
+}
+// -- one D32 depth buffer the size of the swapchain, with its dsv in a heap of its own
+static bool
+create_depth_buffer (D3DRenderContext * render_ctx) {
+    D3D12_DESCRIPTOR_HEAP_DESC dsv_heap_desc = {};
+    dsv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
+    dsv_heap_desc.NumDescriptors = 1;
+    dsv_heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+    if (FAILED(render_ctx->device->CreateDescriptorHeap(&dsv_heap_desc, IID_PPV_ARGS(&render_ctx->dsv_heap)))) {
+        render_ctx->dsv_heap = nullptr;
+        return false;
+    }
+
+    D3D12_HEAP_PROPERTIES depth_heap_props = {};
+    depth_heap_props.Type = D3D12_HEAP_TYPE_DEFAULT;
+    depth_heap_props.CreationNodeMask = 1U;
+    depth_heap_props.VisibleNodeMask = 1U;
+
+    D3D12_RESOURCE_DESC depth_desc = {};
+    depth_desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    depth_desc.Width = render_ctx->width;
+    depth_desc.Height = render_ctx->height;
+    depth_desc.DepthOrArraySize = 1;
+    depth_desc.MipLevels = 1;
+    depth_desc.Format = DXGI_FORMAT_D32_FLOAT;
+    depth_desc.SampleDesc.Count = 1;
+    depth_desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+    depth_desc.Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL | D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE;
+
+    D3D12_CLEAR_VALUE depth_clear = {};
+    depth_clear.Format = DXGI_FORMAT_D32_FLOAT;
+    depth_clear.DepthStencil.Depth = 1.0f;
+
+    // -- never leaves DEPTH_WRITE, so the state tracker doesn't need to know about it
+    if (FAILED(render_ctx->device->CreateCommittedResource(
+        &depth_heap_props, D3D12_HEAP_FLAG_NONE, &depth_desc,
+        D3D12_RESOURCE_STATE_DEPTH_WRITE, &depth_clear, IID_PPV_ARGS(&render_ctx->depth_buffer)
+    ))) {
+        render_ctx->depth_buffer = nullptr;
+        return false;
+    }
+    render_ctx->device->CreateDepthStencilView(render_ctx->depth_buffer, nullptr, render_ctx->dsv_heap->GetCPUDescriptorHandleForHeapStart());
+    return true;
+}
 static LRESULT CALLBACK
 main_win_cb (HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
     LRESULT ret = {};
@@ -545,49 +1745,141 @@ WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, INT) {
 #pragma region Descriptors
     // -- create descriptor heaps
 
-    // Create Render Target View Descriptor Heap
-    D3D12_DESCRIPTOR_HEAP_DESC rtv_heap_desc = {};
-    rtv_heap_desc.NumDescriptors = FRAME_COUNT;
-    rtv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE::D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-    rtv_heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAGS::D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-    CHECK_AND_FAIL(render_ctx.device->CreateDescriptorHeap(&rtv_heap_desc, IID_PPV_ARGS(&render_ctx.rtv_heap)));
-    
-    // NOTE(omid): We create a single descriptor heap for both SRV and CBV 
-    // -- A shader resource view (SRV) for the texture  (index 0 of srv_cbv_heap) 
-    // -- A constant buffer view (CBV) for animation    (index 1 of srv_cbv_heap) 
+    render_ctx.rtv_descriptor_size = render_ctx.device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE::D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+    render_ctx.srv_cbv_descriptor_size = render_ctx.device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE::D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+    // Render Target View descriptors: cpu-only, so the allocator may add pages as needed
+    render_ctx.rtv_page_params.device = render_ctx.device;
+    render_ctx.rtv_page_params.type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+    render_ctx.rtv_page_params.shader_visible = false;
+    descriptor_allocator_init(
+        &render_ctx.rtv_allocator, "rtv", 64 /*page size*/, 4 /*max pages*/, render_ctx.rtv_descriptor_size,
+        create_descriptor_page, destroy_descriptor_page, &render_ctx.rtv_page_params
+    );
 
-    // Create srv_cbv_heap for SRV and CBV
+    // NOTE(omid): We use a single descriptor heap for both SRV and CBV 
+    // -- A shader resource view (SRV) for the texture
+    // -- A constant buffer view (CBV) for animation
     // Flags indicate that this descriptor heap can be bound to the pipeline
-    // and that descriptors contained in it can be referenced by a root table
-    D3D12_DESCRIPTOR_HEAP_DESC heap_desc = {};
-    heap_desc.NumDescriptors = 2;
-    heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE::D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-    heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAGS::D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-    CHECK_AND_FAIL(render_ctx.device->CreateDescriptorHeap(&heap_desc, IID_PPV_ARGS(&render_ctx.srv_cbv_heap)));
+    // and that descriptors contained in it can be referenced by a root table;
+    // only one such heap can be bound at a time, hence a single page.
+    render_ctx.srv_cbv_page_params.device = render_ctx.device;
+    render_ctx.srv_cbv_page_params.type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+    render_ctx.srv_cbv_page_params.shader_visible = true;
+    descriptor_allocator_init(
+        &render_ctx.srv_cbv_allocator, "srv_cbv", SRV_CBV_HEAP_SIZE /*page size*/, 1 /*max pages*/, render_ctx.srv_cbv_descriptor_size,
+        create_descriptor_page, destroy_descriptor_page, &render_ctx.srv_cbv_page_params
+    );
+#if USE_BINDLESS > 0
+    // -- unbounded descriptor ranges need resource binding tier 2
+    D3D12_FEATURE_DATA_D3D12_OPTIONS d3d12_options = {};
+    CHECK_AND_FAIL(render_ctx.device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &d3d12_options, sizeof(d3d12_options)));
+    if (d3d12_options.ResourceBindingTier < D3D12_RESOURCE_BINDING_TIER_2) {
+        ::printf("[ERROR] bindless mode needs resource binding tier 2\n");
+        ::abort();
+    }
+    // -- reserve the bindless range once; slots inside it get stable indices
+    render_ctx.bindless_range = descriptor_allocate(&render_ctx.srv_cbv_allocator, BINDLESS_MAX_DESCRIPTORS);
+    SIMPLE_ASSERT(render_ctx.bindless_range.id != DESCRIPTOR_NONE);
+    bindless_index_allocator_init(&render_ctx.bindless_indices, BINDLESS_MAX_DESCRIPTORS);
+    render_ctx.texture_bindless_index = bindless_index_allocate(&render_ctx.bindless_indices, 0);
+    render_ctx.constants_bindless_index = bindless_index_allocate(&render_ctx.bindless_indices, 0);
+    render_ctx.srv_descriptor = descriptor_sub_range(&render_ctx.bindless_range, render_ctx.texture_bindless_index, 1);
+    render_ctx.cbv_descriptor = descriptor_sub_range(&render_ctx.bindless_range, render_ctx.constants_bindless_index, 1);
+#endif
+#if TABLES_FROM_DESCRIPTOR_RING
+    // -- persistent views go to cpu-only staging pages; shader-visible slots only hold per-frame copies
+    render_ctx.staging_page_params.device = render_ctx.device;
+    render_ctx.staging_page_params.type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+    render_ctx.staging_page_params.shader_visible = false;
+    descriptor_allocator_init(
+        &render_ctx.staging_allocator, "staging", 256 /*page size*/, 4 /*max pages*/, render_ctx.srv_cbv_descriptor_size,
+        create_descriptor_page, destroy_descriptor_page, &render_ctx.staging_page_params
+    );
+    render_ctx.ring_range = descriptor_allocate(&render_ctx.srv_cbv_allocator, DESCRIPTOR_RING_SIZE);
+    SIMPLE_ASSERT(render_ctx.ring_range.id != DESCRIPTOR_NONE);
+    descriptor_ring_init(
+        &render_ctx.descriptor_ring, render_ctx.device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
+        &render_ctx.ring_range, descriptor_heap_offset(&render_ctx.srv_cbv_allocator, &render_ctx.ring_range)
+    );
+    // -- views are created on request (and shared when identical) through the view cache
+    view_cache_init(&render_ctx.view_cache, render_ctx.device, &render_ctx.staging_allocator);
+#else
+    // -- views are created on request (and shared when identical) through the view cache
+    view_cache_init(&render_ctx.view_cache, render_ctx.device, &render_ctx.srv_cbv_allocator);
+#endif
+    render_ctx.srv_cbv_heap = reinterpret_cast<ID3D12DescriptorHeap *>(render_ctx.srv_cbv_allocator.pages[0].memory.heap);
 
 #pragma endregion Descriptors
 
-        // -- create frame resources: a rtv and a cmd-allocator for each frame
-    render_ctx.rtv_descriptor_size = render_ctx.device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE::D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-    D3D12_CPU_DESCRIPTOR_HANDLE rtv_handle_start = render_ctx.rtv_heap->GetCPUDescriptorHandleForHeapStart();
+        // -- create frame resources: a rtv for each frame
+    render_ctx.rtv_descriptors = descriptor_allocate(&render_ctx.rtv_allocator, FRAME_COUNT);
+    SIMPLE_ASSERT(render_ctx.rtv_descriptors.id != DESCRIPTOR_NONE);
+    render_ctx.rtv_heap = reinterpret_cast<ID3D12DescriptorHeap *>(descriptor_heap_of(&render_ctx.rtv_allocator, &render_ctx.rtv_descriptors));
+    state_tracker_init(&render_ctx.state_tracker);
     for (UINT i = 0; i < FRAME_COUNT; ++i) {
         CHECK_AND_FAIL(render_ctx.swapchain3->GetBuffer(i, IID_PPV_ARGS(&render_ctx.render_targets[i])));
+        state_tracker_register(&render_ctx.state_tracker, render_ctx.render_targets[i], 1, D3D12_RESOURCE_STATE_PRESENT);
         
-        D3D12_CPU_DESCRIPTOR_HANDLE cpu_handle = {};
-        cpu_handle.ptr = rtv_handle_start.ptr + ((UINT64)i * render_ctx.rtv_descriptor_size);
         // -- create a rtv for each frame
-        render_ctx.device->CreateRenderTargetView(render_ctx.render_targets[i], nullptr, cpu_handle);
-        // -- create a cmd-allocator for each frame
-        res = render_ctx.device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE::D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&render_ctx.cmd_allocator[i]));
-
+        render_ctx.device->CreateRenderTargetView(render_ctx.render_targets[i], nullptr, descriptor_cpu_handle(&render_ctx.rtv_descriptors, i));
     }
 
-    // Create bundle allocator
-    res = render_ctx.device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE::D3D12_COMMAND_LIST_TYPE_BUNDLE, IID_PPV_ARGS(&render_ctx.bundle_allocator));
-
-    CHECK_AND_FAIL(res);
+    // -- cmd-allocators are created on demand by the pool (no fence exists yet, so nothing is in flight)
+    command_allocator_pool_init(&render_ctx.allocator_pool, render_ctx.device);
+    render_ctx.cmd_allocator = command_allocator_pool_acquire(&render_ctx.allocator_pool, D3D12_COMMAND_LIST_TYPE_DIRECT, 0);
 
     // ========================================================================================================
+    // Load and compile shaders, in the background while the root signature is built
+    
+#if defined(_DEBUG)
+    UINT compiler_flags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+    UINT compiler_flags = 0;
+#endif
+
+#if USE_BINDLESS > 0
+    // -- unbounded arrays need shader model 5.1
+    char const * shaders_path = "./shaders/bindless_shader.hlsl";
+    char const * vs_target = "vs_5_1";
+    char const * ps_target = "ps_5_1";
+#else
+    char const * shaders_path = "./shaders/cbuffer_shader.hlsl";
+    char const * vs_target = "vs_5_0";
+    char const * ps_target = "ps_5_0";
+#endif
+    LARGE_INTEGER shader_t0 = {}, shader_t1 = {};
+    QueryPerformanceCounter(&shader_t0);
+    ShaderPermutationKey ps_keys [PS_KEY_COUNT] = {};
+    ps_keys[PS_KEY_FLIP_TEXTU_Y] = {"SHOULD_FLIP_TEXTU_Y", 2};
+    ps_keys[PS_KEY_DEBUG_VIEW] = {"DEBUG_VIEW", 3};     // none, uv, luma
+    uint32_t ps_generic_values [PS_KEY_COUNT] = {};
+    shader_permutation_set_init(
+        &render_ctx.ps_permutations, "ps_main", shaders_path, "PixelShader_Main", ps_target, compiler_flags,
+        ps_keys, PS_KEY_COUNT, ps_generic_values
+    );
+
+    shader_cache_init(&render_ctx.shader_cache, SHADER_CACHE_DIR, D3D_COMPILER_VERSION);
+    D3D12_FEATURE_DATA_SHADER_MODEL shader_model = {D3D_SHADER_MODEL_6_0};
+    bool dxil_supported =
+        SUCCEEDED(render_ctx.device->CheckFeatureSupport(D3D12_FEATURE_SHADER_MODEL, &shader_model, sizeof(shader_model))) &&
+        shader_model.HighestShaderModel >= D3D_SHADER_MODEL_6_0;
+    if (dxil_supported && shader_archive_load(&render_ctx.shader_archive, SHADER_ARCHIVE_PATH) &&
+        !shader_archive_covers(&render_ctx.shader_archive, &render_ctx.ps_permutations, shaders_path, "VertexShader_Main", vs_target)
+    ) {
+        ::printf("shader archive: %s is incomplete (rerun tools/build_shaders.py), compiling at runtime\n", SHADER_ARCHIVE_PATH);
+        shader_archive_destroy(&render_ctx.shader_archive);
+    }
+    shader_build_service_init(
+        &render_ctx.shader_builds, &render_ctx.shader_cache,
+        render_ctx.shader_archive.data ? &render_ctx.shader_archive : nullptr, 0
+    );
+    ShaderBuildJob * vs_job = shader_build_submit(&render_ctx.shader_builds, shaders_path, nullptr, "VertexShader_Main", vs_target, compiler_flags);
+    SIMPLE_ASSERT(vs_job);
+    // -- pixel shader variants: the generic one now, plus whatever the last run used
+    shader_permutation_request(&render_ctx.ps_permutations, &render_ctx.shader_builds, render_ctx.ps_permutations.generic_index);
+    shader_permutation_prewarm(&render_ctx.ps_permutations, &render_ctx.shader_builds, PS_USAGE_PATH);
+
 #pragma region Root Signature
     // Create root signature
     D3D12_FEATURE_DATA_ROOT_SIGNATURE feature_data = {};
@@ -597,6 +1889,41 @@ WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, INT) {
         ::printf("root signature version 1_1 is not supported, switched to 1_0!");
     }
 
+#if USE_BINDLESS > 0
+    // NOTE(omid): Bindless layout: one table whose two unbounded ranges alias the
+    // whole bindless range (textures in space1, constant buffers in space2), and
+    // root constants selecting the entries a draw uses. Descriptors may be written
+    // while the table is bound (for slots not used by in-flight work), hence volatile.
+    D3D12_DESCRIPTOR_RANGE1 ranges [2] = {};
+    ranges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+    ranges[0].NumDescriptors = UINT_MAX;        // unbounded
+    ranges[0].BaseShaderRegister = 0;
+    ranges[0].RegisterSpace = 1;
+    ranges[0].Flags = D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE | D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE;
+    ranges[0].OffsetInDescriptorsFromTableStart = 0;
+
+    ranges[1].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
+    ranges[1].NumDescriptors = UINT_MAX;        // unbounded
+    ranges[1].BaseShaderRegister = 0;
+    ranges[1].RegisterSpace = 2;
+    ranges[1].Flags = D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE | D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE;
+    ranges[1].OffsetInDescriptorsFromTableStart = 0;
+
+    D3D12_ROOT_PARAMETER1 root_paramters [3] = {};
+
+    // -- the bindless table
+    root_paramters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+    root_paramters[0].DescriptorTable.NumDescriptorRanges = ARRAY_COUNT(ranges);
+    root_paramters[0].DescriptorTable.pDescriptorRanges = &ranges[0];
+    root_paramters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+
+    // -- material indices (b0): texture index, constants index
+    root_paramters[ROOT_PARAM_MATERIAL].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+    root_paramters[ROOT_PARAM_MATERIAL].Constants.ShaderRegister = 0;
+    root_paramters[ROOT_PARAM_MATERIAL].Constants.RegisterSpace = 0;
+    root_paramters[ROOT_PARAM_MATERIAL].Constants.Num32BitValues = 2;
+    root_paramters[ROOT_PARAM_MATERIAL].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+#else
     D3D12_DESCRIPTOR_RANGE1 ranges [2] = {};
 
     // -- define a range of srv descriptor(s)
@@ -617,7 +1944,7 @@ WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, INT) {
 
     // NOTE(omid): descriptor tables are ranges in a descriptor heap
 
-    D3D12_ROOT_PARAMETER1 root_paramters [2] = {};
+    D3D12_ROOT_PARAMETER1 root_paramters [3] = {};
 
     // -- srv parameter space (s0)
     root_paramters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
@@ -630,6 +1957,14 @@ WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, INT) {
     root_paramters[1].DescriptorTable.NumDescriptorRanges = 1;
     root_paramters[1].DescriptorTable.pDescriptorRanges = &ranges[1];
     root_paramters[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+#endif
+
+    // -- per-draw root constants (b1), written by ExecuteIndirect commands
+    root_paramters[ROOT_PARAM_DRAW_CONSTANTS].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+    root_paramters[ROOT_PARAM_DRAW_CONSTANTS].Constants.ShaderRegister = 1;
+    root_paramters[ROOT_PARAM_DRAW_CONSTANTS].Constants.RegisterSpace = 0;
+    root_paramters[ROOT_PARAM_DRAW_CONSTANTS].Constants.Num32BitValues = INDIRECT_ROOT_CONSTANT_COUNT;
+    root_paramters[ROOT_PARAM_DRAW_CONSTANTS].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
 
     D3D12_STATIC_SAMPLER_DESC sampler = {};
     sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_POINT;
@@ -673,20 +2008,14 @@ WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, INT) {
     
 #pragma endregion Root Signature
 
-    // Load and compile shaders
-    
-#if defined(_DEBUG)
-    UINT compiler_flags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#else
-    UINT compiler_flags = 0;
-#endif
-
-    wchar_t const * shaders_path = L"./shaders/cbuffer_shader.hlsl";
+    // -- wait for the shaders submitted before the root signature
     ID3DBlob * vertex_shader = nullptr;
     ID3DBlob * vs_err = nullptr;
-    ID3DBlob * pixel_shader = nullptr;
-    ID3DBlob * ps_err = nullptr;
-    res = D3DCompileFromFile(shaders_path, nullptr, nullptr, "VertexShader_Main", "vs_5_0", compiler_flags, 0, &vertex_shader, &vs_err);
+    ID3DBlob * pixel_shader = nullptr;   // owned by ps_permutations
+    res = shader_build_await(vs_job);
+    vertex_shader = vs_job->bytecode;
+    vs_err = vs_job->errors;
+    shader_build_release(&render_ctx.shader_builds, vs_job);
     if (FAILED(res)) {
         if (vs_err) {
             OutputDebugStringA((char *)vs_err->GetBufferPointer());
@@ -695,86 +2024,163 @@ WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, INT) {
             ::printf("could not load/compile shader\n");
         }
     }
-    res = D3DCompileFromFile(shaders_path, nullptr, nullptr, "PixelShader_Main", "ps_5_0", compiler_flags, 0, &pixel_shader, &ps_err);
-    if (FAILED(res)) {
-        if (ps_err) {
-            OutputDebugStringA((char *)ps_err->GetBufferPointer());
-            ps_err->Release();
-        }
-    }
+    pixel_shader = shader_permutation_await(&render_ctx.ps_permutations, &render_ctx.shader_builds, render_ctx.ps_permutations.generic_index);
+    render_ctx.ps_variant_index = render_ctx.ps_permutations.generic_index;
     SIMPLE_ASSERT(vertex_shader);
     SIMPLE_ASSERT(pixel_shader);
+    render_ctx.vertex_shader = vertex_shader;
+    render_ctx.ps_variant_generation = render_ctx.ps_permutations.variants[render_ctx.ps_variant_index].generation;
+
+    // -- hot reload compiles from source, so not while the precompiled archive is in use
+    if (nullptr == render_ctx.shader_archive.data && shader_watcher_init(&render_ctx.hot_reload.watcher, SHADER_WATCH_DIR)) {
+        ShaderHotReload * reload = &render_ctx.hot_reload;
+        reload->enabled = true;
+        reload->vs_entry = "VertexShader_Main";
+        reload->vs_target = vs_target;
+        reload->ps_target = ps_target;
+        reload->flags = compiler_flags;
+        reload->source_hash = shader_cache_key(&render_ctx.shader_cache, shaders_path, nullptr, reload->vs_entry, vs_target, compiler_flags).hash;
+        reload->scene_source_hash = shader_cache_key(&render_ctx.shader_cache, SCENE_SHADER_PATH, nullptr, "VertexShader_Scene", vs_target, compiler_flags).hash;
+    }
+    QueryPerformanceCounter(&shader_t1);
+    {
+        LARGE_INTEGER qpc_freq = {};
+        QueryPerformanceFrequency(&qpc_freq);
+        ::printf("Shader load (wall): %.3f ms\n", 1e3 * (double)(shader_t1.QuadPart - shader_t0.QuadPart) / (double)qpc_freq.QuadPart);
+    }
 
-    // Create vertex-input-layout Elements
-    D3D12_INPUT_ELEMENT_DESC input_desc [2];
-    input_desc[0] = {};
-    input_desc[0].SemanticName = "POSITION";
-    input_desc[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-    input_desc[0].InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
-    
-    input_desc[1] = {};
-    input_desc[1].SemanticName = "TEXCOORD";
-    input_desc[1].Format = DXGI_FORMAT_R32G32_FLOAT;
-    input_desc[1].AlignedByteOffset = 12; // bc of the position?
-    input_desc[1].InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
+    // -- input layout from the vertex shader's signature, root signature checked against what the shaders bind
+    // -- the quad is uploaded packed (see vertex_compression.h); its uvs are all in [0, 1]
+    render_ctx.vertex_layout = &packed_textu_vertex_layout_unorm_uv;
+    ID3D12ShaderReflection * vs_reflection = nullptr;
+    ID3D12ShaderReflection * ps_reflection = nullptr;
+    if (shader_reflect_create(vertex_shader->GetBufferPointer(), vertex_shader->GetBufferSize(), &vs_reflection) &&
+        shader_reflect_create(pixel_shader->GetBufferPointer(), pixel_shader->GetBufferSize(), &ps_reflection)
+    ) {
+        bool layout_ok = shader_reflect_input_layout(
+            vs_reflection, render_ctx.vertex_layout, render_ctx.input_elements, ARRAY_COUNT(render_ctx.input_elements), &render_ctx.input_element_count
+        );
+        SIMPLE_ASSERT(layout_ok);
+
+        ShaderBindings shader_bindings = {};
+        bool bindings_ok =
+            shader_reflect_bindings(vs_reflection, SHADER_STAGE_VERTEX, &shader_bindings) &&
+            shader_reflect_bindings(ps_reflection, SHADER_STAGE_PIXEL, &shader_bindings) &&
+            shader_bindings_check_root_signature(&shader_bindings, &root_desc1);
+        SIMPLE_ASSERT(bindings_ok);
+
+        ShaderRootSignatureLayout minimal_root_signature = {};
+        if (shader_bindings_build_root_signature(&shader_bindings, &sampler, 1, &minimal_root_signature)) {
+            ::printf(
+                "Root signature: %u parameters, %u dwords (the shaders alone need %u parameters, %u dwords)\n",
+                root_desc1.NumParameters, shader_root_signature_cost(&root_desc1),
+                minimal_root_signature.desc.NumParameters, shader_root_signature_cost(&minimal_root_signature.desc)
+            );
+        }
+    } else {
+        // -- DXIL (from the archive) has no DXBC reflection; take the struct as declared
+        render_ctx.input_element_count = vertex_layout_input_elements(render_ctx.vertex_layout, render_ctx.input_elements, ARRAY_COUNT(render_ctx.input_elements));
+        ::printf("input layout: no reflection for these shaders, using %s as declared\n", render_ctx.vertex_layout->name);
+    }
+    if (vs_reflection)
+        vs_reflection->Release();
+    if (ps_reflection)
+        ps_reflection->Release();
 
     // Create pipeline state object
 
-    D3D12_BLEND_DESC def_blend_desc = {};
-    def_blend_desc.AlphaToCoverageEnable                    = FALSE;
-    def_blend_desc.IndependentBlendEnable                   = FALSE;
-    def_blend_desc.RenderTarget[0].BlendEnable              = FALSE;
-    def_blend_desc.RenderTarget[0].LogicOpEnable            = FALSE;
-    def_blend_desc.RenderTarget[0].SrcBlend                 = D3D12_BLEND_ONE;
-    def_blend_desc.RenderTarget[0].DestBlend                = D3D12_BLEND_ZERO;
-    def_blend_desc.RenderTarget[0].BlendOp                  = D3D12_BLEND_OP_ADD;
-    def_blend_desc.RenderTarget[0].SrcBlendAlpha            = D3D12_BLEND_ONE;
-    def_blend_desc.RenderTarget[0].DestBlendAlpha           = D3D12_BLEND_ZERO;
-    def_blend_desc.RenderTarget[0].BlendOpAlpha             = D3D12_BLEND_OP_ADD;
-    def_blend_desc.RenderTarget[0].LogicOp                  = D3D12_LOGIC_OP_NOOP;
-    def_blend_desc.RenderTarget[0].RenderTargetWriteMask    = D3D12_COLOR_WRITE_ENABLE_ALL;
-
-    D3D12_RASTERIZER_DESC def_rasterizer_desc = {};
-    def_rasterizer_desc.FillMode = D3D12_FILL_MODE_SOLID;
-    def_rasterizer_desc.CullMode = D3D12_CULL_MODE_BACK;
-    def_rasterizer_desc.FrontCounterClockwise = false;
-    def_rasterizer_desc.DepthBias = 0;
-    def_rasterizer_desc.DepthBiasClamp = 0.0f;
-    def_rasterizer_desc.SlopeScaledDepthBias = 0.0f;
-    def_rasterizer_desc.DepthClipEnable = TRUE;
-    def_rasterizer_desc.ForcedSampleCount = 0;
-    def_rasterizer_desc.ConservativeRaster = D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF;
-
     D3D12_GRAPHICS_PIPELINE_STATE_DESC pso_desc = {};
     pso_desc.pRootSignature = render_ctx.root_signature;
     pso_desc.VS.pShaderBytecode = vertex_shader->GetBufferPointer();
     pso_desc.VS.BytecodeLength = vertex_shader->GetBufferSize();
     pso_desc.PS.pShaderBytecode = pixel_shader->GetBufferPointer();
     pso_desc.PS.BytecodeLength = pixel_shader->GetBufferSize();
-    pso_desc.BlendState = def_blend_desc;
+    pso_desc.BlendState = pso_default_blend_desc();
     pso_desc.SampleMask = UINT_MAX;
-    pso_desc.RasterizerState = def_rasterizer_desc;
+    pso_desc.RasterizerState = pso_default_rasterizer_desc();
     pso_desc.DepthStencilState.StencilEnable = FALSE;
     pso_desc.DepthStencilState.DepthEnable = FALSE;
-    pso_desc.InputLayout.pInputElementDescs = input_desc;
-    pso_desc.InputLayout.NumElements = ARRAY_COUNT(input_desc);
+    pso_desc.InputLayout.pInputElementDescs = render_ctx.input_elements;
+    pso_desc.InputLayout.NumElements = render_ctx.input_element_count;
     pso_desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE::D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
     pso_desc.NumRenderTargets = 1;
     pso_desc.RTVFormats[0] = DXGI_FORMAT::DXGI_FORMAT_R8G8B8A8_UNORM;
     pso_desc.SampleDesc.Count = 1;
     pso_desc.SampleDesc.Quality = 0;
 
-    CHECK_AND_FAIL(render_ctx.device->CreateGraphicsPipelineState(&pso_desc, IID_PPV_ARGS(&render_ctx.pso)));
+    pso_cache_init(&render_ctx.pso_cache, render_ctx.device, PSO_CACHE_LIBRARY_PATH, PSO_CACHE_INDEX_PATH);
+    UINT64 root_signature_hash = fnv1a_64(signature->GetBufferPointer(), signature->GetBufferSize(), FNV1A_64_SEED);
+    render_ctx.pso = pso_cache_create_graphics(&render_ctx.pso_cache, &pso_desc, root_signature_hash);
+    if (!create_depth_buffer(&render_ctx) || !create_scene_pipeline(&render_ctx, &pso_desc, vs_target, ps_target, compiler_flags))
+        ::printf("Scene pipeline: not created, the scene won't be drawn\n");
 
     // Create command list
-    CHECK_AND_FAIL(render_ctx.device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, render_ctx.cmd_allocator[render_ctx.frame_index], render_ctx.pso, IID_PPV_ARGS(&render_ctx.direct_cmd_list)));
+    CHECK_AND_FAIL(render_ctx.device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, render_ctx.cmd_allocator, render_ctx.pso, IID_PPV_ARGS(&render_ctx.direct_cmd_list)));
+
+    // scene, drawn after the quad (see draw_scene)
+    // -- mapped from its container; the .dae is imported again when the container is missing or
+    // stale, and once more when the container's gpu streams can't be read back whole
+    if (!mesh_container_open(&render_ctx.scene_file, SCENE_CONTAINER_PATH, SCENE_PATH))
+        import_scene(&render_ctx);
+    if (render_ctx.scene_file.base && !load_scene_streams(&render_ctx)) {
+        ::printf("Mesh container: %s gpu streams unreadable, importing %s again\n", SCENE_CONTAINER_PATH, SCENE_PATH);
+        close_scene_container(&render_ctx);
+        if (import_scene(&render_ctx) && !load_scene_streams(&render_ctx)) {
+            ::printf("Mesh container: %s still unreadable, scene dropped\n", SCENE_CONTAINER_PATH);
+            close_scene_container(&render_ctx);
+        }
+    }
+    // -- no container could be written: the imported arrays go up as they are
+    if (!render_ctx.scene_file.base && render_ctx.scene_batch.draw_count && !upload_scene_streams(&render_ctx))
+        ::printf("Index batch scene: gpu streams not created\n");
+    // -- culled every frame; scene_visible indexes scene_cull, scene_cull_nodes maps back to nodes
+    render_ctx.scene_cull_nodes = reinterpret_cast<uint32_t *>(::malloc(render_ctx.scene.node_count * sizeof(uint32_t) + sizeof(uint32_t)));
+    if (render_ctx.scene_cull_nodes)
+        cull_set_add_scene(&render_ctx.scene_cull, &render_ctx.scene, render_ctx.scene_cull_nodes);
+    if (render_ctx.scene_cull.count) {
+        render_ctx.scene_visible = reinterpret_cast<uint32_t *>(::malloc(cull_visible_capacity(render_ctx.scene_cull.count) * sizeof(uint32_t)));
+        // -- where the camera stands: the box around every node's box
+        CullSet const * cull = &render_ctx.scene_cull;
+        float lo [3] = {FLT_MAX, FLT_MAX, FLT_MAX}, hi [3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+        for (uint32_t i = 0; i < cull->count; ++i) {
+            float const center [3] = {cull->center_x[i], cull->center_y[i], cull->center_z[i]};
+            float const extent [3] = {cull->extent_x[i], cull->extent_y[i], cull->extent_z[i]};
+            for (uint32_t c = 0; c < 3; ++c) {
+                lo[c] = center[c] - extent[c] < lo[c] ? center[c] - extent[c] : lo[c];
+                hi[c] = center[c] + extent[c] > hi[c] ? center[c] + extent[c] : hi[c];
+            }
+        }
+        float d [3];
+        for (uint32_t c = 0; c < 3; ++c) {
+            render_ctx.scene_center[c] = 0.5f * (lo[c] + hi[c]);
+            d[c] = hi[c] - lo[c];
+        }
+        render_ctx.scene_radius = 0.5f * ::sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        render_ctx.scene_radius = render_ctx.scene_radius > 0.0f ? render_ctx.scene_radius : 1.0f;
+    }
+#if RUN_STARTUP_BENCHMARKS
+    cull_benchmark(&render_ctx.scene, CULL_BENCHMARK_OBJECTS);
+#endif
 
     // vertex data
     /*TextuVertex vertices [3] = {};
     create_triangle_vertices(render_ctx.aspect_ratio, vertices);*/
     TextuVertex vertices [4] = {};
     create_quad_vertices(render_ctx.aspect_ratio, vertices);
-    size_t vb_size = sizeof(vertices);
+    // -- packed to 12 bytes a vertex; the shaders decode positions with the bounds in the constant buffer
+    VertexQuantization quad_quantization = vertex_quantization(
+        &vertices[0].position.x, sizeof(TextuVertex), &vertices[0].uv.x, sizeof(TextuVertex), ARRAY_COUNT(vertices)
+    );
+    SIMPLE_ASSERT(packed_textu_vertex_layout(&quad_quantization) == render_ctx.vertex_layout);
+    PackedTextuVertex packed_vertices [ARRAY_COUNT(vertices)] = {};
+    vertex_compress_textu_sse2(
+        &vertices[0].position.x, &vertices[0].uv.x, sizeof(TextuVertex), ARRAY_COUNT(vertices), &quad_quantization, packed_vertices
+    );
+    for (uint32_t c = 0; c < 3; ++c) {
+        render_ctx.constant_buffer_data.position_min[c] = quad_quantization.position_min[c];
+        render_ctx.constant_buffer_data.position_scale[c] = quad_quantization.position_scale[c];
+    }
+    size_t vb_size = sizeof(packed_vertices);
 
     D3D12_HEAP_PROPERTIES vb_heap_props = {};
     vb_heap_props.Type = D3D12_HEAP_TYPE_UPLOAD;
@@ -805,12 +2211,12 @@ WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, INT) {
     D3D12_RANGE vb_mem_range = {};
     vb_mem_range.Begin = vb_mem_range.End = 0; // We do not intend to read from this resource on the CPU.
     render_ctx.vertex_buffer->Map(0, &vb_mem_range, reinterpret_cast<void **>(&vertex_data));
-    memcpy(vertex_data, vertices, vb_size);
+    memcpy(vertex_data, packed_vertices, vb_size);
     render_ctx.vertex_buffer->Unmap(0, nullptr /*aka full-range*/);
 
     // Initialize the vertex buffer view (vbv)
     render_ctx.vb_view.BufferLocation = render_ctx.vertex_buffer->GetGPUVirtualAddress();
-    render_ctx.vb_view.StrideInBytes = sizeof(*vertices);
+    render_ctx.vb_view.StrideInBytes = sizeof(*packed_vertices);
     render_ctx.vb_view.SizeInBytes = (UINT)vb_size;
 
 #pragma region Create Texture
@@ -842,6 +2248,7 @@ WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, INT) {
     CHECK_AND_FAIL(render_ctx.device->CreateCommittedResource(
         &textu_heap_props, D3D12_HEAP_FLAG_NONE, &texture_desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&render_ctx.texture)
     ));
+    state_tracker_register(&render_ctx.state_tracker, render_ctx.texture, texture_desc.MipLevels, D3D12_RESOURCE_STATE_COPY_DEST);
 
     UINT64 upload_buffer_size = 0;
     UINT first_subresource = 0;
@@ -900,14 +2307,8 @@ WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, INT) {
 
 #pragma endregion Create Texture
 
-    D3D12_RESOURCE_BARRIER barrier = {};
-    barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-    barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-    barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-    barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-    barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
-    barrier.Transition.pResource = render_ctx.texture;
-    render_ctx.direct_cmd_list->ResourceBarrier(1, &barrier);
+    state_tracker_transition(&render_ctx.state_tracker, render_ctx.texture, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    state_tracker_flush(&render_ctx.state_tracker, render_ctx.direct_cmd_list);
 
     // -- describe and create a SRV for the texture
     D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
@@ -915,7 +2316,12 @@ WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, INT) {
     srv_desc.Format = texture_desc.Format;
     srv_desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
     srv_desc.Texture2D.MipLevels = 1;
-    render_ctx.device->CreateShaderResourceView(render_ctx.texture, &srv_desc, render_ctx.srv_cbv_heap->GetCPUDescriptorHandleForHeapStart());
+#if USE_BINDLESS > 0
+    render_ctx.device->CreateShaderResourceView(render_ctx.texture, &srv_desc, descriptor_cpu_handle(&render_ctx.srv_descriptor, 0));
+#else
+    render_ctx.srv_descriptor = view_cache_get_srv(&render_ctx.view_cache, render_ctx.texture, &srv_desc);
+    SIMPLE_ASSERT(render_ctx.srv_descriptor.id != DESCRIPTOR_NONE);
+#endif
 
     // -- close the command list and execute it to begin inital gpu setup
     CHECK_AND_FAIL(render_ctx.direct_cmd_list->Close());
@@ -952,15 +2358,16 @@ WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, INT) {
         IID_PPV_ARGS(&render_ctx.constant_buffer)));
 
 
-    render_ctx.srv_cbv_descriptor_size = render_ctx.device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE::D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-    D3D12_CPU_DESCRIPTOR_HANDLE cbv_cpu_handle = {};
-    cbv_cpu_handle.ptr = render_ctx.srv_cbv_heap->GetCPUDescriptorHandleForHeapStart().ptr + (UINT64)render_ctx.srv_cbv_descriptor_size;
-
     // Describe and create a constant buffer view.
     D3D12_CONSTANT_BUFFER_VIEW_DESC cbv_desc = {};
     cbv_desc.BufferLocation = render_ctx.constant_buffer->GetGPUVirtualAddress();
     cbv_desc.SizeInBytes = cb_size;
-    render_ctx.device->CreateConstantBufferView(&cbv_desc, cbv_cpu_handle);
+#if USE_BINDLESS > 0
+    render_ctx.device->CreateConstantBufferView(&cbv_desc, descriptor_cpu_handle(&render_ctx.cbv_descriptor, 0));
+#else
+    render_ctx.cbv_descriptor = view_cache_get_cbv(&render_ctx.view_cache, &cbv_desc);
+    SIMPLE_ASSERT(render_ctx.cbv_descriptor.id != DESCRIPTOR_NONE);
+#endif
 
     // Map and initialize the constant buffer. We don't unmap this until the
     // app closes. Keeping things mapped for the lifetime of the resource is okay.
@@ -973,15 +2380,74 @@ WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, INT) {
 
 
 #pragma region Bundle
-    // -- create and record the bundle
-    CHECK_AND_FAIL(render_ctx.device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_BUNDLE, render_ctx.bundle_allocator, render_ctx.pso, IID_PPV_ARGS(&render_ctx.bundle)));
-    render_ctx.bundle->SetGraphicsRootSignature(render_ctx.root_signature);
-    render_ctx.bundle->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-    render_ctx.bundle->IASetVertexBuffers(0, 1, &render_ctx.vb_view);
-    render_ctx.bundle->DrawInstanced(4, 1, 0, 0);
-    CHECK_AND_FAIL(render_ctx.bundle->Close());
+    // -- bundles are recorded lazily by the cache the first time a draw asks for them
+    bundle_cache_init(&render_ctx.bundle_cache, render_ctx.device, &render_ctx.allocator_pool);
 #pragma endregion Bundle
 
+#pragma region Command Stream
+    // -- objects the recorded command stream refers to by id
+    command_stream_init(&render_ctx.cmd_stream, 4096);
+    render_ctx.stream_bindings.psos[STREAM_PSO_MAIN] = render_ctx.pso;
+    render_ctx.stream_bindings.root_signatures[STREAM_ROOT_SIGNATURE_MAIN] = render_ctx.root_signature;
+    render_ctx.stream_bindings.heaps[STREAM_HEAP_RTV] = render_ctx.rtv_heap;
+    render_ctx.stream_bindings.heap_increments[STREAM_HEAP_RTV] = render_ctx.rtv_descriptor_size;
+    render_ctx.stream_bindings.heaps[STREAM_HEAP_SRV_CBV] = render_ctx.srv_cbv_heap;
+    render_ctx.stream_bindings.heap_increments[STREAM_HEAP_SRV_CBV] = render_ctx.srv_cbv_descriptor_size;
+    render_ctx.stream_bindings.resources[STREAM_RESOURCE_VERTEX_BUFFER] = render_ctx.vertex_buffer;
+
+    // -- sorted draw submission (radix sort goes wide only for large queues)
+    draw_queue_init(&render_ctx.draw_queue, 1024, std::thread::hardware_concurrency());
+#pragma endregion Command Stream
+
+#pragma region Indirect Arguments
+    // -- command signature: vertex buffer view + root constants + draw, 48 bytes per command
+    IndirectLayout draw_layout = {};
+    indirect_layout_make_draw(&draw_layout, ROOT_PARAM_DRAW_CONSTANTS);
+    render_ctx.draw_cmd_signature = create_command_signature(
+        render_ctx.device, render_ctx.root_signature, &draw_layout, INDIRECT_DRAW_STRIDE
+    );
+    SIMPLE_ASSERT(render_ctx.draw_cmd_signature);
+
+    // -- one upload buffer, persistently mapped, one region per frame in flight
+    D3D12_HEAP_PROPERTIES indirect_heap_props = {};
+    indirect_heap_props.Type = D3D12_HEAP_TYPE_UPLOAD;
+    indirect_heap_props.CreationNodeMask = 1U;
+    indirect_heap_props.VisibleNodeMask = 1U;
+
+    D3D12_RESOURCE_DESC indirect_desc = {};
+    indirect_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    indirect_desc.Alignment = 0;
+    indirect_desc.Width = (UINT64)INDIRECT_FRAME_SIZE * FRAME_COUNT;
+    indirect_desc.Height = 1;
+    indirect_desc.DepthOrArraySize = 1;
+    indirect_desc.MipLevels = 1;
+    indirect_desc.Format = DXGI_FORMAT_UNKNOWN;
+    indirect_desc.SampleDesc.Count = 1;
+    indirect_desc.SampleDesc.Quality = 0;
+    indirect_desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    indirect_desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+    CHECK_AND_FAIL(render_ctx.device->CreateCommittedResource(
+        &indirect_heap_props, D3D12_HEAP_FLAG_NONE, &indirect_desc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,      // includes INDIRECT_ARGUMENT
+        nullptr, IID_PPV_ARGS(&render_ctx.indirect_buffer)
+    ));
+    D3D12_RANGE indirect_mem_range = {};
+    indirect_mem_range.Begin = indirect_mem_range.End = 0; // We do not intend to read from this resource on the CPU.
+    CHECK_AND_FAIL(render_ctx.indirect_buffer->Map(0, &indirect_mem_range, reinterpret_cast<void **>(&render_ctx.indirect_data_begin_ptr)));
+
+    render_ctx.indirect_vb_table[0].buffer_location = render_ctx.vb_view.BufferLocation;
+    render_ctx.indirect_vb_table[0].size_in_bytes = render_ctx.vb_view.SizeInBytes;
+    render_ctx.indirect_vb_table[0].stride_in_bytes = render_ctx.vb_view.StrideInBytes;
+
+    render_ctx.stream_bindings.resources[STREAM_RESOURCE_INDIRECT_ARGS] = render_ctx.indirect_buffer;
+    render_ctx.stream_bindings.command_signatures[STREAM_COMMAND_SIGNATURE_DRAW] = render_ctx.draw_cmd_signature;
+
+#if RUN_STARTUP_BENCHMARKS
+    benchmark_indirect_packing(64 * 1024);
+#endif
+#pragma endregion Indirect Arguments
+
     //----------------
     // Create fence
     // create synchronization objects and wait until assets have been uploaded to the GPU.
@@ -989,6 +2455,13 @@ WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, INT) {
 
     ++render_ctx.fence_value[render_ctx.frame_index];
 
+    // -- the setup allocator is free to reuse once wait_for_gpu signals this value
+    command_allocator_pool_release(
+        &render_ctx.allocator_pool, D3D12_COMMAND_LIST_TYPE_DIRECT,
+        render_ctx.cmd_allocator, render_ctx.fence_value[render_ctx.frame_index]
+    );
+    render_ctx.cmd_allocator = nullptr;
+
     // Create an event handle to use for frame synchronization.
     render_ctx.fence_event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
     if(nullptr == render_ctx.fence_event) {
@@ -1000,25 +2473,45 @@ WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, INT) {
     // list in our main loop but for now, we just want to wait for setup to 
     // complete before continuing.
     CHECK_AND_FAIL(wait_for_gpu(&render_ctx));
+    // -- the scene streams are in their default heap now
+    if (render_ctx.scene_staging) {
+        render_ctx.scene_staging->Release();
+        render_ctx.scene_staging = nullptr;
+    }
 
 #pragma endregion Initialization
 
     // ========================================================================================================
 #pragma region Main_Loop
     global_running = true;
+    UINT64 frame_counter = 0;
     while(global_running) {
         MSG msg = {};
         while (PeekMessageA(&msg, 0, 0, 0, PM_REMOVE)) {
             TranslateMessage(&msg);
             DispatchMessageA(&msg);
+            // -- F: flip texture y, V: cycle debug view (pixel shader permutations)
+            if (WM_KEYDOWN == msg.message && 'F' == msg.wParam)
+                render_ctx.ps_wanted_values[PS_KEY_FLIP_TEXTU_Y] ^= 1;
+            if (WM_KEYDOWN == msg.message && 'V' == msg.wParam)
+                render_ctx.ps_wanted_values[PS_KEY_DEBUG_VIEW] = (render_ctx.ps_wanted_values[PS_KEY_DEBUG_VIEW] + 1) % 3;
         }
         // OnUpdate()
         update_constant_buffer(&render_ctx);
+        update_shader_hot_reload(&render_ctx, &pso_desc);
+        update_pixel_shader_variant(&render_ctx, &pso_desc, root_signature_hash);
 
         // OnRender() aka rendering
         CHECK_AND_FAIL(render_stuff(&render_ctx));
 
         CHECK_AND_FAIL(move_to_next_frame(&render_ctx));
+        bundle_cache_next_frame(&render_ctx.bundle_cache, render_ctx.fence->GetCompletedValue());
+        view_cache_collect(&render_ctx.view_cache, render_ctx.fence->GetCompletedValue());
+        release_retired_psos(&render_ctx, render_ctx.fence->GetCompletedValue());
+
+        // -- give back allocators that only a burst of work needed
+        if (0 == (++frame_counter % 512))
+            command_allocator_pool_trim(&render_ctx.allocator_pool);
     }
 #pragma endregion Main_Loop
 
@@ -1030,7 +2523,35 @@ WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, INT) {
 
     render_ctx.fence->Release();
 
-    render_ctx.bundle->Release();
+    bundle_cache_print_stats(&render_ctx.bundle_cache);
+    state_tracker_print_stats(&render_ctx.state_tracker);
+
+    command_stream_print_stats(&render_ctx.cmd_stream);
+    if (render_ctx.stream_recorded_frames > 0) {
+        LARGE_INTEGER qpc_freq = {};
+        QueryPerformanceFrequency(&qpc_freq);
+        double avg_us = 1e6 * (double)render_ctx.stream_record_ticks / (double)qpc_freq.QuadPart / (double)render_ctx.stream_recorded_frames;
+        ::printf("Command stream recording: %.3f us/frame over %llu frames\n", avg_us, render_ctx.stream_recorded_frames);
+    }
+    command_stream_destroy(&render_ctx.cmd_stream);
+
+#if QUAD_SUBMIT_MODE == QUAD_SUBMIT_DRAW_QUEUE
+    draw_queue_print_stats(&render_ctx.draw_queue);
+#endif
+    draw_queue_destroy(&render_ctx.draw_queue);
+
+#if QUAD_SUBMIT_MODE == QUAD_SUBMIT_INDIRECT
+    if (render_ctx.stream_recorded_frames > 0) {
+        LARGE_INTEGER qpc_freq = {};
+        QueryPerformanceFrequency(&qpc_freq);
+        double avg_us = 1e6 * (double)render_ctx.indirect_pack_ticks / (double)qpc_freq.QuadPart / (double)render_ctx.stream_recorded_frames;
+        ::printf("Indirect argument packing: %.3f us/frame\n", avg_us);
+    }
+#endif
+    render_ctx.indirect_buffer->Unmap(0, nullptr);
+    render_ctx.indirect_buffer->Release();
+    render_ctx.draw_cmd_signature->Release();
+    bundle_cache_destroy(&render_ctx.bundle_cache);
 
     texture_upload_heap->Release();
     
@@ -1039,27 +2560,94 @@ WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, INT) {
     render_ctx.constant_buffer->Release();
     render_ctx.texture->Release();
     render_ctx.vertex_buffer->Release();
+    if (render_ctx.scene_pso)
+        render_ctx.scene_pso->Release();
+    if (render_ctx.scene_root_signature)
+        render_ctx.scene_root_signature->Release();
+    if (render_ctx.depth_buffer)
+        render_ctx.depth_buffer->Release();
+    if (render_ctx.dsv_heap)
+        render_ctx.dsv_heap->Release();
+    release_scene_buffers(&render_ctx);
+    if (render_ctx.scene_culled_frames > 0) {
+        LARGE_INTEGER qpc_freq = {};
+        QueryPerformanceFrequency(&qpc_freq);
+        double avg_us = 1e6 * (double)render_ctx.scene_cull_ticks / (double)qpc_freq.QuadPart / (double)render_ctx.scene_culled_frames;
+        ::printf(
+            "Scene culling: %.3f us/frame, %.1f of %u nodes drawn per frame, LOD level %.2f on average\n",
+            avg_us, (double)render_ctx.scene_nodes_drawn / (double)render_ctx.scene_culled_frames, render_ctx.scene_cull.count,
+            render_ctx.scene_nodes_drawn ? (double)render_ctx.scene_lod_levels / (double)render_ctx.scene_nodes_drawn : 0.0
+        );
+    }
+    ::free(render_ctx.scene_visible);
+    ::free(render_ctx.scene_cull_nodes);
+    cull_set_destroy(&render_ctx.scene_cull);
+    if (render_ctx.scene_file.base) {
+        close_scene_container(&render_ctx);     // the scene structs were views into it
+    } else {
+        index_batch_destroy(&render_ctx.scene_batch);
+        ::free(render_ctx.scene_mesh_draws);
+        meshlet_set_destroy(&render_ctx.meshlets);
+        mesh_lod_set_destroy(&render_ctx.lods);
+        packed_scene_destroy(&render_ctx.packed_scene);
+        collada_scene_destroy(&render_ctx.scene);
+    }
 
     render_ctx.direct_cmd_list->Release();
+    shader_hot_reload_shutdown(&render_ctx);
     render_ctx.pso->Release();
-
-    pixel_shader->Release();
-    vertex_shader->Release();
+    release_retired_psos(&render_ctx, UINT64_MAX);
+    pso_cache_print_stats(&render_ctx.pso_cache);
+    pso_cache_destroy(&render_ctx.pso_cache);
+
+    render_ctx.vertex_shader->Release();
+    shader_permutation_save_usage(&render_ctx.ps_permutations, PS_USAGE_PATH);
+    shader_permutation_print_stats(&render_ctx.ps_permutations);
+    shader_permutation_set_destroy(&render_ctx.ps_permutations, &render_ctx.shader_builds);
+    shader_build_print_stats(&render_ctx.shader_builds);
+    shader_build_service_destroy(&render_ctx.shader_builds);
+    shader_cache_print_stats(&render_ctx.shader_cache);
+    shader_archive_print_stats(&render_ctx.shader_archive);
+    shader_archive_destroy(&render_ctx.shader_archive);
 
     render_ctx.root_signature->Release();
     if (signature_error_blob)
         signature_error_blob->Release();
     signature->Release();
 
-    render_ctx.bundle_allocator->Release();
+    command_allocator_pool_print_stats(&render_ctx.allocator_pool);
+    command_allocator_pool_destroy(&render_ctx.allocator_pool);
 
     for (unsigned i = 0; i < FRAME_COUNT; ++i) {
         render_ctx.render_targets[i]->Release();
-        render_ctx.cmd_allocator[i]->Release();
     }
 
-    render_ctx.srv_cbv_heap->Release();
-    render_ctx.rtv_heap->Release();
+#if USE_BINDLESS > 0
+    // -- the gpu is idle (wait_for_gpu above), so the slots can go back right away
+    bindless_index_release(&render_ctx.bindless_indices, render_ctx.texture_bindless_index, 0);
+    bindless_index_release(&render_ctx.bindless_indices, render_ctx.constants_bindless_index, 0);
+    bindless_index_print_stats(&render_ctx.bindless_indices);
+    bindless_index_allocator_destroy(&render_ctx.bindless_indices);
+    descriptor_free(&render_ctx.srv_cbv_allocator, &render_ctx.bindless_range);
+#else
+    view_cache_release(&render_ctx.view_cache, &render_ctx.srv_descriptor, 0);
+    view_cache_release(&render_ctx.view_cache, &render_ctx.cbv_descriptor, 0);
+#endif
+    view_cache_print_stats(&render_ctx.view_cache);
+    view_cache_destroy(&render_ctx.view_cache);
+#if TABLES_FROM_DESCRIPTOR_RING
+    descriptor_ring_print_stats(&render_ctx.descriptor_ring);
+    descriptor_free(&render_ctx.srv_cbv_allocator, &render_ctx.ring_range);
+    descriptor_allocator_print_stats(&render_ctx.staging_allocator);
+    descriptor_allocator_destroy(&render_ctx.staging_allocator);
+#endif
+    descriptor_free(&render_ctx.rtv_allocator, &render_ctx.rtv_descriptors);
+    descriptor_allocator_print_stats(&render_ctx.rtv_allocator);
+    descriptor_allocator_print_stats(&render_ctx.srv_cbv_allocator);
+    descriptor_allocator_destroy(&render_ctx.srv_cbv_allocator);
+    descriptor_allocator_destroy(&render_ctx.rtv_allocator);
+    render_ctx.srv_cbv_heap = nullptr;
+    render_ctx.rtv_heap = nullptr;
 
     render_ctx.swapchain3->Release();
     render_ctx.swapchain->Release();
@@ -0,0 +1,475 @@
+#pragma once
+
+// NOTE(omid): Frustum culling over structure-of-arrays bounds, eight objects per
+// iteration with AVX2 (scalar reference path otherwise; picked at runtime).
+//
+// A CullSet holds one bounding sphere and one AABB (center + half extents) per
+// object, each component in its own 32-byte aligned array. Both are usually
+// built from scene node world matrices (cull_set_add_scene). An object is kept
+// when it is not entirely behind any of the six planes:
+//   sphere     dot(n, c) + w >= -r
+//   aabb       dot(n, c) + w >= -dot(|n|, e)
+// The surviving indices are written compacted, in order: the lane mask of each
+// group of eight picks a permutation from a 256-entry table, the permuted indices
+// are stored with one unaligned store, and the cursor moves by the mask's
+// popcount. Large sets are split over threads; each writes its own region (with
+// room for the last store's spill) and the regions are moved together at the end.
+//
+// Both paths evaluate the same expressions in the same order (no FMA), so their
+// visible lists are identical.
+
+#include "collada_loader.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <immintrin.h>
+#include <thread>
+#include <chrono>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CULL_AVX2
+#else
+#define CULL_AVX2                   __attribute__((target("avx2")))
+#endif
+
+#define CULL_LANES                  8
+#define CULL_MAX_THREADS            8
+#define CULL_MIN_PER_THREAD         (16 * 1024)     // objects; smaller sets stay on fewer threads
+#define CULL_BENCHMARK_OBJECTS      (1024 * 1024)
+
+enum CullShape : uint32_t {
+    CullShape_Sphere = 0,
+    CullShape_Aabb,
+};
+
+// -- planes point inwards; normalized, so sphere radii compare directly
+struct CullFrustum {
+    float                           planes [6][4];  // nx, ny, nz, w
+};
+struct CullSet {
+    float *                         center_x;
+    float *                         center_y;
+    float *                         center_z;
+    float *                         radius;
+    float *                         extent_x;
+    float *                         extent_y;
+    float *                         extent_z;
+    uint32_t                        count;
+    uint32_t                        capacity;       // multiple of CULL_LANES
+    void *                          memory;
+};
+
+// NOTE(omid): Gribb / Hartmann plane extraction. m is row-major for column
+// vectors (clip = m * p, like ColladaNode::world), D3D depth range 0 <= z <= w.
+static void
+cull_frustum_from_matrix (float const * m, CullFrustum * frustum) {
+    float const * r0 = m;
+    float const * r1 = m + 4;
+    float const * r2 = m + 8;
+    float const * r3 = m + 12;
+    for (uint32_t c = 0; c < 4; ++c) {
+        frustum->planes[0][c] = r3[c] + r0[c];      // left
+        frustum->planes[1][c] = r3[c] - r0[c];      // right
+        frustum->planes[2][c] = r3[c] + r1[c];      // bottom
+        frustum->planes[3][c] = r3[c] - r1[c];      // top
+        frustum->planes[4][c] = r2[c];              // near
+        frustum->planes[5][c] = r3[c] - r2[c];      // far
+    }
+    for (uint32_t p = 0; p < 6; ++p) {
+        float * plane = frustum->planes[p];
+        float length = ::sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.0f) {
+            for (uint32_t c = 0; c < 4; ++c)
+                plane[c] /= length;
+        }
+    }
+}
+// -- left-handed look-at * perspective (fov_y in radians), row-major for column vectors
+static void
+cull_view_projection (float const * eye, float const * target, float fov_y, float aspect, float z_near, float z_far, float * out) {
+    float f [3] = {target[0] - eye[0], target[1] - eye[1], target[2] - eye[2]};
+    float fl = ::sqrtf(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+    for (uint32_t c = 0; c < 3; ++c)
+        f[c] /= fl;
+    float up [3] = {0.0f, 1.0f, 0.0f};
+    if (::fabsf(f[1]) > 0.999f) {
+        up[1] = 0.0f;
+        up[2] = 1.0f;
+    }
+    float s [3] = {up[1] * f[2] - up[2] * f[1], up[2] * f[0] - up[0] * f[2], up[0] * f[1] - up[1] * f[0]};
+    float sl = ::sqrtf(s[0] * s[0] + s[1] * s[1] + s[2] * s[2]);
+    for (uint32_t c = 0; c < 3; ++c)
+        s[c] /= sl;
+    float u [3] = {f[1] * s[2] - f[2] * s[1], f[2] * s[0] - f[0] * s[2], f[0] * s[1] - f[1] * s[0]};
+    float view [16] = {
+        s[0], s[1], s[2], -(s[0] * eye[0] + s[1] * eye[1] + s[2] * eye[2]),
+        u[0], u[1], u[2], -(u[0] * eye[0] + u[1] * eye[1] + u[2] * eye[2]),
+        f[0], f[1], f[2], -(f[0] * eye[0] + f[1] * eye[1] + f[2] * eye[2]),
+        0.0f, 0.0f, 0.0f, 1.0f,
+    };
+    float y_scale = 1.0f / ::tanf(0.5f * fov_y);
+    float x_scale = y_scale / aspect;
+    float z_scale = z_far / (z_far - z_near);
+    float projection [16] = {
+        x_scale, 0.0f, 0.0f, 0.0f,
+        0.0f, y_scale, 0.0f, 0.0f,
+        0.0f, 0.0f, z_scale, -z_near * z_scale,
+        0.0f, 0.0f, 1.0f, 0.0f,
+    };
+    collada_matrix_multiply(projection, view, out);
+}
+
+static void
+cull_set_destroy (CullSet * set) {
+    ::free(set->memory);
+    ::memset(set, 0, sizeof(*set));
+}
+// -- room for capacity objects (rounded up to CULL_LANES); existing objects are kept
+static bool
+cull_set_reserve (CullSet * set, uint32_t capacity) {
+    capacity = (capacity + CULL_LANES - 1) & ~(uint32_t)(CULL_LANES - 1);
+    if (capacity <= set->capacity)
+        return true;
+    void * memory = ::malloc((size_t)capacity * 7 * sizeof(float) + 32);
+    if (!memory)
+        return false;
+    float * base = reinterpret_cast<float *>(((uintptr_t)memory + 31) & ~(uintptr_t)31);
+    float ** arrays [7] = {&set->center_x, &set->center_y, &set->center_z, &set->radius, &set->extent_x, &set->extent_y, &set->extent_z};
+    for (uint32_t a = 0; a < 7; ++a) {
+        float * array = base + (size_t)a * capacity;
+        // -- padding lanes are read (never reported), keep them defined
+        ::memset(array, 0, (size_t)capacity * sizeof(float));
+        if (set->count)
+            ::memcpy(array, *arrays[a], (size_t)set->count * sizeof(float));
+        *arrays[a] = array;
+    }
+    ::free(set->memory);
+    set->memory = memory;
+    set->capacity = capacity;
+    return true;
+}
+static bool
+cull_set_add (CullSet * set, float const * center, float radius, float const * extent) {
+    if (set->count == set->capacity && !cull_set_reserve(set, set->capacity ? set->capacity * 2 : 64))
+        return false;
+    uint32_t i = set->count++;
+    set->center_x[i] = center[0];
+    set->center_y[i] = center[1];
+    set->center_z[i] = center[2];
+    set->radius[i] = radius;
+    set->extent_x[i] = extent[0];
+    set->extent_y[i] = extent[1];
+    set->extent_z[i] = extent[2];
+    return true;
+}
+// NOTE(omid): One object per scene node that instances a mesh: the mesh bounds
+// moved by the node's world matrix (Arvo's method for the box; the sphere scales
+// by the largest axis). out_nodes (node_count entries, may be null) gets the node
+// index of each object added.
+static uint32_t
+cull_set_add_scene (CullSet * set, ColladaScene const * scene, uint32_t * out_nodes) {
+    uint32_t added = 0;
+    for (uint32_t n = 0; n < scene->node_count; ++n) {
+        ColladaNode const * node = &scene->nodes[n];
+        if (COLLADA_NONE == node->mesh)
+            continue;
+        ColladaMesh const * mesh = &scene->meshes[node->mesh];
+        float const * m = node->world;
+        float local_center [3], local_extent [3];
+        for (uint32_t c = 0; c < 3; ++c) {
+            local_center[c] = 0.5f * (mesh->bounds_min[c] + mesh->bounds_max[c]);
+            local_extent[c] = 0.5f * (mesh->bounds_max[c] - mesh->bounds_min[c]);
+        }
+        float center [3], extent [3];
+        float max_scale = 0.0f;
+        for (uint32_t r = 0; r < 3; ++r) {
+            center[r] = m[r * 4 + 3];
+            extent[r] = 0.0f;
+            for (uint32_t c = 0; c < 3; ++c) {
+                center[r] += m[r * 4 + c] * local_center[c];
+                extent[r] += ::fabsf(m[r * 4 + c]) * local_extent[c];
+            }
+            float column = ::sqrtf(m[r] * m[r] + m[4 + r] * m[4 + r] + m[8 + r] * m[8 + r]);
+            max_scale = column > max_scale ? column : max_scale;
+        }
+        float radius = max_scale * ::sqrtf(local_extent[0] * local_extent[0] + local_extent[1] * local_extent[1] + local_extent[2] * local_extent[2]);
+        if (!cull_set_add(set, center, radius, extent))
+            break;
+        if (out_nodes)
+            out_nodes[added] = n;
+        ++added;
+    }
+    return added;
+}
+// -- visible index buffers must hold this many entries (per-thread spill room)
+static uint32_t
+cull_visible_capacity (uint32_t count) {
+    return count + (CULL_MAX_THREADS + 1) * CULL_LANES;
+}
+
+// =========================================================================================================
+// -- scalar reference
+
+static uint32_t
+cull_range_scalar (CullSet const * set, CullFrustum const * frustum, CullShape shape, uint32_t begin, uint32_t end, uint32_t * out) {
+    uint32_t written = 0;
+    for (uint32_t i = begin; i < end; ++i) {
+        bool visible = true;
+        for (uint32_t p = 0; p < 6 && visible; ++p) {
+            float const * plane = frustum->planes[p];
+            float d = plane[0] * set->center_x[i] + plane[1] * set->center_y[i] + plane[2] * set->center_z[i] + plane[3];
+            float reach = CullShape_Sphere == shape ?
+                set->radius[i] :
+                ::fabsf(plane[0]) * set->extent_x[i] + ::fabsf(plane[1]) * set->extent_y[i] + ::fabsf(plane[2]) * set->extent_z[i];
+            visible = d >= -reach;
+        }
+        out[written] = i;
+        written += visible ? 1 : 0;
+    }
+    return written;
+}
+
+// =========================================================================================================
+// -- AVX2
+
+// -- per lane mask: the set lanes' indices packed as 4-bit nibbles, and how many there are
+struct CullCompactTable {
+    uint32_t                        nibbles [256];
+    uint8_t                         counts [256];
+};
+static CullCompactTable const *
+cull_compact_table () {
+    static CullCompactTable table = [] {
+        CullCompactTable t = {};
+        for (uint32_t mask = 0; mask < 256; ++mask) {
+            uint32_t n = 0;
+            for (uint32_t lane = 0; lane < CULL_LANES; ++lane) {
+                if (mask & (1u << lane))
+                    t.nibbles[mask] |= lane << (4 * n++);
+            }
+            t.counts[mask] = (uint8_t)n;
+        }
+        return t;
+    }();
+    return &table;
+}
+static bool
+cull_has_avx2 () {
+    static int const supported = [] {
+#if defined(_MSC_VER)
+        int info [4] = {};
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return 0;
+        __cpuid(info, 1);
+        bool osxsave_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28));
+        if (!osxsave_avx || 6 != (_xgetbv(0) & 6))
+            return 0;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) ? 1 : 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? 1 : 0;
+#endif
+    }();
+    return 0 != supported;
+}
+// -- begin must be a multiple of CULL_LANES; out needs CULL_LANES entries of spill room
+CULL_AVX2 static uint32_t
+cull_range_avx2 (CullSet const * set, CullFrustum const * frustum, CullShape shape, uint32_t begin, uint32_t end, uint32_t * out) {
+    CullCompactTable const * table = cull_compact_table();
+    __m256 nx [6], ny [6], nz [6], nw [6], ax [6], ay [6], az [6];
+    __m256 const sign = _mm256_set1_ps(-0.0f);
+    for (uint32_t p = 0; p < 6; ++p) {
+        nx[p] = _mm256_set1_ps(frustum->planes[p][0]);
+        ny[p] = _mm256_set1_ps(frustum->planes[p][1]);
+        nz[p] = _mm256_set1_ps(frustum->planes[p][2]);
+        nw[p] = _mm256_set1_ps(frustum->planes[p][3]);
+        ax[p] = _mm256_andnot_ps(sign, nx[p]);
+        ay[p] = _mm256_andnot_ps(sign, ny[p]);
+        az[p] = _mm256_andnot_ps(sign, nz[p]);
+    }
+    __m256i const lane_index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i const nibble_shift = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+    __m256i const nibble_mask = _mm256_set1_epi32(0xf);
+    uint32_t written = 0;
+    for (uint32_t base = begin; base < end; base += CULL_LANES) {
+        __m256 cx = _mm256_load_ps(set->center_x + base);
+        __m256 cy = _mm256_load_ps(set->center_y + base);
+        __m256 cz = _mm256_load_ps(set->center_z + base);
+        __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        if (CullShape_Sphere == shape) {
+            __m256 reach = _mm256_xor_ps(_mm256_load_ps(set->radius + base), sign);
+            for (uint32_t p = 0; p < 6; ++p) {
+                __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[p], cx), _mm256_mul_ps(ny[p], cy)), _mm256_mul_ps(nz[p], cz)), nw[p]);
+                visible = _mm256_and_ps(visible, _mm256_cmp_ps(d, reach, _CMP_GE_OQ));
+            }
+        } else {
+            __m256 ex = _mm256_load_ps(set->extent_x + base);
+            __m256 ey = _mm256_load_ps(set->extent_y + base);
+            __m256 ez = _mm256_load_ps(set->extent_z + base);
+            for (uint32_t p = 0; p < 6; ++p) {
+                __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[p], cx), _mm256_mul_ps(ny[p], cy)), _mm256_mul_ps(nz[p], cz)), nw[p]);
+                __m256 reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax[p], ex), _mm256_mul_ps(ay[p], ey)), _mm256_mul_ps(az[p], ez));
+                visible = _mm256_and_ps(visible, _mm256_cmp_ps(d, _mm256_xor_ps(reach, sign), _CMP_GE_OQ));
+            }
+        }
+        uint32_t mask = (uint32_t)_mm256_movemask_ps(visible);
+        if (end - base < CULL_LANES)
+            mask &= (1u << (end - base)) - 1;      // lanes past the end
+        __m256i permutation = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32((int)table->nibbles[mask]), nibble_shift), nibble_mask);
+        __m256i indices = _mm256_add_epi32(_mm256_set1_epi32((int)base), lane_index);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + written), _mm256_permutevar8x32_epi32(indices, permutation));
+        written += table->counts[mask];
+    }
+    return written;
+}
+
+// =========================================================================================================
+// -- threads
+
+struct CullJob {
+    CullSet const *                 set;
+    CullFrustum const *             frustum;
+    CullShape                       shape;
+    bool                            avx2;
+    uint32_t                        begin;
+    uint32_t                        end;
+    uint32_t *                      out;
+    uint32_t                        written;
+};
+static void
+cull_job_run (CullJob * job) {
+    job->written = job->avx2 ?
+        cull_range_avx2(job->set, job->frustum, job->shape, job->begin, job->end, job->out) :
+        cull_range_scalar(job->set, job->frustum, job->shape, job->begin, job->end, job->out);
+}
+// NOTE(omid): Writes the indices of the visible objects to visible (at least
+// cull_visible_capacity(set->count) entries), in ascending order; returns how
+// many. thread_count 0: one per core; use_avx2 false forces the scalar path.
+static uint32_t
+cull_set_frustum (CullSet const * set, CullFrustum const * frustum, CullShape shape, uint32_t * visible, uint32_t thread_count, bool use_avx2) {
+    if (0 == set->count)
+        return 0;
+    if (0 == thread_count)
+        thread_count = std::thread::hardware_concurrency();
+    uint32_t useful = (set->count + CULL_MIN_PER_THREAD - 1) / CULL_MIN_PER_THREAD;
+    thread_count = thread_count < useful ? thread_count : useful;
+    thread_count = thread_count < 1 ? 1 : (thread_count > CULL_MAX_THREADS ? CULL_MAX_THREADS : thread_count);
+
+    CullJob jobs [CULL_MAX_THREADS] = {};
+    uint32_t groups = (set->count + CULL_LANES - 1) / CULL_LANES;
+    uint32_t groups_per_job = (groups + thread_count - 1) / thread_count;
+    for (uint32_t t = 0; t < thread_count; ++t) {
+        CullJob * job = &jobs[t];
+        job->set = set;
+        job->frustum = frustum;
+        job->shape = shape;
+        job->avx2 = use_avx2 && cull_has_avx2();
+        job->begin = t * groups_per_job * CULL_LANES;
+        job->end = (t + 1) * groups_per_job * CULL_LANES;
+        job->begin = job->begin < set->count ? job->begin : set->count;
+        job->end = job->end < set->count ? job->end : set->count;
+        job->out = visible + job->begin + t * CULL_LANES;     // spill room between regions
+    }
+    std::thread workers [CULL_MAX_THREADS];
+    for (uint32_t t = 1; t < thread_count; ++t)
+        workers[t] = std::thread(cull_job_run, &jobs[t]);
+    cull_job_run(&jobs[0]);
+    for (uint32_t t = 1; t < thread_count; ++t)
+        workers[t].join();
+
+    uint32_t written = jobs[0].written;
+    for (uint32_t t = 1; t < thread_count; ++t) {
+        ::memmove(visible + written, jobs[t].out, jobs[t].written * sizeof(uint32_t));
+        written += jobs[t].written;
+    }
+    return written;
+}
+
+// NOTE(omid): object_count instances of the scene's node bounds (unit spheres if it
+// has none) scattered through a 2 km cube, culled against a camera in its middle:
+// scalar vs AVX2 on one thread vs AVX2 on every core, spheres and boxes. Checks
+// that all paths agree.
+static void
+cull_benchmark (ColladaScene const * scene, uint32_t object_count) {
+    CullSet templates = {};
+    if (0 == cull_set_add_scene(&templates, scene, nullptr)) {
+        float zero [3] = {}, half [3] = {0.5f, 0.5f, 0.5f};
+        cull_set_add(&templates, zero, 1.0f, half);
+    }
+    CullSet set = {};
+    uint32_t * visible [2] = {
+        reinterpret_cast<uint32_t *>(::malloc(cull_visible_capacity(object_count) * sizeof(uint32_t))),
+        reinterpret_cast<uint32_t *>(::malloc(cull_visible_capacity(object_count) * sizeof(uint32_t))),
+    };
+    if (!visible[0] || !visible[1] || !cull_set_reserve(&set, object_count)) {
+        ::free(visible[0]);
+        ::free(visible[1]);
+        cull_set_destroy(&templates);
+        return;
+    }
+    uint32_t random = 0x9e3779b9u;
+    for (uint32_t i = 0; i < object_count; ++i) {
+        uint32_t t = i % templates.count;
+        float center [3];
+        float const template_center [3] = {templates.center_x[t], templates.center_y[t], templates.center_z[t]};
+        for (uint32_t c = 0; c < 3; ++c) {
+            random ^= random << 13;
+            random ^= random >> 17;
+            random ^= random << 5;
+            center[c] = template_center[c] + ((float)(random >> 8) / 16777216.0f - 0.5f) * 2000.0f;
+        }
+        float extent [3] = {templates.extent_x[t], templates.extent_y[t], templates.extent_z[t]};
+        cull_set_add(&set, center, templates.radius[t], extent);
+    }
+    float eye [3] = {0.0f, 0.0f, 0.0f}, target [3] = {0.3f, 0.1f, 1.0f};
+    float view_projection [16];
+    cull_view_projection(eye, target, 1.0471976f, 16.0f / 9.0f, 0.1f, 1000.0f, view_projection);
+    CullFrustum frustum;
+    cull_frustum_from_matrix(view_projection, &frustum);
+
+    uint32_t threads = std::thread::hardware_concurrency();
+    threads = threads < 1 ? 1 : (threads > CULL_MAX_THREADS ? CULL_MAX_THREADS : threads);
+    bool avx2 = cull_has_avx2();
+    for (uint32_t shape = CullShape_Sphere; shape <= CullShape_Aabb; ++shape) {
+        double ms [3] = {};
+        uint32_t counts [3] = {};
+        bool agree = true;
+        for (uint32_t run = 0; run < 3; ++run) {
+            uint32_t run_threads = 2 == run ? threads : 1;
+            bool run_avx2 = 0 != run;
+            if (run_avx2 && !avx2)
+                continue;
+            double best = 1e30;
+            for (uint32_t repeat = 0; repeat < 5; ++repeat) {
+                auto begin = std::chrono::steady_clock::now();
+                counts[run] = cull_set_frustum(&set, &frustum, (CullShape)shape, visible[run ? 1 : 0], run_threads, run_avx2);
+                double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+                best = elapsed < best ? elapsed : best;
+            }
+            ms[run] = best;
+            if (run)
+                agree = agree && counts[run] == counts[0] && 0 == ::memcmp(visible[0], visible[1], counts[0] * sizeof(uint32_t));
+        }
+        ::printf(
+            "Frustum cull %u %s: %u visible (%.1f%%); scalar %.2f ms (%.2f ns/object)",
+            object_count, CullShape_Sphere == shape ? "spheres" : "aabbs", counts[0], 100.0 * counts[0] / object_count, ms[0], 1e6 * ms[0] / object_count
+        );
+        if (avx2) {
+            ::printf(
+                ", avx2 %.2f ms (%.2f ns/object), avx2 on %u threads %.2f ms; %s\n",
+                ms[1], 1e6 * ms[1] / object_count, threads, ms[2], agree ? "identical" : "MISMATCH"
+            );
+        } else {
+            ::printf(", no avx2 on this cpu\n");
+        }
+    }
+    ::free(visible[0]);
+    ::free(visible[1]);
+    cull_set_destroy(&set);
+    cull_set_destroy(&templates);
+}
@@ -0,0 +1,332 @@
+#pragma once
+
+// NOTE(omid): Indexed geometry batches: many meshes of one vertex format share a
+// single vertex buffer and index buffer, and each is drawn with
+// DrawIndexedInstanced(index_count, instances, first_index, base_vertex, 0).
+//
+// Adding a mesh welds its vertices first (byte-identical vertices become one;
+// non-indexed input gets its index list from this), and then picks the index
+// format from the welded vertex count. Vertices welded earlier (index_weld_scene
+// at import) and kept in a stream of their own go in with index_batch_add_lists,
+// which only appends the index lists. Indices are relative to the mesh's base
+// vertex, so R16 holds any mesh of up to 64K vertices however large the shared
+// vertex buffer grows. The batch keeps two index streams (R16, R32) in the same
+// buffer; draws switch between them only when the format changes.
+//
+// Several index lists can share one mesh's vertices (its LOD levels): each list
+// is a draw of its own with the same base vertex.
+//
+// Like the other D3D12 helpers, this expects d3d12.h to be included first.
+
+#include "collada_loader.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INDEX_R16_MAX_VERTICES      65536
+#define INDEX_BUFFER_ALIGNMENT      256
+
+struct IndexedDraw {
+    uint32_t                        index_count;
+    uint32_t                        first_index;    // into the R16 or R32 stream, whichever format says
+    int32_t                         base_vertex;
+    uint32_t                        vertex_count;   // welded
+    DXGI_FORMAT                     format;         // DXGI_FORMAT_R16_UINT / DXGI_FORMAT_R32_UINT
+};
+struct IndexBatchStats {
+    uint64_t                        vertices_in;
+    uint64_t                        vertices_welded;    // removed as duplicates
+    uint32_t                        r16_draws;
+    uint32_t                        r32_draws;
+};
+struct IndexBatch {
+    uint8_t *                       vertices;
+    uint32_t                        vertex_count;
+    uint32_t                        vertex_capacity;    // in bytes
+    uint32_t                        vertex_stride;
+    uint16_t *                      indices16;
+    uint32_t                        index16_count;
+    uint32_t                        index16_capacity;
+    uint32_t *                      indices32;
+    uint32_t                        index32_count;
+    uint32_t                        index32_capacity;
+    IndexedDraw *                   draws;
+    uint32_t                        draw_count;
+    uint32_t                        draw_capacity;
+    IndexBatchStats                 stats;
+};
+struct IndexBatchGpu {
+    D3D12_VERTEX_BUFFER_VIEW        vb_view;
+    D3D12_INDEX_BUFFER_VIEW         ib16_view;
+    D3D12_INDEX_BUFFER_VIEW         ib32_view;
+    DXGI_FORMAT                     bound_format;       // index buffer last set by index_batch_draw
+};
+
+static void
+index_batch_init (IndexBatch * batch, uint32_t vertex_stride) {
+    ::memset(batch, 0, sizeof(*batch));
+    batch->vertex_stride = vertex_stride;
+}
+static void
+index_batch_destroy (IndexBatch * batch) {
+    ::free(batch->vertices);
+    ::free(batch->indices16);
+    ::free(batch->indices32);
+    ::free(batch->draws);
+    ::memset(batch, 0, sizeof(*batch));
+}
+static uint32_t
+index_vertex_hash (uint8_t const * vertex, uint32_t stride) {
+    // -- FNV-1a over 32-bit words (strides are multiples of 4)
+    uint32_t h = 2166136261u;
+    for (uint32_t i = 0; i < stride; i += 4) {
+        uint32_t word;
+        ::memcpy(&word, vertex + i, sizeof(word));
+        h = (h ^ word) * 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+// NOTE(omid): Welds byte-identical vertices. remap[v] gets the new index of vertex
+// v; out_vertices the unique vertices in first-use order. Returns the unique
+// count, or 0 when out of memory.
+static uint32_t
+index_weld (void const * vertices, uint32_t vertex_count, uint32_t stride, uint32_t * remap, void * out_vertices) {
+    uint32_t table_size = 64;
+    while (table_size < vertex_count * 2)
+        table_size *= 2;
+    uint32_t * table = reinterpret_cast<uint32_t *>(::malloc(table_size * sizeof(uint32_t)));
+    if (!table)
+        return 0;
+    ::memset(table, 0xff, table_size * sizeof(uint32_t));
+    uint8_t const * in = reinterpret_cast<uint8_t const *>(vertices);
+    uint8_t * out = reinterpret_cast<uint8_t *>(out_vertices);
+    uint32_t unique = 0;
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        uint8_t const * vertex = in + (size_t)v * stride;
+        uint32_t slot = index_vertex_hash(vertex, stride) & (table_size - 1);
+        for (;;) {
+            uint32_t other = table[slot];
+            if (COLLADA_NONE == other) {
+                table[slot] = unique;
+                ::memcpy(out + (size_t)unique * stride, vertex, stride);
+                remap[v] = unique++;
+                break;
+            }
+            if (0 == ::memcmp(out + (size_t)other * stride, vertex, stride)) {
+                remap[v] = other;
+                break;
+            }
+            slot = (slot + 1) & (table_size - 1);
+        }
+    }
+    ::free(table);
+    return unique;
+}
+// -- appends the draws of list_count index lists over unique vertices at base_vertex;
+// remap (nullptr: identity) maps the lists' indices (< vertex_count) to those vertices
+static bool
+index_batch_push_lists (
+    IndexBatch * batch, uint32_t base_vertex, uint32_t vertex_count, uint32_t unique, uint32_t const * remap,
+    uint32_t const * const * index_lists, uint32_t const * index_counts, uint32_t list_count
+) {
+    if (!COLLADA_RESERVE(batch->draws, batch->draw_capacity, (uint64_t)batch->draw_count + list_count))
+        return false;
+    bool ok = true;
+    bool r16 = unique <= INDEX_R16_MAX_VERTICES;
+    uint32_t first_draw = batch->draw_count;
+    for (uint32_t l = 0; l < list_count && ok; ++l) {
+        uint32_t const * list = index_lists ? index_lists[l] : nullptr;
+        uint32_t count = index_lists ? index_counts[l] : vertex_count;
+        IndexedDraw * draw = &batch->draws[batch->draw_count];
+        draw->index_count = count;
+        draw->base_vertex = (int32_t)base_vertex;
+        draw->vertex_count = unique;
+        draw->format = r16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+        if (r16) {
+            ok = COLLADA_RESERVE(batch->indices16, batch->index16_capacity, (uint64_t)batch->index16_count + count);
+            draw->first_index = batch->index16_count;
+            for (uint32_t i = 0; i < count && ok; ++i) {
+                uint32_t v = list ? list[i] : i;
+                ok = v < vertex_count;
+                batch->indices16[batch->index16_count + i] = ok ? (uint16_t)(remap ? remap[v] : v) : 0;
+            }
+            batch->index16_count += ok ? count : 0;
+        } else {
+            ok = COLLADA_RESERVE(batch->indices32, batch->index32_capacity, (uint64_t)batch->index32_count + count);
+            draw->first_index = batch->index32_count;
+            for (uint32_t i = 0; i < count && ok; ++i) {
+                uint32_t v = list ? list[i] : i;
+                ok = v < vertex_count;
+                batch->indices32[batch->index32_count + i] = ok ? (remap ? remap[v] : v) : 0;
+            }
+            batch->index32_count += ok ? count : 0;
+        }
+        batch->draw_count += ok ? 1 : 0;
+    }
+    if (!ok) {
+        // -- roll the whole mesh back (index streams of earlier lists included)
+        for (uint32_t d = batch->draw_count; d > first_draw; --d) {
+            IndexedDraw const * draw = &batch->draws[d - 1];
+            if (DXGI_FORMAT_R16_UINT == draw->format)
+                batch->index16_count -= draw->index_count;
+            else
+                batch->index32_count -= draw->index_count;
+        }
+        batch->draw_count = first_draw;
+        return false;
+    }
+    if (r16)
+        batch->stats.r16_draws += list_count;
+    else
+        batch->stats.r32_draws += list_count;
+    return true;
+}
+// NOTE(omid): Adds one mesh: vertex_count vertices of the batch's stride, and
+// list_count index lists over them (nullptr index_lists: the vertices are a plain
+// triangle list). Returns the draw id of the first list, the rest follow in order;
+// COLLADA_NONE when out of memory or an index is out of range.
+static uint32_t
+index_batch_add (
+    IndexBatch * batch, void const * vertices, uint32_t vertex_count,
+    uint32_t const * const * index_lists, uint32_t const * index_counts, uint32_t list_count
+) {
+    uint32_t stride = batch->vertex_stride;
+    if (0 == vertex_count || 0 != stride % 4)
+        return COLLADA_NONE;
+    if (!index_lists)
+        list_count = 1;
+    uint64_t vertex_bytes = (uint64_t)(batch->vertex_count + vertex_count) * stride;
+    if (vertex_bytes > 0xffffffffull || !COLLADA_RESERVE(batch->vertices, batch->vertex_capacity, vertex_bytes))
+        return COLLADA_NONE;
+    uint32_t * remap = reinterpret_cast<uint32_t *>(::malloc(vertex_count * sizeof(uint32_t)));
+    if (!remap)
+        return COLLADA_NONE;
+    uint32_t base_vertex = batch->vertex_count;
+    uint32_t first_draw = batch->draw_count;
+    uint32_t unique = index_weld(vertices, vertex_count, stride, remap, batch->vertices + (size_t)base_vertex * stride);
+    bool ok = unique > 0 && index_batch_push_lists(batch, base_vertex, vertex_count, unique, remap, index_lists, index_counts, list_count);
+    ::free(remap);
+    if (!ok)
+        return COLLADA_NONE;
+    batch->vertex_count += unique;
+    batch->stats.vertices_in += vertex_count;
+    batch->stats.vertices_welded += vertex_count - unique;
+    return first_draw;
+}
+// NOTE(omid): Adds index lists over vertex_count vertices that are already welded
+// and sit at base_vertex of a vertex stream the batch doesn't hold (batch->vertices
+// stays untouched; vertex_count only tracks the end of the stream). Returns as
+// index_batch_add.
+static uint32_t
+index_batch_add_lists (
+    IndexBatch * batch, uint32_t base_vertex, uint32_t vertex_count,
+    uint32_t const * const * index_lists, uint32_t const * index_counts, uint32_t list_count
+) {
+    if (0 == vertex_count)
+        return COLLADA_NONE;
+    if (!index_lists)
+        list_count = 1;
+    uint32_t first_draw = batch->draw_count;
+    if (!index_batch_push_lists(batch, base_vertex, vertex_count, vertex_count, nullptr, index_lists, index_counts, list_count))
+        return COLLADA_NONE;
+    uint32_t end = base_vertex + vertex_count;
+    batch->vertex_count = end > batch->vertex_count ? end : batch->vertex_count;
+    batch->stats.vertices_in += vertex_count;
+    return first_draw;
+}
+// NOTE(omid): Welds byte-identical vertices of every mesh of an imported scene, in
+// place: indices are remapped, each mesh's vertices packed down (first-use order)
+// and the vertex array compacted. Meant for right after the import, before the
+// optimizer renumbers for the vertex cache. Returns the number of vertices removed,
+// COLLADA_NONE when out of memory (the scene is unchanged then).
+static uint32_t
+index_weld_scene (ColladaScene * scene) {
+    // -- remap over the whole vertex array plus the welded count of every mesh, so nothing
+    // is touched until every mesh has welded
+    ColladaVertex * welded = reinterpret_cast<ColladaVertex *>(::malloc((size_t)scene->vertex_count * sizeof(ColladaVertex) + sizeof(ColladaVertex)));
+    uint32_t * remap = reinterpret_cast<uint32_t *>(::malloc(((size_t)scene->vertex_count + scene->mesh_count + 1) * sizeof(uint32_t)));
+    bool ok = welded && remap;
+    uint32_t * unique = remap + scene->vertex_count;
+    uint32_t written = 0;
+    for (uint32_t m = 0; m < scene->mesh_count && ok; ++m) {
+        ColladaMesh const * mesh = &scene->meshes[m];
+        unique[m] = 0;
+        if (mesh->vertex_count) {
+            unique[m] = index_weld(
+                scene->vertices + mesh->first_vertex, mesh->vertex_count, sizeof(ColladaVertex), remap + mesh->first_vertex, welded + written
+            );
+            ok = unique[m] > 0;
+        }
+        written += unique[m];
+    }
+    if (!ok) {
+        ::free(welded);
+        ::free(remap);
+        return COLLADA_NONE;
+    }
+    written = 0;
+    for (uint32_t m = 0; m < scene->mesh_count; ++m) {
+        ColladaMesh * mesh = &scene->meshes[m];
+        uint32_t const * mesh_remap = remap + mesh->first_vertex;
+        uint32_t * indices = scene->indices + mesh->first_index;
+        for (uint32_t i = 0; i < mesh->index_count; ++i)
+            indices[i] = indices[i] < mesh->vertex_count ? mesh_remap[indices[i]] : indices[i];
+        mesh->first_vertex = written;
+        mesh->vertex_count = unique[m];
+        written += unique[m];
+    }
+    uint32_t removed = scene->vertex_count - written;
+    ::free(remap);
+    ::free(scene->vertices);
+    scene->vertices = welded;
+    scene->vertex_capacity = scene->vertex_count + 1;   // what welded was allocated for
+    scene->vertex_count = written;
+    return removed;
+}
+static void
+index_batch_print_stats (IndexBatch const * batch, char const * name) {
+    uint64_t index_bytes = (uint64_t)batch->index16_count * 2 + (uint64_t)batch->index32_count * 4;
+    uint64_t r32_bytes = ((uint64_t)batch->index16_count + batch->index32_count) * 4;
+    ::printf(
+        "Index batch %s: %u draws (R16 %u / R32 %u), %llu -> %u vertices welded, %u indices, %.1f KiB of indices (%.1f KiB as R32 only)\n",
+        name, batch->draw_count, batch->stats.r16_draws, batch->stats.r32_draws,
+        (unsigned long long)batch->stats.vertices_in, batch->vertex_count,
+        batch->index16_count + batch->index32_count, index_bytes / 1024.0, r32_bytes / 1024.0
+    );
+}
+
+// NOTE(omid): Views over the batch's streams in a buffer the caller owns (one
+// default heap buffer, usually, with each stream INDEX_BUFFER_ALIGNMENT aligned).
+static void
+index_batch_set_views (
+    IndexBatchGpu * gpu, IndexBatch const * batch,
+    D3D12_GPU_VIRTUAL_ADDRESS vertices, D3D12_GPU_VIRTUAL_ADDRESS indices16, D3D12_GPU_VIRTUAL_ADDRESS indices32
+) {
+    gpu->vb_view.BufferLocation = vertices;
+    gpu->vb_view.StrideInBytes = batch->vertex_stride;
+    gpu->vb_view.SizeInBytes = batch->vertex_count * batch->vertex_stride;
+    gpu->ib16_view.BufferLocation = indices16;
+    gpu->ib16_view.SizeInBytes = batch->index16_count * (UINT)sizeof(uint16_t);
+    gpu->ib16_view.Format = DXGI_FORMAT_R16_UINT;
+    gpu->ib32_view.BufferLocation = indices32;
+    gpu->ib32_view.SizeInBytes = batch->index32_count * (UINT)sizeof(uint32_t);
+    gpu->ib32_view.Format = DXGI_FORMAT_R32_UINT;
+    gpu->bound_format = DXGI_FORMAT_UNKNOWN;
+}
+// -- binds the batch's vertex buffer; call once per command list before index_batch_draw
+static void
+index_batch_bind (ID3D12GraphicsCommandList * cmd_list, IndexBatchGpu * gpu) {
+    cmd_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    cmd_list->IASetVertexBuffers(0, 1, &gpu->vb_view);
+    gpu->bound_format = DXGI_FORMAT_UNKNOWN;
+}
+static void
+index_batch_draw (ID3D12GraphicsCommandList * cmd_list, IndexBatchGpu * gpu, IndexBatch const * batch, uint32_t draw_id, uint32_t instance_count, uint32_t start_instance) {
+    IndexedDraw const * draw = &batch->draws[draw_id];
+    if (draw->format != gpu->bound_format) {
+        cmd_list->IASetIndexBuffer(DXGI_FORMAT_R16_UINT == draw->format ? &gpu->ib16_view : &gpu->ib32_view);
+        gpu->bound_format = draw->format;
+    }
+    cmd_list->DrawIndexedInstanced(draw->index_count, instance_count, draw->first_index, draw->base_vertex, start_instance);
+}
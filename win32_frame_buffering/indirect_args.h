@@ -0,0 +1,256 @@
+#pragma once
+
+// NOTE(omid): Builds ExecuteIndirect argument buffers from a compact CPU draw list.
+// A command is described by an IndirectLayout (a list of arguments in the order
+// the command signature declares them); the layout is checked against the
+// command signature rules before it is turned into D3D12_INDIRECT_ARGUMENT_DESCs:
+//   - exactly one draw argument, and it must be the last one
+//   - at most one vertex buffer view per slot, at most one index buffer view
+//   - arguments are tightly packed in declaration order, each 4-byte aligned
+//   - gpu virtual addresses (vertex/index buffer views) must be 8-byte aligned
+//   - root constants must fit in the root parameter they write to and must not overlap
+//   - if any argument changes root arguments, a root signature is required
+//   - ByteStride must be a multiple of 4 and at least the packed argument size
+// The packing path copies 16-byte blocks with SSE2; a scalar path is kept for
+// reference and benchmarking. This header only depends on the C runtime + SSE2.
+
+#include "common_macros.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <emmintrin.h>
+
+#define INDIRECT_MAX_ARGUMENTS          8
+#define INDIRECT_ROOT_CONSTANT_COUNT    4           // root constants per draw (one 16-byte block)
+#define INDIRECT_MAX_VERTEX_BUFFERS     256
+
+enum IndirectArgumentKind : uint32_t {
+    IndirectArgument_Draw = 0,
+    IndirectArgument_DrawIndexed,
+    IndirectArgument_VertexBufferView,
+    IndirectArgument_IndexBufferView,
+    IndirectArgument_Constant,
+    IndirectArgument_ConstantBufferView,
+};
+struct IndirectArgument {
+    IndirectArgumentKind            kind;
+    uint32_t                        slot;                   // vertex buffer slot
+    uint32_t                        root_parameter_index;   // constants / cbv
+    uint32_t                        dest_offset;            // constants, in 32-bit values
+    uint32_t                        value_count;            // constants, in 32-bit values
+    uint32_t                        root_parameter_size;    // constants: 32-bit values declared in the root signature
+};
+struct IndirectLayout {
+    IndirectArgument                arguments [INDIRECT_MAX_ARGUMENTS];
+    uint32_t                        argument_count;
+    uint32_t                        offsets [INDIRECT_MAX_ARGUMENTS];   // filled by indirect_layout_validate
+    uint32_t                        byte_stride;
+    bool                            needs_root_signature;
+};
+
+// -- sizes match D3D12_DRAW_ARGUMENTS, D3D12_DRAW_INDEXED_ARGUMENTS, D3D12_VERTEX_BUFFER_VIEW, D3D12_INDEX_BUFFER_VIEW
+static uint32_t
+indirect_argument_size (IndirectArgument const * arg) {
+    switch (arg->kind) {
+        case IndirectArgument_Draw:                 return 16;
+        case IndirectArgument_DrawIndexed:          return 20;
+        case IndirectArgument_VertexBufferView:     return 16;
+        case IndirectArgument_IndexBufferView:      return 16;
+        case IndirectArgument_Constant:             return 4 * arg->value_count;
+        case IndirectArgument_ConstantBufferView:   return 8;
+        default:                                    return 0;
+    }
+}
+// NOTE(omid): Returns nullptr if the layout is valid (and fills offsets, byte_stride
+// and needs_root_signature), otherwise a description of the first broken rule.
+// A byte_stride of 0 means "packed size".
+static char const *
+indirect_layout_validate (IndirectLayout * layout, uint32_t byte_stride) {
+    if (0 == layout->argument_count || layout->argument_count > INDIRECT_MAX_ARGUMENTS)
+        return "argument count out of range";
+
+    uint32_t offset = 0;
+    uint32_t vb_slots_used [INDIRECT_MAX_ARGUMENTS] = {};
+    uint32_t vb_count = 0;
+    bool has_ibv = false;
+    layout->needs_root_signature = false;
+    for (uint32_t i = 0; i < layout->argument_count; ++i) {
+        IndirectArgument const * arg = &layout->arguments[i];
+        bool is_draw = IndirectArgument_Draw == arg->kind || IndirectArgument_DrawIndexed == arg->kind;
+        bool is_last = i + 1 == layout->argument_count;
+        if (is_draw && !is_last)
+            return "draw argument must be the last argument";
+        if (!is_draw && is_last)
+            return "last argument must be a draw";
+
+        switch (arg->kind) {
+            case IndirectArgument_VertexBufferView: {
+                for (uint32_t v = 0; v < vb_count; ++v) {
+                    if (vb_slots_used[v] == arg->slot)
+                        return "vertex buffer slot bound twice";
+                }
+                vb_slots_used[vb_count++] = arg->slot;
+                if (offset % 8)
+                    return "vertex buffer view must be 8-byte aligned";
+            } break;
+            case IndirectArgument_IndexBufferView: {
+                if (has_ibv)
+                    return "more than one index buffer view";
+                has_ibv = true;
+                if (offset % 8)
+                    return "index buffer view must be 8-byte aligned";
+            } break;
+            case IndirectArgument_Constant: {
+                if (0 == arg->value_count)
+                    return "root constant argument with no values";
+                if (arg->dest_offset + arg->value_count > arg->root_parameter_size)
+                    return "root constants overflow their root parameter";
+                for (uint32_t j = 0; j < i; ++j) {
+                    IndirectArgument const * other = &layout->arguments[j];
+                    if (IndirectArgument_Constant == other->kind && other->root_parameter_index == arg->root_parameter_index &&
+                        arg->dest_offset < other->dest_offset + other->value_count && other->dest_offset < arg->dest_offset + arg->value_count
+                    ) {
+                        return "root constant ranges overlap";
+                    }
+                }
+                layout->needs_root_signature = true;
+            } break;
+            case IndirectArgument_ConstantBufferView: {
+                if (offset % 8)
+                    return "constant buffer view address must be 8-byte aligned";
+                layout->needs_root_signature = true;
+            } break;
+            case IndirectArgument_Draw:
+            case IndirectArgument_DrawIndexed:
+                break;
+            default:
+                return "unknown argument kind";
+        }
+        layout->offsets[i] = offset;
+        offset += indirect_argument_size(arg);
+    }
+    if (0 == byte_stride)
+        byte_stride = offset;
+    if (byte_stride % 4)
+        return "byte stride must be a multiple of 4";
+    if (byte_stride < offset)
+        return "byte stride smaller than the packed arguments";
+    layout->byte_stride = byte_stride;
+    return nullptr;
+}
+
+// -- compact per-draw description; vertex buffer views are referenced by index into a table
+struct IndirectDrawItem {
+    uint32_t                        vertex_count_per_instance;
+    uint32_t                        instance_count;
+    uint32_t                        start_vertex;
+    uint32_t                        start_instance;
+    uint32_t                        constants [INDIRECT_ROOT_CONSTANT_COUNT];
+    uint32_t                        vb_index;
+};
+// -- binary-compatible with D3D12_VERTEX_BUFFER_VIEW
+struct IndirectVertexBufferView {
+    uint64_t                        buffer_location;
+    uint32_t                        size_in_bytes;
+    uint32_t                        stride_in_bytes;
+};
+static_assert(16 == sizeof(IndirectVertexBufferView), "must match D3D12_VERTEX_BUFFER_VIEW");
+
+// NOTE(omid): The fixed layout the packers below write:
+//   [0..16)   vertex buffer view (slot 0)
+//   [16..32)  INDIRECT_ROOT_CONSTANT_COUNT root constants
+//   [32..48)  draw arguments
+static void
+indirect_layout_make_draw (IndirectLayout * layout, uint32_t constants_root_parameter_index) {
+    ::memset(layout, 0, sizeof(*layout));
+    layout->arguments[0].kind = IndirectArgument_VertexBufferView;
+    layout->arguments[0].slot = 0;
+    layout->arguments[1].kind = IndirectArgument_Constant;
+    layout->arguments[1].root_parameter_index = constants_root_parameter_index;
+    layout->arguments[1].dest_offset = 0;
+    layout->arguments[1].value_count = INDIRECT_ROOT_CONSTANT_COUNT;
+    layout->arguments[1].root_parameter_size = INDIRECT_ROOT_CONSTANT_COUNT;
+    layout->arguments[2].kind = IndirectArgument_Draw;
+    layout->argument_count = 3;
+}
+#define INDIRECT_DRAW_STRIDE    48
+
+// -- the packers copy whole 16-byte blocks, so the source fields must already be laid out like the arguments
+static_assert(0 == offsetof(IndirectVertexBufferView, buffer_location) && 8 == offsetof(IndirectVertexBufferView, size_in_bytes) &&
+              12 == offsetof(IndirectVertexBufferView, stride_in_bytes), "must match D3D12_VERTEX_BUFFER_VIEW");
+static_assert(4 == offsetof(IndirectDrawItem, instance_count) && 8 == offsetof(IndirectDrawItem, start_vertex) &&
+              12 == offsetof(IndirectDrawItem, start_instance), "draw fields must match D3D12_DRAW_ARGUMENTS");
+static_assert(16 == offsetof(IndirectDrawItem, constants) && 16 == sizeof(IndirectDrawItem::constants), "root constants are one 16-byte block");
+static_assert(INDIRECT_DRAW_STRIDE == 16 + 4 * INDIRECT_ROOT_CONSTANT_COUNT + 16 && 0 == INDIRECT_DRAW_STRIDE % 16,
+              "stride must cover the fixed layout and keep every command 16-byte aligned");
+
+// -- reference path
+static void
+indirect_pack_draws_scalar (
+    IndirectDrawItem const * items, uint32_t count,
+    IndirectVertexBufferView const * vb_table, uint8_t * out
+) {
+    for (uint32_t i = 0; i < count; ++i) {
+        uint8_t * cmd = out + (size_t)i * INDIRECT_DRAW_STRIDE;
+        ::memcpy(cmd, &vb_table[items[i].vb_index], 16);
+        ::memcpy(cmd + 16, items[i].constants, 16);
+        ::memcpy(cmd + 32, &items[i].vertex_count_per_instance, 16);
+    }
+}
+// -- SSE2 path: three 16-byte loads/stores per draw; out should be 16-byte aligned
+static void
+indirect_pack_draws (
+    IndirectDrawItem const * items, uint32_t count,
+    IndirectVertexBufferView const * vb_table, uint8_t * out
+) {
+    bool aligned = 0 == ((uintptr_t)out & 15);
+    for (uint32_t i = 0; i < count; ++i) {
+        IndirectDrawItem const * item = &items[i];
+        __m128i vbv = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&vb_table[item->vb_index]));
+        __m128i constants = _mm_loadu_si128(reinterpret_cast<__m128i const *>(item->constants));
+        __m128i draw = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&item->vertex_count_per_instance));
+        __m128i * cmd = reinterpret_cast<__m128i *>(out + (size_t)i * INDIRECT_DRAW_STRIDE);
+        if (aligned) {
+            // -- argument buffers live in write-combined upload memory: stream past the cache
+            _mm_stream_si128(cmd + 0, vbv);
+            _mm_stream_si128(cmd + 1, constants);
+            _mm_stream_si128(cmd + 2, draw);
+        } else {
+            _mm_storeu_si128(cmd + 0, vbv);
+            _mm_storeu_si128(cmd + 1, constants);
+            _mm_storeu_si128(cmd + 2, draw);
+        }
+    }
+    if (aligned)
+        _mm_sfence();
+}
+
+// NOTE(omid): The argument buffer holds max_count commands; the count buffer holds
+// a single uint32 that ExecuteIndirect reads as the actual command count, so a
+// visibility pass can shrink the list on the gpu without touching the arguments.
+struct IndirectDrawBuilder {
+    uint8_t *                       args;           // mapped argument buffer
+    uint32_t *                      count;          // mapped count buffer location
+    uint32_t                        max_count;
+    uint32_t                        written;
+};
+static void
+indirect_builder_begin (IndirectDrawBuilder * builder, void * mapped_args, uint32_t * mapped_count, uint32_t max_count) {
+    builder->args = reinterpret_cast<uint8_t *>(mapped_args);
+    builder->count = mapped_count;
+    builder->max_count = max_count;
+    builder->written = 0;
+}
+static void
+indirect_builder_add (IndirectDrawBuilder * builder, IndirectDrawItem const * items, uint32_t count, IndirectVertexBufferView const * vb_table) {
+    SIMPLE_ASSERT(builder->written + count <= builder->max_count);
+    indirect_pack_draws(items, count, vb_table, builder->args + (size_t)builder->written * INDIRECT_DRAW_STRIDE);
+    builder->written += count;
+}
+static uint32_t
+indirect_builder_end (IndirectDrawBuilder * builder) {
+    if (builder->count)
+        *builder->count = builder->written;
+    return builder->written;
+}
@@ -0,0 +1,487 @@
+#pragma once
+
+// NOTE(omid): Binary mesh container: everything the importer, optimizer, LOD and
+// meshlet builders produce, stored as the same POD arrays the renderer uses, so
+// loading is mapping the file and pointing at it (no parsing, no copies).
+//
+//   header       MeshContainerHeader: magic, version, section table, .dae size/time
+//   cpu region   meshes, nodes, visual scenes, float vertices, quantization, LOD chains, meshlet ranges,
+//                index batch draws and the first draw of each mesh
+//   gpu region   packed vertices, indices, LOD indices, meshlets, meshlet bounds / vertices / triangles,
+//                index batch R16 / R32 streams (every mesh and LOD level, over the packed vertices)
+//
+// The gpu region is contiguous and starts page aligned, and each stream in it is
+// MESH_CONTAINER_GPU_ALIGNMENT aligned, so one sequential read drops it straight
+// into an upload heap with every stream at a usable offset
+// (mesh_container_read_gpu_streams), from where it is copied into a default heap
+// as it is. Vertices are welded at import, before anything here is built, so the
+// index batch draws straight from the packed vertex stream. The whole file is also
+// mapped copy-on-write for the cpu side; pages are only touched when used.
+//
+// Every section records its element stride, and opening fails on any mismatch
+// (or on a different version / header size), as well as when the source .dae's
+// size or write time differs from what the container was built from. The caller
+// then imports the .dae again and rewrites the container.
+
+#include "collada_loader.h"
+#include "vertex_compression.h"
+#include "mesh_lod.h"
+#include "meshlet_builder.h"
+#include "index_buffer.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define MESH_CONTAINER_MAGIC            0x434d444cu     // "LDMC"
+#define MESH_CONTAINER_VERSION          2
+#define MESH_CONTAINER_CPU_ALIGNMENT    64
+#define MESH_CONTAINER_GPU_ALIGNMENT    256             // D3D12 constant / raw buffer view offsets
+#define MESH_CONTAINER_PAGE             4096            // start of the gpu region
+#define MESH_CONTAINER_READ_CHUNK       (64u << 20)
+
+enum MeshSection : uint32_t {
+    // -- cpu
+    MeshSection_Meshes = 0,
+    MeshSection_Nodes,
+    MeshSection_VisualScenes,
+    MeshSection_Vertices,
+    MeshSection_Quantization,
+    MeshSection_LodChains,
+    MeshSection_MeshletRanges,
+    MeshSection_IndexDraws,
+    MeshSection_MeshDraws,
+    // -- gpu
+    MeshSection_PackedVertices,
+    MeshSection_Indices,
+    MeshSection_LodIndices,
+    MeshSection_Meshlets,
+    MeshSection_MeshletBounds,
+    MeshSection_MeshletVertices,
+    MeshSection_MeshletTriangles,
+    MeshSection_Indices16,
+    MeshSection_Indices32,
+
+    MeshSection_Count,
+    MeshSection_FirstGpu = MeshSection_PackedVertices,
+};
+static uint32_t const mesh_section_strides [MeshSection_Count] = {
+    sizeof(ColladaMesh), sizeof(ColladaNode), sizeof(ColladaVisualScene), sizeof(ColladaVertex),
+    sizeof(VertexQuantization), sizeof(MeshLodChain), sizeof(uint32_t), sizeof(IndexedDraw), sizeof(uint32_t),
+    sizeof(PackedMeshVertex), sizeof(uint32_t), sizeof(uint32_t), sizeof(Meshlet), sizeof(MeshletBounds),
+    sizeof(uint32_t), sizeof(uint8_t), sizeof(uint16_t), sizeof(uint32_t),
+};
+
+struct MeshContainerSection {
+    uint64_t                        offset;         // from the start of the file
+    uint64_t                        size;
+    uint32_t                        count;
+    uint32_t                        stride;
+};
+struct MeshContainerHeader {
+    uint32_t                        magic;
+    uint32_t                        version;
+    uint32_t                        header_size;    // catches layout changes the version bump missed
+    uint32_t                        section_count;
+    uint64_t                        file_size;
+    uint64_t                        source_size;    // of the .dae this was built from
+    uint64_t                        source_time;    // last write time of the .dae, platform units
+    uint64_t                        gpu_offset;
+    uint64_t                        gpu_size;       // through the end of the last gpu section
+    uint32_t                        active_scene;
+    uint32_t                        reserved;
+    MeshContainerSection            sections [MeshSection_Count];
+};
+
+struct MeshContainer {
+#if defined(_WIN32)
+    HANDLE                          file;
+    HANDLE                          mapping;
+#else
+    int                             fd;
+#endif
+    uint8_t *                       base;           // copy-on-write mapping of the whole file
+    uint64_t                        size;
+    MeshContainerHeader const *     header;
+};
+
+static bool
+mesh_container_source_stamp (char const * path, uint64_t * size, uint64_t * time) {
+#if defined(_WIN32)
+    WIN32_FILE_ATTRIBUTE_DATA data = {};
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data))
+        return false;
+    *size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    *time = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+#else
+    struct stat info = {};
+    if (0 != ::stat(path, &info))
+        return false;
+    *size = (uint64_t)info.st_size;
+    *time = (uint64_t)info.st_mtim.tv_sec * 1000000000ull + (uint64_t)info.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+static uint64_t
+mesh_container_align (uint64_t offset, uint64_t alignment) {
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+// NOTE(omid): Writes the container next to path (.tmp) and moves it into place, so
+// a crash mid-write never leaves a truncated container behind. Sections are
+// written straight from the arrays, in file order. batch holds index lists over
+// packed's vertices (index_batch_add_lists) and mesh_draws the first draw of each mesh.
+static bool
+mesh_container_write (
+    char const * path, char const * source_path,
+    ColladaScene const * scene, PackedScene const * packed, MeshLodSet const * lods, MeshletSet const * meshlets,
+    IndexBatch const * batch, uint32_t const * mesh_draws
+) {
+    if (packed->vertex_count != scene->vertex_count || packed->mesh_count != scene->mesh_count ||
+        lods->chain_count != scene->mesh_count || meshlets->mesh_count != scene->mesh_count ||
+        batch->vertex_stride != sizeof(PackedMeshVertex) || batch->vertex_count > packed->vertex_count || !mesh_draws
+    ) {
+        ::printf("Mesh container: %s not written (scene data incomplete)\n", path);
+        return false;
+    }
+    void const * data [MeshSection_Count] = {
+        scene->meshes, scene->nodes, scene->visual_scenes, scene->vertices,
+        packed->meshes, lods->chains, meshlets->mesh_first_meshlet, batch->draws, mesh_draws,
+        packed->vertices, scene->indices, lods->indices, meshlets->meshlets, meshlets->bounds,
+        meshlets->vertices, meshlets->triangles, batch->indices16, batch->indices32,
+    };
+    uint32_t const counts [MeshSection_Count] = {
+        scene->mesh_count, scene->node_count, scene->visual_scene_count, scene->vertex_count,
+        packed->mesh_count, lods->chain_count, meshlets->mesh_count + 1, batch->draw_count, scene->mesh_count,
+        packed->vertex_count, scene->index_count, lods->index_count, meshlets->meshlet_count, meshlets->meshlet_count,
+        meshlets->vertex_count, meshlets->triangle_bytes, batch->index16_count, batch->index32_count,
+    };
+
+    MeshContainerHeader header = {};
+    header.magic = MESH_CONTAINER_MAGIC;
+    header.version = MESH_CONTAINER_VERSION;
+    header.header_size = sizeof(MeshContainerHeader);
+    header.section_count = MeshSection_Count;
+    header.active_scene = scene->active_scene;
+    if (!mesh_container_source_stamp(source_path, &header.source_size, &header.source_time))
+        return false;
+    uint64_t offset = sizeof(MeshContainerHeader);
+    for (uint32_t s = 0; s < MeshSection_Count; ++s) {
+        if (MeshSection_FirstGpu == s) {
+            offset = mesh_container_align(offset, MESH_CONTAINER_PAGE);
+            header.gpu_offset = offset;
+        }
+        offset = mesh_container_align(offset, s >= MeshSection_FirstGpu ? MESH_CONTAINER_GPU_ALIGNMENT : MESH_CONTAINER_CPU_ALIGNMENT);
+        MeshContainerSection * section = &header.sections[s];
+        section->offset = offset;
+        section->count = counts[s];
+        section->stride = mesh_section_strides[s];
+        section->size = (uint64_t)section->count * section->stride;
+        offset += section->size;
+    }
+    header.gpu_size = offset - header.gpu_offset;
+    header.file_size = offset;
+
+    char temp_path [512] = {};
+    ::snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    FILE * file = ::fopen(temp_path, "wb");
+    if (!file) {
+        ::printf("Mesh container: can't create %s\n", temp_path);
+        return false;
+    }
+    static uint8_t const zeros [MESH_CONTAINER_PAGE] = {};
+    bool ok = 1 == ::fwrite(&header, sizeof(header), 1, file);
+    uint64_t written = sizeof(header);
+    for (uint32_t s = 0; s < MeshSection_Count && ok; ++s) {
+        MeshContainerSection const * section = &header.sections[s];
+        ok = ::fwrite(zeros, 1, (size_t)(section->offset - written), file) == section->offset - written;
+        if (ok && section->size)
+            ok = ::fwrite(data[s], 1, (size_t)section->size, file) == section->size;
+        written = section->offset + section->size;
+    }
+    ok = 0 == ::fclose(file) && ok;
+#if defined(_WIN32)
+    ok = ok && MoveFileExA(temp_path, path, MOVEFILE_REPLACE_EXISTING);
+#else
+    ok = ok && 0 == ::rename(temp_path, path);
+#endif
+    if (!ok) {
+        ::remove(temp_path);
+        ::printf("Mesh container: writing %s failed\n", path);
+        return false;
+    }
+    ::printf("Mesh container: wrote %s, %.2f MiB (gpu streams %.2f MiB)\n", path, header.file_size / 1048576.0, header.gpu_size / 1048576.0);
+    return true;
+}
+
+static void
+mesh_container_close (MeshContainer * container) {
+#if defined(_WIN32)
+    if (container->base)
+        UnmapViewOfFile(container->base);
+    if (container->mapping)
+        CloseHandle(container->mapping);
+    if (container->file && INVALID_HANDLE_VALUE != container->file)
+        CloseHandle(container->file);
+#else
+    if (container->base)
+        ::munmap(container->base, container->size);
+    if (container->fd > 0)
+        ::close(container->fd);
+#endif
+    ::memset(container, 0, sizeof(*container));
+}
+// NOTE(omid): Every range a section holds into another stays inside it, so the
+// views (and draws) never read past a stream; the index values themselves are not
+// checked. The section table must have been validated first.
+static bool
+mesh_container_validate_ranges (MeshContainerHeader const * header) {
+    uint8_t const * base = reinterpret_cast<uint8_t const *>(header);
+    MeshContainerSection const * sections = header->sections;
+    uint32_t mesh_count = sections[MeshSection_Meshes].count;
+    if (sections[MeshSection_Quantization].count != mesh_count || sections[MeshSection_LodChains].count != mesh_count ||
+        sections[MeshSection_MeshDraws].count != mesh_count || sections[MeshSection_MeshletRanges].count != (uint64_t)mesh_count + 1 ||
+        sections[MeshSection_PackedVertices].count != sections[MeshSection_Vertices].count ||
+        sections[MeshSection_MeshletBounds].count != sections[MeshSection_Meshlets].count
+    ) {
+        return false;
+    }
+
+    ColladaMesh const * meshes = reinterpret_cast<ColladaMesh const *>(base + sections[MeshSection_Meshes].offset);
+    MeshLodChain const * chains = reinterpret_cast<MeshLodChain const *>(base + sections[MeshSection_LodChains].offset);
+    uint32_t const * mesh_draws = reinterpret_cast<uint32_t const *>(base + sections[MeshSection_MeshDraws].offset);
+    uint32_t const * first_meshlet = reinterpret_cast<uint32_t const *>(base + sections[MeshSection_MeshletRanges].offset);
+    uint32_t draw_count = sections[MeshSection_IndexDraws].count;
+    uint32_t meshlet_count = sections[MeshSection_Meshlets].count;
+    if (0 != first_meshlet[0] || first_meshlet[mesh_count] > meshlet_count)
+        return false;
+    for (uint32_t m = 0; m < mesh_count; ++m) {
+        ColladaMesh const * mesh = &meshes[m];
+        MeshLodChain const * chain = &chains[m];
+        if ((uint64_t)mesh->first_vertex + mesh->vertex_count > sections[MeshSection_Vertices].count ||
+            (uint64_t)mesh->first_index + mesh->index_count > sections[MeshSection_Indices].count ||
+            chain->level_count > MESH_LOD_MAX_LEVELS || first_meshlet[m] > first_meshlet[m + 1] ||
+            (COLLADA_NONE != mesh_draws[m] && (uint64_t)mesh_draws[m] + chain->level_count > draw_count)
+        ) {
+            return false;
+        }
+        for (uint32_t l = 0; l < chain->level_count; ++l) {
+            if ((uint64_t)chain->levels[l].first_index + chain->levels[l].index_count > sections[MeshSection_LodIndices].count)
+                return false;
+        }
+    }
+
+    IndexedDraw const * draws = reinterpret_cast<IndexedDraw const *>(base + sections[MeshSection_IndexDraws].offset);
+    for (uint32_t d = 0; d < draw_count; ++d) {
+        IndexedDraw const * draw = &draws[d];
+        uint32_t index_count =
+            DXGI_FORMAT_R16_UINT == draw->format ? sections[MeshSection_Indices16].count :
+            DXGI_FORMAT_R32_UINT == draw->format ? sections[MeshSection_Indices32].count : 0;
+        if ((uint64_t)draw->first_index + draw->index_count > index_count || draw->base_vertex < 0 ||
+            (uint64_t)draw->base_vertex + draw->vertex_count > sections[MeshSection_PackedVertices].count
+        ) {
+            return false;
+        }
+    }
+
+    Meshlet const * meshlets = reinterpret_cast<Meshlet const *>(base + sections[MeshSection_Meshlets].offset);
+    for (uint32_t i = 0; i < meshlet_count; ++i) {
+        Meshlet const * meshlet = &meshlets[i];
+        if ((uint64_t)meshlet->vertex_offset + meshlet->vertex_count > sections[MeshSection_MeshletVertices].count ||
+            (uint64_t)meshlet->triangle_offset + 3u * meshlet->triangle_count > sections[MeshSection_MeshletTriangles].count ||
+            meshlet->mesh >= mesh_count
+        ) {
+            return false;
+        }
+    }
+    return true;
+}
+// -- section table sane for a file of this size, and the ranges in it inside their streams
+static bool
+mesh_container_validate (MeshContainerHeader const * header, uint64_t file_size) {
+    if (MESH_CONTAINER_MAGIC != header->magic || MESH_CONTAINER_VERSION != header->version ||
+        sizeof(MeshContainerHeader) != header->header_size || MeshSection_Count != header->section_count ||
+        file_size != header->file_size
+    ) {
+        return false;
+    }
+    for (uint32_t s = 0; s < MeshSection_Count; ++s) {
+        MeshContainerSection const * section = &header->sections[s];
+        uint64_t alignment = s >= MeshSection_FirstGpu ? MESH_CONTAINER_GPU_ALIGNMENT : MESH_CONTAINER_CPU_ALIGNMENT;
+        if (mesh_section_strides[s] != section->stride || (uint64_t)section->count * section->stride != section->size ||
+            0 != section->offset % alignment || section->offset > file_size || section->size > file_size - section->offset
+        ) {
+            return false;
+        }
+    }
+    MeshContainerSection const * last = &header->sections[MeshSection_Count - 1];
+    return
+        0 == header->gpu_offset % MESH_CONTAINER_PAGE && header->sections[MeshSection_FirstGpu].offset >= header->gpu_offset &&
+        header->gpu_offset + header->gpu_size == last->offset + last->size &&
+        mesh_container_validate_ranges(header);
+}
+// NOTE(omid): Maps the container; false when missing, malformed, from another
+// build of these structs, or older than source_path (pass nullptr to skip that check).
+static bool
+mesh_container_open (MeshContainer * container, char const * path, char const * source_path) {
+    ::memset(container, 0, sizeof(*container));
+    auto begin = std::chrono::steady_clock::now();
+#if defined(_WIN32)
+    container->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (INVALID_HANDLE_VALUE == container->file) {
+        container->file = nullptr;
+        return false;
+    }
+    LARGE_INTEGER size = {};
+    if (GetFileSizeEx(container->file, &size) && size.QuadPart >= (LONGLONG)sizeof(MeshContainerHeader)) {
+        container->size = (uint64_t)size.QuadPart;
+        container->mapping = CreateFileMappingA(container->file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+        if (container->mapping)
+            container->base = reinterpret_cast<uint8_t *>(MapViewOfFile(container->mapping, FILE_MAP_COPY, 0, 0, 0));
+    }
+#else
+    container->fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (container->fd < 0) {
+        container->fd = 0;
+        return false;
+    }
+    struct stat info = {};
+    if (0 == ::fstat(container->fd, &info) && info.st_size >= (off_t)sizeof(MeshContainerHeader)) {
+        container->size = (uint64_t)info.st_size;
+        void * base = ::mmap(nullptr, container->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, container->fd, 0);
+        container->base = MAP_FAILED == base ? nullptr : reinterpret_cast<uint8_t *>(base);
+    }
+#endif
+    MeshContainerHeader const * header = reinterpret_cast<MeshContainerHeader const *>(container->base);
+    bool ok = header && mesh_container_validate(header, container->size);
+    if (ok && source_path) {
+        uint64_t source_size = 0, source_time = 0;
+        ok = mesh_container_source_stamp(source_path, &source_size, &source_time) &&
+            source_size == header->source_size && source_time == header->source_time;
+    }
+    if (!ok) {
+        ::printf("Mesh container: %s is stale or unreadable\n", path);
+        mesh_container_close(container);
+        return false;
+    }
+    container->header = header;
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    ::printf("Mesh container: mapped %s, %.2f MiB in %.3f ms\n", path, container->size / 1048576.0, ms);
+    return true;
+}
+static void *
+mesh_container_section (MeshContainer const * container, MeshSection section) {
+    return container->base + container->header->sections[section].offset;
+}
+static uint32_t
+mesh_container_count (MeshContainer const * container, MeshSection section) {
+    return container->header->sections[section].count;
+}
+// -- offset of a gpu stream inside the block mesh_container_read_gpu_streams fills
+static uint64_t
+mesh_container_gpu_offset (MeshContainer const * container, MeshSection section) {
+    return container->header->sections[section].offset - container->header->gpu_offset;
+}
+// NOTE(omid): Points the scene structs at the mapping. They borrow it: don't pass
+// them to the *_destroy functions, close the container instead.
+static void
+mesh_container_views (
+    MeshContainer const * container, ColladaScene * scene, PackedScene * packed, MeshLodSet * lods, MeshletSet * meshlets,
+    IndexBatch * batch, uint32_t ** mesh_draws
+) {
+    ::memset(scene, 0, sizeof(*scene));
+    scene->meshes = reinterpret_cast<ColladaMesh *>(mesh_container_section(container, MeshSection_Meshes));
+    scene->mesh_count = mesh_container_count(container, MeshSection_Meshes);
+    scene->nodes = reinterpret_cast<ColladaNode *>(mesh_container_section(container, MeshSection_Nodes));
+    scene->node_count = mesh_container_count(container, MeshSection_Nodes);
+    scene->visual_scenes = reinterpret_cast<ColladaVisualScene *>(mesh_container_section(container, MeshSection_VisualScenes));
+    scene->visual_scene_count = mesh_container_count(container, MeshSection_VisualScenes);
+    scene->vertices = reinterpret_cast<ColladaVertex *>(mesh_container_section(container, MeshSection_Vertices));
+    scene->vertex_count = mesh_container_count(container, MeshSection_Vertices);
+    scene->indices = reinterpret_cast<uint32_t *>(mesh_container_section(container, MeshSection_Indices));
+    scene->index_count = mesh_container_count(container, MeshSection_Indices);
+    scene->active_scene = container->header->active_scene;
+
+    packed->vertices = reinterpret_cast<PackedMeshVertex *>(mesh_container_section(container, MeshSection_PackedVertices));
+    packed->vertex_count = mesh_container_count(container, MeshSection_PackedVertices);
+    packed->meshes = reinterpret_cast<VertexQuantization *>(mesh_container_section(container, MeshSection_Quantization));
+    packed->mesh_count = mesh_container_count(container, MeshSection_Quantization);
+
+    lods->indices = reinterpret_cast<uint32_t *>(mesh_container_section(container, MeshSection_LodIndices));
+    lods->index_count = mesh_container_count(container, MeshSection_LodIndices);
+    lods->chains = reinterpret_cast<MeshLodChain *>(mesh_container_section(container, MeshSection_LodChains));
+    lods->chain_count = mesh_container_count(container, MeshSection_LodChains);
+
+    meshlets->meshlets = reinterpret_cast<Meshlet *>(mesh_container_section(container, MeshSection_Meshlets));
+    meshlets->bounds = reinterpret_cast<MeshletBounds *>(mesh_container_section(container, MeshSection_MeshletBounds));
+    meshlets->meshlet_count = mesh_container_count(container, MeshSection_Meshlets);
+    meshlets->vertices = reinterpret_cast<uint32_t *>(mesh_container_section(container, MeshSection_MeshletVertices));
+    meshlets->vertex_count = mesh_container_count(container, MeshSection_MeshletVertices);
+    meshlets->triangles = reinterpret_cast<uint8_t *>(mesh_container_section(container, MeshSection_MeshletTriangles));
+    meshlets->triangle_bytes = mesh_container_count(container, MeshSection_MeshletTriangles);
+    meshlets->mesh_first_meshlet = reinterpret_cast<uint32_t *>(mesh_container_section(container, MeshSection_MeshletRanges));
+    meshlets->mesh_count = mesh_container_count(container, MeshSection_MeshletRanges) - 1;
+
+    // -- the vertex stream of the batch is the packed vertices
+    ::memset(batch, 0, sizeof(*batch));
+    batch->vertices = reinterpret_cast<uint8_t *>(packed->vertices);
+    batch->vertex_stride = sizeof(PackedMeshVertex);
+    batch->vertex_count = packed->vertex_count;
+    batch->draws = reinterpret_cast<IndexedDraw *>(mesh_container_section(container, MeshSection_IndexDraws));
+    batch->draw_count = mesh_container_count(container, MeshSection_IndexDraws);
+    batch->indices16 = reinterpret_cast<uint16_t *>(mesh_container_section(container, MeshSection_Indices16));
+    batch->index16_count = mesh_container_count(container, MeshSection_Indices16);
+    batch->indices32 = reinterpret_cast<uint32_t *>(mesh_container_section(container, MeshSection_Indices32));
+    batch->index32_count = mesh_container_count(container, MeshSection_Indices32);
+    for (uint32_t d = 0; d < batch->draw_count; ++d) {
+        if (DXGI_FORMAT_R16_UINT == batch->draws[d].format)
+            ++batch->stats.r16_draws;
+        else
+            ++batch->stats.r32_draws;
+    }
+    batch->stats.vertices_in = batch->vertex_count;
+    *mesh_draws = reinterpret_cast<uint32_t *>(mesh_container_section(container, MeshSection_MeshDraws));
+}
+// NOTE(omid): One sequential read of the whole gpu region into dest (gpu_size
+// bytes, e.g. a mapped upload heap), bypassing the mapping so the pages don't go
+// through the cache twice. Stream s lands at mesh_container_gpu_offset(s).
+static bool
+mesh_container_read_gpu_streams (MeshContainer const * container, void * dest) {
+    auto begin = std::chrono::steady_clock::now();
+    uint64_t offset = container->header->gpu_offset;
+    uint64_t remaining = container->header->gpu_size;
+    uint8_t * out = reinterpret_cast<uint8_t *>(dest);
+    while (remaining > 0) {
+        uint32_t chunk = remaining > MESH_CONTAINER_READ_CHUNK ? MESH_CONTAINER_READ_CHUNK : (uint32_t)remaining;
+#if defined(_WIN32)
+        OVERLAPPED at = {};
+        at.Offset = (DWORD)offset;
+        at.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD got = 0;
+        if (!ReadFile(container->file, out, chunk, &got, &at) || 0 == got)
+            return false;
+#else
+        ssize_t got = ::pread(container->fd, out, chunk, (off_t)offset);
+        if (got <= 0)
+            return false;
+#endif
+        offset += (uint64_t)got;
+        out += got;
+        remaining -= (uint64_t)got;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    ::printf(
+        "Mesh container: gpu streams, %.2f MiB in one read, %.3f ms (%.2f GB/s)\n",
+        container->header->gpu_size / 1048576.0, ms, ms > 0.0 ? container->header->gpu_size / ms * 1e-6 : 0.0
+    );
+    return true;
+}
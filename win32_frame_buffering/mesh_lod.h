@@ -0,0 +1,687 @@
+#pragma once
+
+// NOTE(omid): Automatic LOD chains: every imported mesh gets a few index buffers
+// of decreasing triangle count over the same vertices, simplified with quadric
+// error metrics (Garland & Heckbert) by edge collapse onto an existing vertex.
+//
+// Attribute seams: the importer splits a position into several vertices where
+// normals / uvs differ. Vertices are classified first (following meshoptimizer's
+// simplifier):
+//   manifold   one vertex per position, no open edges: collapses anywhere
+//   border     one vertex per position on an open edge: only along that edge, to another border vertex
+//   seam       two vertices per position on a consistent seam: only along the seam, both copies together
+//   locked     everything else (seam corners, non-manifold): never moves
+// Open edges also add a steep quadric so they keep their shape. Collapses that
+// would flip a triangle are rejected.
+//
+// Every level is built from the full mesh, so its error is measured against the
+// original surface: the largest quadric error of its collapses, as an object-space
+// distance. mesh_lod_select turns that into pixels for a given projected size. Meshes
+// are processed one per job on a few threads; each level is then reordered with
+// tipsify (mesh_optimizer.h).
+
+#include "mesh_optimizer.h"
+
+#include <float.h>
+#include <math.h>
+
+#define MESH_LOD_MAX_LEVELS         5
+#define MESH_LOD_RATIO              0.5f    // each level targets half the triangles of the previous one
+#define MESH_LOD_MAX_ERROR          0.05f   // relative to the mesh extent; coarser levels are not built
+#define MESH_LOD_MIN_REDUCTION      0.85f   // a level must drop at least 15% of the previous level's triangles
+#define MESH_LOD_EDGE_WEIGHT        10.0f
+#define MESH_LOD_MAX_THREADS        8
+
+enum MeshVertexKind : uint8_t {
+    MeshVertexKind_Manifold = 0,
+    MeshVertexKind_Border,
+    MeshVertexKind_Seam,
+    MeshVertexKind_Locked,
+};
+// -- [from][to]: may a vertex of kind from collapse onto one of kind to
+static uint8_t const mesh_lod_can_collapse [4][4] = {
+    {1, 1, 1, 1},
+    {0, 1, 0, 0},
+    {0, 0, 1, 0},
+    {0, 0, 0, 0},
+};
+// -- [k0][k1]: is an edge between such vertices seen from both of its triangles
+static uint8_t const mesh_lod_has_opposite [4][4] = {
+    {1, 1, 1, 0},
+    {1, 0, 1, 0},
+    {1, 1, 1, 0},
+    {0, 0, 0, 0},
+};
+
+struct MeshQuadric {
+    float                           a00, a11, a22;
+    float                           a10, a20, a21;
+    float                           b0, b1, b2;
+    float                           c;
+    float                           w;
+};
+static void
+mesh_quadric_add_plane (MeshQuadric * q, float a, float b, float c, float d, float w) {
+    q->a00 += w * a * a;
+    q->a11 += w * b * b;
+    q->a22 += w * c * c;
+    q->a10 += w * b * a;
+    q->a20 += w * c * a;
+    q->a21 += w * c * b;
+    q->b0 += w * a * d;
+    q->b1 += w * b * d;
+    q->b2 += w * c * d;
+    q->c += w * d * d;
+    q->w += w;
+}
+static void
+mesh_quadric_add (MeshQuadric * q, MeshQuadric const * r) {
+    q->a00 += r->a00; q->a11 += r->a11; q->a22 += r->a22;
+    q->a10 += r->a10; q->a20 += r->a20; q->a21 += r->a21;
+    q->b0 += r->b0; q->b1 += r->b1; q->b2 += r->b2;
+    q->c += r->c;
+    q->w += r->w;
+}
+// -- weighted mean squared distance of p to the quadric's planes
+static float
+mesh_quadric_error (MeshQuadric const * q, float const * p) {
+    float ax = q->a00 * p[0] + q->a10 * p[1] + q->a20 * p[2];
+    float ay = q->a10 * p[0] + q->a11 * p[1] + q->a21 * p[2];
+    float az = q->a20 * p[0] + q->a21 * p[1] + q->a22 * p[2];
+    float r = ax * p[0] + ay * p[1] + az * p[2] + 2.0f * (q->b0 * p[0] + q->b1 * p[1] + q->b2 * p[2]) + q->c;
+    return q->w > 0.0f ? ::fabsf(r) / q->w : 0.0f;
+}
+static float
+mesh_lod_normalize (float * v) {
+    float length = ::sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (length > 0.0f) {
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+    }
+    return length;
+}
+static void
+mesh_lod_cross (float const * a, float const * b, float * out) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+// -- plane through edge p0 -> p1, perpendicular to the triangle (p2 is the opposite corner)
+static void
+mesh_quadric_add_edge (MeshQuadric * q, float const * p0, float const * p1, float const * p2, float weight) {
+    float p10 [3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    float p20 [3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    float length_sq = p10[0] * p10[0] + p10[1] * p10[1] + p10[2] * p10[2];
+    float projection = p20[0] * p10[0] + p20[1] * p10[1] + p20[2] * p10[2];
+    float perp [3] = {p20[0] * length_sq - p10[0] * projection, p20[1] * length_sq - p10[1] * projection, p20[2] * length_sq - p10[2] * projection};
+    mesh_lod_normalize(perp);
+    float d = -(perp[0] * p0[0] + perp[1] * p0[1] + perp[2] * p0[2]);
+    mesh_quadric_add_plane(q, perp[0], perp[1], perp[2], d, ::sqrtf(length_sq) * weight);
+}
+
+struct MeshCollapse {
+    uint32_t                        v0;             // collapses onto v1
+    uint32_t                        v1;
+    float                           error;
+    uint32_t                        bidirectional;
+};
+static int
+mesh_collapse_compare (void const * a, void const * b) {
+    MeshCollapse const * ca = reinterpret_cast<MeshCollapse const *>(a);
+    MeshCollapse const * cb = reinterpret_cast<MeshCollapse const *>(b);
+    if (ca->error != cb->error)
+        return ca->error < cb->error ? -1 : 1;
+    return ca->v0 != cb->v0 ? (ca->v0 < cb->v0 ? -1 : 1) : (ca->v1 < cb->v1 ? -1 : (ca->v1 > cb->v1 ? 1 : 0));
+}
+
+// -- everything mesh_simplify needs besides the index buffer, carved from one allocation
+struct MeshSimplifyScratch {
+    float *                         positions;      // 3 per vertex, scaled into the unit cube
+    uint32_t *                      remap;          // vertex -> first vertex with the same position
+    uint32_t *                      wedge;          // vertex -> next vertex with the same position (cyclic)
+    uint32_t *                      loop;           // open edge leaving the vertex, or COLLADA_NONE
+    uint32_t *                      loopback;       // open edge entering the vertex
+    uint8_t *                       kind;
+    MeshQuadric *                   quadrics;       // per remapped vertex
+    MeshCollapse *                  collapses;      // index_count
+    uint32_t *                      collapse_remap;
+    uint8_t *                       collapse_locked;
+    uint32_t *                      offsets;        // vertex_count + 1: adjacency (edges, then triangles)
+    uint32_t *                      adjacency;      // index_count
+    uint32_t *                      table;          // position hash, table_size
+    uint32_t                        table_size;
+    void *                          memory;
+};
+static bool
+mesh_simplify_scratch_create (MeshSimplifyScratch * s, uint32_t vertex_count, uint32_t index_count) {
+    ::memset(s, 0, sizeof(*s));
+    s->table_size = 64;
+    while (s->table_size < vertex_count * 2)
+        s->table_size *= 2;
+    size_t v = vertex_count, i = index_count;
+    size_t bytes =
+        v * 3 * sizeof(float) + v * 4 * sizeof(uint32_t) + v + v * sizeof(MeshQuadric) +
+        i * sizeof(MeshCollapse) + v * sizeof(uint32_t) + v + (v + 1) * sizeof(uint32_t) + i * sizeof(uint32_t) +
+        s->table_size * sizeof(uint32_t) + 16 * 16;
+    uint8_t * memory = reinterpret_cast<uint8_t *>(::malloc(bytes));
+    if (!memory)
+        return false;
+    s->memory = memory;
+    auto carve = [&memory] (size_t size) {
+        void * p = memory;
+        memory += (size + 15) & ~(size_t)15;
+        return p;
+    };
+    s->positions = reinterpret_cast<float *>(carve(v * 3 * sizeof(float)));
+    s->remap = reinterpret_cast<uint32_t *>(carve(v * sizeof(uint32_t)));
+    s->wedge = reinterpret_cast<uint32_t *>(carve(v * sizeof(uint32_t)));
+    s->loop = reinterpret_cast<uint32_t *>(carve(v * sizeof(uint32_t)));
+    s->loopback = reinterpret_cast<uint32_t *>(carve(v * sizeof(uint32_t)));
+    s->kind = reinterpret_cast<uint8_t *>(carve(v));
+    s->quadrics = reinterpret_cast<MeshQuadric *>(carve(v * sizeof(MeshQuadric)));
+    s->collapses = reinterpret_cast<MeshCollapse *>(carve(i * sizeof(MeshCollapse)));
+    s->collapse_remap = reinterpret_cast<uint32_t *>(carve(v * sizeof(uint32_t)));
+    s->collapse_locked = reinterpret_cast<uint8_t *>(carve(v));
+    s->offsets = reinterpret_cast<uint32_t *>(carve((v + 1) * sizeof(uint32_t)));
+    s->adjacency = reinterpret_cast<uint32_t *>(carve(i * sizeof(uint32_t)));
+    s->table = reinterpret_cast<uint32_t *>(carve(s->table_size * sizeof(uint32_t)));
+    return true;
+}
+static void
+mesh_simplify_scratch_destroy (MeshSimplifyScratch * s) {
+    ::free(s->memory);
+    ::memset(s, 0, sizeof(*s));
+}
+// -- does edge a -> b exist (adjacency holds each vertex's outgoing edge targets)
+static bool
+mesh_lod_has_edge (MeshSimplifyScratch const * s, uint32_t a, uint32_t b) {
+    for (uint32_t e = s->offsets[a]; e < s->offsets[a + 1]; ++e) {
+        if (s->adjacency[e] == b)
+            return true;
+    }
+    return false;
+}
+// -- remap / wedge / loops / kinds for the current (full) index buffer
+static void
+mesh_lod_classify (MeshSimplifyScratch * s, uint32_t const * indices, uint32_t index_count, uint32_t vertex_count) {
+    // -- vertices with bit-identical positions share a remap entry
+    ::memset(s->table, 0xff, s->table_size * sizeof(uint32_t));
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        uint32_t bits [3];
+        ::memcpy(bits, &s->positions[v * 3], sizeof(bits));
+        uint32_t slot = collada_tuple_hash(bits) & (s->table_size - 1);
+        for (;;) {
+            uint32_t other = s->table[slot];
+            if (COLLADA_NONE == other) {
+                s->table[slot] = v;
+                s->remap[v] = v;
+                s->wedge[v] = v;
+                break;
+            }
+            if (0 == ::memcmp(&s->positions[other * 3], &s->positions[v * 3], 3 * sizeof(float))) {
+                s->remap[v] = other;
+                s->wedge[v] = s->wedge[other];
+                s->wedge[other] = v;
+                break;
+            }
+            slot = (slot + 1) & (s->table_size - 1);
+        }
+    }
+    // -- outgoing edges per vertex, then the open ones (no opposite half-edge in index space)
+    ::memset(s->offsets, 0, (vertex_count + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < index_count; ++i)
+        ++s->offsets[indices[i] + 1];
+    for (uint32_t v = 0; v < vertex_count; ++v)
+        s->offsets[v + 1] += s->offsets[v];
+    for (uint32_t i = 0; i < index_count; ++i) {
+        uint32_t a = indices[i], b = indices[i % 3 == 2 ? i - 2 : i + 1];
+        s->adjacency[s->offsets[a]++] = b;
+    }
+    for (uint32_t v = vertex_count; v > 0; --v)
+        s->offsets[v] = s->offsets[v - 1];
+    s->offsets[0] = 0;
+
+    ::memset(s->loop, 0xff, vertex_count * sizeof(uint32_t));
+    ::memset(s->loopback, 0xff, vertex_count * sizeof(uint32_t));
+    for (uint32_t a = 0; a < vertex_count; ++a) {
+        for (uint32_t e = s->offsets[a]; e < s->offsets[a + 1]; ++e) {
+            uint32_t b = s->adjacency[e];
+            if (mesh_lod_has_edge(s, b, a))
+                continue;
+            // -- a second open edge marks the vertex with itself (not a simple loop)
+            s->loop[a] = COLLADA_NONE == s->loop[a] ? b : a;
+            s->loopback[b] = COLLADA_NONE == s->loopback[b] ? a : b;
+        }
+    }
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        if (s->remap[v] != v)
+            continue;
+        uint8_t kind = MeshVertexKind_Locked;
+        if (s->wedge[v] == v) {
+            uint32_t in = s->loopback[v], out = s->loop[v];
+            if (COLLADA_NONE == in && COLLADA_NONE == out)
+                kind = MeshVertexKind_Manifold;
+            else if (COLLADA_NONE != in && COLLADA_NONE != out && in != v && out != v)
+                kind = MeshVertexKind_Border;
+        } else if (s->wedge[s->wedge[v]] == v) {
+            // -- exactly two copies: a seam if each has one open edge in and out and they line up
+            uint32_t w = s->wedge[v];
+            uint32_t in_v = s->loopback[v], out_v = s->loop[v], in_w = s->loopback[w], out_w = s->loop[w];
+            if (COLLADA_NONE != in_v && in_v != v && COLLADA_NONE != out_v && out_v != v &&
+                COLLADA_NONE != in_w && in_w != w && COLLADA_NONE != out_w && out_w != w &&
+                s->remap[in_v] == s->remap[out_w] && s->remap[out_v] == s->remap[in_w]
+            ) {
+                kind = MeshVertexKind_Seam;
+            }
+        }
+        s->kind[v] = kind;
+    }
+    for (uint32_t v = 0; v < vertex_count; ++v)
+        s->kind[v] = s->kind[s->remap[v]];
+}
+static void
+mesh_lod_fill_quadrics (MeshSimplifyScratch * s, uint32_t const * indices, uint32_t index_count, uint32_t vertex_count) {
+    ::memset(s->quadrics, 0, vertex_count * sizeof(MeshQuadric));
+    for (uint32_t i = 0; i < index_count; i += 3) {
+        float const * p [3] = {&s->positions[indices[i] * 3], &s->positions[indices[i + 1] * 3], &s->positions[indices[i + 2] * 3]};
+        float e1 [3] = {p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2]};
+        float e2 [3] = {p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2]};
+        float n [3];
+        mesh_lod_cross(e1, e2, n);
+        float area = mesh_lod_normalize(n);
+        float d = -(n[0] * p[0][0] + n[1] * p[0][1] + n[2] * p[0][2]);
+        MeshQuadric q = {};
+        mesh_quadric_add_plane(&q, n[0], n[1], n[2], d, ::sqrtf(area));
+        for (uint32_t k = 0; k < 3; ++k)
+            mesh_quadric_add(&s->quadrics[s->remap[indices[i + k]]], &q);
+        // -- open edges (borders, and seams seen from one side)
+        for (uint32_t k = 0; k < 3; ++k) {
+            uint32_t a = indices[i + k], b = indices[i + (k + 1) % 3];
+            if (s->loop[a] != b)
+                continue;
+            uint8_t ka = s->kind[a], kb = s->kind[b];
+            if ((MeshVertexKind_Border == ka || MeshVertexKind_Seam == ka || MeshVertexKind_Locked == ka) &&
+                (MeshVertexKind_Border == kb || MeshVertexKind_Seam == kb || MeshVertexKind_Locked == kb)
+            ) {
+                MeshQuadric eq = {};
+                mesh_quadric_add_edge(&eq, p[k], p[(k + 1) % 3], p[(k + 2) % 3], MESH_LOD_EDGE_WEIGHT);
+                mesh_quadric_add(&s->quadrics[s->remap[a]], &eq);
+                mesh_quadric_add(&s->quadrics[s->remap[b]], &eq);
+            }
+        }
+    }
+}
+// -- would moving remapped vertex r0 onto position p flip any of its triangles (not shared with r1)
+static bool
+mesh_lod_flips (MeshSimplifyScratch const * s, uint32_t const * indices, uint32_t r0, uint32_t r1, float const * p) {
+    for (uint32_t e = s->offsets[r0]; e < s->offsets[r0 + 1]; ++e) {
+        uint32_t const * tri = indices + s->adjacency[e] * 3;
+        uint32_t r [3] = {s->remap[tri[0]], s->remap[tri[1]], s->remap[tri[2]]};
+        if (r[0] == r1 || r[1] == r1 || r[2] == r1)
+            continue;           // collapses away
+        float const * before [3] = {&s->positions[tri[0] * 3], &s->positions[tri[1] * 3], &s->positions[tri[2] * 3]};
+        float const * after [3] = {before[0], before[1], before[2]};
+        for (uint32_t k = 0; k < 3; ++k)
+            after[k] = r[k] == r0 ? p : before[k];
+        float nb [3], na [3];
+        float b1 [3] = {before[1][0] - before[0][0], before[1][1] - before[0][1], before[1][2] - before[0][2]};
+        float b2 [3] = {before[2][0] - before[0][0], before[2][1] - before[0][1], before[2][2] - before[0][2]};
+        float a1 [3] = {after[1][0] - after[0][0], after[1][1] - after[0][1], after[1][2] - after[0][2]};
+        float a2 [3] = {after[2][0] - after[0][0], after[2][1] - after[0][1], after[2][2] - after[0][2]};
+        mesh_lod_cross(b1, b2, nb);
+        mesh_lod_cross(a1, a2, na);
+        if (nb[0] * na[0] + nb[1] * na[1] + nb[2] * na[2] < 0.0f)
+            return true;
+    }
+    return false;
+}
+// NOTE(omid): Simplifies indices in place towards target_index_count, never past
+// max_error (relative to the mesh extent). positions: xyz floats, position_stride
+// apart, vertex_count of them. Returns the new index count; out_error gets the
+// largest collapse error as an object-space distance.
+static uint32_t
+mesh_simplify (
+    MeshSimplifyScratch * s, uint32_t * indices, uint32_t index_count,
+    float const * positions, size_t position_stride, uint32_t vertex_count,
+    uint32_t target_index_count, float max_error, float * out_error
+) {
+    *out_error = 0.0f;
+    if (index_count <= target_index_count || 0 == vertex_count)
+        return index_count;
+
+    // -- unit-cube positions, so errors are relative to the extent
+    float min [3] = {FLT_MAX, FLT_MAX, FLT_MAX}, max [3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        float const * p = reinterpret_cast<float const *>(reinterpret_cast<uint8_t const *>(positions) + v * position_stride);
+        for (uint32_t c = 0; c < 3; ++c) {
+            min[c] = p[c] < min[c] ? p[c] : min[c];
+            max[c] = p[c] > max[c] ? p[c] : max[c];
+        }
+    }
+    float extent = ::fmaxf(max[0] - min[0], ::fmaxf(max[1] - min[1], max[2] - min[2]));
+    float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        float const * p = reinterpret_cast<float const *>(reinterpret_cast<uint8_t const *>(positions) + v * position_stride);
+        for (uint32_t c = 0; c < 3; ++c)
+            s->positions[v * 3 + c] = (p[c] - min[c]) * scale;
+    }
+    mesh_lod_classify(s, indices, index_count, vertex_count);
+    mesh_lod_fill_quadrics(s, indices, index_count, vertex_count);
+
+    float error_limit = max_error * max_error;
+    float result_error = 0.0f;
+    while (index_count > target_index_count) {
+        // -- triangles around each remapped vertex, for the flip test
+        ::memset(s->offsets, 0, (vertex_count + 1) * sizeof(uint32_t));
+        for (uint32_t i = 0; i < index_count; ++i)
+            ++s->offsets[s->remap[indices[i]] + 1];
+        for (uint32_t v = 0; v < vertex_count; ++v)
+            s->offsets[v + 1] += s->offsets[v];
+        for (uint32_t i = 0; i < index_count; ++i)
+            s->adjacency[s->offsets[s->remap[indices[i]]]++] = i / 3;
+        for (uint32_t v = vertex_count; v > 0; --v)
+            s->offsets[v] = s->offsets[v - 1];
+        s->offsets[0] = 0;
+
+        // -- candidate edges, each with the cheaper of its allowed directions
+        uint32_t collapse_count = 0;
+        for (uint32_t i = 0; i < index_count; ++i) {
+            uint32_t i0 = indices[i], i1 = indices[i % 3 == 2 ? i - 2 : i + 1];
+            uint8_t k0 = s->kind[i0], k1 = s->kind[i1];
+            if (!mesh_lod_can_collapse[k0][k1] && !mesh_lod_can_collapse[k1][k0])
+                continue;
+            if (mesh_lod_has_opposite[k0][k1] && s->remap[i1] > s->remap[i0])
+                continue;       // seen from the other side as well
+            if (k0 == k1 && (MeshVertexKind_Border == k0 || MeshVertexKind_Seam == k0) && s->loop[i0] != i1)
+                continue;       // both on open edges, but not on the same one
+            MeshCollapse * c = &s->collapses[collapse_count++];
+            bool both = mesh_lod_can_collapse[k0][k1] && mesh_lod_can_collapse[k1][k0];
+            c->v0 = both || mesh_lod_can_collapse[k0][k1] ? i0 : i1;
+            c->v1 = c->v0 == i0 ? i1 : i0;
+            c->bidirectional = both ? 1 : 0;
+            c->error = mesh_quadric_error(&s->quadrics[s->remap[c->v0]], &s->positions[c->v1 * 3]);
+            if (both) {
+                float reverse = mesh_quadric_error(&s->quadrics[s->remap[c->v1]], &s->positions[c->v0 * 3]);
+                if (reverse < c->error) {
+                    uint32_t t = c->v0;
+                    c->v0 = c->v1;
+                    c->v1 = t;
+                    c->error = reverse;
+                }
+            }
+        }
+        if (0 == collapse_count)
+            break;
+        ::qsort(s->collapses, collapse_count, sizeof(MeshCollapse), mesh_collapse_compare);
+
+        // -- apply the cheapest ones; a vertex takes part in at most one collapse per pass
+        for (uint32_t v = 0; v < vertex_count; ++v)
+            s->collapse_remap[v] = v;
+        ::memset(s->collapse_locked, 0, vertex_count);
+        uint32_t triangle_goal = (index_count - target_index_count) / 3;
+        uint32_t edge_goal = triangle_goal / 2;
+        // -- later collapses are often blocked by locks, so allow some slack over the goal's error
+        float error_goal = edge_goal < collapse_count ? 1.5f * s->collapses[edge_goal].error : FLT_MAX;
+        uint32_t triangles_removed = 0;
+        for (uint32_t c = 0; c < collapse_count; ++c) {
+            MeshCollapse const * collapse = &s->collapses[c];
+            if (collapse->error > error_limit || triangles_removed >= triangle_goal)
+                break;
+            if (collapse->error > error_goal && triangles_removed > triangle_goal / 10)
+                break;
+            uint32_t i0 = collapse->v0, i1 = collapse->v1;
+            uint32_t r0 = s->remap[i0], r1 = s->remap[i1];
+            if (s->collapse_locked[r0] || s->collapse_locked[r1])
+                continue;
+            if (mesh_lod_flips(s, indices, r0, r1, &s->positions[i1 * 3]))
+                continue;
+            if (MeshVertexKind_Seam == s->kind[i0]) {
+                // -- the other copy moves along the other side of the seam
+                uint32_t s0 = s->wedge[i0];
+                uint32_t s1 = s->loop[i0] == i1 ? s->loopback[s0] : s->loop[s0];
+                if (COLLADA_NONE == s1 || s->remap[s1] != r1)
+                    continue;
+                s->collapse_remap[i0] = i1;
+                s->collapse_remap[s0] = s1;
+            } else {
+                s->collapse_remap[i0] = i1;
+            }
+            s->collapse_locked[r0] = 1;
+            s->collapse_locked[r1] = 1;
+            mesh_quadric_add(&s->quadrics[r1], &s->quadrics[r0]);
+            triangles_removed += MeshVertexKind_Border == s->kind[i0] ? 1 : 2;
+            result_error = collapse->error > result_error ? collapse->error : result_error;
+        }
+        if (0 == triangles_removed)
+            break;
+
+        // -- rewrite, dropping triangles that lost a corner, and keep the open-edge loops pointing at live vertices
+        uint32_t write = 0;
+        for (uint32_t i = 0; i < index_count; i += 3) {
+            uint32_t a = s->collapse_remap[indices[i]], b = s->collapse_remap[indices[i + 1]], c = s->collapse_remap[indices[i + 2]];
+            if (a == b || b == c || c == a)
+                continue;
+            indices[write++] = a;
+            indices[write++] = b;
+            indices[write++] = c;
+        }
+        index_count = write;
+        for (uint32_t v = 0; v < vertex_count; ++v) {
+            if (COLLADA_NONE != s->loop[v]) {
+                uint32_t l = s->loop[v], r = s->collapse_remap[l];
+                s->loop[v] = v == r ? s->loop[l] : r;
+            }
+            if (COLLADA_NONE != s->loopback[v]) {
+                uint32_t l = s->loopback[v], r = s->collapse_remap[l];
+                s->loopback[v] = v == r ? s->loopback[l] : r;
+            }
+        }
+    }
+    *out_error = ::sqrtf(result_error) * extent;
+    return index_count;
+}
+
+// =========================================================================================================
+// -- chains
+
+struct MeshLodLevel {
+    uint32_t                        first_index;    // into MeshLodSet::indices; relative to the mesh's first vertex
+    uint32_t                        index_count;
+    float                           error;          // object space
+};
+struct MeshLodChain {
+    MeshLodLevel                    levels [MESH_LOD_MAX_LEVELS];   // 0 is the full mesh
+    uint32_t                        level_count;
+    float                           center [3];     // bounding sphere of the mesh
+    float                           radius;
+};
+struct MeshLodSet {
+    uint32_t *                      indices;
+    uint32_t                        index_count;
+    MeshLodChain *                  chains;         // parallel to ColladaScene::meshes
+    uint32_t                        chain_count;
+};
+// NOTE(omid): Picks the coarsest level whose error stays under max_pixel_error
+// once projected. projection_scale is viewport height / (2 tan(fov_y / 2));
+// distance is from the eye to the sphere center, in the mesh's space (divide by
+// the node scale first). Inside the sphere it is always level 0.
+static uint32_t
+mesh_lod_select (MeshLodChain const * chain, float distance, float projection_scale, float max_pixel_error) {
+    float to_surface = distance - chain->radius;
+    if (to_surface <= 0.0f || chain->radius <= 0.0f)
+        return 0;
+    // -- projected radius in pixels; a level's error takes the same fraction of it as of the radius
+    float projected_radius = chain->radius * projection_scale / to_surface;
+    uint32_t level = 0;
+    for (uint32_t l = 1; l < chain->level_count; ++l) {
+        if (chain->levels[l].error / chain->radius * projected_radius > max_pixel_error)
+            break;
+        level = l;
+    }
+    return level;
+}
+
+struct MeshLodBuild {
+    uint32_t *                      indices;        // all levels back to back
+    uint32_t                        index_count;
+    MeshLodChain                    chain;
+    double                          ms;
+    bool                            ok;
+};
+static bool
+mesh_lod_build_chain (ColladaScene const * scene, ColladaMesh const * mesh, MeshLodBuild * build) {
+    uint32_t index_count = mesh->index_count;
+    uint32_t vertex_count = mesh->vertex_count;
+    uint32_t const * source = scene->indices + mesh->first_index;
+    ColladaVertex const * vertices = scene->vertices + mesh->first_vertex;
+    MeshLodChain * chain = &build->chain;
+    ::memset(chain, 0, sizeof(*chain));
+    for (uint32_t c = 0; c < 3; ++c)
+        chain->center[c] = 0.5f * (mesh->bounds_min[c] + mesh->bounds_max[c]);
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        float const * p = vertices[v].position;
+        float d [3] = {p[0] - chain->center[0], p[1] - chain->center[1], p[2] - chain->center[2]};
+        chain->radius = ::fmaxf(chain->radius, ::sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]));
+    }
+
+    // -- every level fits in 2x the full mesh (each at most half of the previous)
+    build->indices = reinterpret_cast<uint32_t *>(::malloc((size_t)index_count * 2 * sizeof(uint32_t) + sizeof(uint32_t)));
+    uint32_t * work = reinterpret_cast<uint32_t *>(::malloc((size_t)index_count * sizeof(uint32_t) + sizeof(uint32_t)));
+    uint32_t * optimized = reinterpret_cast<uint32_t *>(::malloc((size_t)index_count * sizeof(uint32_t) + sizeof(uint32_t)));
+    MeshSimplifyScratch scratch = {};
+    bool ok = build->indices && work && optimized && mesh_simplify_scratch_create(&scratch, vertex_count, index_count);
+
+    // -- tipsify scratch after the simplifier's (only used between simplify calls)
+    uint32_t * tipsify_memory = ok ? reinterpret_cast<uint32_t *>(::malloc(((size_t)vertex_count * 3 + 1 + (size_t)index_count * 4) * sizeof(uint32_t) + index_count / 3 + 1)) : nullptr;
+    ok = ok && tipsify_memory;
+    if (ok) {
+        ::memcpy(build->indices, source, index_count * sizeof(uint32_t));
+        chain->levels[0] = {0, index_count, 0.0f};
+        chain->level_count = 1;
+        build->index_count = index_count;
+
+        MeshTipsifyScratch tipsify = {};
+        tipsify.offsets = tipsify_memory;
+        tipsify.adjacency = tipsify.offsets + vertex_count + 1;
+        tipsify.live = tipsify.adjacency + index_count;
+        tipsify.stamps = tipsify.live + vertex_count;
+        tipsify.dead_ends = tipsify.stamps + vertex_count;
+        tipsify.candidates = tipsify.dead_ends + index_count;
+        uint32_t * clusters = tipsify.candidates + index_count;
+        tipsify.emitted = reinterpret_cast<uint8_t *>(clusters + index_count / 3);
+
+        uint32_t previous = index_count;
+        while (chain->level_count < MESH_LOD_MAX_LEVELS) {
+            uint32_t target = (uint32_t)((float)previous * MESH_LOD_RATIO) / 3 * 3;
+            if (target < 3)
+                break;
+            ::memcpy(work, source, index_count * sizeof(uint32_t));
+            float error = 0.0f;
+            uint32_t count = mesh_simplify(
+                &scratch, work, index_count, vertices->position, sizeof(ColladaVertex), vertex_count,
+                target, MESH_LOD_MAX_ERROR, &error
+            );
+            if ((float)count > (float)previous * MESH_LOD_MIN_REDUCTION)
+                break;      // stuck on locked vertices or the error limit
+            mesh_tipsify(work, count, vertex_count, MESH_OPT_CACHE_SIZE, &tipsify, optimized, clusters);
+            ::memcpy(build->indices + build->index_count, optimized, count * sizeof(uint32_t));
+            chain->levels[chain->level_count++] = {build->index_count, count, error};
+            build->index_count += count;
+            previous = count;
+        }
+    }
+    mesh_simplify_scratch_destroy(&scratch);
+    ::free(tipsify_memory);
+    ::free(optimized);
+    ::free(work);
+    return ok;
+}
+static void
+mesh_lod_worker (ColladaScene const * scene, MeshLodBuild * builds, std::atomic<uint32_t> * next) {
+    for (;;) {
+        uint32_t m = next->fetch_add(1);
+        if (m >= scene->mesh_count)
+            return;
+        auto begin = std::chrono::steady_clock::now();
+        builds[m].ok = mesh_lod_build_chain(scene, &scene->meshes[m], &builds[m]);
+        builds[m].ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    }
+}
+static void
+mesh_lod_set_destroy (MeshLodSet * set) {
+    ::free(set->indices);
+    ::free(set->chains);
+    ::memset(set, 0, sizeof(*set));
+}
+// NOTE(omid): Builds a chain for every mesh of the scene, one mesh per job on up to
+// thread_count threads (0: one per core), and prints triangles and error per level.
+static bool
+mesh_lod_set_create (ColladaScene const * scene, MeshLodSet * set, uint32_t thread_count) {
+    ::memset(set, 0, sizeof(*set));
+    if (0 == scene->mesh_count)
+        return false;
+    if (0 == thread_count)
+        thread_count = std::thread::hardware_concurrency();
+    if (thread_count < 1)
+        thread_count = 1;
+    if (thread_count > MESH_LOD_MAX_THREADS)
+        thread_count = MESH_LOD_MAX_THREADS;
+    if (thread_count > scene->mesh_count)
+        thread_count = scene->mesh_count;
+    MeshLodBuild * builds = reinterpret_cast<MeshLodBuild *>(::calloc(scene->mesh_count, sizeof(MeshLodBuild)));
+    if (!builds)
+        return false;
+
+    auto begin = std::chrono::steady_clock::now();
+    std::atomic<uint32_t> next(0);
+    std::thread workers [MESH_LOD_MAX_THREADS];
+    for (uint32_t t = 1; t < thread_count; ++t)
+        workers[t] = std::thread(mesh_lod_worker, scene, builds, &next);
+    mesh_lod_worker(scene, builds, &next);
+    for (uint32_t t = 1; t < thread_count; ++t)
+        workers[t].join();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+    // -- gather into one index pool, in mesh order
+    bool ok = true;
+    uint64_t total = 0;
+    for (uint32_t m = 0; m < scene->mesh_count; ++m) {
+        ok = ok && builds[m].ok;
+        total += builds[m].index_count;
+    }
+    set->chains = ok ? reinterpret_cast<MeshLodChain *>(::calloc(scene->mesh_count, sizeof(MeshLodChain))) : nullptr;
+    set->indices = ok ? reinterpret_cast<uint32_t *>(::malloc((size_t)total * sizeof(uint32_t) + sizeof(uint32_t))) : nullptr;
+    ok = ok && set->chains && set->indices && total <= 0xffffffffull;
+    if (ok) {
+        set->chain_count = scene->mesh_count;
+        for (uint32_t m = 0; m < scene->mesh_count; ++m) {
+            MeshLodChain * chain = &set->chains[m];
+            *chain = builds[m].chain;
+            for (uint32_t l = 0; l < chain->level_count; ++l)
+                chain->levels[l].first_index += set->index_count;
+            ::memcpy(set->indices + set->index_count, builds[m].indices, builds[m].index_count * sizeof(uint32_t));
+            set->index_count += builds[m].index_count;
+        }
+        ::printf("Mesh LODs: %u meshes on %u threads in %.2f ms, %u indices in all levels\n", scene->mesh_count, thread_count, ms, set->index_count);
+        for (uint32_t m = 0; m < scene->mesh_count; ++m) {
+            MeshLodChain const * chain = &set->chains[m];
+            char line [256] = {};
+            int len = 0;
+            for (uint32_t l = 0; l < chain->level_count && len < (int)sizeof(line); ++l) {
+                len += ::snprintf(
+                    line + len, sizeof(line) - len, "%s%u tris (%.2f%%)", l ? " | " : "",
+                    chain->levels[l].index_count / 3, chain->radius > 0.0f ? 100.0f * chain->levels[l].error / chain->radius : 0.0f
+                );
+            }
+            ::printf("  %-10s %.2f ms: %s\n", scene->meshes[m].name, builds[m].ms, line);
+        }
+    } else {
+        ::printf("Mesh LODs: not built (out of memory)\n");
+        mesh_lod_set_destroy(set);
+    }
+    for (uint32_t m = 0; m < scene->mesh_count; ++m)
+        ::free(builds[m].indices);
+    ::free(builds);
+    return ok;
+}
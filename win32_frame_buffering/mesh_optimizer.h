@@ -0,0 +1,435 @@
+#pragma once
+
+// NOTE(omid): Index / vertex reordering for imported meshes, after Sander, Nehab and
+// Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (2007):
+//   1. tipsify: linear-time reordering for the post-transform vertex cache; it fans
+//      around one vertex at a time and only jumps elsewhere at dead ends, which also
+//      splits the mesh into clusters
+//   2. overdraw: clusters are split further where their own cache efficiency is
+//      already good, then sorted so outward-facing clusters far from the centroid
+//      come first and tend to occlude the rest (view-independent)
+//   3. vertex fetch: vertices are renumbered and moved in first-use order, so the
+//      vertex buffer is read front to back
+// ACMR (cache misses per triangle) and ATVR (misses per vertex, 1.0 is the optimum)
+// come from a FIFO cache simulation. A scene is optimized one mesh per job on
+// a few threads, because meshes own disjoint vertex / index ranges.
+
+#include "collada_loader.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#define MESH_OPT_CACHE_SIZE             16      // fifo entries the passes and the stats assume
+#define MESH_OPT_OVERDRAW_THRESHOLD     1.05f   // cluster split once its acmr is within 5% of the mesh's
+#define MESH_OPT_MAX_THREADS            8
+
+struct MeshCacheStats {
+    uint32_t                        triangles;
+    uint32_t                        vertices;       // referenced ones
+    uint32_t                        misses;
+};
+static float
+mesh_acmr (MeshCacheStats const * s) {
+    return s->triangles ? (float)s->misses / (float)s->triangles : 0.0f;
+}
+static float
+mesh_atvr (MeshCacheStats const * s) {
+    return s->vertices ? (float)s->misses / (float)s->vertices : 0.0f;
+}
+// -- stamps: vertex_count scratch entries
+static MeshCacheStats
+mesh_simulate_fifo (uint32_t const * indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size, uint32_t * stamps) {
+    MeshCacheStats stats = {};
+    stats.triangles = index_count / 3;
+    ::memset(stamps, 0, vertex_count * sizeof(uint32_t));
+    uint32_t time = cache_size + 1;     // a stamp of 0 is always out of the cache
+    for (uint32_t i = 0; i < index_count; ++i) {
+        uint32_t v = indices[i];
+        stats.vertices += 0 == stamps[v] ? 1 : 0;
+        if (time - stamps[v] > cache_size) {
+            stamps[v] = time++;
+            ++stats.misses;
+        }
+    }
+    return stats;
+}
+
+// =========================================================================================================
+// -- tipsify
+
+// -- vertex -> triangles adjacency; offsets has vertex_count + 1 entries, triangles index_count
+static void
+mesh_build_adjacency (uint32_t const * indices, uint32_t index_count, uint32_t vertex_count, uint32_t * offsets, uint32_t * triangles) {
+    ::memset(offsets, 0, (vertex_count + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < index_count; ++i)
+        ++offsets[indices[i] + 1];
+    for (uint32_t v = 0; v < vertex_count; ++v)
+        offsets[v + 1] += offsets[v];
+    for (uint32_t i = 0; i < index_count; ++i)
+        triangles[offsets[indices[i]]++] = i / 3;
+    // -- the fill advanced every offset to the next one's start; shift back
+    for (uint32_t v = vertex_count; v > 0; --v)
+        offsets[v] = offsets[v - 1];
+    offsets[0] = 0;
+}
+struct MeshTipsifyScratch {
+    uint32_t *                      offsets;        // vertex_count + 1
+    uint32_t *                      adjacency;      // index_count
+    uint32_t *                      live;           // vertex_count, live triangles per vertex
+    uint32_t *                      stamps;         // vertex_count
+    uint32_t *                      dead_ends;      // index_count
+    uint32_t *                      candidates;     // index_count
+    uint8_t *                       emitted;        // triangle_count
+};
+// NOTE(omid): Writes the reordered triangles to out_indices and the first triangle
+// of every cluster to out_clusters (triangle_count entries at most); returns the
+// cluster count. A new cluster starts wherever the fan had to jump to a vertex
+// that is not in the cache any more.
+static uint32_t
+mesh_tipsify (
+    uint32_t const * indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size,
+    MeshTipsifyScratch * scratch, uint32_t * out_indices, uint32_t * out_clusters
+) {
+    uint32_t triangle_count = index_count / 3;
+    if (0 == triangle_count)
+        return 0;
+    mesh_build_adjacency(indices, index_count, vertex_count, scratch->offsets, scratch->adjacency);
+    for (uint32_t v = 0; v < vertex_count; ++v)
+        scratch->live[v] = scratch->offsets[v + 1] - scratch->offsets[v];
+    ::memset(scratch->stamps, 0, vertex_count * sizeof(uint32_t));
+    ::memset(scratch->emitted, 0, triangle_count);
+
+    uint32_t dead_end_count = 0;
+    uint32_t time = cache_size + 1;
+    uint32_t cursor = 0;                // next vertex to try once dead ends run out
+    uint32_t out_count = 0;
+    uint32_t cluster_count = 0;
+    uint32_t fan = indices[0];
+    bool jumped = true;
+    while (COLLADA_NONE != fan) {
+        if (jumped)
+            out_clusters[cluster_count++] = out_count / 3;
+        uint32_t candidate_count = 0;
+        for (uint32_t a = scratch->offsets[fan]; a < scratch->offsets[fan + 1]; ++a) {
+            uint32_t t = scratch->adjacency[a];
+            if (scratch->emitted[t])
+                continue;
+            scratch->emitted[t] = 1;
+            for (uint32_t k = 0; k < 3; ++k) {
+                uint32_t v = indices[t * 3 + k];
+                out_indices[out_count++] = v;
+                scratch->dead_ends[dead_end_count++] = v;
+                scratch->candidates[candidate_count++] = v;
+                --scratch->live[v];
+                if (time - scratch->stamps[v] > cache_size)
+                    scratch->stamps[v] = time++;
+            }
+        }
+        // -- next fan: the candidate that stays in the cache longest while it still has triangles
+        uint32_t best = COLLADA_NONE;
+        int best_priority = -1;
+        for (uint32_t c = 0; c < candidate_count; ++c) {
+            uint32_t v = scratch->candidates[c];
+            if (0 == scratch->live[v])
+                continue;
+            int priority = 0;
+            int age = (int)(time - scratch->stamps[v]);
+            if (age + 2 * (int)scratch->live[v] <= (int)cache_size)
+                priority = age;
+            if (priority > best_priority) {
+                best_priority = priority;
+                best = v;
+            }
+        }
+        jumped = COLLADA_NONE == best;
+        if (jumped) {
+            // -- dead end: most recent vertex that still has work, else scan forward
+            while (dead_end_count > 0 && COLLADA_NONE == best) {
+                uint32_t v = scratch->dead_ends[--dead_end_count];
+                if (scratch->live[v] > 0)
+                    best = v;
+            }
+            while (COLLADA_NONE == best && cursor < index_count) {
+                uint32_t v = indices[cursor++];
+                if (scratch->live[v] > 0)
+                    best = v;
+            }
+            // -- a dead-end vertex can still be in the cache; only a real jump breaks the cluster
+            jumped = COLLADA_NONE != best && time - scratch->stamps[best] > cache_size;
+        }
+        fan = best;
+    }
+    return cluster_count;
+}
+
+// =========================================================================================================
+// -- overdraw
+
+struct MeshCluster {
+    uint32_t                        first_triangle;
+    uint32_t                        triangle_count;
+    float                           sort_key;
+};
+static void
+mesh_triangle_centroid_normal (
+    uint32_t const * tri, float const * positions, size_t position_stride, float * centroid, float * area_normal
+) {
+    float const * p [3];
+    for (uint32_t k = 0; k < 3; ++k)
+        p[k] = reinterpret_cast<float const *>(reinterpret_cast<uint8_t const *>(positions) + tri[k] * position_stride);
+    float e1 [3] = {p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2]};
+    float e2 [3] = {p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2]};
+    area_normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    area_normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    area_normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    for (uint32_t c = 0; c < 3; ++c)
+        centroid[c] = (p[0][c] + p[1][c] + p[2][c]) / 3.0f;
+}
+static int
+mesh_cluster_compare (void const * a, void const * b) {
+    MeshCluster const * ca = reinterpret_cast<MeshCluster const *>(a);
+    MeshCluster const * cb = reinterpret_cast<MeshCluster const *>(b);
+    if (ca->sort_key != cb->sort_key)
+        return ca->sort_key > cb->sort_key ? -1 : 1;
+    return ca->first_triangle < cb->first_triangle ? -1 : 1;   // keep qsort deterministic
+}
+// NOTE(omid): indices must come out of mesh_tipsify with its clusters. Soft splits
+// happen where a cluster's running acmr drops to threshold * the mesh's, so
+// sorting costs little cache efficiency. positions: xyz floats, position_stride apart.
+// scratch: index_count + vertex_count uint32s; clusters: room for triangle_count.
+static void
+mesh_optimize_overdraw (
+    uint32_t * indices, uint32_t index_count, uint32_t vertex_count,
+    float const * positions, size_t position_stride,
+    uint32_t const * hard_clusters, uint32_t hard_cluster_count,
+    uint32_t cache_size, float threshold, MeshCluster * clusters, uint32_t * scratch
+) {
+    uint32_t triangle_count = index_count / 3;
+    if (triangle_count < 2)
+        return;
+    uint32_t * stamps = scratch;
+    uint32_t * reordered = scratch + vertex_count;
+    MeshCacheStats whole = mesh_simulate_fifo(indices, index_count, vertex_count, cache_size, stamps);
+    float target_acmr = threshold * mesh_acmr(&whole);
+
+    // -- soft splits inside every hard cluster (fresh simulated cache per cluster)
+    uint32_t cluster_count = 0;
+    ::memset(stamps, 0, vertex_count * sizeof(uint32_t));
+    uint32_t time = cache_size + 1;
+    for (uint32_t h = 0; h < hard_cluster_count; ++h) {
+        uint32_t begin = hard_clusters[h];
+        uint32_t end = h + 1 < hard_cluster_count ? hard_clusters[h + 1] : triangle_count;
+        uint32_t start = begin, misses = 0;
+        time += cache_size + 1;         // flush
+        for (uint32_t t = begin; t < end; ++t) {
+            for (uint32_t k = 0; k < 3; ++k) {
+                uint32_t v = indices[t * 3 + k];
+                if (time - stamps[v] > cache_size) {
+                    stamps[v] = time++;
+                    ++misses;
+                }
+            }
+            if (t + 1 < end && (float)misses <= target_acmr * (float)(t + 1 - start)) {
+                clusters[cluster_count++] = {start, t + 1 - start, 0.0f};
+                start = t + 1;
+                misses = 0;
+                time += cache_size + 1;
+            }
+        }
+        clusters[cluster_count++] = {start, end - start, 0.0f};
+    }
+
+    // -- mesh centroid, then every cluster's distance from it along its own normal
+    float mesh_centroid [3] = {};
+    float mesh_area = 0.0f;
+    for (uint32_t t = 0; t < triangle_count; ++t) {
+        float centroid [3], normal [3];
+        mesh_triangle_centroid_normal(indices + t * 3, positions, position_stride, centroid, normal);
+        float area = ::sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        for (uint32_t c = 0; c < 3; ++c)
+            mesh_centroid[c] += centroid[c] * area;
+        mesh_area += area;
+    }
+    for (uint32_t c = 0; c < 3 && mesh_area > 0.0f; ++c)
+        mesh_centroid[c] /= mesh_area;
+    for (uint32_t i = 0; i < cluster_count; ++i) {
+        MeshCluster * cluster = &clusters[i];
+        float centroid [3] = {}, normal [3] = {};
+        float area = 0.0f;
+        for (uint32_t t = cluster->first_triangle; t < cluster->first_triangle + cluster->triangle_count; ++t) {
+            float tc [3], tn [3];
+            mesh_triangle_centroid_normal(indices + t * 3, positions, position_stride, tc, tn);
+            float ta = ::sqrtf(tn[0] * tn[0] + tn[1] * tn[1] + tn[2] * tn[2]);
+            for (uint32_t c = 0; c < 3; ++c) {
+                centroid[c] += tc[c] * ta;
+                normal[c] += tn[c];
+            }
+            area += ta;
+        }
+        float normal_length = ::sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        cluster->sort_key = 0.0f;
+        if (area > 0.0f && normal_length > 0.0f) {
+            for (uint32_t c = 0; c < 3; ++c)
+                cluster->sort_key += (centroid[c] / area - mesh_centroid[c]) * normal[c] / normal_length;
+        }
+    }
+    ::qsort(clusters, cluster_count, sizeof(MeshCluster), mesh_cluster_compare);
+
+    uint32_t out_count = 0;
+    for (uint32_t i = 0; i < cluster_count; ++i) {
+        ::memcpy(reordered + out_count, indices + clusters[i].first_triangle * 3, clusters[i].triangle_count * 3 * sizeof(uint32_t));
+        out_count += clusters[i].triangle_count * 3;
+    }
+    ::memcpy(indices, reordered, index_count * sizeof(uint32_t));
+}
+
+// =========================================================================================================
+// -- vertex fetch
+
+// NOTE(omid): Renumbers vertices in first-use order and moves them to match;
+// unreferenced vertices go to the end. remap: vertex_count uint32s, vertex_scratch:
+// vertex_count * vertex_stride bytes. Returns the number of referenced vertices.
+static uint32_t
+mesh_optimize_vertex_fetch (
+    void * vertices, size_t vertex_stride, uint32_t vertex_count, uint32_t * indices, uint32_t index_count,
+    uint32_t * remap, void * vertex_scratch
+) {
+    ::memset(remap, 0xff, vertex_count * sizeof(uint32_t));
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < index_count; ++i) {
+        uint32_t v = indices[i];
+        if (COLLADA_NONE == remap[v])
+            remap[v] = next++;
+        indices[i] = remap[v];
+    }
+    uint32_t referenced = next;
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        if (COLLADA_NONE == remap[v])
+            remap[v] = next++;
+    }
+    uint8_t const * src = reinterpret_cast<uint8_t const *>(vertices);
+    uint8_t * dst = reinterpret_cast<uint8_t *>(vertex_scratch);
+    for (uint32_t v = 0; v < vertex_count; ++v)
+        ::memcpy(dst + remap[v] * vertex_stride, src + v * vertex_stride, vertex_stride);
+    ::memcpy(vertices, vertex_scratch, vertex_count * vertex_stride);
+    return referenced;
+}
+
+// =========================================================================================================
+// -- scene
+
+struct MeshOptimizeResult {
+    MeshCacheStats                  before;
+    MeshCacheStats                  after;
+    uint32_t                        clusters;
+    bool                            ok;
+};
+// -- all three passes on one mesh of the scene; false if scratch memory ran out (mesh untouched)
+static bool
+mesh_optimize (ColladaScene * scene, ColladaMesh const * mesh, MeshOptimizeResult * result) {
+    uint32_t vertex_count = mesh->vertex_count;
+    uint32_t index_count = mesh->index_count;
+    uint32_t triangle_count = index_count / 3;
+    uint32_t * indices = scene->indices + mesh->first_index;
+    ColladaVertex * vertices = scene->vertices + mesh->first_vertex;
+
+    // -- one allocation for every pass
+    size_t words = (size_t)(vertex_count + 1) + index_count + vertex_count * 2 + index_count * 2 + triangle_count + index_count + vertex_count;
+    size_t bytes = words * sizeof(uint32_t) + triangle_count + triangle_count * sizeof(MeshCluster) + (size_t)vertex_count * sizeof(ColladaVertex) + 16;
+    uint8_t * memory = reinterpret_cast<uint8_t *>(::malloc(bytes));
+    if (!memory)
+        return false;
+    uint32_t * words_begin = reinterpret_cast<uint32_t *>(memory);
+    MeshTipsifyScratch scratch = {};
+    scratch.offsets = words_begin;
+    scratch.adjacency = scratch.offsets + vertex_count + 1;
+    scratch.live = scratch.adjacency + index_count;
+    scratch.stamps = scratch.live + vertex_count;
+    scratch.dead_ends = scratch.stamps + vertex_count;
+    scratch.candidates = scratch.dead_ends + index_count;
+    uint32_t * hard_clusters = scratch.candidates + index_count;
+    uint32_t * tipsified = hard_clusters + triangle_count;         // index_count, then reused as overdraw scratch
+    uint32_t * remap = tipsified + index_count;                     // vertex_count
+    uint8_t * tail = reinterpret_cast<uint8_t *>(remap + vertex_count);
+    MeshCluster * clusters = reinterpret_cast<MeshCluster *>(tail);
+    ColladaVertex * vertex_scratch = reinterpret_cast<ColladaVertex *>(clusters + triangle_count);
+    scratch.emitted = reinterpret_cast<uint8_t *>(vertex_scratch + vertex_count);
+
+    result->before = mesh_simulate_fifo(indices, index_count, vertex_count, MESH_OPT_CACHE_SIZE, scratch.stamps);
+    uint32_t hard_count = mesh_tipsify(indices, index_count, vertex_count, MESH_OPT_CACHE_SIZE, &scratch, tipsified, hard_clusters);
+    ::memcpy(indices, tipsified, index_count * sizeof(uint32_t));
+    // -- tipsify's scratch is free again: adjacency onwards has index_count + vertex_count words to spare
+    mesh_optimize_overdraw(
+        indices, index_count, vertex_count, vertices->position, sizeof(ColladaVertex),
+        hard_clusters, hard_count, MESH_OPT_CACHE_SIZE, MESH_OPT_OVERDRAW_THRESHOLD, clusters, scratch.adjacency
+    );
+    mesh_optimize_vertex_fetch(vertices, sizeof(ColladaVertex), vertex_count, indices, index_count, remap, vertex_scratch);
+    result->after = mesh_simulate_fifo(indices, index_count, vertex_count, MESH_OPT_CACHE_SIZE, scratch.stamps);
+    result->clusters = hard_count;
+    ::free(memory);
+    return true;
+}
+static void
+mesh_optimize_worker (ColladaScene * scene, MeshOptimizeResult * results, std::atomic<uint32_t> * next) {
+    for (;;) {
+        uint32_t m = next->fetch_add(1);
+        if (m >= scene->mesh_count)
+            return;
+        results[m].ok = mesh_optimize(scene, &scene->meshes[m], &results[m]);
+    }
+}
+// NOTE(omid): Optimizes every mesh of the scene in place, one mesh per job on up
+// to thread_count threads (0: one per core), and prints ACMR / ATVR before and after.
+static void
+mesh_optimize_scene (ColladaScene * scene, uint32_t thread_count) {
+    if (0 == scene->mesh_count)
+        return;
+    if (0 == thread_count)
+        thread_count = std::thread::hardware_concurrency();
+    if (thread_count < 1)
+        thread_count = 1;
+    if (thread_count > MESH_OPT_MAX_THREADS)
+        thread_count = MESH_OPT_MAX_THREADS;
+    if (thread_count > scene->mesh_count)
+        thread_count = scene->mesh_count;
+    MeshOptimizeResult * results = reinterpret_cast<MeshOptimizeResult *>(::calloc(scene->mesh_count, sizeof(MeshOptimizeResult)));
+    if (!results)
+        return;
+
+    auto begin = std::chrono::steady_clock::now();
+    std::atomic<uint32_t> next(0);
+    std::thread workers [MESH_OPT_MAX_THREADS];
+    for (uint32_t t = 1; t < thread_count; ++t)
+        workers[t] = std::thread(mesh_optimize_worker, scene, results, &next);
+    mesh_optimize_worker(scene, results, &next);
+    for (uint32_t t = 1; t < thread_count; ++t)
+        workers[t].join();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+    MeshCacheStats before = {}, after = {};
+    uint32_t failed = 0, clusters = 0;
+    for (uint32_t m = 0; m < scene->mesh_count; ++m) {
+        MeshOptimizeResult const * r = &results[m];
+        if (!r->ok) {
+            ++failed;
+            continue;
+        }
+        before.triangles += r->before.triangles;
+        before.vertices += r->before.vertices;
+        before.misses += r->before.misses;
+        after.triangles += r->after.triangles;
+        after.vertices += r->after.vertices;
+        after.misses += r->after.misses;
+        clusters += r->clusters;
+    }
+    ::printf(
+        "Mesh optimize: %u meshes on %u threads in %.2f ms, %u tipsify clusters, fifo %u: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f%s\n",
+        scene->mesh_count - failed, thread_count, ms, clusters, MESH_OPT_CACHE_SIZE,
+        mesh_acmr(&before), mesh_acmr(&after), mesh_atvr(&before), mesh_atvr(&after), failed ? " (some meshes skipped: out of memory)" : ""
+    );
+    ::free(results);
+}
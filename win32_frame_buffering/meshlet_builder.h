@@ -0,0 +1,583 @@
+#pragma once
+
+// NOTE(omid): Meshlets: every imported mesh is cut into clusters of at most 64
+// vertices and 124 triangles (the usual mesh shader sweet spot: 124 * 3 local
+// indices stay under 384 bytes, 64 vertices fit one or two waves).
+//
+// Layout, one set for the whole scene:
+//   Meshlet          12 bytes: offsets into the two streams below, counts, owning mesh
+//   MeshletBounds    32 bytes: bounding sphere, normal cone apex, snorm8 cone axis and cutoff
+//   vertices         uint32 per meshlet vertex, index into the scene's vertex buffer
+//   triangles        3 bytes per triangle (meshlet-local indices), each meshlet 4-byte aligned
+// shaders/meshlet.hlsli reads the same layout from ByteAddressBuffers.
+//
+// Building is greedy: a meshlet starts at the first triangle not yet emitted
+// and keeps taking the neighbour (through shared positions, so it crosses uv
+// seams) that adds the fewest new vertices, then the one closest to the meshlet's
+// center and normal. Meshes are built one per job like the LODs.
+//
+// Cone culling: a meshlet is back facing for every eye in the cone behind its
+// apex; meshlet_cone_culled uses the quantized axis and cutoff, which are
+// rounded so the test stays conservative.
+
+#include "collada_loader.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#define MESHLET_MAX_VERTICES        64
+#define MESHLET_MAX_TRIANGLES       124
+#define MESHLET_CONE_WEIGHT         0.25f   // 0: pick neighbours by distance only
+#define MESHLET_NO_CONE             127     // cone_cutoff value of a meshlet that can't be cone culled
+#define MESHLET_MAX_THREADS         8
+#define MESHLET_CULL_VIEWS          64      // eye positions on a sphere around each mesh, for the stats
+
+struct Meshlet {
+    uint32_t                        vertex_offset;      // into MeshletSet::vertices
+    uint32_t                        triangle_offset;    // bytes into MeshletSet::triangles, multiple of 4
+    uint8_t                         vertex_count;
+    uint8_t                         triangle_count;
+    uint16_t                        mesh;               // ColladaScene::meshes
+};
+struct MeshletBounds {
+    float                           center [3];
+    float                           radius;
+    float                           cone_apex [3];
+    int8_t                          cone_axis [3];      // snorm8, normalize before use
+    int8_t                          cone_cutoff;        // snorm8 sin of the cone's half angle, rounded up
+};
+static_assert(sizeof(Meshlet) == 12, "Meshlet layout is shared with meshlet.hlsli");
+static_assert(sizeof(MeshletBounds) == 32, "MeshletBounds layout is shared with meshlet.hlsli");
+
+struct MeshletSet {
+    Meshlet *                       meshlets;
+    MeshletBounds *                 bounds;             // parallel to meshlets
+    uint32_t                        meshlet_count;
+    uint32_t *                      vertices;
+    uint32_t                        vertex_count;
+    uint8_t *                       triangles;
+    uint32_t                        triangle_bytes;
+    uint32_t *                      mesh_first_meshlet; // mesh_count + 1 entries
+    uint32_t                        mesh_count;
+};
+
+static float
+meshlet_dot (float const * a, float const * b) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+static float
+meshlet_normalize (float * v) {
+    float length = ::sqrtf(meshlet_dot(v, v));
+    if (length > 0.0f) {
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+    }
+    return length;
+}
+// -- true when the whole meshlet faces away from eye (same space as the bounds)
+static bool
+meshlet_cone_culled (MeshletBounds const * b, float const * eye) {
+    if (b->cone_cutoff >= MESHLET_NO_CONE)
+        return false;
+    float axis [3] = {(float)b->cone_axis[0], (float)b->cone_axis[1], (float)b->cone_axis[2]};
+    meshlet_normalize(axis);
+    float d [3] = {b->cone_apex[0] - eye[0], b->cone_apex[1] - eye[1], b->cone_apex[2] - eye[2]};
+    return meshlet_dot(d, axis) >= (float)b->cone_cutoff / 127.0f * ::sqrtf(meshlet_dot(d, d));
+}
+
+// -- per mesh work arrays, carved from one allocation
+struct MeshletScratch {
+    uint32_t *                      position_ids;       // vertex -> first vertex with the same position
+    uint32_t *                      offsets;            // vertex_count + 1: triangles around each position
+    uint32_t *                      adjacency;          // index_count
+    uint32_t *                      live;               // triangles left per vertex
+    uint32_t *                      table;              // position hash, table_size
+    uint32_t                        table_size;
+    float *                         normals;            // 3 per triangle, zero for degenerate ones
+    float *                         centroids;          // 3 per triangle
+    uint8_t *                       emitted;            // triangle_count
+    uint8_t *                       local;              // vertex -> meshlet-local index, 0xff if not in the current meshlet
+    void *                          memory;
+};
+static bool
+meshlet_scratch_create (MeshletScratch * s, uint32_t vertex_count, uint32_t index_count) {
+    ::memset(s, 0, sizeof(*s));
+    uint32_t triangle_count = index_count / 3;
+    s->table_size = 64;
+    while (s->table_size < vertex_count * 2)
+        s->table_size *= 2;
+    size_t v = vertex_count, t = triangle_count;
+    size_t bytes =
+        v * sizeof(uint32_t) + (v + 1) * sizeof(uint32_t) + (size_t)index_count * sizeof(uint32_t) + v * sizeof(uint32_t) +
+        s->table_size * sizeof(uint32_t) + t * 6 * sizeof(float) + t + v + 16 * 10;
+    uint8_t * memory = reinterpret_cast<uint8_t *>(::malloc(bytes));
+    if (!memory)
+        return false;
+    s->memory = memory;
+    auto carve = [&memory] (size_t size) {
+        void * p = memory;
+        memory += (size + 15) & ~(size_t)15;
+        return p;
+    };
+    s->position_ids = reinterpret_cast<uint32_t *>(carve(v * sizeof(uint32_t)));
+    s->offsets = reinterpret_cast<uint32_t *>(carve((v + 1) * sizeof(uint32_t)));
+    s->adjacency = reinterpret_cast<uint32_t *>(carve((size_t)index_count * sizeof(uint32_t)));
+    s->live = reinterpret_cast<uint32_t *>(carve(v * sizeof(uint32_t)));
+    s->table = reinterpret_cast<uint32_t *>(carve(s->table_size * sizeof(uint32_t)));
+    s->normals = reinterpret_cast<float *>(carve(t * 3 * sizeof(float)));
+    s->centroids = reinterpret_cast<float *>(carve(t * 3 * sizeof(float)));
+    s->emitted = reinterpret_cast<uint8_t *>(carve(t));
+    s->local = reinterpret_cast<uint8_t *>(carve(v));
+    return true;
+}
+static void
+meshlet_scratch_destroy (MeshletScratch * s) {
+    ::free(s->memory);
+    ::memset(s, 0, sizeof(*s));
+}
+
+// -- one mesh's meshlets; offsets are local until the set gathers them
+struct MeshletBuild {
+    Meshlet *                       meshlets;
+    MeshletBounds *                 bounds;
+    uint32_t                        meshlet_count;
+    uint32_t *                      vertices;
+    uint32_t                        vertex_count;
+    uint8_t *                       triangles;
+    uint32_t                        triangle_bytes;
+    double                          ms;
+    bool                            ok;
+};
+
+// -- sphere (Ritter) and normal cone of the meshlet just filled
+static void
+meshlet_compute_bounds (
+    ColladaVertex const * vertices, uint32_t const * meshlet_vertices, uint32_t vertex_count,
+    uint8_t const * meshlet_triangles, uint32_t triangle_count, MeshletBounds * b
+) {
+    ::memset(b, 0, sizeof(*b));
+    float const * first = vertices[meshlet_vertices[0]].position;
+    float const * far_a = first;
+    float best = -1.0f;
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        float const * p = vertices[meshlet_vertices[v]].position;
+        float d [3] = {p[0] - first[0], p[1] - first[1], p[2] - first[2]};
+        if (meshlet_dot(d, d) > best) {
+            best = meshlet_dot(d, d);
+            far_a = p;
+        }
+    }
+    float const * far_b = far_a;
+    best = -1.0f;
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        float const * p = vertices[meshlet_vertices[v]].position;
+        float d [3] = {p[0] - far_a[0], p[1] - far_a[1], p[2] - far_a[2]};
+        if (meshlet_dot(d, d) > best) {
+            best = meshlet_dot(d, d);
+            far_b = p;
+        }
+    }
+    float center [3] = {0.5f * (far_a[0] + far_b[0]), 0.5f * (far_a[1] + far_b[1]), 0.5f * (far_a[2] + far_b[2])};
+    float radius = 0.5f * ::sqrtf(best);
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        float const * p = vertices[meshlet_vertices[v]].position;
+        float d [3] = {p[0] - center[0], p[1] - center[1], p[2] - center[2]};
+        float distance = ::sqrtf(meshlet_dot(d, d));
+        if (distance > radius) {
+            // -- grow just enough to take p in
+            float grow = 0.5f * (distance - radius);
+            radius += grow;
+            for (uint32_t c = 0; c < 3; ++c)
+                center[c] += d[c] / distance * grow;
+        }
+    }
+    ::memcpy(b->center, center, sizeof(center));
+    b->radius = radius;
+    ::memcpy(b->cone_apex, center, sizeof(center));
+    b->cone_cutoff = MESHLET_NO_CONE;
+
+    // -- average normal, quantized first so the cutoff is measured against the axis the test will use
+    float normals [MESHLET_MAX_TRIANGLES][3];
+    uint32_t normal_count = 0;
+    float axis [3] = {};
+    for (uint32_t t = 0; t < triangle_count; ++t) {
+        float const * p0 = vertices[meshlet_vertices[meshlet_triangles[t * 3 + 0]]].position;
+        float const * p1 = vertices[meshlet_vertices[meshlet_triangles[t * 3 + 1]]].position;
+        float const * p2 = vertices[meshlet_vertices[meshlet_triangles[t * 3 + 2]]].position;
+        float e1 [3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        float e2 [3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        float * n = normals[normal_count];
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+        if (meshlet_normalize(n) <= 0.0f)
+            continue;       // degenerate triangles never show
+        axis[0] += n[0];
+        axis[1] += n[1];
+        axis[2] += n[2];
+        ++normal_count;
+    }
+    if (0 == normal_count || meshlet_normalize(axis) <= 0.0f)
+        return;
+    float axis_q [3];
+    for (uint32_t c = 0; c < 3; ++c) {
+        float q = ::roundf(axis[c] * 127.0f);
+        b->cone_axis[c] = (int8_t)(q < -127.0f ? -127.0f : (q > 127.0f ? 127.0f : q));
+        axis_q[c] = (float)b->cone_axis[c];
+    }
+    meshlet_normalize(axis_q);
+    float min_dot = 1.0f;
+    for (uint32_t n = 0; n < normal_count; ++n) {
+        float d = meshlet_dot(normals[n], axis_q);
+        min_dot = d < min_dot ? d : min_dot;
+    }
+    if (min_dot <= 0.1f)
+        return;             // normals spread over more than ~84 degrees: the cone would hardly ever cull
+
+    // -- apex: the point on center - t * axis behind every triangle's plane
+    float max_t = 0.0f;
+    uint32_t n = 0;
+    for (uint32_t t = 0; t < triangle_count; ++t) {
+        float const * p0 = vertices[meshlet_vertices[meshlet_triangles[t * 3 + 0]]].position;
+        float const * p1 = vertices[meshlet_vertices[meshlet_triangles[t * 3 + 1]]].position;
+        float const * p2 = vertices[meshlet_vertices[meshlet_triangles[t * 3 + 2]]].position;
+        float e1 [3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        float e2 [3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        float cross [3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+        if (meshlet_dot(cross, cross) <= 0.0f)
+            continue;
+        float const * normal = normals[n++];
+        float dc [3] = {center[0] - p0[0], center[1] - p0[1], center[2] - p0[2]};
+        float t_plane = meshlet_dot(dc, normal) / meshlet_dot(axis_q, normal);
+        max_t = t_plane > max_t ? t_plane : max_t;
+    }
+    for (uint32_t c = 0; c < 3; ++c)
+        b->cone_apex[c] = center[c] - axis_q[c] * max_t;
+    // -- cone of eyes that see only back faces: half angle 90 - acos(min_dot), so the cutoff is sin(acos(min_dot))
+    float cutoff = ::sqrtf(1.0f - min_dot * min_dot);
+    float q = ::ceilf(cutoff * 127.0f);
+    b->cone_cutoff = (int8_t)(q > 127.0f ? 127.0f : q);
+}
+
+static bool
+meshlet_build_mesh (ColladaScene const * scene, uint32_t mesh_index, MeshletBuild * build) {
+    ColladaMesh const * mesh = &scene->meshes[mesh_index];
+    uint32_t vertex_count = mesh->vertex_count;
+    uint32_t index_count = mesh->index_count;
+    uint32_t triangle_count = index_count / 3;
+    uint32_t const * indices = scene->indices + mesh->first_index;
+    ColladaVertex const * vertices = scene->vertices + mesh->first_vertex;
+    ::memset(build, 0, sizeof(*build));
+    if (0 == triangle_count)
+        return true;
+
+    // -- worst case one meshlet per triangle; every triangle record padded to 4 bytes
+    build->meshlets = reinterpret_cast<Meshlet *>(::malloc(triangle_count * sizeof(Meshlet)));
+    build->bounds = reinterpret_cast<MeshletBounds *>(::malloc(triangle_count * sizeof(MeshletBounds)));
+    build->vertices = reinterpret_cast<uint32_t *>(::malloc(index_count * sizeof(uint32_t)));
+    build->triangles = reinterpret_cast<uint8_t *>(::malloc((size_t)triangle_count * 4));
+    MeshletScratch s = {};
+    if (!build->meshlets || !build->bounds || !build->vertices || !build->triangles || !meshlet_scratch_create(&s, vertex_count, index_count)) {
+        meshlet_scratch_destroy(&s);
+        return false;
+    }
+
+    // -- positions shared across uv / normal seams
+    ::memset(s.table, 0xff, s.table_size * sizeof(uint32_t));
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        uint32_t bits [3];
+        ::memcpy(bits, vertices[v].position, sizeof(bits));
+        uint32_t slot = collada_tuple_hash(bits) & (s.table_size - 1);
+        for (;;) {
+            uint32_t other = s.table[slot];
+            if (COLLADA_NONE == other) {
+                s.table[slot] = v;
+                s.position_ids[v] = v;
+                break;
+            }
+            if (0 == ::memcmp(vertices[other].position, vertices[v].position, sizeof(bits))) {
+                s.position_ids[v] = other;
+                break;
+            }
+            slot = (slot + 1) & (s.table_size - 1);
+        }
+    }
+    ::memset(s.offsets, 0, (vertex_count + 1) * sizeof(uint32_t));
+    ::memset(s.live, 0, vertex_count * sizeof(uint32_t));
+    for (uint32_t i = 0; i < index_count; ++i) {
+        ++s.offsets[s.position_ids[indices[i]] + 1];
+        ++s.live[indices[i]];
+    }
+    for (uint32_t v = 0; v < vertex_count; ++v)
+        s.offsets[v + 1] += s.offsets[v];
+    for (uint32_t i = 0; i < index_count; ++i)
+        s.adjacency[s.offsets[s.position_ids[indices[i]]]++] = i / 3;
+    for (uint32_t v = vertex_count; v > 0; --v)
+        s.offsets[v] = s.offsets[v - 1];
+    s.offsets[0] = 0;
+
+    float surface = 0.0f;
+    for (uint32_t t = 0; t < triangle_count; ++t) {
+        float const * p0 = vertices[indices[t * 3 + 0]].position;
+        float const * p1 = vertices[indices[t * 3 + 1]].position;
+        float const * p2 = vertices[indices[t * 3 + 2]].position;
+        float e1 [3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        float e2 [3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        float * n = &s.normals[t * 3];
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+        surface += 0.5f * meshlet_normalize(n);
+        for (uint32_t c = 0; c < 3; ++c)
+            s.centroids[t * 3 + c] = (p0[c] + p1[c] + p2[c]) / 3.0f;
+    }
+    // -- radius of a full meshlet if triangles were evenly sized; scales the distance term
+    float expected_radius = ::sqrtf(surface / (float)triangle_count * MESHLET_MAX_TRIANGLES / 3.14159265f);
+    if (expected_radius <= 0.0f)
+        expected_radius = 1.0f;
+    ::memset(s.emitted, 0, triangle_count);
+    ::memset(s.local, 0xff, vertex_count);
+
+    uint32_t cursor = 0;
+    for (;;) {
+        while (cursor < triangle_count && s.emitted[cursor])
+            ++cursor;
+        if (cursor == triangle_count)
+            break;
+        Meshlet * meshlet = &build->meshlets[build->meshlet_count];
+        meshlet->vertex_offset = build->vertex_count;
+        meshlet->triangle_offset = build->triangle_bytes;
+        meshlet->vertex_count = 0;
+        meshlet->triangle_count = 0;
+        meshlet->mesh = (uint16_t)mesh_index;
+        uint32_t * meshlet_vertices = build->vertices + build->vertex_count;
+        uint8_t * meshlet_triangles = build->triangles + build->triangle_bytes;
+        float center_sum [3] = {}, normal_sum [3] = {};
+
+        uint32_t next = cursor;
+        while (COLLADA_NONE != next) {
+            uint32_t const * tri = indices + next * 3;
+            for (uint32_t k = 0; k < 3; ++k) {
+                uint32_t v = tri[k];
+                if (0xff == s.local[v]) {
+                    s.local[v] = meshlet->vertex_count;
+                    meshlet_vertices[meshlet->vertex_count++] = v;
+                }
+                meshlet_triangles[meshlet->triangle_count * 3 + k] = s.local[v];
+                --s.live[v];
+            }
+            for (uint32_t c = 0; c < 3; ++c) {
+                center_sum[c] += s.centroids[next * 3 + c];
+                normal_sum[c] += s.normals[next * 3 + c];
+            }
+            s.emitted[next] = 1;
+            ++meshlet->triangle_count;
+            if (MESHLET_MAX_TRIANGLES == meshlet->triangle_count)
+                break;
+
+            // -- best neighbour: fewest new vertices (finishing a vertex counts as none), then closest in space and normal
+            float center [3] = {center_sum[0] / meshlet->triangle_count, center_sum[1] / meshlet->triangle_count, center_sum[2] / meshlet->triangle_count};
+            float axis [3] = {normal_sum[0], normal_sum[1], normal_sum[2]};
+            meshlet_normalize(axis);
+            next = COLLADA_NONE;
+            uint32_t best_extra = 4;
+            float best_score = FLT_MAX;
+            for (uint32_t mv = 0; mv < meshlet->vertex_count; ++mv) {
+                uint32_t p = s.position_ids[meshlet_vertices[mv]];
+                for (uint32_t e = s.offsets[p]; e < s.offsets[p + 1]; ++e) {
+                    uint32_t t = s.adjacency[e];
+                    if (s.emitted[t])
+                        continue;
+                    uint32_t const * candidate = indices + t * 3;
+                    uint32_t extra = (0xff == s.local[candidate[0]]) + (0xff == s.local[candidate[1]]) + (0xff == s.local[candidate[2]]);
+                    if (meshlet->vertex_count + extra > MESHLET_MAX_VERTICES)
+                        continue;
+                    if (1 == s.live[candidate[0]] || 1 == s.live[candidate[1]] || 1 == s.live[candidate[2]])
+                        extra = 0;
+                    if (extra > best_extra)
+                        continue;
+                    float d [3] = {s.centroids[t * 3] - center[0], s.centroids[t * 3 + 1] - center[1], s.centroids[t * 3 + 2] - center[2]};
+                    float spread = meshlet_dot(&s.normals[t * 3], axis);
+                    float cone = 1.0f - spread * MESHLET_CONE_WEIGHT;
+                    cone = cone < 1e-3f ? 1e-3f : cone;
+                    float score = (1.0f + ::sqrtf(meshlet_dot(d, d)) / expected_radius * (1.0f - MESHLET_CONE_WEIGHT)) * cone;
+                    if (extra < best_extra || score < best_score) {
+                        best_extra = extra;
+                        best_score = score;
+                        next = t;
+                    }
+                }
+            }
+        }
+        meshlet_compute_bounds(vertices, meshlet_vertices, meshlet->vertex_count, meshlet_triangles, meshlet->triangle_count, &build->bounds[build->meshlet_count]);
+        for (uint32_t mv = 0; mv < meshlet->vertex_count; ++mv) {
+            s.local[meshlet_vertices[mv]] = 0xff;
+            meshlet_vertices[mv] += mesh->first_vertex;     // scene vertex buffer
+        }
+        build->vertex_count += meshlet->vertex_count;
+        uint32_t triangle_bytes = (meshlet->triangle_count * 3 + 3) & ~3u;
+        ::memset(meshlet_triangles + meshlet->triangle_count * 3, 0, triangle_bytes - meshlet->triangle_count * 3);
+        build->triangle_bytes += triangle_bytes;
+        ++build->meshlet_count;
+    }
+    meshlet_scratch_destroy(&s);
+    return true;
+}
+static void
+meshlet_worker (ColladaScene const * scene, MeshletBuild * builds, std::atomic<uint32_t> * next) {
+    for (;;) {
+        uint32_t m = next->fetch_add(1);
+        if (m >= scene->mesh_count)
+            return;
+        auto begin = std::chrono::steady_clock::now();
+        builds[m].ok = meshlet_build_mesh(scene, m, &builds[m]);
+        builds[m].ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    }
+}
+
+// NOTE(omid): Fraction of meshlets (and of their triangles) the cone test rejects,
+// averaged over MESHLET_CULL_VIEWS eyes spread evenly on a sphere of three times
+// the mesh's size around it.
+static void
+meshlet_cone_cull_rate (MeshletSet const * set, ColladaMesh const * mesh, uint32_t mesh_index, float * out_meshlets, float * out_triangles) {
+    uint32_t first = set->mesh_first_meshlet[mesh_index], last = set->mesh_first_meshlet[mesh_index + 1];
+    float center [3], extent = 0.0f;
+    for (uint32_t c = 0; c < 3; ++c) {
+        center[c] = 0.5f * (mesh->bounds_min[c] + mesh->bounds_max[c]);
+        extent = ::fmaxf(extent, mesh->bounds_max[c] - mesh->bounds_min[c]);
+    }
+    uint64_t culled = 0, culled_triangles = 0, total = 0, total_triangles = 0;
+    for (uint32_t view = 0; view < MESHLET_CULL_VIEWS; ++view) {
+        // -- fibonacci sphere
+        float z = 1.0f - (2.0f * view + 1.0f) / MESHLET_CULL_VIEWS;
+        float r = ::sqrtf(1.0f - z * z);
+        float phi = 2.39996323f * view;
+        float eye [3] = {center[0] + 3.0f * extent * r * ::cosf(phi), center[1] + 3.0f * extent * r * ::sinf(phi), center[2] + 3.0f * extent * z};
+        for (uint32_t m = first; m < last; ++m) {
+            bool is_culled = meshlet_cone_culled(&set->bounds[m], eye);
+            culled += is_culled;
+            culled_triangles += is_culled ? set->meshlets[m].triangle_count : 0;
+            total_triangles += set->meshlets[m].triangle_count;
+        }
+        total += last - first;
+    }
+    *out_meshlets = total ? (float)culled / (float)total : 0.0f;
+    *out_triangles = total_triangles ? (float)culled_triangles / (float)total_triangles : 0.0f;
+}
+static void
+meshlet_set_destroy (MeshletSet * set) {
+    ::free(set->meshlets);
+    ::free(set->bounds);
+    ::free(set->vertices);
+    ::free(set->triangles);
+    ::free(set->mesh_first_meshlet);
+    ::memset(set, 0, sizeof(*set));
+}
+// NOTE(omid): Builds meshlets for every mesh of the scene on up to thread_count
+// threads (0: one per core) and prints build time, fill and cone cull rates.
+static bool
+meshlet_set_create (ColladaScene const * scene, MeshletSet * set, uint32_t thread_count) {
+    ::memset(set, 0, sizeof(*set));
+    if (0 == scene->mesh_count || scene->mesh_count > 0xffff)
+        return false;
+    if (0 == thread_count)
+        thread_count = std::thread::hardware_concurrency();
+    if (thread_count < 1)
+        thread_count = 1;
+    if (thread_count > MESHLET_MAX_THREADS)
+        thread_count = MESHLET_MAX_THREADS;
+    if (thread_count > scene->mesh_count)
+        thread_count = scene->mesh_count;
+    MeshletBuild * builds = reinterpret_cast<MeshletBuild *>(::calloc(scene->mesh_count, sizeof(MeshletBuild)));
+    if (!builds)
+        return false;
+
+    auto begin = std::chrono::steady_clock::now();
+    std::atomic<uint32_t> next(0);
+    std::thread workers [MESHLET_MAX_THREADS];
+    for (uint32_t t = 1; t < thread_count; ++t)
+        workers[t] = std::thread(meshlet_worker, scene, builds, &next);
+    meshlet_worker(scene, builds, &next);
+    for (uint32_t t = 1; t < thread_count; ++t)
+        workers[t].join();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+    // -- gather in mesh order
+    bool ok = true;
+    uint64_t meshlet_total = 0, vertex_total = 0, byte_total = 0;
+    for (uint32_t m = 0; m < scene->mesh_count; ++m) {
+        ok = ok && builds[m].ok;
+        meshlet_total += builds[m].meshlet_count;
+        vertex_total += builds[m].vertex_count;
+        byte_total += builds[m].triangle_bytes;
+    }
+    ok = ok && byte_total <= 0xffffffffull;
+    if (ok) {
+        set->meshlets = reinterpret_cast<Meshlet *>(::malloc(meshlet_total * sizeof(Meshlet) + 1));
+        set->bounds = reinterpret_cast<MeshletBounds *>(::malloc(meshlet_total * sizeof(MeshletBounds) + 1));
+        set->vertices = reinterpret_cast<uint32_t *>(::malloc(vertex_total * sizeof(uint32_t) + 1));
+        set->triangles = reinterpret_cast<uint8_t *>(::malloc(byte_total + 1));
+        set->mesh_first_meshlet = reinterpret_cast<uint32_t *>(::malloc((scene->mesh_count + 1) * sizeof(uint32_t)));
+        ok = set->meshlets && set->bounds && set->vertices && set->triangles && set->mesh_first_meshlet;
+    }
+    if (ok) {
+        set->mesh_count = scene->mesh_count;
+        for (uint32_t m = 0; m < scene->mesh_count; ++m) {
+            MeshletBuild const * build = &builds[m];
+            set->mesh_first_meshlet[m] = set->meshlet_count;
+            for (uint32_t i = 0; i < build->meshlet_count; ++i) {
+                Meshlet meshlet = build->meshlets[i];
+                meshlet.vertex_offset += set->vertex_count;
+                meshlet.triangle_offset += set->triangle_bytes;
+                set->meshlets[set->meshlet_count + i] = meshlet;
+            }
+            ::memcpy(set->bounds + set->meshlet_count, build->bounds, build->meshlet_count * sizeof(MeshletBounds));
+            ::memcpy(set->vertices + set->vertex_count, build->vertices, build->vertex_count * sizeof(uint32_t));
+            ::memcpy(set->triangles + set->triangle_bytes, build->triangles, build->triangle_bytes);
+            set->meshlet_count += build->meshlet_count;
+            set->vertex_count += build->vertex_count;
+            set->triangle_bytes += build->triangle_bytes;
+        }
+        set->mesh_first_meshlet[scene->mesh_count] = set->meshlet_count;
+
+        uint32_t triangle_total = 0;
+        for (uint32_t m = 0; m < set->meshlet_count; ++m)
+            triangle_total += set->meshlets[m].triangle_count;
+        uint64_t bytes = (uint64_t)set->meshlet_count * (sizeof(Meshlet) + sizeof(MeshletBounds)) + set->vertex_count * sizeof(uint32_t) + set->triangle_bytes;
+        ::printf(
+            "Meshlets: %u from %u triangles in %.2f ms on %u threads (%.2f Mtri/s), %.1f vertices / %.1f triangles each (%.0f%% / %.0f%% full), %.1f KiB (%.1f bytes per triangle)\n",
+            set->meshlet_count, triangle_total, ms, thread_count, ms > 0.0 ? triangle_total / ms * 1e-3 : 0.0,
+            set->meshlet_count ? (float)set->vertex_count / set->meshlet_count : 0.0f,
+            set->meshlet_count ? (float)triangle_total / set->meshlet_count : 0.0f,
+            set->meshlet_count ? 100.0f * set->vertex_count / (set->meshlet_count * MESHLET_MAX_VERTICES) : 0.0f,
+            set->meshlet_count ? 100.0f * triangle_total / (set->meshlet_count * MESHLET_MAX_TRIANGLES) : 0.0f,
+            bytes / 1024.0, triangle_total ? (double)bytes / triangle_total : 0.0
+        );
+        for (uint32_t m = 0; m < scene->mesh_count; ++m) {
+            float meshlet_rate = 0.0f, triangle_rate = 0.0f;
+            meshlet_cone_cull_rate(set, &scene->meshes[m], m, &meshlet_rate, &triangle_rate);
+            ::printf(
+                "  %-10s %4u meshlets in %.2f ms, cone culled over %u views: %4.1f%% of meshlets, %4.1f%% of triangles\n",
+                scene->meshes[m].name, builds[m].meshlet_count, builds[m].ms, MESHLET_CULL_VIEWS, 100.0f * meshlet_rate, 100.0f * triangle_rate
+            );
+        }
+    } else {
+        ::printf("Meshlets: not built (out of memory)\n");
+        meshlet_set_destroy(set);
+    }
+    for (uint32_t m = 0; m < scene->mesh_count; ++m) {
+        ::free(builds[m].meshlets);
+        ::free(builds[m].bounds);
+        ::free(builds[m].vertices);
+        ::free(builds[m].triangles);
+    }
+    ::free(builds);
+    return ok;
+}
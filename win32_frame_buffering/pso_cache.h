@@ -0,0 +1,384 @@
+#pragma once
+
+// NOTE(omid): Pipeline state cache persisted across runs. A graphics pso desc is
+// canonicalized into a 64-bit hash: pointers are replaced by what they point to
+// (shader bytecode, input layout semantic names, the serialized root signature),
+// so the same pipeline hashes the same in every process.
+// Compiled pipelines are kept in an ID3D12PipelineLibrary serialized to disk
+// (ID3D12Device1); on runtimes without it, per-pipeline GetCachedBlob blobs are
+// stored in the index file instead and fed back through CachedPSO.
+// The index file also remembers how long each pipeline took to create cold, so
+// the time a cache hit saved can be reported.
+
+#include "common_macros.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#define PSO_CACHE_MAGIC             0x434f5350      // 'PSOC'
+#define PSO_CACHE_VERSION           1
+#define PSO_CACHE_MAX_RECORDS       256
+
+struct PsoCacheRecord {
+    UINT64                          hash;
+    UINT64                          create_us;      // cold creation time
+    UINT64                          blob_offset;    // into blob_data (GetCachedBlob path only)
+    UINT64                          blob_size;
+};
+struct PsoCacheFileHeader {
+    UINT                            magic;
+    UINT                            version;
+    UINT                            record_count;
+    UINT                            reserved;
+    UINT64                          blob_bytes;
+};
+struct PsoCacheStats {
+    UINT                            hits;
+    UINT                            misses;
+    UINT                            stale;          // cached data rejected by the driver
+    double                          hit_us;
+    double                          miss_us;
+    double                          saved_us;
+};
+struct PsoCache {
+    ID3D12Device *                  device;
+    ID3D12Device1 *                 device1;        // null when pipeline libraries are unavailable
+    ID3D12PipelineLibrary *         library;
+    void *                          library_data;   // must outlive the library
+    char const *                    library_path;
+    char const *                    index_path;
+
+    PsoCacheRecord                  records [PSO_CACHE_MAX_RECORDS];
+    UINT                            record_count;
+    uint8_t *                       blob_data;
+    UINT64                          blob_bytes;
+    UINT64                          blob_capacity;
+    bool                            dirty;
+
+    LARGE_INTEGER                   qpc_freq;
+    PsoCacheStats                   stats;
+};
+
+#define PSO_HASH_VALUE(hash, v)     fnv1a_64(&(v), sizeof(v), hash)
+
+static UINT64
+pso_hash_shader (UINT64 hash, D3D12_SHADER_BYTECODE const * shader) {
+    hash = PSO_HASH_VALUE(hash, shader->BytecodeLength);
+    if (shader->BytecodeLength > 0)
+        hash = fnv1a_64(shader->pShaderBytecode, shader->BytecodeLength, hash);
+    return hash;
+}
+// NOTE(omid): root_signature_hash is a hash of the serialized root signature blob,
+// since the root signature object itself differs between runs.
+static UINT64
+pso_desc_hash (D3D12_GRAPHICS_PIPELINE_STATE_DESC const * desc, UINT64 root_signature_hash) {
+    UINT64 hash = FNV1A_64_SEED;
+    hash = PSO_HASH_VALUE(hash, root_signature_hash);
+    hash = pso_hash_shader(hash, &desc->VS);
+    hash = pso_hash_shader(hash, &desc->PS);
+    hash = pso_hash_shader(hash, &desc->DS);
+    hash = pso_hash_shader(hash, &desc->HS);
+    hash = pso_hash_shader(hash, &desc->GS);
+    SIMPLE_ASSERT(0 == desc->StreamOutput.NumEntries);     // not canonicalized
+    // -- blend and depth-stencil descs have padding after their UINT8 members: hash field by field
+    hash = PSO_HASH_VALUE(hash, desc->BlendState.AlphaToCoverageEnable);
+    hash = PSO_HASH_VALUE(hash, desc->BlendState.IndependentBlendEnable);
+    for (UINT i = 0; i < D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT; ++i) {
+        D3D12_RENDER_TARGET_BLEND_DESC const * target = &desc->BlendState.RenderTarget[i];
+        hash = PSO_HASH_VALUE(hash, target->BlendEnable);
+        hash = PSO_HASH_VALUE(hash, target->LogicOpEnable);
+        hash = PSO_HASH_VALUE(hash, target->SrcBlend);
+        hash = PSO_HASH_VALUE(hash, target->DestBlend);
+        hash = PSO_HASH_VALUE(hash, target->BlendOp);
+        hash = PSO_HASH_VALUE(hash, target->SrcBlendAlpha);
+        hash = PSO_HASH_VALUE(hash, target->DestBlendAlpha);
+        hash = PSO_HASH_VALUE(hash, target->BlendOpAlpha);
+        hash = PSO_HASH_VALUE(hash, target->LogicOp);
+        hash = PSO_HASH_VALUE(hash, target->RenderTargetWriteMask);
+    }
+    hash = PSO_HASH_VALUE(hash, desc->SampleMask);
+    hash = PSO_HASH_VALUE(hash, desc->RasterizerState);
+    D3D12_DEPTH_STENCIL_DESC const * depth_stencil = &desc->DepthStencilState;
+    hash = PSO_HASH_VALUE(hash, depth_stencil->DepthEnable);
+    hash = PSO_HASH_VALUE(hash, depth_stencil->DepthWriteMask);
+    hash = PSO_HASH_VALUE(hash, depth_stencil->DepthFunc);
+    hash = PSO_HASH_VALUE(hash, depth_stencil->StencilEnable);
+    hash = PSO_HASH_VALUE(hash, depth_stencil->StencilReadMask);
+    hash = PSO_HASH_VALUE(hash, depth_stencil->StencilWriteMask);
+    hash = PSO_HASH_VALUE(hash, depth_stencil->FrontFace);
+    hash = PSO_HASH_VALUE(hash, depth_stencil->BackFace);
+    hash = PSO_HASH_VALUE(hash, desc->InputLayout.NumElements);
+    for (UINT i = 0; i < desc->InputLayout.NumElements; ++i) {
+        D3D12_INPUT_ELEMENT_DESC const * element = &desc->InputLayout.pInputElementDescs[i];
+        hash = fnv1a_64(element->SemanticName, ::strlen(element->SemanticName) + 1, hash);
+        hash = PSO_HASH_VALUE(hash, element->SemanticIndex);
+        hash = PSO_HASH_VALUE(hash, element->Format);
+        hash = PSO_HASH_VALUE(hash, element->InputSlot);
+        hash = PSO_HASH_VALUE(hash, element->AlignedByteOffset);
+        hash = PSO_HASH_VALUE(hash, element->InputSlotClass);
+        hash = PSO_HASH_VALUE(hash, element->InstanceDataStepRate);
+    }
+    hash = PSO_HASH_VALUE(hash, desc->IBStripCutValue);
+    hash = PSO_HASH_VALUE(hash, desc->PrimitiveTopologyType);
+    hash = PSO_HASH_VALUE(hash, desc->NumRenderTargets);
+    hash = PSO_HASH_VALUE(hash, desc->RTVFormats);
+    hash = PSO_HASH_VALUE(hash, desc->DSVFormat);
+    hash = PSO_HASH_VALUE(hash, desc->SampleDesc);
+    hash = PSO_HASH_VALUE(hash, desc->NodeMask);
+    hash = PSO_HASH_VALUE(hash, desc->Flags);
+    return hash;
+}
+
+// -- the states every sample builds by hand (opaque, no blending / solid, back-face culling)
+static D3D12_BLEND_DESC
+pso_default_blend_desc () {
+    D3D12_BLEND_DESC ret = {};
+    ret.AlphaToCoverageEnable = FALSE;
+    ret.IndependentBlendEnable = FALSE;
+    for (UINT i = 0; i < D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT; ++i) {
+        ret.RenderTarget[i].BlendEnable = FALSE;
+        ret.RenderTarget[i].LogicOpEnable = FALSE;
+        ret.RenderTarget[i].SrcBlend = D3D12_BLEND_ONE;
+        ret.RenderTarget[i].DestBlend = D3D12_BLEND_ZERO;
+        ret.RenderTarget[i].BlendOp = D3D12_BLEND_OP_ADD;
+        ret.RenderTarget[i].SrcBlendAlpha = D3D12_BLEND_ONE;
+        ret.RenderTarget[i].DestBlendAlpha = D3D12_BLEND_ZERO;
+        ret.RenderTarget[i].BlendOpAlpha = D3D12_BLEND_OP_ADD;
+        ret.RenderTarget[i].LogicOp = D3D12_LOGIC_OP_NOOP;
+        ret.RenderTarget[i].RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
+    }
+    return ret;
+}
+static D3D12_RASTERIZER_DESC
+pso_default_rasterizer_desc () {
+    D3D12_RASTERIZER_DESC ret = {};
+    ret.FillMode = D3D12_FILL_MODE_SOLID;
+    ret.CullMode = D3D12_CULL_MODE_BACK;
+    ret.FrontCounterClockwise = FALSE;
+    ret.DepthBias = D3D12_DEFAULT_DEPTH_BIAS;
+    ret.DepthBiasClamp = D3D12_DEFAULT_DEPTH_BIAS_CLAMP;
+    ret.SlopeScaledDepthBias = D3D12_DEFAULT_SLOPE_SCALED_DEPTH_BIAS;
+    ret.DepthClipEnable = TRUE;
+    ret.MultisampleEnable = FALSE;
+    ret.AntialiasedLineEnable = FALSE;
+    ret.ForcedSampleCount = 0;
+    ret.ConservativeRaster = D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF;
+    return ret;
+}
+
+static void
+pso_cache_load_index (PsoCache * cache) {
+    size_t size = 0;
+    uint8_t * data = reinterpret_cast<uint8_t *>(read_whole_file(cache->index_path, &size));
+    if (!data)
+        return;
+    PsoCacheFileHeader header = {};
+    bool valid = size >= sizeof(header);
+    if (valid) {
+        ::memcpy(&header, data, sizeof(header));
+        valid = PSO_CACHE_MAGIC == header.magic && PSO_CACHE_VERSION == header.version &&
+                header.record_count <= PSO_CACHE_MAX_RECORDS &&
+                size == sizeof(header) + header.record_count * sizeof(PsoCacheRecord) + header.blob_bytes;
+    }
+    if (valid) {
+        cache->record_count = header.record_count;
+        ::memcpy(cache->records, data + sizeof(header), header.record_count * sizeof(PsoCacheRecord));
+        if (header.blob_bytes > 0) {
+            cache->blob_data = reinterpret_cast<uint8_t *>(::malloc((size_t)header.blob_bytes));
+            SIMPLE_ASSERT(cache->blob_data);
+            ::memcpy(cache->blob_data, data + sizeof(header) + header.record_count * sizeof(PsoCacheRecord), (size_t)header.blob_bytes);
+            cache->blob_bytes = cache->blob_capacity = header.blob_bytes;
+        }
+    } else {
+        ::printf("pso cache: ignoring invalid index %s\n", cache->index_path);
+    }
+    ::free(data);
+}
+static void
+pso_cache_init (PsoCache * cache, ID3D12Device * device, char const * library_path, char const * index_path) {
+    ::memset(cache, 0, sizeof(*cache));
+    cache->device = device;
+    cache->library_path = library_path;
+    cache->index_path = index_path;
+    QueryPerformanceFrequency(&cache->qpc_freq);
+    pso_cache_load_index(cache);
+
+    if (FAILED(device->QueryInterface(IID_PPV_ARGS(&cache->device1))))
+        cache->device1 = nullptr;
+    if (!cache->device1)
+        return;
+
+    // -- a library written by another driver / adapter is rejected; start over with an empty one
+    size_t library_size = 0;
+    cache->library_data = read_whole_file(library_path, &library_size);
+    if (cache->library_data && 0 == library_size) {
+        ::free(cache->library_data);
+        cache->library_data = nullptr;
+    }
+    if (cache->library_data) {
+        HRESULT hr = cache->device1->CreatePipelineLibrary(cache->library_data, library_size, IID_PPV_ARGS(&cache->library));
+        if (FAILED(hr)) {
+            ::printf("pso cache: stale pipeline library (0x%08lx), rebuilding\n", (unsigned long)hr);
+            ::free(cache->library_data);
+            cache->library_data = nullptr;
+            cache->library = nullptr;
+            cache->record_count = 0;
+            cache->dirty = true;
+        }
+    }
+    if (!cache->library)
+        CHECK_AND_FAIL(cache->device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&cache->library)));
+}
+static PsoCacheRecord *
+pso_cache_find_record (PsoCache * cache, UINT64 hash) {
+    for (UINT i = 0; i < cache->record_count; ++i) {
+        if (cache->records[i].hash == hash)
+            return &cache->records[i];
+    }
+    return nullptr;
+}
+static void
+pso_cache_append_blob (PsoCache * cache, PsoCacheRecord * record, ID3DBlob * blob) {
+    UINT64 size = blob->GetBufferSize();
+    if (cache->blob_bytes + size > cache->blob_capacity) {
+        UINT64 new_capacity = cache->blob_capacity ? cache->blob_capacity * 2 : 64 * 1024;
+        while (new_capacity < cache->blob_bytes + size)
+            new_capacity *= 2;
+        cache->blob_data = reinterpret_cast<uint8_t *>(::realloc(cache->blob_data, (size_t)new_capacity));
+        SIMPLE_ASSERT(cache->blob_data);
+        cache->blob_capacity = new_capacity;
+    }
+    ::memcpy(cache->blob_data + cache->blob_bytes, blob->GetBufferPointer(), (size_t)size);
+    record->blob_offset = cache->blob_bytes;
+    record->blob_size = size;
+    cache->blob_bytes += size;
+}
+static double
+pso_cache_elapsed_us (PsoCache const * cache, LARGE_INTEGER begin) {
+    LARGE_INTEGER end = {};
+    QueryPerformanceCounter(&end);
+    return 1e6 * (double)(end.QuadPart - begin.QuadPart) / (double)cache->qpc_freq.QuadPart;
+}
+// NOTE(omid): Returns a pipeline for desc, loaded from the cache when possible.
+// desc is not modified (CachedPSO is filled on a copy).
+static ID3D12PipelineState *
+pso_cache_create_graphics (PsoCache * cache, D3D12_GRAPHICS_PIPELINE_STATE_DESC const * desc, UINT64 root_signature_hash) {
+    UINT64 hash = pso_desc_hash(desc, root_signature_hash);
+    wchar_t name [32] = {};
+    ::swprintf(name, ARRAY_COUNT(name), L"pso_%016llx", hash);
+
+    PsoCacheRecord * record = pso_cache_find_record(cache, hash);
+    ID3D12PipelineState * ret = nullptr;
+    LARGE_INTEGER begin = {};
+    QueryPerformanceCounter(&begin);
+
+    // -- 1. try the cache
+    if (record) {
+        HRESULT hr = E_FAIL;
+        if (cache->library) {
+            hr = cache->library->LoadGraphicsPipeline(name, desc, IID_PPV_ARGS(&ret));
+        } else if (record->blob_size > 0) {
+            D3D12_GRAPHICS_PIPELINE_STATE_DESC cached_desc = *desc;
+            cached_desc.CachedPSO.pCachedBlob = cache->blob_data + record->blob_offset;
+            cached_desc.CachedPSO.CachedBlobSizeInBytes = (SIZE_T)record->blob_size;
+            hr = cache->device->CreateGraphicsPipelineState(&cached_desc, IID_PPV_ARGS(&ret));
+        }
+        if (SUCCEEDED(hr)) {
+            double us = pso_cache_elapsed_us(cache, begin);
+            ++cache->stats.hits;
+            cache->stats.hit_us += us;
+            if ((double)record->create_us > us)
+                cache->stats.saved_us += (double)record->create_us - us;
+            return ret;
+        }
+        // -- driver rejected the cached data: recreate and store again
+        ++cache->stats.stale;
+        ret = nullptr;
+        record->blob_size = 0;
+        QueryPerformanceCounter(&begin);
+    }
+
+    // -- 2. cold create and remember
+    CHECK_AND_FAIL(cache->device->CreateGraphicsPipelineState(desc, IID_PPV_ARGS(&ret)));
+    double us = pso_cache_elapsed_us(cache, begin);
+    ++cache->stats.misses;
+    cache->stats.miss_us += us;
+
+    if (!record && cache->record_count < PSO_CACHE_MAX_RECORDS) {
+        record = &cache->records[cache->record_count++];
+        ::memset(record, 0, sizeof(*record));
+        record->hash = hash;
+    }
+    if (record) {
+        record->create_us = (UINT64)us;
+        if (cache->library) {
+            // -- E_INVALIDARG means the name is already stored (stale entry); the serialized library keeps the old one
+            cache->library->StorePipeline(name, ret);
+        } else {
+            ID3DBlob * blob = nullptr;
+            if (SUCCEEDED(ret->GetCachedBlob(&blob))) {
+                pso_cache_append_blob(cache, record, blob);
+                blob->Release();
+            }
+        }
+        cache->dirty = true;
+    }
+    return ret;
+}
+static bool
+pso_cache_save (PsoCache * cache) {
+    if (cache->library) {
+        SIZE_T size = cache->library->GetSerializedSize();
+        void * data = ::malloc(size);
+        SIMPLE_ASSERT(data);
+        bool written = false;
+        if (SUCCEEDED(cache->library->Serialize(data, size))) {
+            FILE * file = ::fopen(cache->library_path, "wb");
+            if (file) {
+                written = ::fwrite(data, 1, size, file) == size;
+                ::fclose(file);
+            }
+        }
+        ::free(data);
+        if (!written)
+            return false;
+    }
+    FILE * file = ::fopen(cache->index_path, "wb");
+    if (!file)
+        return false;
+    PsoCacheFileHeader header = {};
+    header.magic = PSO_CACHE_MAGIC;
+    header.version = PSO_CACHE_VERSION;
+    header.record_count = cache->record_count;
+    header.blob_bytes = cache->blob_bytes;
+    bool ok = 1 == ::fwrite(&header, sizeof(header), 1, file);
+    ok = ok && cache->record_count == ::fwrite(cache->records, sizeof(PsoCacheRecord), cache->record_count, file);
+    ok = ok && (0 == cache->blob_bytes || 1 == ::fwrite(cache->blob_data, (size_t)cache->blob_bytes, 1, file));
+    ::fclose(file);
+    return ok;
+}
+static void
+pso_cache_print_stats (PsoCache const * cache) {
+    PsoCacheStats const * s = &cache->stats;
+    ::printf(
+        "PSO cache (%s): %u hits (%.1f us), %u misses (%.1f us), %u stale, ~%.1f us saved\n",
+        cache->library ? "pipeline library" : "cached blobs",
+        s->hits, s->hit_us, s->misses, s->miss_us, s->stale, s->saved_us
+    );
+}
+// -- writes the cache back if anything new was created
+static void
+pso_cache_destroy (PsoCache * cache) {
+    if (cache->dirty && !pso_cache_save(cache))
+        ::printf("pso cache: could not write %s\n", cache->index_path);
+    if (cache->library)
+        cache->library->Release();
+    if (cache->device1)
+        cache->device1->Release();
+    ::free(cache->library_data);
+    ::free(cache->blob_data);
+    ::memset(cache, 0, sizeof(*cache));
+}
@@ -0,0 +1,268 @@
+#pragma once
+
+// NOTE(omid): Tracks the state of every registered resource per subresource and
+// turns "I need this resource in state X" requests into the minimal set of
+// transition barriers. Barriers are queued and flushed with a single
+// ResourceBarrier call per batch. Requests for the same (resource, subresource)
+// that land in the same batch are folded together (A->B then B->C becomes A->C,
+// A->B then B->A disappears).
+// Split barriers (BEGIN_ONLY / END_ONLY) let the gpu start a transition early
+// and finish it right before the resource is used.
+// Only D3D12 structs and ID3D12GraphicsCommandList::ResourceBarrier are used,
+// so the tracker can be driven by a mock command list.
+
+#include "common_macros.h"
+
+#define STATE_TRACKER_MAX_RESOURCES         64
+#define STATE_TRACKER_MAX_SUBRESOURCES      16
+#define STATE_TRACKER_MAX_BARRIERS          64
+#define STATE_TRACKER_NOT_FOUND             0xffffffff
+
+struct TrackedResource {
+    ID3D12Resource *                resource;
+    UINT                            subresource_count;
+    // -- when uniform is set, every subresource is in states[0]
+    bool                            uniform;
+    D3D12_RESOURCE_STATES           states [STATE_TRACKER_MAX_SUBRESOURCES];
+    // -- bit per subresource with an outstanding BEGIN_ONLY barrier
+    UINT                            split_mask;
+    D3D12_RESOURCE_STATES           split_after [STATE_TRACKER_MAX_SUBRESOURCES];
+};
+struct ResourceStateTrackerStats {
+    UINT64                          requests;
+    UINT64                          barriers_emitted;
+    UINT64                          barriers_skipped;   // already in requested state
+    UINT64                          barriers_folded;    // merged into a queued barrier
+    UINT64                          flushes;
+};
+struct ResourceStateTracker {
+    TrackedResource                 resources [STATE_TRACKER_MAX_RESOURCES];
+    UINT                            resource_count;
+
+    D3D12_RESOURCE_BARRIER          pending [STATE_TRACKER_MAX_BARRIERS];
+    UINT                            pending_count;
+
+    ResourceStateTrackerStats       stats;
+};
+
+static void
+state_tracker_init (ResourceStateTracker * tracker) {
+    ::memset(tracker, 0, sizeof(*tracker));
+}
+static UINT
+state_tracker_find (ResourceStateTracker * tracker, ID3D12Resource * resource) {
+    for (UINT i = 0; i < tracker->resource_count; ++i) {
+        if (tracker->resources[i].resource == resource)
+            return i;
+    }
+    return STATE_TRACKER_NOT_FOUND;
+}
+static void
+state_tracker_register (ResourceStateTracker * tracker, ID3D12Resource * resource, UINT subresource_count, D3D12_RESOURCE_STATES initial_state) {
+    SIMPLE_ASSERT(STATE_TRACKER_NOT_FOUND == state_tracker_find(tracker, resource));
+    SIMPLE_ASSERT(tracker->resource_count < STATE_TRACKER_MAX_RESOURCES);
+    SIMPLE_ASSERT(subresource_count > 0 && subresource_count <= STATE_TRACKER_MAX_SUBRESOURCES);
+
+    TrackedResource * tracked = &tracker->resources[tracker->resource_count++];
+    ::memset(tracked, 0, sizeof(*tracked));
+    tracked->resource = resource;
+    tracked->subresource_count = subresource_count;
+    tracked->uniform = true;
+    for (UINT i = 0; i < subresource_count; ++i)
+        tracked->states[i] = initial_state;
+}
+static void
+state_tracker_unregister (ResourceStateTracker * tracker, ID3D12Resource * resource) {
+    UINT index = state_tracker_find(tracker, resource);
+    SIMPLE_ASSERT(index != STATE_TRACKER_NOT_FOUND);
+    SIMPLE_ASSERT(0 == tracker->resources[index].split_mask);
+    tracker->resources[index] = tracker->resources[--tracker->resource_count];
+}
+static D3D12_RESOURCE_STATES
+state_tracker_get_state (ResourceStateTracker * tracker, ID3D12Resource * resource, UINT subresource) {
+    UINT index = state_tracker_find(tracker, resource);
+    SIMPLE_ASSERT(index != STATE_TRACKER_NOT_FOUND);
+    TrackedResource * tracked = &tracker->resources[index];
+    return tracked->uniform ? tracked->states[0] : tracked->states[subresource];
+}
+// -- queue a barrier, folding it into an already queued one for the same subresource if possible
+static void
+state_tracker_push_barrier (
+    ResourceStateTracker * tracker, ID3D12Resource * resource, UINT subresource,
+    D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after, D3D12_RESOURCE_BARRIER_FLAGS flags
+) {
+    if (D3D12_RESOURCE_BARRIER_FLAG_NONE == flags) {
+        for (UINT i = 0; i < tracker->pending_count; ++i) {
+            D3D12_RESOURCE_BARRIER * queued = &tracker->pending[i];
+            if (queued->Type != D3D12_RESOURCE_BARRIER_TYPE_TRANSITION || queued->Flags != D3D12_RESOURCE_BARRIER_FLAG_NONE)
+                continue;
+            if (queued->Transition.pResource != resource || queued->Transition.Subresource != subresource)
+                continue;
+            SIMPLE_ASSERT(queued->Transition.StateAfter == before);
+            ++tracker->stats.barriers_folded;
+            if (queued->Transition.StateBefore == after) {
+                // -- round trip within one batch: drop it
+                tracker->pending[i] = tracker->pending[--tracker->pending_count];
+            } else {
+                queued->Transition.StateAfter = after;
+            }
+            return;
+        }
+    }
+    SIMPLE_ASSERT(tracker->pending_count < STATE_TRACKER_MAX_BARRIERS);
+    D3D12_RESOURCE_BARRIER * barrier = &tracker->pending[tracker->pending_count++];
+    *barrier = {};
+    barrier->Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+    barrier->Flags = flags;
+    barrier->Transition.pResource = resource;
+    barrier->Transition.Subresource = subresource;
+    barrier->Transition.StateBefore = before;
+    barrier->Transition.StateAfter = after;
+}
+// -- switch tracked resource to per-subresource bookkeeping
+static void
+state_tracker_split_uniform (TrackedResource * tracked) {
+    if (tracked->uniform) {
+        for (UINT i = 1; i < tracked->subresource_count; ++i)
+            tracked->states[i] = tracked->states[0];
+        tracked->uniform = false;
+    }
+}
+static void
+state_tracker_try_make_uniform (TrackedResource * tracked) {
+    for (UINT i = 1; i < tracked->subresource_count; ++i) {
+        if (tracked->states[i] != tracked->states[0])
+            return;
+    }
+    tracked->uniform = true;
+}
+// NOTE(omid): Request resource (or one of its subresources, or
+// D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES) to be in state after.
+// Nothing is recorded until state_tracker_flush.
+static void
+state_tracker_transition (ResourceStateTracker * tracker, ID3D12Resource * resource, UINT subresource, D3D12_RESOURCE_STATES after) {
+    UINT index = state_tracker_find(tracker, resource);
+    SIMPLE_ASSERT(index != STATE_TRACKER_NOT_FOUND);
+    TrackedResource * tracked = &tracker->resources[index];
+    SIMPLE_ASSERT(0 == tracked->split_mask);    // finish split barriers before using the resource
+    ++tracker->stats.requests;
+
+    if (D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES == subresource) {
+        if (tracked->uniform) {
+            if (tracked->states[0] == after) {
+                ++tracker->stats.barriers_skipped;
+            } else {
+                state_tracker_push_barrier(tracker, resource, subresource, tracked->states[0], after, D3D12_RESOURCE_BARRIER_FLAG_NONE);
+                tracked->states[0] = after;
+            }
+        } else {
+            // -- subresources disagree: transition only the ones that differ
+            for (UINT i = 0; i < tracked->subresource_count; ++i) {
+                if (tracked->states[i] == after) {
+                    ++tracker->stats.barriers_skipped;
+                } else {
+                    state_tracker_push_barrier(tracker, resource, i, tracked->states[i], after, D3D12_RESOURCE_BARRIER_FLAG_NONE);
+                    tracked->states[i] = after;
+                }
+            }
+            tracked->uniform = true;
+        }
+    } else {
+        SIMPLE_ASSERT(subresource < tracked->subresource_count);
+        D3D12_RESOURCE_STATES before = tracked->uniform ? tracked->states[0] : tracked->states[subresource];
+        if (before == after) {
+            ++tracker->stats.barriers_skipped;
+        } else {
+            if (1 == tracked->subresource_count) {
+                // -- single subresource resources always stay uniform
+                tracked->states[0] = after;
+            } else {
+                state_tracker_split_uniform(tracked);
+                tracked->states[subresource] = after;
+                state_tracker_try_make_uniform(tracked);
+            }
+            state_tracker_push_barrier(tracker, resource, subresource, before, after, D3D12_RESOURCE_BARRIER_FLAG_NONE);
+        }
+    }
+}
+// NOTE(omid): Start a split transition of a whole resource. The gpu may begin the
+// transition as soon as the batch is flushed; the resource must not be used until
+// state_tracker_end_split is flushed.
+static void
+state_tracker_begin_split (ResourceStateTracker * tracker, ID3D12Resource * resource, D3D12_RESOURCE_STATES after) {
+    UINT index = state_tracker_find(tracker, resource);
+    SIMPLE_ASSERT(index != STATE_TRACKER_NOT_FOUND);
+    TrackedResource * tracked = &tracker->resources[index];
+    SIMPLE_ASSERT(0 == tracked->split_mask);
+    ++tracker->stats.requests;
+
+    for (UINT i = 0; i < tracked->subresource_count; ++i) {
+        D3D12_RESOURCE_STATES before = tracked->uniform ? tracked->states[0] : tracked->states[i];
+        if (before != after) {
+            tracked->split_mask |= 1u << i;
+            tracked->split_after[i] = after;
+        }
+    }
+    if (0 == tracked->split_mask) {
+        ++tracker->stats.barriers_skipped;
+    } else if (tracked->uniform) {
+        state_tracker_push_barrier(tracker, resource, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, tracked->states[0], after, D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY);
+    } else {
+        for (UINT i = 0; i < tracked->subresource_count; ++i) {
+            if (tracked->split_mask & (1u << i))
+                state_tracker_push_barrier(tracker, resource, i, tracked->states[i], after, D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY);
+        }
+    }
+}
+static void
+state_tracker_end_split (ResourceStateTracker * tracker, ID3D12Resource * resource) {
+    UINT index = state_tracker_find(tracker, resource);
+    SIMPLE_ASSERT(index != STATE_TRACKER_NOT_FOUND);
+    TrackedResource * tracked = &tracker->resources[index];
+    if (0 == tracked->split_mask)
+        return;
+
+    if (tracked->uniform) {
+        // -- a uniform resource began its split as a whole, so all subresources share one target
+        D3D12_RESOURCE_STATES after = tracked->split_after[0];
+        state_tracker_push_barrier(tracker, resource, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, tracked->states[0], after, D3D12_RESOURCE_BARRIER_FLAG_END_ONLY);
+        tracked->states[0] = after;
+    } else {
+        for (UINT i = 0; i < tracked->subresource_count; ++i) {
+            if (tracked->split_mask & (1u << i)) {
+                state_tracker_push_barrier(tracker, resource, i, tracked->states[i], tracked->split_after[i], D3D12_RESOURCE_BARRIER_FLAG_END_ONLY);
+                tracked->states[i] = tracked->split_after[i];
+            }
+        }
+        state_tracker_try_make_uniform(tracked);
+    }
+    tracked->split_mask = 0;
+}
+static void
+state_tracker_uav_barrier (ResourceStateTracker * tracker, ID3D12Resource * resource) {
+    SIMPLE_ASSERT(tracker->pending_count < STATE_TRACKER_MAX_BARRIERS);
+    D3D12_RESOURCE_BARRIER * barrier = &tracker->pending[tracker->pending_count++];
+    *barrier = {};
+    barrier->Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+    barrier->Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    barrier->UAV.pResource = resource;
+}
+// -- record every queued barrier with one ResourceBarrier call
+static void
+state_tracker_flush (ResourceStateTracker * tracker, ID3D12GraphicsCommandList * cmd_list) {
+    if (tracker->pending_count > 0) {
+        cmd_list->ResourceBarrier(tracker->pending_count, tracker->pending);
+        tracker->stats.barriers_emitted += tracker->pending_count;
+        ++tracker->stats.flushes;
+        tracker->pending_count = 0;
+    }
+}
+static void
+state_tracker_print_stats (ResourceStateTracker * tracker) {
+    ::printf(
+        "Resource state tracker: %llu requests, %llu barriers in %llu batches, %llu skipped, %llu folded\n",
+        (unsigned long long)tracker->stats.requests, (unsigned long long)tracker->stats.barriers_emitted,
+        (unsigned long long)tracker->stats.flushes, (unsigned long long)tracker->stats.barriers_skipped,
+        (unsigned long long)tracker->stats.barriers_folded
+    );
+}
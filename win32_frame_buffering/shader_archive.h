@@ -0,0 +1,209 @@
+#pragma once
+
+// NOTE(omid): Read side of the offline shader build (tools/build_shaders.py). The
+// archive holds precompiled DXIL (plus its reflection and optionally SPIR-V) for
+// every entry point and permutation, so nothing has to be compiled at runtime.
+//
+//   header | entries (sorted by lookup hash) | 16-byte aligned blobs | string table
+//
+// An entry is found by (name, entry point, stage, defines): name is the source path
+// relative to the project ("shaders/cbuffer_shader.hlsl"), stage the first two
+// characters of the target ("vs", "ps"), and defines are canonicalized as
+// "A=1;B=0" sorted by name, so the order a caller lists them in does not matter.
+// This header only depends on the C runtime.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shader_cache.h"       // ShaderCacheDefine
+
+#define SHADER_ARCHIVE_MAGIC            0x52414853      // 'SHAR'
+#define SHADER_ARCHIVE_VERSION          1
+#define SHADER_ARCHIVE_FLAG_SPIRV       1
+#define SHADER_ARCHIVE_MAX_DEFINES      16
+#define SHADER_ARCHIVE_MAX_KEY          512
+
+struct ShaderArchiveHeader {
+    uint32_t                        magic;
+    uint32_t                        version;
+    uint32_t                        entry_count;
+    uint32_t                        flags;
+    uint64_t                        strings_offset;
+    uint64_t                        strings_size;
+};
+struct ShaderArchiveEntry {
+    uint64_t                        lookup_hash;
+    uint32_t                        name;           // string table offsets
+    uint32_t                        entry;
+    uint32_t                        stage;
+    uint32_t                        defines;
+    uint64_t                        dxil_offset;    // file offsets
+    uint32_t                        dxil_size;
+    uint32_t                        reflection_size;
+    uint64_t                        reflection_offset;
+    uint64_t                        spirv_offset;
+    uint32_t                        spirv_size;
+    uint32_t                        pad;
+};
+static_assert(32 == sizeof(ShaderArchiveHeader), "must match tools/build_shaders.py HEADER_FORMAT");
+static_assert(64 == sizeof(ShaderArchiveEntry), "must match tools/build_shaders.py ENTRY_FORMAT");
+
+struct ShaderArchiveBlob {
+    void const *                    data;
+    size_t                          size;
+};
+struct ShaderArchive {
+    uint8_t *                       data;
+    size_t                          size;
+    ShaderArchiveHeader const *     header;
+    ShaderArchiveEntry const *      entries;
+    char const *                    strings;
+    // -- stats
+    uint32_t                        hits;
+    uint32_t                        misses;
+};
+
+static bool
+shader_archive_load (ShaderArchive * archive, char const * path) {
+    ::memset(archive, 0, sizeof(*archive));
+    size_t size = 0;
+    uint8_t * data = reinterpret_cast<uint8_t *>(read_whole_file(path, &size));
+    if (!data)
+        return false;
+
+    ShaderArchiveHeader const * header = reinterpret_cast<ShaderArchiveHeader const *>(data);
+    bool ok = size >= sizeof(ShaderArchiveHeader) &&
+         SHADER_ARCHIVE_MAGIC == header->magic && SHADER_ARCHIVE_VERSION == header->version &&
+         sizeof(ShaderArchiveHeader) + (uint64_t)header->entry_count * sizeof(ShaderArchiveEntry) <= header->strings_offset &&
+         header->strings_offset + header->strings_size == (uint64_t)size &&
+         header->strings_size > 0 && '\0' == data[size - 1];
+    if (ok) {
+        // -- every blob and string offset must stay inside the file
+        ShaderArchiveEntry const * entries = reinterpret_cast<ShaderArchiveEntry const *>(data + sizeof(ShaderArchiveHeader));
+        for (uint32_t i = 0; ok && i < header->entry_count; ++i) {
+            ShaderArchiveEntry const * e = &entries[i];
+            ok = e->dxil_offset + e->dxil_size <= header->strings_offset &&
+                 e->reflection_offset + e->reflection_size <= header->strings_offset &&
+                 e->spirv_offset + e->spirv_size <= header->strings_offset &&
+                 e->name < header->strings_size && e->entry < header->strings_size &&
+                 e->stage < header->strings_size && e->defines < header->strings_size;
+        }
+    }
+    if (!ok) {
+        ::printf("shader archive: %s is not a valid archive\n", path);
+        ::free(data);
+        return false;
+    }
+    archive->data = data;
+    archive->size = size;
+    archive->header = header;
+    archive->entries = reinterpret_cast<ShaderArchiveEntry const *>(data + sizeof(ShaderArchiveHeader));
+    archive->strings = reinterpret_cast<char const *>(data + header->strings_offset);
+    return true;
+}
+// -- "A=1;B=0", sorted by define name; returns false if it does not fit
+static bool
+shader_archive_canonical_defines (ShaderCacheDefine const * defines, char * out, size_t out_size) {
+    ShaderCacheDefine const * sorted [SHADER_ARCHIVE_MAX_DEFINES];
+    uint32_t count = 0;
+    for (ShaderCacheDefine const * define = defines; define && define->name; ++define) {
+        if (count == SHADER_ARCHIVE_MAX_DEFINES)
+            return false;
+        uint32_t i = count++;
+        while (i > 0 && ::strcmp(sorted[i - 1]->name, define->name) > 0) {
+            sorted[i] = sorted[i - 1];
+            --i;
+        }
+        sorted[i] = define;
+    }
+    size_t len = 0;
+    out[0] = '\0';
+    for (uint32_t i = 0; i < count; ++i) {
+        int written = ::snprintf(
+            out + len, out_size - len, "%s%s=%s", i > 0 ? ";" : "",
+            sorted[i]->name, sorted[i]->definition ? sorted[i]->definition : "1"
+        );
+        if (written < 0 || (size_t)written >= out_size - len)
+            return false;
+        len += (size_t)written;
+    }
+    return true;
+}
+// NOTE(omid): path may be given the way the runtime opens it ("./shaders/x.hlsl");
+// a leading "./" is dropped and backslashes become slashes.
+static ShaderArchiveEntry const *
+shader_archive_find (ShaderArchive * archive, char const * path, char const * entry, char const * target, ShaderCacheDefine const * defines) {
+    if (!archive->data)
+        return nullptr;
+    char name [SHADER_CACHE_MAX_PATH];
+    char stage [3] = {target[0], target[0] ? target[1] : '\0', '\0'};
+    char canonical [SHADER_ARCHIVE_MAX_KEY];
+    while ('.' == path[0] && ('/' == path[1] || '\\' == path[1]))
+        path += 2;
+    size_t name_len = 0;
+    for (; path[name_len] && name_len + 1 < sizeof(name); ++name_len)
+        name[name_len] = '\\' == path[name_len] ? '/' : path[name_len];
+    name[name_len] = '\0';
+    if (!shader_archive_canonical_defines(defines, canonical, sizeof(canonical)))
+        return nullptr;
+
+    uint64_t hash = FNV1A_64_SEED;
+    hash = shader_hash_string(hash, name);
+    hash = shader_hash_string(hash, entry);
+    hash = shader_hash_string(hash, stage);
+    hash = shader_hash_string(hash, canonical);
+
+    // -- lower bound, then walk the (rare) entries sharing the hash
+    uint32_t lo = 0, hi = archive->header->entry_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (archive->entries[mid].lookup_hash < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    for (uint32_t i = lo; i < archive->header->entry_count && archive->entries[i].lookup_hash == hash; ++i) {
+        ShaderArchiveEntry const * e = &archive->entries[i];
+        if (0 == ::strcmp(archive->strings + e->name, name) && 0 == ::strcmp(archive->strings + e->entry, entry) &&
+            0 == ::strcmp(archive->strings + e->stage, stage) && 0 == ::strcmp(archive->strings + e->defines, canonical)
+        ) {
+            ++archive->hits;
+            return e;
+        }
+    }
+    ++archive->misses;
+    return nullptr;
+}
+static ShaderArchiveBlob
+shader_archive_dxil (ShaderArchive const * archive, ShaderArchiveEntry const * entry) {
+    ShaderArchiveBlob ret = {archive->data + entry->dxil_offset, entry->dxil_size};
+    return ret;
+}
+static ShaderArchiveBlob
+shader_archive_reflection (ShaderArchive const * archive, ShaderArchiveEntry const * entry) {
+    ShaderArchiveBlob ret = {entry->reflection_size ? archive->data + entry->reflection_offset : nullptr, entry->reflection_size};
+    return ret;
+}
+static ShaderArchiveBlob
+shader_archive_spirv (ShaderArchive const * archive, ShaderArchiveEntry const * entry) {
+    ShaderArchiveBlob ret = {entry->spirv_size ? archive->data + entry->spirv_offset : nullptr, entry->spirv_size};
+    return ret;
+}
+static void
+shader_archive_print_stats (ShaderArchive const * archive) {
+    if (!archive->data)
+        return;
+    ::printf(
+        "Shader archive: %u entries (%.1f KiB%s), %u lookups hit, %u missed\n",
+        archive->header->entry_count, (double)archive->size / 1024.0,
+        (archive->header->flags & SHADER_ARCHIVE_FLAG_SPIRV) ? ", with spir-v" : "",
+        archive->hits, archive->misses
+    );
+}
+static void
+shader_archive_destroy (ShaderArchive * archive) {
+    ::free(archive->data);
+    ::memset(archive, 0, sizeof(*archive));
+}
@@ -0,0 +1,264 @@
+#pragma once
+
+// NOTE(omid): Compiles shaders on a small pool of worker threads. A submit returns
+// a job whose future becomes ready once the bytecode is available, so every stage
+// and permutation can be in flight at once and startup pays roughly for the
+// longest compile instead of the sum. Each job goes through the shader cache first;
+// the cache's files and stats are only touched under cache_mutex, the compile
+// itself runs unlocked.
+// D3DCompileFromFile is documented as thread-safe; each job compiles on its own thread.
+// With a precompiled archive attached (see shader_archive.h), jobs it covers are
+// served from it and never reach the cache or the compiler.
+
+#include "shader_cache.h"
+#include "shader_archive.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+
+#define SHADER_BUILD_MAX_THREADS    8
+#define SHADER_BUILD_MAX_JOBS       64
+
+static_assert(sizeof(ShaderCacheDefine) == sizeof(D3D_SHADER_MACRO), "ShaderCacheDefine must match D3D_SHADER_MACRO");
+
+struct ShaderBuildJob {
+    // -- inputs (pointers must stay valid until the job is released)
+    char const *                    path;
+    ShaderCacheDefine const *       defines;
+    char const *                    entry;
+    char const *                    target;
+    UINT                            flags;
+
+    // -- results, valid once the future is ready
+    ID3DBlob *                      bytecode;
+    ID3DBlob *                      errors;
+    HRESULT                         hr;
+    bool                            from_cache;
+    bool                            from_archive;
+    double                          build_ms;
+
+    bool                            used;
+    std::promise<HRESULT>           promise;
+    std::shared_future<HRESULT>     future;
+};
+struct ShaderBuildStats {
+    uint32_t                        jobs;
+    uint32_t                        cache_hits;
+    uint32_t                        archive_hits;
+    uint32_t                        failed;
+    double                          sum_build_ms;       // what a serial build would have cost
+    double                          longest_build_ms;
+};
+struct ShaderBuildService {
+    ShaderCache *                   cache;
+    ShaderArchive *                 archive;            // optional, read-only apart from its stats
+    std::mutex                      cache_mutex;        // guards cache and archive
+
+    std::thread                     workers [SHADER_BUILD_MAX_THREADS];
+    uint32_t                        thread_count;
+
+    // -- pending jobs, fifo (guarded by mutex)
+    std::mutex                      mutex;
+    std::condition_variable         wake;
+    ShaderBuildJob *                queue [SHADER_BUILD_MAX_JOBS];
+    uint32_t                        queue_head;
+    uint32_t                        queue_count;
+    bool                            stop;
+
+    ShaderBuildJob                  jobs [SHADER_BUILD_MAX_JOBS];
+    ShaderBuildStats                stats;
+    LARGE_INTEGER                   qpc_freq;
+};
+
+// -- synchronous build of one job through the cache (what the workers run)
+static void
+shader_build_run (ShaderBuildService * service, ShaderBuildJob * job) {
+    LARGE_INTEGER begin = {}, end = {};
+    QueryPerformanceCounter(&begin);
+
+    job->bytecode = nullptr;
+    job->errors = nullptr;
+    job->from_cache = false;
+    job->from_archive = false;
+    if (service->archive) {
+        ShaderArchiveBlob dxil = {};
+        {
+            std::lock_guard<std::mutex> lock(service->cache_mutex);
+            ShaderArchiveEntry const * entry = shader_archive_find(service->archive, job->path, job->entry, job->target, job->defines);
+            if (entry)
+                dxil = shader_archive_dxil(service->archive, entry);
+        }
+        if (dxil.data && SUCCEEDED(D3DCreateBlob(dxil.size, &job->bytecode))) {
+            ::memcpy(job->bytecode->GetBufferPointer(), dxil.data, dxil.size);
+            job->from_archive = true;
+            job->hr = S_OK;
+            QueryPerformanceCounter(&end);
+            job->build_ms = 1e3 * (double)(end.QuadPart - begin.QuadPart) / (double)service->qpc_freq.QuadPart;
+            return;
+        }
+    }
+    ShaderCacheKey key = shader_cache_key(service->cache, job->path, job->defines, job->entry, job->target, job->flags);
+
+    size_t cached_size = 0;
+    void * cached = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(service->cache_mutex);
+        cached = shader_cache_load(service->cache, &key, &cached_size);
+    }
+    HRESULT hr = E_FAIL;
+    if (cached) {
+        hr = D3DCreateBlob(cached_size, &job->bytecode);
+        if (SUCCEEDED(hr)) {
+            ::memcpy(job->bytecode->GetBufferPointer(), cached, cached_size);
+            job->from_cache = true;
+        }
+        ::free(cached);
+    }
+    if (!job->from_cache) {
+        wchar_t wide_path [SHADER_CACHE_MAX_PATH] = {};
+        MultiByteToWideChar(CP_UTF8, 0, job->path, -1, wide_path, ARRAY_COUNT(wide_path));
+        hr = D3DCompileFromFile(
+            wide_path, reinterpret_cast<D3D_SHADER_MACRO const *>(job->defines), D3D_COMPILE_STANDARD_FILE_INCLUDE,
+            job->entry, job->target, job->flags, 0, &job->bytecode, &job->errors
+        );
+        if (SUCCEEDED(hr)) {
+            std::lock_guard<std::mutex> lock(service->cache_mutex);
+            shader_cache_store(service->cache, &key, job->bytecode->GetBufferPointer(), job->bytecode->GetBufferSize());
+        }
+    }
+    job->hr = hr;
+
+    QueryPerformanceCounter(&end);
+    job->build_ms = 1e3 * (double)(end.QuadPart - begin.QuadPart) / (double)service->qpc_freq.QuadPart;
+}
+static void
+shader_build_worker (ShaderBuildService * service) {
+    for (;;) {
+        ShaderBuildJob * job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(service->mutex);
+            service->wake.wait(lock, [service] { return service->stop || service->queue_count > 0; });
+            if (0 == service->queue_count)
+                return;     // stop requested and nothing left
+            job = service->queue[service->queue_head];
+            service->queue_head = (service->queue_head + 1) % SHADER_BUILD_MAX_JOBS;
+            --service->queue_count;
+        }
+        shader_build_run(service, job);
+        {
+            std::lock_guard<std::mutex> lock(service->mutex);
+            ShaderBuildStats * s = &service->stats;
+            s->cache_hits += job->from_cache ? 1 : 0;
+            s->archive_hits += job->from_archive ? 1 : 0;
+            s->failed += FAILED(job->hr) ? 1 : 0;
+            s->sum_build_ms += job->build_ms;
+            if (job->build_ms > s->longest_build_ms)
+                s->longest_build_ms = job->build_ms;
+        }
+        // -- the slot may be resubmitted as soon as the future is ready, so complete through a local
+        std::promise<HRESULT> promise = std::move(job->promise);
+        promise.set_value(job->hr);
+    }
+}
+// -- service must be default-constructed (it holds std:: sync objects); thread_count 0 means one per core
+// archive may be null; it must stay loaded while the service runs
+static void
+shader_build_service_init (ShaderBuildService * service, ShaderCache * cache, ShaderArchive * archive, uint32_t thread_count) {
+    if (0 == thread_count)
+        thread_count = std::thread::hardware_concurrency();
+    if (thread_count < 1)
+        thread_count = 1;
+    if (thread_count > SHADER_BUILD_MAX_THREADS)
+        thread_count = SHADER_BUILD_MAX_THREADS;
+    service->cache = cache;
+    service->archive = archive;
+    service->thread_count = thread_count;
+    service->queue_head = 0;
+    service->queue_count = 0;
+    service->stop = false;
+    service->stats = {};
+    QueryPerformanceFrequency(&service->qpc_freq);
+    for (uint32_t i = 0; i < SHADER_BUILD_MAX_JOBS; ++i)
+        service->jobs[i].used = false;
+    for (uint32_t t = 0; t < thread_count; ++t)
+        service->workers[t] = std::thread(shader_build_worker, service);
+}
+// NOTE(omid): Queues a compile and returns immediately. Returns null when all job
+// slots are taken; release awaited jobs to free them.
+static ShaderBuildJob *
+shader_build_submit (
+    ShaderBuildService * service, char const * path, ShaderCacheDefine const * defines,
+    char const * entry, char const * target, UINT flags
+) {
+    std::lock_guard<std::mutex> lock(service->mutex);
+    ShaderBuildJob * job = nullptr;
+    for (uint32_t i = 0; i < SHADER_BUILD_MAX_JOBS; ++i) {
+        if (!service->jobs[i].used) {
+            job = &service->jobs[i];
+            break;
+        }
+    }
+    if (!job)
+        return nullptr;
+    job->path = path;
+    job->defines = defines;
+    job->entry = entry;
+    job->target = target;
+    job->flags = flags;
+    job->bytecode = nullptr;
+    job->errors = nullptr;
+    job->hr = E_PENDING;
+    job->from_cache = false;
+    job->from_archive = false;
+    job->build_ms = 0.0;
+    job->used = true;
+    job->promise = std::promise<HRESULT>();
+    job->future = job->promise.get_future().share();
+
+    uint32_t tail = (service->queue_head + service->queue_count) % SHADER_BUILD_MAX_JOBS;
+    service->queue[tail] = job;
+    ++service->queue_count;
+    ++service->stats.jobs;
+    service->wake.notify_one();
+    return job;
+}
+static bool
+shader_build_is_ready (ShaderBuildJob const * job) {
+    return std::future_status::ready == job->future.wait_for(std::chrono::seconds(0));
+}
+// -- blocks until the job finished; bytecode / errors are then owned by the caller
+static HRESULT
+shader_build_await (ShaderBuildJob * job) {
+    return job->future.get();
+}
+// -- job must have been awaited; its result blobs are not released here
+static void
+shader_build_release (ShaderBuildService * service, ShaderBuildJob * job) {
+    std::lock_guard<std::mutex> lock(service->mutex);
+    SIMPLE_ASSERT(job->used);
+    job->used = false;
+    job->future = std::shared_future<HRESULT>();
+}
+static void
+shader_build_print_stats (ShaderBuildService * service) {
+    std::lock_guard<std::mutex> lock(service->mutex);
+    ShaderBuildStats const * s = &service->stats;
+    ::printf(
+        "Shader builds: %u jobs on %u threads, %u from archive, %u from cache, %u failed, %.3f ms summed, %.3f ms longest\n",
+        s->jobs, service->thread_count, s->archive_hits, s->cache_hits, s->failed, s->sum_build_ms, s->longest_build_ms
+    );
+}
+// -- finishes queued jobs, then joins the workers
+static void
+shader_build_service_destroy (ShaderBuildService * service) {
+    {
+        std::lock_guard<std::mutex> lock(service->mutex);
+        service->stop = true;
+    }
+    service->wake.notify_all();
+    for (uint32_t t = 0; t < service->thread_count; ++t)
+        service->workers[t].join();
+    service->thread_count = 0;
+}
@@ -0,0 +1,257 @@
+#pragma once
+
+// NOTE(omid): Persistent cache for compiled shader bytecode. The key is a hash of
+// everything that can change the compiler output:
+//   - the source file and, recursively, every file it #includes (quoted includes
+//     resolve relative to the including file, like D3D_COMPILE_STANDARD_FILE_INCLUDE)
+//   - defines, entry point, target, compile flags and the compiler version
+// Bytecode lives in one file per key under the cache directory. Only successful
+// compiles are stored, so errors are always reported by the real compiler.
+// This header only depends on the C runtime (plus mkdir), so the caching logic
+// can be exercised off Windows.
+
+#include "common_macros.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#define SHADER_CACHE_MAGIC              0x43444853      // 'SHDC'
+#define SHADER_CACHE_VERSION            1
+#define SHADER_CACHE_MAX_PATH           260
+#define SHADER_CACHE_ENTRY_PATH_SIZE    (SHADER_CACHE_MAX_PATH + 21)    // dir + "/" + 16 hex digits + ".cso"
+#define SHADER_CACHE_MAX_INCLUDE_DEPTH  16
+
+// -- same layout as D3D_SHADER_MACRO; an array is terminated by a null name
+struct ShaderCacheDefine {
+    char const *                    name;
+    char const *                    definition;
+};
+struct ShaderCacheKey {
+    uint64_t                        hash;
+    uint32_t                        file_count;     // source + includes hashed
+    bool                            valid;          // false if the source could not be read
+};
+struct ShaderCacheFileHeader {
+    uint32_t                        magic;
+    uint32_t                        version;
+    uint64_t                        key_hash;
+    uint64_t                        size;
+};
+struct ShaderCacheStats {
+    uint32_t                        hits;
+    uint32_t                        misses;
+    uint32_t                        stores;
+    uint32_t                        corrupt;        // entries ignored because the file did not validate
+};
+struct ShaderCache {
+    char                            dir [SHADER_CACHE_MAX_PATH];
+    uint32_t                        compiler_version;
+    ShaderCacheStats                stats;
+};
+
+// -- strings hashed with their terminator so ("ab","c") != ("a","bc"); null hashes differently from ""
+static uint64_t
+shader_hash_string (uint64_t hash, char const * str) {
+    if (nullptr == str) {
+        uint8_t const none = 0xff;
+        return fnv1a_64(&none, 1, hash);
+    }
+    return fnv1a_64(str, ::strlen(str) + 1, hash);
+}
+
+// -- directory part of path including the trailing separator ("" when there is none)
+static void
+shader_cache_dir_of (char const * path, char * out_dir, size_t out_size) {
+    size_t len = 0;
+    for (size_t i = 0; path[i]; ++i) {
+        if ('/' == path[i] || '\\' == path[i])
+            len = i + 1;
+    }
+    if (len >= out_size)
+        len = out_size - 1;
+    ::memcpy(out_dir, path, len);
+    out_dir[len] = '\0';
+}
+// NOTE(omid): Hashes the file and the files it includes, depth first in include order.
+// Line-based scan: an #include inside a block comment or a disabled #if branch is
+// still followed, which only makes the key more conservative.
+static uint64_t
+shader_hash_file_recursive (uint64_t hash, char const * path, uint32_t depth, uint32_t * file_count, bool * ok) {
+    size_t size = 0;
+    char * text = read_whole_file(path, &size);
+    hash = shader_hash_string(hash, path);
+    if (!text) {
+        *ok = false;
+        return hash;
+    }
+    ++*file_count;
+    hash = fnv1a_64(text, size, hash);
+
+    char dir [SHADER_CACHE_MAX_PATH];
+    shader_cache_dir_of(path, dir, sizeof(dir));
+    for (char const * line = text; line && *line; ) {
+        char const * c = line;
+        while (' ' == *c || '\t' == *c)
+            ++c;
+        if ('#' == *c) {
+            ++c;
+            while (' ' == *c || '\t' == *c)
+                ++c;
+            if (0 == ::strncmp(c, "include", 7)) {
+                c += 7;
+                while (' ' == *c || '\t' == *c)
+                    ++c;
+                char close = '"' == *c ? '"' : ('<' == *c ? '>' : '\0');
+                char const * name_end = close ? ::strchr(c + 1, close) : nullptr;
+                char const * line_end = ::strchr(c, '\n');
+                if (name_end && (nullptr == line_end || name_end < line_end)) {
+                    char include_path [SHADER_CACHE_MAX_PATH];
+                    size_t dir_len = ::strlen(dir);
+                    size_t name_len = (size_t)(name_end - (c + 1));
+                    if (dir_len + name_len < sizeof(include_path) && depth < SHADER_CACHE_MAX_INCLUDE_DEPTH) {
+                        ::memcpy(include_path, dir, dir_len);
+                        ::memcpy(include_path + dir_len, c + 1, name_len);
+                        include_path[dir_len + name_len] = '\0';
+                        hash = shader_hash_file_recursive(hash, include_path, depth + 1, file_count, ok);
+                    } else {
+                        *ok = false;
+                    }
+                }
+            }
+        }
+        line = ::strchr(line, '\n');
+        if (line)
+            ++line;
+    }
+    ::free(text);
+    return hash;
+}
+
+static void
+shader_cache_init (ShaderCache * cache, char const * dir, uint32_t compiler_version) {
+    ::memset(cache, 0, sizeof(*cache));
+    size_t len = ::strlen(dir);
+    SIMPLE_ASSERT(len + 32 < sizeof(cache->dir));
+    ::memcpy(cache->dir, dir, len + 1);
+    cache->compiler_version = compiler_version;
+    // -- fails harmlessly when the directory already exists
+#if defined(_WIN32)
+    ::_mkdir(dir);
+#else
+    ::mkdir(dir, 0755);
+#endif
+}
+// NOTE(omid): A key that is not valid (unreadable source or include) must not be
+// looked up or stored; compile normally and let the compiler report the error.
+static ShaderCacheKey
+shader_cache_key (
+    ShaderCache const * cache, char const * path, ShaderCacheDefine const * defines,
+    char const * entry, char const * target, uint32_t flags
+) {
+    ShaderCacheKey ret = {};
+    bool ok = true;
+    uint64_t hash = FNV1A_64_SEED;
+    hash = fnv1a_64(&cache->compiler_version, sizeof(cache->compiler_version), hash);
+    hash = shader_hash_string(hash, entry);
+    hash = shader_hash_string(hash, target);
+    hash = fnv1a_64(&flags, sizeof(flags), hash);
+    for (ShaderCacheDefine const * define = defines; define && define->name; ++define) {
+        hash = shader_hash_string(hash, define->name);
+        hash = shader_hash_string(hash, define->definition);
+    }
+    hash = shader_hash_file_recursive(hash, path, 0, &ret.file_count, &ok);
+    ret.hash = hash;
+    ret.valid = ok;
+    return ret;
+}
+// -- false when the path does not fit out_path; the lookup or store is then skipped
+static bool
+shader_cache_entry_path (ShaderCache const * cache, ShaderCacheKey const * key, char * out_path, size_t out_size) {
+    int len = ::snprintf(out_path, out_size, "%s/%016llx.cso", cache->dir, (unsigned long long)key->hash);
+    return len >= 0 && (size_t)len < out_size;
+}
+// -- returns malloc'ed bytecode (caller frees) or null on a miss
+static void *
+shader_cache_load (ShaderCache * cache, ShaderCacheKey const * key, size_t * out_size) {
+    *out_size = 0;
+    if (!key->valid)
+        return nullptr;
+    char path [SHADER_CACHE_ENTRY_PATH_SIZE];
+    size_t size = 0;
+    if (!shader_cache_entry_path(cache, key, path, sizeof(path))) {
+        ++cache->stats.misses;
+        return nullptr;
+    }
+    char * data = read_whole_file(path, &size);
+    if (!data) {
+        ++cache->stats.misses;
+        return nullptr;
+    }
+    ShaderCacheFileHeader header = {};
+    bool valid = size >= sizeof(header);
+    if (valid) {
+        ::memcpy(&header, data, sizeof(header));
+        valid = SHADER_CACHE_MAGIC == header.magic && SHADER_CACHE_VERSION == header.version &&
+                key->hash == header.key_hash && size == sizeof(header) + header.size && header.size > 0;
+    }
+    if (!valid) {
+        ::free(data);
+        ++cache->stats.corrupt;
+        ++cache->stats.misses;
+        return nullptr;
+    }
+    ::memmove(data, data + sizeof(header), (size_t)header.size);
+    ++cache->stats.hits;
+    *out_size = (size_t)header.size;
+    return data;
+}
+// -- written to a temporary file first so a crash never leaves a truncated entry behind
+static bool
+shader_cache_store (ShaderCache * cache, ShaderCacheKey const * key, void const * bytecode, size_t size) {
+    if (!key->valid || 0 == size)
+        return false;
+    char path [SHADER_CACHE_ENTRY_PATH_SIZE];
+    char temp_path [SHADER_CACHE_ENTRY_PATH_SIZE + 4];
+    if (!shader_cache_entry_path(cache, key, path, sizeof(path)))
+        return false;
+    int temp_len = ::snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    if (temp_len < 0 || (size_t)temp_len >= sizeof(temp_path))
+        return false;
+
+    FILE * file = ::fopen(temp_path, "wb");
+    if (!file)
+        return false;
+    ShaderCacheFileHeader header = {};
+    header.magic = SHADER_CACHE_MAGIC;
+    header.version = SHADER_CACHE_VERSION;
+    header.key_hash = key->hash;
+    header.size = size;
+    bool ok = 1 == ::fwrite(&header, sizeof(header), 1, file);
+    ok = ok && 1 == ::fwrite(bytecode, size, 1, file);
+    ok = (0 == ::fclose(file)) && ok;
+    if (ok) {
+        ::remove(path);     // rename does not replace on windows
+        ok = 0 == ::rename(temp_path, path);
+    }
+    if (!ok) {
+        ::remove(temp_path);
+        return false;
+    }
+    ++cache->stats.stores;
+    return true;
+}
+static void
+shader_cache_print_stats (ShaderCache const * cache) {
+    ShaderCacheStats const * s = &cache->stats;
+    ::printf(
+        "Shader cache (%s): %u hits, %u misses, %u stored, %u corrupt\n",
+        cache->dir, s->hits, s->misses, s->stores, s->corrupt
+    );
+}
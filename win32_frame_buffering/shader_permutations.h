@@ -0,0 +1,307 @@
+#pragma once
+
+// NOTE(omid): Permutations of one shader entry point. Each key is a #define the
+// shader tests (booleans have 2 values, enums n); a combination of key values maps
+// to a compact mixed-radix index:
+//
+//   index = v0 + n0 * (v1 + n1 * (v2 + ...))
+//
+// Variants are compiled lazily on the ShaderBuildService the first time they are
+// asked for. Until a variant is ready, the generic variant (compiled up front) is
+// served instead, so asking never blocks a frame. Variants requested during a run
+// are recorded to a usage file; the next launch pre-warms from that list, so the
+// variants a build actually uses are compiled (or pulled from the shader cache)
+// before they are needed.
+// After the source changes (hot reload), variants are invalidated rather than
+// dropped: each keeps serving its old bytecode, marked stale, until the recompile
+// for the new source lands.
+
+#include "shader_build_service.h"
+
+#define SHADER_PERMUTATION_MAX_KEYS         8
+#define SHADER_PERMUTATION_MAX_VARIANTS     64
+#define SHADER_PERMUTATION_NONE             0xffffffff
+
+struct ShaderPermutationKey {
+    char const *                    name;           // the #define the shader tests
+    uint32_t                        value_count;    // 2 for booleans
+};
+enum ShaderVariantState : uint32_t {
+    ShaderVariant_NotRequested = 0,
+    ShaderVariant_Compiling,
+    ShaderVariant_Ready,
+    ShaderVariant_Failed,
+};
+struct ShaderVariant {
+    ShaderVariantState              state;
+    ShaderBuildJob *                job;            // while compiling (also while a ready variant rebuilds)
+    ID3DBlob *                      bytecode;       // once ready, owned by the set
+    uint32_t                        generation;     // bumped whenever bytecode is replaced
+    bool                            used;           // asked for this run (goes to the usage file)
+    bool                            stale;          // bytecode was built from an older source
+    bool                            rebuild;        // stale and not resubmitted yet
+    bool                            restart;        // in-flight job started before the source changed
+    // -- defines handed to the compiler; must live as long as the job
+    ShaderCacheDefine               defines [SHADER_PERMUTATION_MAX_KEYS + 1];
+    char                            values [SHADER_PERMUTATION_MAX_KEYS][4];
+};
+struct ShaderPermutationStats {
+    uint32_t                        lazy_compiles;  // requested on first use
+    uint32_t                        prewarmed;      // requested from the usage file
+    uint32_t                        failed;
+    uint32_t                        rebuilds;       // recompiles after the source changed
+    uint64_t                        fallbacks;      // requests served by the generic variant
+};
+struct ShaderPermutationSet {
+    char const *                    name;
+    char const *                    path;
+    char const *                    entry;
+    char const *                    target;
+    UINT                            flags;
+
+    ShaderPermutationKey            keys [SHADER_PERMUTATION_MAX_KEYS];
+    uint32_t                        key_count;
+    uint32_t                        variant_count;
+    uint32_t                        generic_index;
+
+    ShaderVariant                   variants [SHADER_PERMUTATION_MAX_VARIANTS];
+    ShaderPermutationStats          stats;
+};
+
+static uint32_t
+shader_permutation_index (ShaderPermutationSet const * set, uint32_t const * values) {
+    uint32_t ret = 0;
+    for (uint32_t k = set->key_count; k-- > 0; ) {
+        SIMPLE_ASSERT(values[k] < set->keys[k].value_count);
+        ret = ret * set->keys[k].value_count + values[k];
+    }
+    return ret;
+}
+static void
+shader_permutation_values (ShaderPermutationSet const * set, uint32_t index, uint32_t * out_values) {
+    for (uint32_t k = 0; k < set->key_count; ++k) {
+        out_values[k] = index % set->keys[k].value_count;
+        index /= set->keys[k].value_count;
+    }
+}
+// -- generic_values: the variant compiled first and served while others are not ready
+static void
+shader_permutation_set_init (
+    ShaderPermutationSet * set, char const * name, char const * path, char const * entry, char const * target, UINT flags,
+    ShaderPermutationKey const * keys, uint32_t key_count, uint32_t const * generic_values
+) {
+    ::memset(set, 0, sizeof(*set));
+    SIMPLE_ASSERT(key_count <= SHADER_PERMUTATION_MAX_KEYS);
+    set->name = name;
+    set->path = path;
+    set->entry = entry;
+    set->target = target;
+    set->flags = flags;
+    set->key_count = key_count;
+    set->variant_count = 1;
+    for (uint32_t k = 0; k < key_count; ++k) {
+        SIMPLE_ASSERT(keys[k].value_count >= 2 && keys[k].value_count <= 100);
+        set->keys[k] = keys[k];
+        set->variant_count *= keys[k].value_count;
+    }
+    SIMPLE_ASSERT(set->variant_count <= SHADER_PERMUTATION_MAX_VARIANTS);
+    set->generic_index = shader_permutation_index(set, generic_values);
+
+    for (uint32_t i = 0; i < set->variant_count; ++i) {
+        ShaderVariant * variant = &set->variants[i];
+        uint32_t values [SHADER_PERMUTATION_MAX_KEYS];
+        shader_permutation_values(set, i, values);
+        for (uint32_t k = 0; k < key_count; ++k) {
+            ::snprintf(variant->values[k], sizeof(variant->values[k]), "%u", values[k]);
+            variant->defines[k].name = keys[k].name;
+            variant->defines[k].definition = variant->values[k];
+        }
+        variant->defines[key_count].name = nullptr;
+        variant->defines[key_count].definition = nullptr;
+    }
+}
+// -- start compiling the variant if nobody asked for it yet (or it went stale); false if the service is full
+static bool
+shader_permutation_request (ShaderPermutationSet * set, ShaderBuildService * service, uint32_t index) {
+    SIMPLE_ASSERT(index < set->variant_count);
+    ShaderVariant * variant = &set->variants[index];
+    if (variant->job)
+        return true;
+    bool rebuild = ShaderVariant_Ready == variant->state && variant->rebuild;
+    if (variant->state != ShaderVariant_NotRequested && !rebuild)
+        return true;
+    variant->job = shader_build_submit(service, set->path, variant->defines, set->entry, set->target, set->flags);
+    if (!variant->job)
+        return false;
+    if (rebuild) {
+        variant->rebuild = false;
+        ++set->stats.rebuilds;
+    } else {
+        variant->state = ShaderVariant_Compiling;
+    }
+    return true;
+}
+// NOTE(omid): A failed rebuild keeps the previous bytecode (still stale) so a typo
+// in the source does not take the variant away; it is retried on the next change.
+static void
+shader_permutation_harvest (ShaderPermutationSet * set, ShaderBuildService * service, ShaderVariant * variant) {
+    HRESULT hr = shader_build_await(variant->job);
+    ID3DBlob * bytecode = variant->job->bytecode;
+    if (variant->job->errors) {
+        ::printf("%s: %s\n", set->name, (char const *)variant->job->errors->GetBufferPointer());
+        variant->job->errors->Release();
+    }
+    shader_build_release(service, variant->job);
+    variant->job = nullptr;
+    if (SUCCEEDED(hr) && bytecode) {
+        if (variant->bytecode)
+            variant->bytecode->Release();
+        variant->bytecode = bytecode;
+        ++variant->generation;
+        variant->state = ShaderVariant_Ready;
+        variant->stale = variant->restart;
+        variant->rebuild = variant->restart;
+    } else {
+        if (bytecode)
+            bytecode->Release();
+        if (variant->bytecode)
+            variant->rebuild = variant->restart;
+        else
+            variant->state = variant->restart ? ShaderVariant_NotRequested : ShaderVariant_Failed;
+        ++set->stats.failed;
+    }
+    variant->restart = false;
+}
+// -- collect finished compiles without blocking
+static void
+shader_permutation_poll (ShaderPermutationSet * set, ShaderBuildService * service) {
+    for (uint32_t i = 0; i < set->variant_count; ++i) {
+        ShaderVariant * variant = &set->variants[i];
+        if (variant->job && shader_build_is_ready(variant->job))
+            shader_permutation_harvest(set, service, variant);
+    }
+}
+// -- blocking; for the generic variant at startup (and any variant with no bytecode yet)
+static ID3DBlob *
+shader_permutation_await (ShaderPermutationSet * set, ShaderBuildService * service, uint32_t index) {
+    ShaderVariant * variant = &set->variants[index];
+    variant->used = true;
+    if (!shader_permutation_request(set, service, index))
+        return nullptr;
+    if (ShaderVariant_Compiling == variant->state)
+        shader_permutation_harvest(set, service, variant);
+    return variant->bytecode;
+}
+// -- built from the current source, with no rebuild pending or in flight
+static bool
+shader_permutation_is_fresh (ShaderPermutationSet const * set, uint32_t index) {
+    ShaderVariant const * variant = &set->variants[index];
+    return ShaderVariant_Ready == variant->state && !variant->stale && !variant->job;
+}
+// -- a (re)compile is queued, in flight, or still to be submitted
+static bool
+shader_permutation_is_building (ShaderPermutationSet const * set, uint32_t index) {
+    ShaderVariant const * variant = &set->variants[index];
+    return variant->job || ShaderVariant_NotRequested == variant->state || (ShaderVariant_Ready == variant->state && variant->rebuild);
+}
+// NOTE(omid): The source (or something it includes) changed. Ready variants keep
+// their bytecode but go stale and are recompiled the next time they are requested;
+// compiles already in flight may have read the old source, so they are redone once
+// they land; failed variants get another chance.
+static void
+shader_permutation_invalidate (ShaderPermutationSet * set) {
+    for (uint32_t i = 0; i < set->variant_count; ++i) {
+        ShaderVariant * variant = &set->variants[i];
+        if (variant->job)
+            variant->restart = true;
+        if (ShaderVariant_Ready == variant->state)
+            variant->stale = variant->rebuild = true;
+        else if (ShaderVariant_Failed == variant->state)
+            variant->state = ShaderVariant_NotRequested;
+    }
+}
+// NOTE(omid): Never blocks once the generic variant is ready. Returns the bytecode
+// to use now; out_served_index says which variant that is (the requested one, or
+// the generic one while the requested variant compiles or if it failed).
+static ID3DBlob *
+shader_permutation_get (ShaderPermutationSet * set, ShaderBuildService * service, uint32_t index, uint32_t * out_served_index) {
+    SIMPLE_ASSERT(index < set->variant_count);
+    ShaderVariant * variant = &set->variants[index];
+    if (!variant->used) {
+        variant->used = true;
+        if (ShaderVariant_NotRequested == variant->state)
+            ++set->stats.lazy_compiles;
+    }
+    shader_permutation_request(set, service, index);
+    if (variant->job && shader_build_is_ready(variant->job))
+        shader_permutation_harvest(set, service, variant);
+    if (ShaderVariant_Ready == variant->state) {
+        *out_served_index = index;
+        return variant->bytecode;
+    }
+    ++set->stats.fallbacks;
+    *out_served_index = set->generic_index;
+    return shader_permutation_await(set, service, set->generic_index);
+}
+// NOTE(omid): Usage file: a header line "<set name> <variant count>" followed by one
+// variant index per line. A file written for a different key layout is ignored.
+static bool
+shader_permutation_save_usage (ShaderPermutationSet const * set, char const * path) {
+    FILE * file = ::fopen(path, "w");
+    if (!file)
+        return false;
+    ::fprintf(file, "%s %u\n", set->name, set->variant_count);
+    for (uint32_t i = 0; i < set->variant_count; ++i) {
+        if (set->variants[i].used)
+            ::fprintf(file, "%u\n", i);
+    }
+    return 0 == ::fclose(file);
+}
+// -- submit every variant the usage file lists; returns how many were requested
+static uint32_t
+shader_permutation_prewarm (ShaderPermutationSet * set, ShaderBuildService * service, char const * path) {
+    FILE * file = ::fopen(path, "r");
+    if (!file)
+        return 0;
+    char name [64] = {};
+    unsigned variant_count = 0;
+    uint32_t ret = 0;
+    if (2 == ::fscanf(file, "%63s %u", name, &variant_count) &&
+        0 == ::strcmp(name, set->name) && variant_count == set->variant_count
+    ) {
+        unsigned index = 0;
+        while (1 == ::fscanf(file, "%u", &index)) {
+            if (index >= set->variant_count || set->variants[index].state != ShaderVariant_NotRequested)
+                continue;
+            if (!shader_permutation_request(set, service, index))
+                break;
+            ++ret;
+        }
+    }
+    ::fclose(file);
+    set->stats.prewarmed += ret;
+    return ret;
+}
+static void
+shader_permutation_print_stats (ShaderPermutationSet const * set) {
+    uint32_t ready = 0;
+    for (uint32_t i = 0; i < set->variant_count; ++i)
+        ready += ShaderVariant_Ready == set->variants[i].state ? 1 : 0;
+    ShaderPermutationStats const * s = &set->stats;
+    ::printf(
+        "Permutations %s: %u/%u variants ready, %u prewarmed, %u compiled on first use, %u rebuilt, %u failed, %llu fallback requests\n",
+        set->name, ready, set->variant_count, s->prewarmed, s->lazy_compiles, s->rebuilds, s->failed, (unsigned long long)s->fallbacks
+    );
+}
+// -- waits for in-flight compiles, then releases every variant's bytecode
+static void
+shader_permutation_set_destroy (ShaderPermutationSet * set, ShaderBuildService * service) {
+    for (uint32_t i = 0; i < set->variant_count; ++i) {
+        ShaderVariant * variant = &set->variants[i];
+        if (variant->job)
+            shader_permutation_harvest(set, service, variant);
+        if (variant->bytecode)
+            variant->bytecode->Release();
+    }
+    ::memset(set, 0, sizeof(*set));
+}
@@ -0,0 +1,477 @@
+#pragma once
+
+// NOTE(omid): Layouts derived from shader reflection instead of written by hand.
+//
+// Input layout: a C++ vertex struct is described once (VERTEX_ATTRIBUTE records the
+// member's offset and size), and the D3D12_INPUT_ELEMENT_DESC array is produced from
+// the vertex shader's input signature, taking format and offset from the struct
+// member with the same semantic. A semantic the struct lacks, a format that does not
+// match the member's size, or an integer / float mix-up fails right away instead of
+// at pso creation (or as garbage on screen). Members the shader never reads show up
+// as wasted stride.
+//
+// Root signature: the resources every stage binds are collected (merged across
+// stages) and checked against a root signature, so a register the signature does
+// not cover, or covers with the wrong visibility, fails at startup. The same
+// bindings can also generate the minimal signature (one table per visibility,
+// samplers static when the caller provides their state).
+//
+// Reflection goes through D3DReflect, which understands DXBC (FXC) bytecode only;
+// callers fall back to the struct order for DXIL.
+
+#include "common_macros.h"
+
+#include <d3d12shader.h>
+
+#define SHADER_REFLECT_MAX_INPUTS       16
+#define SHADER_REFLECT_MAX_BINDINGS     32
+#define SHADER_STAGE_VERTEX             1u
+#define SHADER_STAGE_PIXEL              2u
+
+struct VertexAttribute {
+    char const *                    semantic;
+    UINT                            semantic_index;
+    DXGI_FORMAT                     format;
+    UINT                            offset;
+    UINT                            size;           // sizeof the member, checked against the format
+};
+struct VertexLayout {
+    char const *                    name;
+    UINT                            stride;
+    VertexAttribute const *         attributes;
+    UINT                            attribute_count;
+};
+#define VERTEX_ATTRIBUTE(type, member, semantic, index, format) \
+    {semantic, index, format, (UINT)offsetof(type, member), (UINT)sizeof(((type *)0)->member)}
+#define VERTEX_LAYOUT(type, attributes) \
+    {#type, (UINT)sizeof(type), attributes, ARRAY_COUNT(attributes)}
+
+// -- one register range a shader binds; stages ORs SHADER_STAGE_* across shaders
+struct ShaderBinding {
+    char                            name [32];
+    D3D12_DESCRIPTOR_RANGE_TYPE     type;
+    UINT                            base_register;
+    UINT                            count;          // UINT_MAX for unbounded arrays
+    UINT                            space;
+    UINT                            stages;
+};
+struct ShaderBindings {
+    ShaderBinding                   items [SHADER_REFLECT_MAX_BINDINGS];
+    UINT                            count;
+    UINT                            stages;         // every stage that was reflected
+    bool                            has_vertex_input;
+};
+// -- storage for a generated root signature (desc points into the arrays)
+struct ShaderRootSignatureLayout {
+    D3D12_DESCRIPTOR_RANGE1         ranges [SHADER_REFLECT_MAX_BINDINGS];
+    D3D12_ROOT_PARAMETER1           params [8];
+    D3D12_STATIC_SAMPLER_DESC       static_samplers [8];
+    D3D12_ROOT_SIGNATURE_DESC1      desc;
+};
+
+// -- DXGI_FORMAT -> byte size and the register component type the shader must declare
+static bool
+vertex_format_info (DXGI_FORMAT format, UINT * out_size, D3D_REGISTER_COMPONENT_TYPE * out_type) {
+    D3D_REGISTER_COMPONENT_TYPE const f = D3D_REGISTER_COMPONENT_FLOAT32;
+    D3D_REGISTER_COMPONENT_TYPE const u = D3D_REGISTER_COMPONENT_UINT32;
+    D3D_REGISTER_COMPONENT_TYPE const s = D3D_REGISTER_COMPONENT_SINT32;
+    UINT size = 0;
+    D3D_REGISTER_COMPONENT_TYPE type = f;
+    switch (format) {
+    case DXGI_FORMAT_R32G32B32A32_FLOAT:    size = 16; break;
+    case DXGI_FORMAT_R32G32B32A32_UINT:     size = 16; type = u; break;
+    case DXGI_FORMAT_R32G32B32A32_SINT:     size = 16; type = s; break;
+    case DXGI_FORMAT_R32G32B32_FLOAT:       size = 12; break;
+    case DXGI_FORMAT_R32G32B32_UINT:        size = 12; type = u; break;
+    case DXGI_FORMAT_R32G32B32_SINT:        size = 12; type = s; break;
+    case DXGI_FORMAT_R32G32_FLOAT:          size = 8; break;
+    case DXGI_FORMAT_R32G32_UINT:           size = 8; type = u; break;
+    case DXGI_FORMAT_R32G32_SINT:           size = 8; type = s; break;
+    case DXGI_FORMAT_R32_FLOAT:             size = 4; break;
+    case DXGI_FORMAT_R32_UINT:              size = 4; type = u; break;
+    case DXGI_FORMAT_R32_SINT:              size = 4; type = s; break;
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:
+    case DXGI_FORMAT_R16G16B16A16_UNORM:
+    case DXGI_FORMAT_R16G16B16A16_SNORM:    size = 8; break;
+    case DXGI_FORMAT_R16G16B16A16_UINT:     size = 8; type = u; break;
+    case DXGI_FORMAT_R16G16B16A16_SINT:     size = 8; type = s; break;
+    case DXGI_FORMAT_R16G16_FLOAT:
+    case DXGI_FORMAT_R16G16_UNORM:
+    case DXGI_FORMAT_R16G16_SNORM:          size = 4; break;
+    case DXGI_FORMAT_R16G16_UINT:           size = 4; type = u; break;
+    case DXGI_FORMAT_R16G16_SINT:           size = 4; type = s; break;
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R8G8B8A8_SNORM:
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_R10G10B10A2_UNORM:     size = 4; break;
+    case DXGI_FORMAT_R8G8B8A8_UINT:         size = 4; type = u; break;
+    case DXGI_FORMAT_R8G8B8A8_SINT:         size = 4; type = s; break;
+    case DXGI_FORMAT_R16_FLOAT:
+    case DXGI_FORMAT_R16_UNORM:             size = 2; break;
+    case DXGI_FORMAT_R16_UINT:              size = 2; type = u; break;
+    default:
+        return false;
+    }
+    *out_size = size;
+    *out_type = type;
+    return true;
+}
+static bool
+shader_reflect_create (void const * bytecode, SIZE_T size, ID3D12ShaderReflection ** out_reflection) {
+    *out_reflection = nullptr;
+    return SUCCEEDED(D3DReflect(bytecode, size, IID_PPV_ARGS(out_reflection)));
+}
+// NOTE(omid): Every (non system-value) element of the vertex shader's input
+// signature must be fed, so the layout has one element per signature entry, in
+// signature order; semantic names point at the VertexAttribute strings, not into
+// the reflection object. Returns false (and says why) on any mismatch.
+static bool
+shader_reflect_input_layout (
+    ID3D12ShaderReflection * vs_reflection, VertexLayout const * layout,
+    D3D12_INPUT_ELEMENT_DESC * out_elements, UINT max_elements, UINT * out_count
+) {
+    *out_count = 0;
+    D3D12_SHADER_DESC shader_desc = {};
+    if (FAILED(vs_reflection->GetDesc(&shader_desc)))
+        return false;
+    UINT read_bytes = 0;
+    for (UINT i = 0; i < shader_desc.InputParameters; ++i) {
+        D3D12_SIGNATURE_PARAMETER_DESC param = {};
+        vs_reflection->GetInputParameterDesc(i, &param);
+        if (param.SystemValueType != D3D_NAME_UNDEFINED)
+            continue;   // SV_VertexID and friends come from the input assembler, not a buffer
+
+        VertexAttribute const * attribute = nullptr;
+        for (UINT a = 0; a < layout->attribute_count && !attribute; ++a) {
+            VertexAttribute const * candidate = &layout->attributes[a];
+            if (0 == _stricmp(candidate->semantic, param.SemanticName) && candidate->semantic_index == param.SemanticIndex)
+                attribute = candidate;
+        }
+        if (!attribute) {
+            ::printf("input layout: %s has no member for %s%u\n", layout->name, param.SemanticName, param.SemanticIndex);
+            return false;
+        }
+        UINT format_size = 0;
+        D3D_REGISTER_COMPONENT_TYPE format_type = D3D_REGISTER_COMPONENT_UNKNOWN;
+        if (!vertex_format_info(attribute->format, &format_size, &format_type)) {
+            ::printf("input layout: %s.%s uses an unsupported format (%d)\n", layout->name, attribute->semantic, (int)attribute->format);
+            return false;
+        }
+        if (format_size != attribute->size) {
+            ::printf("input layout: %s.%s is %u bytes but its format is %u\n", layout->name, attribute->semantic, attribute->size, format_size);
+            return false;
+        }
+        if (format_type != param.ComponentType) {
+            ::printf("input layout: %s%u mixes integer and float data between %s and the shader\n", param.SemanticName, param.SemanticIndex, layout->name);
+            return false;
+        }
+        if (*out_count == max_elements)
+            return false;
+        D3D12_INPUT_ELEMENT_DESC * element = &out_elements[(*out_count)++];
+        *element = {};
+        element->SemanticName = attribute->semantic;
+        element->SemanticIndex = attribute->semantic_index;
+        element->Format = attribute->format;
+        element->InputSlot = 0;
+        element->AlignedByteOffset = attribute->offset;
+        element->InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
+        element->InstanceDataStepRate = 0;
+        if (param.ReadWriteMask)
+            read_bytes += attribute->size;
+    }
+    if (read_bytes < layout->stride)
+        ::printf("input layout: %s is %u bytes per vertex, the shader reads %u\n", layout->name, layout->stride, read_bytes);
+    return true;
+}
+// -- no reflection (DXIL): every attribute, in struct order
+static UINT
+vertex_layout_input_elements (VertexLayout const * layout, D3D12_INPUT_ELEMENT_DESC * out_elements, UINT max_elements) {
+    UINT count = 0;
+    for (UINT a = 0; a < layout->attribute_count && count < max_elements; ++a) {
+        VertexAttribute const * attribute = &layout->attributes[a];
+        D3D12_INPUT_ELEMENT_DESC * element = &out_elements[count++];
+        *element = {};
+        element->SemanticName = attribute->semantic;
+        element->SemanticIndex = attribute->semantic_index;
+        element->Format = attribute->format;
+        element->AlignedByteOffset = attribute->offset;
+        element->InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
+    }
+    return count;
+}
+
+static bool
+shader_binding_range_type (D3D_SHADER_INPUT_TYPE type, D3D12_DESCRIPTOR_RANGE_TYPE * out_type) {
+    switch (type) {
+    case D3D_SIT_CBUFFER:
+        *out_type = D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
+        return true;
+    case D3D_SIT_TBUFFER:
+    case D3D_SIT_TEXTURE:
+    case D3D_SIT_STRUCTURED:
+    case D3D_SIT_BYTEADDRESS:
+        *out_type = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+        return true;
+    case D3D_SIT_SAMPLER:
+        *out_type = D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER;
+        return true;
+    case D3D_SIT_UAV_RWTYPED:
+    case D3D_SIT_UAV_RWSTRUCTURED:
+    case D3D_SIT_UAV_RWBYTEADDRESS:
+    case D3D_SIT_UAV_APPEND_STRUCTURED:
+    case D3D_SIT_UAV_CONSUME_STRUCTURED:
+    case D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER:
+        *out_type = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+        return true;
+    default:
+        return false;
+    }
+}
+// -- adds the shader's bound resources; the same register seen from another stage is merged
+static bool
+shader_reflect_bindings (ID3D12ShaderReflection * reflection, UINT stage, ShaderBindings * bindings) {
+    D3D12_SHADER_DESC shader_desc = {};
+    if (FAILED(reflection->GetDesc(&shader_desc)))
+        return false;
+    bindings->stages |= stage;
+    if (SHADER_STAGE_VERTEX == stage)
+        bindings->has_vertex_input = shader_desc.InputParameters > 0;
+    for (UINT i = 0; i < shader_desc.BoundResources; ++i) {
+        D3D12_SHADER_INPUT_BIND_DESC bind = {};
+        reflection->GetResourceBindingDesc(i, &bind);
+        D3D12_DESCRIPTOR_RANGE_TYPE type;
+        if (!shader_binding_range_type(bind.Type, &type)) {
+            ::printf("shader bindings: %s has a resource type this sample does not bind (%d)\n", bind.Name, (int)bind.Type);
+            return false;
+        }
+        UINT count = (0 == bind.BindCount || UINT_MAX == bind.BindCount) ? UINT_MAX : bind.BindCount;
+        ShaderBinding * binding = nullptr;
+        for (UINT b = 0; b < bindings->count && !binding; ++b) {
+            ShaderBinding * candidate = &bindings->items[b];
+            if (candidate->type == type && candidate->space == bind.Space && candidate->base_register == bind.BindPoint)
+                binding = candidate;
+        }
+        if (!binding) {
+            if (bindings->count == SHADER_REFLECT_MAX_BINDINGS)
+                return false;
+            binding = &bindings->items[bindings->count++];
+            *binding = {};
+            ::snprintf(binding->name, sizeof(binding->name), "%s", bind.Name);
+            binding->type = type;
+            binding->base_register = bind.BindPoint;
+            binding->space = bind.Space;
+        }
+        if (count > binding->count)
+            binding->count = count;
+        binding->stages |= stage;
+    }
+    return true;
+}
+static D3D12_SHADER_VISIBILITY
+shader_stages_visibility (UINT stages) {
+    if (SHADER_STAGE_VERTEX == stages)
+        return D3D12_SHADER_VISIBILITY_VERTEX;
+    if (SHADER_STAGE_PIXEL == stages)
+        return D3D12_SHADER_VISIBILITY_PIXEL;
+    return D3D12_SHADER_VISIBILITY_ALL;
+}
+static bool
+shader_visibility_covers (D3D12_SHADER_VISIBILITY visibility, UINT stages) {
+    return D3D12_SHADER_VISIBILITY_ALL == visibility || shader_stages_visibility(stages) == visibility;
+}
+static bool
+shader_register_range_covers (UINT base, UINT count, UINT binding_base, UINT binding_count) {
+    if (binding_base < base)
+        return false;
+    if (UINT_MAX == count)
+        return true;
+    if (UINT_MAX == binding_count)
+        return false;
+    return binding_base + binding_count <= base + count;
+}
+// -- true if some root parameter / static sampler makes the binding visible to all its stages
+static bool
+shader_root_signature_covers (D3D12_ROOT_SIGNATURE_DESC1 const * desc, ShaderBinding const * binding, UINT * out_param) {
+    *out_param = UINT_MAX;
+    for (UINT p = 0; p < desc->NumParameters; ++p) {
+        D3D12_ROOT_PARAMETER1 const * param = &desc->pParameters[p];
+        if (!shader_visibility_covers(param->ShaderVisibility, binding->stages))
+            continue;
+        bool covered = false;
+        switch (param->ParameterType) {
+        case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+            for (UINT r = 0; r < param->DescriptorTable.NumDescriptorRanges && !covered; ++r) {
+                D3D12_DESCRIPTOR_RANGE1 const * range = &param->DescriptorTable.pDescriptorRanges[r];
+                covered = range->RangeType == binding->type && range->RegisterSpace == binding->space &&
+                          shader_register_range_covers(range->BaseShaderRegister, range->NumDescriptors, binding->base_register, binding->count);
+            }
+            break;
+        case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+            covered = D3D12_DESCRIPTOR_RANGE_TYPE_CBV == binding->type && 1 == binding->count &&
+                      param->Constants.ShaderRegister == binding->base_register && param->Constants.RegisterSpace == binding->space;
+            break;
+        case D3D12_ROOT_PARAMETER_TYPE_CBV:
+        case D3D12_ROOT_PARAMETER_TYPE_SRV:
+        case D3D12_ROOT_PARAMETER_TYPE_UAV: {
+            D3D12_DESCRIPTOR_RANGE_TYPE type =
+                D3D12_ROOT_PARAMETER_TYPE_CBV == param->ParameterType ? D3D12_DESCRIPTOR_RANGE_TYPE_CBV :
+                D3D12_ROOT_PARAMETER_TYPE_SRV == param->ParameterType ? D3D12_DESCRIPTOR_RANGE_TYPE_SRV : D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+            covered = type == binding->type && 1 == binding->count &&
+                      param->Descriptor.ShaderRegister == binding->base_register && param->Descriptor.RegisterSpace == binding->space;
+        } break;
+        default:
+            break;
+        }
+        if (covered) {
+            *out_param = p;
+            return true;
+        }
+    }
+    if (D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER == binding->type && 1 == binding->count) {
+        for (UINT s = 0; s < desc->NumStaticSamplers; ++s) {
+            D3D12_STATIC_SAMPLER_DESC const * sampler = &desc->pStaticSamplers[s];
+            if (sampler->ShaderRegister == binding->base_register && sampler->RegisterSpace == binding->space &&
+                shader_visibility_covers(sampler->ShaderVisibility, binding->stages)
+            ) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+static char const *
+shader_range_type_name (D3D12_DESCRIPTOR_RANGE_TYPE type) {
+    switch (type) {
+    case D3D12_DESCRIPTOR_RANGE_TYPE_SRV:       return "t";
+    case D3D12_DESCRIPTOR_RANGE_TYPE_UAV:       return "u";
+    case D3D12_DESCRIPTOR_RANGE_TYPE_CBV:       return "b";
+    default:                                    return "s";
+    }
+}
+// NOTE(omid): Fails on any binding the signature misses; root parameters nobody
+// reads are only reported (a signature may carry state for other passes or
+// ExecuteIndirect arguments).
+static bool
+shader_bindings_check_root_signature (ShaderBindings const * bindings, D3D12_ROOT_SIGNATURE_DESC1 const * desc) {
+    bool ok = true;
+    bool param_used [64] = {};
+    for (UINT b = 0; b < bindings->count; ++b) {
+        ShaderBinding const * binding = &bindings->items[b];
+        UINT param = UINT_MAX;
+        if (!shader_root_signature_covers(desc, binding, &param)) {
+            ::printf(
+                "root signature: %s (%s%u, space%u, %s) is not covered for the stages that use it\n",
+                binding->name, shader_range_type_name(binding->type), binding->base_register, binding->space,
+                SHADER_STAGE_VERTEX == binding->stages ? "vs" : SHADER_STAGE_PIXEL == binding->stages ? "ps" : "vs+ps"
+            );
+            ok = false;
+        } else if (param < ARRAY_COUNT(param_used)) {
+            param_used[param] = true;
+        }
+    }
+    if (bindings->has_vertex_input && !(desc->Flags & D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT)) {
+        ::printf("root signature: the vertex shader has inputs but the input assembler is not allowed\n");
+        ok = false;
+    }
+    for (UINT p = 0; p < desc->NumParameters && p < ARRAY_COUNT(param_used); ++p) {
+        if (!param_used[p])
+            ::printf("root signature: parameter %u is not read by these shaders\n", p);
+    }
+    return ok;
+}
+// -- root signature size in DWORDs (64 max): tables 1, root descriptors 2, constants 1 each
+static UINT
+shader_root_signature_cost (D3D12_ROOT_SIGNATURE_DESC1 const * desc) {
+    UINT ret = 0;
+    for (UINT p = 0; p < desc->NumParameters; ++p) {
+        D3D12_ROOT_PARAMETER1 const * param = &desc->pParameters[p];
+        if (D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE == param->ParameterType)
+            ret += 1;
+        else if (D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS == param->ParameterType)
+            ret += param->Constants.Num32BitValues;
+        else
+            ret += 2;
+    }
+    return ret;
+}
+// NOTE(omid): Minimal signature for the bindings: per visibility (vs, ps, all) one
+// table for its cbv/srv/uav ranges and one for samplers that have no static state.
+// static_samplers gives the state for sampler registers (matched by register and
+// space); visibility is taken from the shaders. Stages with nothing bound are denied
+// root access.
+static bool
+shader_bindings_build_root_signature (
+    ShaderBindings const * bindings, D3D12_STATIC_SAMPLER_DESC const * static_samplers, UINT static_sampler_count,
+    ShaderRootSignatureLayout * layout
+) {
+    ::memset(layout, 0, sizeof(*layout));
+    UINT range_count = 0, param_count = 0, sampler_count = 0;
+    D3D12_SHADER_VISIBILITY const visibilities [] = {
+        D3D12_SHADER_VISIBILITY_VERTEX, D3D12_SHADER_VISIBILITY_PIXEL, D3D12_SHADER_VISIBILITY_ALL
+    };
+    for (UINT v = 0; v < ARRAY_COUNT(visibilities); ++v) {
+        for (UINT sampler_table = 0; sampler_table < 2; ++sampler_table) {
+            UINT first_range = range_count;
+            for (UINT b = 0; b < bindings->count; ++b) {
+                ShaderBinding const * binding = &bindings->items[b];
+                bool is_sampler = D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER == binding->type;
+                if (shader_stages_visibility(binding->stages) != visibilities[v] || is_sampler != (1 == sampler_table))
+                    continue;
+                if (is_sampler && 1 == binding->count) {
+                    D3D12_STATIC_SAMPLER_DESC const * state = nullptr;
+                    for (UINT s = 0; s < static_sampler_count && !state; ++s) {
+                        if (static_samplers[s].ShaderRegister == binding->base_register && static_samplers[s].RegisterSpace == binding->space)
+                            state = &static_samplers[s];
+                    }
+                    if (state) {
+                        if (sampler_count == ARRAY_COUNT(layout->static_samplers))
+                            return false;
+                        layout->static_samplers[sampler_count] = *state;
+                        layout->static_samplers[sampler_count].ShaderVisibility = visibilities[v];
+                        ++sampler_count;
+                        continue;
+                    }
+                }
+                if (range_count == SHADER_REFLECT_MAX_BINDINGS)
+                    return false;
+                D3D12_DESCRIPTOR_RANGE1 * range = &layout->ranges[range_count++];
+                range->RangeType = binding->type;
+                range->NumDescriptors = binding->count;
+                range->BaseShaderRegister = binding->base_register;
+                range->RegisterSpace = binding->space;
+                range->Flags = is_sampler ? D3D12_DESCRIPTOR_RANGE_FLAG_NONE : D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE;
+                range->OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+            }
+            if (range_count == first_range)
+                continue;
+            if (param_count == ARRAY_COUNT(layout->params))
+                return false;
+            D3D12_ROOT_PARAMETER1 * param = &layout->params[param_count++];
+            param->ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+            param->DescriptorTable.NumDescriptorRanges = range_count - first_range;
+            param->DescriptorTable.pDescriptorRanges = &layout->ranges[first_range];
+            param->ShaderVisibility = visibilities[v];
+        }
+    }
+    UINT used_stages = 0;
+    for (UINT b = 0; b < bindings->count; ++b)
+        used_stages |= bindings->items[b].stages;
+
+    D3D12_ROOT_SIGNATURE_FLAGS flags =
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS      |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS    |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS;
+    if (bindings->has_vertex_input)
+        flags |= D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
+    if (!(used_stages & SHADER_STAGE_VERTEX))
+        flags |= D3D12_ROOT_SIGNATURE_FLAG_DENY_VERTEX_SHADER_ROOT_ACCESS;
+    if (!(used_stages & SHADER_STAGE_PIXEL))
+        flags |= D3D12_ROOT_SIGNATURE_FLAG_DENY_PIXEL_SHADER_ROOT_ACCESS;
+
+    layout->desc.NumParameters = param_count;
+    layout->desc.pParameters = param_count ? layout->params : nullptr;
+    layout->desc.NumStaticSamplers = sampler_count;
+    layout->desc.pStaticSamplers = sampler_count ? layout->static_samplers : nullptr;
+    layout->desc.Flags = flags;
+    return true;
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+// NOTE(omid): Non-blocking watch of a shader directory (and its subdirectories on
+// Windows). ReadDirectoryChangesW with an overlapped read on Windows, inotify on
+// Linux; both are polled once per frame and never wait. Editors tend to save in
+// several steps (truncate, write, rename), so events are collected until the
+// directory has been quiet for SHADER_WATCHER_SETTLE_MS and then reported as one
+// burst.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#define SHADER_WATCHER_SETTLE_MS        100.0
+#define SHADER_WATCHER_MAX_CHANGES      32
+#define SHADER_WATCHER_MAX_NAME         128
+#define SHADER_WATCHER_BUFFER_SIZE      (16 * 1024)
+
+struct ShaderWatcher {
+#if defined(_WIN32)
+    HANDLE                          dir;
+    OVERLAPPED                      overlapped;
+    DWORD                           buffer [SHADER_WATCHER_BUFFER_SIZE / sizeof(DWORD)];    // DWORD-aligned records
+#else
+    int                             fd;
+    int                             wd;
+    uint8_t                         buffer [SHADER_WATCHER_BUFFER_SIZE];
+#endif
+    bool                            active;
+
+    // -- burst being collected / last reported burst (names relative to the watched directory)
+    char                            changed [SHADER_WATCHER_MAX_CHANGES][SHADER_WATCHER_MAX_NAME];
+    uint32_t                        changed_count;
+    bool                            changed_overflow;   // more files than fit; treat as "everything"
+    double                          last_event_ms;
+    uint32_t                        bursts;
+};
+
+static double
+shader_watcher_now_ms () {
+#if defined(_WIN32)
+    LARGE_INTEGER freq = {}, now = {};
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return 1e3 * (double)now.QuadPart / (double)freq.QuadPart;
+#else
+    timespec now = {};
+    ::clock_gettime(CLOCK_MONOTONIC, &now);
+    return 1e3 * (double)now.tv_sec + 1e-6 * (double)now.tv_nsec;
+#endif
+}
+static void
+shader_watcher_note (ShaderWatcher * watcher, char const * name) {
+    watcher->last_event_ms = shader_watcher_now_ms();
+    for (uint32_t i = 0; i < watcher->changed_count; ++i) {
+        if (0 == ::strcmp(watcher->changed[i], name))
+            return;
+    }
+    if (watcher->changed_count == SHADER_WATCHER_MAX_CHANGES) {
+        watcher->changed_overflow = true;
+        return;
+    }
+    ::snprintf(watcher->changed[watcher->changed_count++], SHADER_WATCHER_MAX_NAME, "%s", name);
+}
+
+#if defined(_WIN32)
+static bool
+shader_watcher_issue_read (ShaderWatcher * watcher) {
+    ResetEvent(watcher->overlapped.hEvent);
+    return FALSE != ReadDirectoryChangesW(
+        watcher->dir, watcher->buffer, sizeof(watcher->buffer), TRUE,
+        FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE,
+        nullptr, &watcher->overlapped, nullptr
+    );
+}
+#endif
+
+static bool
+shader_watcher_init (ShaderWatcher * watcher, char const * dir) {
+    ::memset(watcher, 0, sizeof(*watcher));
+#if defined(_WIN32)
+    watcher->dir = CreateFileA(
+        dir, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr
+    );
+    if (INVALID_HANDLE_VALUE == watcher->dir)
+        return false;
+    watcher->overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    watcher->active = nullptr != watcher->overlapped.hEvent && shader_watcher_issue_read(watcher);
+    if (!watcher->active) {
+        if (watcher->overlapped.hEvent)
+            CloseHandle(watcher->overlapped.hEvent);
+        CloseHandle(watcher->dir);
+    }
+#else
+    watcher->fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watcher->fd < 0)
+        return false;
+    watcher->wd = ::inotify_add_watch(watcher->fd, dir, IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+    watcher->active = watcher->wd >= 0;
+    if (!watcher->active)
+        ::close(watcher->fd);
+#endif
+    return watcher->active;
+}
+// -- drain whatever the os has queued, without blocking
+static void
+shader_watcher_drain (ShaderWatcher * watcher) {
+#if defined(_WIN32)
+    DWORD bytes = 0;
+    while (GetOverlappedResult(watcher->dir, &watcher->overlapped, &bytes, FALSE)) {
+        if (0 == bytes) {
+            // -- the buffer overflowed and the os dropped the details
+            watcher->changed_overflow = true;
+            watcher->last_event_ms = shader_watcher_now_ms();
+        }
+        uint8_t const * record = reinterpret_cast<uint8_t const *>(watcher->buffer);
+        while (bytes > 0) {
+            FILE_NOTIFY_INFORMATION const * info = reinterpret_cast<FILE_NOTIFY_INFORMATION const *>(record);
+            char name [SHADER_WATCHER_MAX_NAME] = {};
+            int len = WideCharToMultiByte(
+                CP_UTF8, 0, info->FileName, (int)(info->FileNameLength / sizeof(WCHAR)),
+                name, (int)sizeof(name) - 1, nullptr, nullptr
+            );
+            name[len > 0 ? len : 0] = '\0';
+            for (char * c = name; *c; ++c)
+                *c = '\\' == *c ? '/' : *c;
+            shader_watcher_note(watcher, name);
+            if (0 == info->NextEntryOffset)
+                break;
+            record += info->NextEntryOffset;
+        }
+        if (!shader_watcher_issue_read(watcher)) {
+            watcher->active = false;
+            break;
+        }
+    }
+#else
+    for (;;) {
+        ssize_t bytes = ::read(watcher->fd, watcher->buffer, sizeof(watcher->buffer));
+        if (bytes <= 0)
+            break;      // EAGAIN: nothing (more) queued
+        for (ssize_t offset = 0; offset < bytes; ) {
+            inotify_event const * event = reinterpret_cast<inotify_event const *>(watcher->buffer + offset);
+            if (event->mask & IN_Q_OVERFLOW) {
+                watcher->changed_overflow = true;
+                watcher->last_event_ms = shader_watcher_now_ms();
+            } else if (event->len > 0) {
+                shader_watcher_note(watcher, event->name);
+            }
+            offset += (ssize_t)(sizeof(inotify_event) + event->len);
+        }
+    }
+#endif
+}
+// NOTE(omid): Returns true once per burst of changes, after it settled; changed /
+// changed_count then list the files until the next call that returns true.
+static bool
+shader_watcher_poll (ShaderWatcher * watcher) {
+    if (!watcher->active)
+        return false;
+    bool had_pending = watcher->last_event_ms > 0.0;
+    if (had_pending && shader_watcher_now_ms() - watcher->last_event_ms < SHADER_WATCHER_SETTLE_MS) {
+        shader_watcher_drain(watcher);
+        return false;
+    }
+    if (!had_pending) {
+        // -- a new burst starts: forget the previous one
+        watcher->changed_count = 0;
+        watcher->changed_overflow = false;
+    }
+    shader_watcher_drain(watcher);
+    if (watcher->last_event_ms > 0.0 && shader_watcher_now_ms() - watcher->last_event_ms >= SHADER_WATCHER_SETTLE_MS) {
+        watcher->last_event_ms = 0.0;
+        ++watcher->bursts;
+        return true;
+    }
+    return false;
+}
+static void
+shader_watcher_destroy (ShaderWatcher * watcher) {
+    if (watcher->active) {
+#if defined(_WIN32)
+        CancelIo(watcher->dir);
+        DWORD bytes = 0;
+        GetOverlappedResult(watcher->dir, &watcher->overlapped, &bytes, TRUE);
+        CloseHandle(watcher->overlapped.hEvent);
+        CloseHandle(watcher->dir);
+#else
+        ::close(watcher->fd);
+#endif
+    }
+    ::memset(watcher, 0, sizeof(*watcher));
+}
@@ -0,0 +1,76 @@
+// NOTE(omid): Bindless variant of cbuffer_shader.hlsl (shader model 5.1).
+// Every texture and constant buffer lives in one big descriptor range; the
+// root constants below carry the indices of the ones this draw uses.
+
+// -- permutation keys (see shader_permutations.h), defaults give the generic variant
+// (the "permutation <stage>: <key> <value count>" lines drive the offline build, tools/build_shaders.py)
+// permutation ps: SHOULD_FLIP_TEXTU_Y 2
+// permutation ps: DEBUG_VIEW 3
+#ifndef SHOULD_FLIP_TEXTU_Y
+#define SHOULD_FLIP_TEXTU_Y 0
+#endif
+#define DEBUG_VIEW_NONE     0
+#define DEBUG_VIEW_UV       1
+#define DEBUG_VIEW_LUMA     2
+#ifndef DEBUG_VIEW
+#define DEBUG_VIEW DEBUG_VIEW_NONE
+#endif
+
+#include "vertex_decode.hlsli"
+
+struct SceneConstants {
+    float4 offset;
+    VertexQuantization quantization;        // positions come in as R16G16B16A16_UNORM
+    float4 padding [13];
+};
+struct MaterialIndices {
+    uint texture_index;
+    uint constants_index;
+};
+ConstantBuffer<MaterialIndices> material : register(b0, space0);
+
+// -- both arrays alias the same table (start of the bindless range)
+Texture2D global_textures [] : register(t0, space1);
+ConstantBuffer<SceneConstants> global_constants [] : register(b0, space2);
+
+SamplerState global_sampler : register(s0);
+
+struct PixelShaderInput {
+    float4 position : SV_Position;
+    float2 uv : TEXCOORD;
+};
+
+PixelShaderInput
+VertexShader_Main (float4 p : POSITION, float4 uv : TEXCOORD) {
+    PixelShaderInput result;
+    SceneConstants constants = global_constants[material.constants_index];
+    result.position = float4(decode_position(p, constants.quantization), p.w) + constants.offset;
+    result.uv = uv;
+    return result;
+}
+
+float2
+get_corrected_textu_coord (float2 textu_coord) {
+#if SHOULD_FLIP_TEXTU_Y
+    return float2(textu_coord.x, 1.0 - textu_coord.y);
+#else
+    return textu_coord;
+#endif
+}
+float4
+apply_debug_view (float4 color, float2 uv) {
+#if DEBUG_VIEW == DEBUG_VIEW_UV
+    return float4(uv, 0.0, 1.0);
+#elif DEBUG_VIEW == DEBUG_VIEW_LUMA
+    float luma = dot(color.rgb, float3(0.299, 0.587, 0.114));
+    return float4(luma, luma, luma, color.a);
+#else
+    return color;
+#endif
+}
+
+float4
+PixelShader_Main (PixelShaderInput input) : SV_Target {
+    float2 uv = get_corrected_textu_coord(input.uv);
+    return apply_debug_view(global_textures[material.texture_index].Sample(global_sampler, uv), uv);
+}
@@ -1,6 +1,23 @@
+// -- permutation keys (see shader_permutations.h), defaults give the generic variant
+// (the "permutation <stage>: <key> <value count>" lines drive the offline build, tools/build_shaders.py)
+// permutation ps: SHOULD_FLIP_TEXTU_Y 2
+// permutation ps: DEBUG_VIEW 3
+#ifndef SHOULD_FLIP_TEXTU_Y
+#define SHOULD_FLIP_TEXTU_Y 0
+#endif
+#define DEBUG_VIEW_NONE     0
+#define DEBUG_VIEW_UV       1
+#define DEBUG_VIEW_LUMA     2
+#ifndef DEBUG_VIEW
+#define DEBUG_VIEW DEBUG_VIEW_NONE
+#endif
+
+#include "vertex_decode.hlsli"
+
 cbuffer SceneConstantBuffer : register(b0) {
     float4 offset;
-    float4 padding [15];
+    VertexQuantization quantization;        // positions come in as R16G16B16A16_UNORM
+    float4 padding [13];
 }
 struct PixelShaderInput {
     float4 position : SV_Position;
@@ -13,13 +30,34 @@ SamplerState global_sampler : register(s0);
 PixelShaderInput
 VertexShader_Main (float4 p : POSITION, float4 uv : TEXCOORD) {
     PixelShaderInput result;
-    result.position = p + offset;       // apply offset from cbuffer
+    result.position = float4(decode_position(p, quantization), p.w) + offset;      // apply offset from cbuffer
     result.uv = uv;
     return result;
 }
 
+float2
+get_corrected_textu_coord (float2 textu_coord) {
+#if SHOULD_FLIP_TEXTU_Y
+    return float2(textu_coord.x, 1.0 - textu_coord.y);
+#else
+    return textu_coord;
+#endif
+}
+float4
+apply_debug_view (float4 color, float2 uv) {
+#if DEBUG_VIEW == DEBUG_VIEW_UV
+    return float4(uv, 0.0, 1.0);
+#elif DEBUG_VIEW == DEBUG_VIEW_LUMA
+    float luma = dot(color.rgb, float3(0.299, 0.587, 0.114));
+    return float4(luma, luma, luma, color.a);
+#else
+    return color;
+#endif
+}
+
 float4
 PixelShader_Main (PixelShaderInput input) : SV_Target {
-    return global_texture.Sample(global_sampler, input.uv);
+    float2 uv = get_corrected_textu_coord(input.uv);
+    return apply_debug_view(global_texture.Sample(global_sampler, uv), uv);
 }
 
@@ -0,0 +1,66 @@
+// NOTE(omid): Reading the meshlet streams of meshlet_builder.h, for a mesh or
+// amplification shader (or a compute culling pass). All four streams are bound
+// as ByteAddressBuffers; records are 12 and 32 bytes.
+
+struct Meshlet {
+    uint vertex_offset;         // into the vertex index stream
+    uint triangle_offset;       // bytes into the triangle stream
+    uint vertex_count;
+    uint triangle_count;
+    uint mesh;
+};
+struct MeshletBounds {
+    float3 center;
+    float radius;
+    float3 cone_apex;
+    float3 cone_axis;           // normalized
+    float cone_cutoff;          // 1: no cone
+};
+
+Meshlet
+load_meshlet (ByteAddressBuffer meshlets, uint index) {
+    uint3 raw = meshlets.Load3(index * 12);
+    Meshlet m;
+    m.vertex_offset = raw.x;
+    m.triangle_offset = raw.y;
+    m.vertex_count = raw.z & 0xff;
+    m.triangle_count = (raw.z >> 8) & 0xff;
+    m.mesh = raw.z >> 16;
+    return m;
+}
+MeshletBounds
+load_meshlet_bounds (ByteAddressBuffer bounds, uint index) {
+    uint4 a = bounds.Load4(index * 32);
+    uint4 b = bounds.Load4(index * 32 + 16);
+    MeshletBounds mb;
+    mb.center = asfloat(a.xyz);
+    mb.radius = asfloat(a.w);
+    mb.cone_apex = asfloat(b.xyz);
+    // -- four snorm8: axis xyz, cutoff
+    int4 packed = int4(b.w << 24, b.w << 16, b.w << 8, b.w) >> 24;
+    mb.cone_axis = normalize(float3(packed.xyz));
+    mb.cone_cutoff = float(packed.w) / 127.0;
+    return mb;
+}
+// -- global vertex index of the meshlet's local vertex i
+uint
+meshlet_vertex (ByteAddressBuffer vertices, Meshlet m, uint i) {
+    return vertices.Load((m.vertex_offset + i) * 4);
+}
+// -- local indices of triangle i (3 bytes, not 4-byte aligned)
+uint3
+meshlet_triangle (ByteAddressBuffer triangles, Meshlet m, uint i) {
+    uint offset = m.triangle_offset + i * 3;
+    uint aligned = offset & ~3u;
+    uint2 words = triangles.Load2(aligned);
+    uint shift = (offset - aligned) * 8;
+    uint bits = shift ? (words.x >> shift) | (words.y << (32 - shift)) : words.x;
+    return uint3(bits & 0xff, (bits >> 8) & 0xff, (bits >> 16) & 0xff);
+}
+bool
+meshlet_cone_culled (MeshletBounds b, float3 eye) {
+    if (b.cone_cutoff >= 1.0)
+        return false;
+    float3 d = b.cone_apex - eye;
+    return dot(d, b.cone_axis) >= b.cone_cutoff * length(d);
+}
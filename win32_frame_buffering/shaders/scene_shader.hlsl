@@ -0,0 +1,26 @@
+// -- scene meshes, drawn from the index batch over the packed vertices (see index_buffer.h)
+
+#include "vertex_decode.hlsli"
+
+// -- root constants, set per node
+cbuffer SceneNodeConstants : register(b0) {
+    row_major float4x4 clip_from_local;
+    VertexQuantization quantization;        // of the node's mesh
+}
+struct PixelShaderInput {
+    float4 position : SV_Position;
+    float3 normal : NORMAL;
+};
+
+PixelShaderInput
+VertexShader_Scene (float4 p : POSITION, float2 n : NORMAL) {
+    PixelShaderInput result;
+    result.position = mul(clip_from_local, float4(decode_position(p, quantization), 1.0));
+    result.normal = decode_octahedral_normal(n);
+    return result;
+}
+float4
+PixelShader_Scene (PixelShaderInput input) : SV_Target {
+    float3 n = normalize(input.normal);
+    return float4(0.5 + 0.5 * n, 1.0);
+}
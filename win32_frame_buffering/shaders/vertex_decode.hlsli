@@ -0,0 +1,22 @@
+// NOTE(omid): Decoding for the quantized vertex formats of vertex_compression.h.
+// The input assembler already turns UNORM / SNORM / FLOAT16 into floats; what is
+// left is the per-mesh position range and unfolding the octahedral normal.
+
+struct VertexQuantization {
+    float3 position_min;
+    float pad0;
+    float3 position_scale;      // bounds extent
+    float pad1;
+};
+
+float3
+decode_position (float4 unorm_position, VertexQuantization q) {
+    return q.position_min + unorm_position.xyz * q.position_scale;
+}
+float3
+decode_octahedral_normal (float2 e) {
+    float3 n = float3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * (n.xy >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
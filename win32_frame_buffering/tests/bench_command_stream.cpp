@@ -0,0 +1,67 @@
+#include "d3d12_host.h"
+#include "../command_stream.h"
+
+#include <chrono>
+
+// NOTE(omid): Recording cost of the command stream: one frame of packet_count
+// packets in the mix render_stuff records (per-frame setup, then per draw a
+// vertex buffer, root constants and the draw), timed over a few repeats after a
+// warm-up frame so the stream's buffer has already grown. Configure the tests
+// with -DCMAKE_BUILD_TYPE=Release for meaningful numbers. Usage:
+//      bench_command_stream [packet_count] [repeat_count]
+
+#define BENCH_DEFAULT_PACKET_COUNT      (1u << 20)
+#define BENCH_DEFAULT_REPEAT_COUNT      8
+
+static void
+record_packets (CommandStream * stream, uint32_t packet_count) {
+    float const clear_color [4] = {0.1f, 0.3f, 0.2f, 1.0f};
+    command_stream_reset(stream);
+    cmd_set_root_signature(stream, 0);
+    cmd_set_pipeline_state(stream, 0);
+    cmd_set_viewport(stream, 0.0f, 0.0f, 1280.0f, 720.0f, 0.0f, 1.0f);
+    cmd_set_scissor(stream, 0, 0, 1280, 720);
+    cmd_transition(stream, 0, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    cmd_set_render_target(stream, 0, 0);
+    cmd_clear_render_target(stream, 0, 0, clear_color);
+    cmd_set_primitive_topology(stream, 4 /*D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST*/);
+    for (uint32_t i = 0; stream->packet_count < packet_count; ++i) {
+        uint32_t const constants [4] = {i, i + 1, i + 2, i + 3};
+        cmd_set_vertex_buffer(stream, 0, i & 63, (i & 15) * 4096, 4096, 32);
+        cmd_set_root_constants(stream, 1, 0, ARRAY_COUNT(constants), constants);
+        cmd_draw(stream, 36, 1, 0, 0);
+    }
+}
+
+int
+main (int argc, char ** argv) {
+    uint32_t packet_count = argc > 1 ? (uint32_t)::strtoul(argv[1], nullptr, 10) : BENCH_DEFAULT_PACKET_COUNT;
+    uint32_t repeat_count = argc > 2 ? (uint32_t)::strtoul(argv[2], nullptr, 10) : BENCH_DEFAULT_REPEAT_COUNT;
+    if (0 == packet_count || 0 == repeat_count) {
+        ::printf("usage: bench_command_stream [packet_count] [repeat_count]\n");
+        return 1;
+    }
+
+    CommandStream stream;
+    command_stream_init(&stream, 0);
+    record_packets(&stream, packet_count);      // warm-up: grow the buffer once
+
+    double best_ns = 0.0;
+    for (uint32_t r = 0; r < repeat_count; ++r) {
+        auto begin = std::chrono::steady_clock::now();
+        record_packets(&stream, packet_count);
+        auto end = std::chrono::steady_clock::now();
+        double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+        if (0 == r || ns < best_ns)
+            best_ns = ns;
+    }
+
+    ::printf(
+        "Command stream recording (%u packets, best of %u): %.2f ns/packet, %.1f bytes/packet\n",
+        stream.packet_count, repeat_count, best_ns / (double)stream.packet_count,
+        (double)stream.size / (double)stream.packet_count
+    );
+    command_stream_print_stats(&stream);
+    command_stream_destroy(&stream);
+    return 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+// NOTE(omid): The handful of D3D12 declarations the host tests need, so headers
+// that only touch D3D12 structs (and interfaces through a mock) compile off
+// Windows. Values match d3d12.h where they matter to the code under test.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef unsigned int                UINT;
+typedef uint64_t                    UINT64;
+typedef int32_t                     HRESULT;
+
+#define S_OK                        ((HRESULT)0)
+#define E_FAIL                      ((HRESULT)0x80004005L)
+
+enum D3D12_RESOURCE_STATES {
+    D3D12_RESOURCE_STATE_COMMON                         = 0,
+    D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER     = 0x1,
+    D3D12_RESOURCE_STATE_INDEX_BUFFER                   = 0x2,
+    D3D12_RESOURCE_STATE_RENDER_TARGET                  = 0x4,
+    D3D12_RESOURCE_STATE_UNORDERED_ACCESS               = 0x8,
+    D3D12_RESOURCE_STATE_DEPTH_WRITE                    = 0x10,
+    D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE          = 0x80,
+    D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT              = 0x200,
+    D3D12_RESOURCE_STATE_COPY_DEST                      = 0x400,
+    D3D12_RESOURCE_STATE_COPY_SOURCE                    = 0x800,
+    D3D12_RESOURCE_STATE_PRESENT                        = 0,
+};
+enum D3D12_RESOURCE_BARRIER_TYPE {
+    D3D12_RESOURCE_BARRIER_TYPE_TRANSITION              = 0,
+    D3D12_RESOURCE_BARRIER_TYPE_ALIASING                = 1,
+    D3D12_RESOURCE_BARRIER_TYPE_UAV                     = 2,
+};
+enum D3D12_RESOURCE_BARRIER_FLAGS {
+    D3D12_RESOURCE_BARRIER_FLAG_NONE                    = 0,
+    D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY              = 0x1,
+    D3D12_RESOURCE_BARRIER_FLAG_END_ONLY                = 0x2,
+};
+#define D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES         0xffffffff
+
+struct ID3D12Resource;
+struct D3D12_RESOURCE_TRANSITION_BARRIER {
+    ID3D12Resource *                pResource;
+    UINT                            Subresource;
+    D3D12_RESOURCE_STATES           StateBefore;
+    D3D12_RESOURCE_STATES           StateAfter;
+};
+struct D3D12_RESOURCE_ALIASING_BARRIER {
+    ID3D12Resource *                pResourceBefore;
+    ID3D12Resource *                pResourceAfter;
+};
+struct D3D12_RESOURCE_UAV_BARRIER {
+    ID3D12Resource *                pResource;
+};
+struct D3D12_RESOURCE_BARRIER {
+    D3D12_RESOURCE_BARRIER_TYPE     Type;
+    D3D12_RESOURCE_BARRIER_FLAGS    Flags;
+    union {
+        D3D12_RESOURCE_TRANSITION_BARRIER   Transition;
+        D3D12_RESOURCE_ALIASING_BARRIER     Aliasing;
+        D3D12_RESOURCE_UAV_BARRIER          UAV;
+    };
+};
+// -- only what the code under test calls; mocks derive from it
+struct ID3D12GraphicsCommandList {
+    virtual void ResourceBarrier (UINT count, D3D12_RESOURCE_BARRIER const * barriers) = 0;
+};
+
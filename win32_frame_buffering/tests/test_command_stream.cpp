@@ -0,0 +1,120 @@
+#include "../command_stream.h"
+#include "test_common.h"
+
+#if !defined(TEST_SCRATCH_DIR)
+#define TEST_SCRATCH_DIR            "."
+#endif
+
+static void
+record_frame (CommandStream * stream) {
+    float const clear_color [4] = {0.1f, 0.2f, 0.3f, 1.0f};
+    uint32_t const constants [3] = {1, 2, 3};
+    cmd_set_root_signature(stream, 0);
+    cmd_set_pipeline_state(stream, 1);
+    cmd_clear_render_target(stream, 0, 1, clear_color);
+    cmd_set_root_constants(stream, 0, 0, 3, constants);
+    cmd_draw(stream, 6, 1, 0, 0);
+}
+// -- write bytes as a stream file with a matching header
+static void
+write_raw (char const * path, void const * data, uint32_t size, uint32_t packet_count) {
+    CommandStreamFileHeader header = {};
+    header.magic = COMMAND_STREAM_MAGIC;
+    header.version = COMMAND_STREAM_VERSION;
+    header.packet_count = packet_count;
+    header.size = size;
+    FILE * file = ::fopen(path, "wb");
+    TEST_CHECK(nullptr != file);
+    if (file) {
+        ::fwrite(&header, sizeof(header), 1, file);
+        ::fwrite(data, size, 1, file);
+        ::fclose(file);
+    }
+}
+
+static void
+test_round_trip () {
+    char const * path = TEST_SCRATCH_DIR "/round_trip.cmds";
+    // -- zero capacity must still grow
+    CommandStream stream;
+    command_stream_init(&stream, 0);
+    record_frame(&stream);
+    TEST_CHECK(5 == stream.packet_count && stream.capacity >= stream.size);
+    TEST_CHECK(command_stream_write_file(&stream, path));
+
+    CommandStream read;
+    command_stream_init(&read, 16);
+    TEST_CHECK(command_stream_read_file(&read, path));
+    TEST_CHECK(read.size == stream.size && read.packet_count == stream.packet_count);
+    TEST_CHECK(0 == ::memcmp(read.base, stream.base, (size_t)stream.size));
+    TEST_CHECK(1 == read.type_counts[CommandPacket_SetRootConstants]);
+    command_stream_destroy(&read);
+    command_stream_destroy(&stream);
+    ::remove(path);
+}
+static void
+test_malformed () {
+    char const * path = TEST_SCRATCH_DIR "/malformed.cmds";
+    CommandStream stream;
+    command_stream_init(&stream, 256);
+    CommandStream read;
+    command_stream_init(&read, 256);
+    uint8_t bytes [256];
+
+    // -- a lone 2-byte tail: not even a header fits
+    record_frame(&stream);
+    ::memcpy(bytes, stream.base, (size_t)stream.size);
+    bytes[stream.size] = 0;
+    bytes[stream.size + 1] = 0;
+    write_raw(path, bytes, (uint32_t)stream.size + 2, stream.packet_count + 1);
+    TEST_CHECK(!command_stream_read_file(&read, path));
+    TEST_CHECK(0 == read.size && 0 == read.packet_count);
+
+    // -- a packet shorter than its type's struct
+    command_stream_reset(&stream);
+    cmd_draw(&stream, 3, 1, 0, 0);
+    CmdDraw draw;
+    ::memcpy(&draw, stream.base, sizeof(draw));
+    draw.header.size = 8;
+    write_raw(path, &draw, 8, 1);
+    TEST_CHECK(!command_stream_read_file(&read, path));
+
+    // -- a size that is not a multiple of 4
+    draw.header.size = sizeof(CmdDraw) + 2;
+    ::memcpy(bytes, &draw, sizeof(draw));
+    ::memset(bytes + sizeof(draw), 0, 2);
+    write_raw(path, bytes, sizeof(CmdDraw) + 2, 1);
+    TEST_CHECK(!command_stream_read_file(&read, path));
+
+    // -- root constants claiming more values than the packet carries
+    command_stream_reset(&stream);
+    uint32_t const constants [2] = {7, 8};
+    cmd_set_root_constants(&stream, 0, 0, 2, constants);
+    ::memcpy(bytes, stream.base, (size_t)stream.size);
+    reinterpret_cast<CmdSetRootConstants *>(bytes)->count = 9;
+    write_raw(path, bytes, (uint32_t)stream.size, 1);
+    TEST_CHECK(!command_stream_read_file(&read, path));
+
+    // -- an unknown packet type
+    reinterpret_cast<CmdSetRootConstants *>(bytes)->count = 2;
+    reinterpret_cast<CommandPacketHeader *>(bytes)->type = CommandPacket_COUNT;
+    write_raw(path, bytes, (uint32_t)stream.size, 1);
+    TEST_CHECK(!command_stream_read_file(&read, path));
+
+    // -- and the untouched packet still reads fine
+    reinterpret_cast<CommandPacketHeader *>(bytes)->type = CommandPacket_SetRootConstants;
+    write_raw(path, bytes, (uint32_t)stream.size, 1);
+    TEST_CHECK(command_stream_read_file(&read, path));
+
+    command_stream_destroy(&read);
+    command_stream_destroy(&stream);
+    ::remove(path);
+}
+
+int
+main () {
+    test_round_trip();
+    test_malformed();
+    ::printf("command_stream: %d failure(s)\n", test_failures);
+    return test_failures ? 1 : 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// NOTE(omid): Check helper for the host tests: failures are reported and counted,
+// and main returns the count so ctest sees them.
+
+#include <stdio.h>
+
+static int test_failures;
+#define TEST_CHECK(exp)                                                         \
+    do {                                                                        \
+        if (!(exp)) {                                                           \
+            ::printf("[FAIL] %s:%d: %s\n", __FILE__, __LINE__, #exp);           \
+            ++test_failures;                                                    \
+        }                                                                       \
+    } while (0)
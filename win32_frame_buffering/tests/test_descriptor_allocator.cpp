@@ -0,0 +1,139 @@
+#include "../descriptor_allocator.h"
+#include "test_common.h"
+
+// -- fake heap: each page gets a distinct, recognizable base address
+struct FakeHeap {
+    uint32_t                        pages_created;
+    uint32_t                        pages_destroyed;
+};
+static bool
+fake_page_create (void * user, uint32_t descriptor_count, DescriptorPageMemory * out_memory) {
+    FakeHeap * heap = reinterpret_cast<FakeHeap *>(user);
+    uint32_t page = heap->pages_created++;
+    out_memory->heap = reinterpret_cast<void *>((uintptr_t)(page + 1));
+    out_memory->cpu_base = 0x100000ull * (page + 1);
+    out_memory->gpu_base = 0x800000000ull + 0x100000ull * (page + 1);
+    (void)descriptor_count;
+    return true;
+}
+static void
+fake_page_destroy (void * user, DescriptorPageMemory * memory) {
+    ++reinterpret_cast<FakeHeap *>(user)->pages_destroyed;
+    (void)memory;
+}
+static uint32_t
+random_next (uint32_t * state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void
+test_addressing () {
+    FakeHeap heap = {};
+    DescriptorAllocator allocator;
+    descriptor_allocator_init(&allocator, "test", 64, 2, 32, fake_page_create, fake_page_destroy, &heap);
+    TEST_CHECK(1 == heap.pages_created);
+
+    DescriptorHandle a = descriptor_allocate(&allocator, 10);
+    DescriptorHandle b = descriptor_allocate(&allocator, 5);
+    TEST_CHECK(0 == a.id && 10 == b.id);
+    TEST_CHECK(0x100000ull == a.cpu && 0x100000ull + 10 * 32 == b.cpu);
+    TEST_CHECK(descriptor_cpu_at(&b, 4) == b.cpu + 4 * 32);
+    TEST_CHECK(descriptor_gpu_at(&a, 1) == a.gpu + 32);
+    DescriptorHandle sub = descriptor_sub_range(&a, 3, 2);
+    TEST_CHECK(3 == sub.id && 2 == sub.count && sub.cpu == a.cpu + 3 * 32);
+    TEST_CHECK(10 == descriptor_heap_offset(&allocator, &b));
+
+    // -- bigger than a page, or zero, always fails
+    TEST_CHECK(DESCRIPTOR_NONE == descriptor_allocate(&allocator, 65).id);
+    TEST_CHECK(DESCRIPTOR_NONE == descriptor_allocate(&allocator, 0).id);
+
+    // -- a full page spills to a second one; then max_pages is reached
+    DescriptorHandle big = descriptor_allocate(&allocator, 64);
+    TEST_CHECK(64 == big.id && 2 == heap.pages_created);
+    TEST_CHECK(descriptor_heap_of(&allocator, &big) != descriptor_heap_of(&allocator, &a));
+    TEST_CHECK(DESCRIPTOR_NONE == descriptor_allocate(&allocator, 60).id);
+    TEST_CHECK(3 == allocator.stats.failed);
+
+    // -- freeing merges the neighbours back into one block
+    descriptor_free(&allocator, &a);
+    descriptor_free(&allocator, &b);
+    TEST_CHECK(DESCRIPTOR_NONE == a.id && DESCRIPTOR_NONE == b.id);
+    TEST_CHECK(64 == descriptor_allocator_validate(&allocator));
+    DescriptorHandle whole = descriptor_allocate(&allocator, 64);
+    TEST_CHECK(0 == whole.id);
+    descriptor_free(&allocator, &whole);
+    descriptor_free(&allocator, &big);
+    TEST_CHECK(128 == descriptor_allocator_validate(&allocator));
+
+    descriptor_allocator_destroy(&allocator);
+    TEST_CHECK(2 == heap.pages_destroyed);
+}
+// NOTE(omid): Random allocate/free churn. Every live range is painted into an
+// ownership map, so overlapping ranges are caught, and the free lists are
+// walked after every step.
+static void
+test_churn () {
+    uint32_t const page_size = 256;
+    uint32_t const max_pages = 4;
+    uint32_t const total = page_size * max_pages;
+    FakeHeap heap = {};
+    DescriptorAllocator allocator;
+    descriptor_allocator_init(&allocator, "churn", page_size, max_pages, 32, fake_page_create, fake_page_destroy, &heap);
+
+    DescriptorHandle live [512] = {};
+    uint32_t live_count = 0;
+    uint32_t owner [page_size * max_pages];
+    ::memset(owner, 0xff, sizeof(owner));
+    uint32_t random = 0x12345678;
+    bool consistent = true;
+    for (uint32_t step = 0; step < 20000; ++step) {
+        bool do_free = live_count > 0 && (live_count == ARRAY_COUNT(live) || random_next(&random) % 100 < 45);
+        if (do_free) {
+            uint32_t pick = random_next(&random) % live_count;
+            DescriptorHandle * h = &live[pick];
+            for (uint32_t i = 0; i < h->count; ++i)
+                owner[h->id + i] = DESCRIPTOR_NONE;
+            descriptor_free(&allocator, h);
+            live[pick] = live[--live_count];
+        } else {
+            // -- mostly small ranges, now and then a big one
+            uint32_t count = random_next(&random) % 16 < 15 ? 1 + random_next(&random) % 8 : 1 + random_next(&random) % 200;
+            DescriptorHandle h = descriptor_allocate(&allocator, count);
+            if (DESCRIPTOR_NONE != h.id) {
+                TEST_CHECK(h.count == count && h.id % page_size + count <= page_size);
+                for (uint32_t i = 0; i < count; ++i) {
+                    consistent = consistent && DESCRIPTOR_NONE == owner[h.id + i];
+                    owner[h.id + i] = h.id;
+                }
+                live[live_count++] = h;
+            }
+        }
+        consistent = consistent && DESCRIPTOR_NONE != descriptor_allocator_validate(&allocator);
+    }
+    TEST_CHECK(consistent);
+    while (live_count)
+        descriptor_free(&allocator, &live[--live_count]);
+    TEST_CHECK(0 == allocator.stats.allocated);
+    TEST_CHECK(allocator.page_count * page_size == descriptor_allocator_validate(&allocator));
+    TEST_CHECK(allocator.page_count <= max_pages && total >= allocator.page_count * page_size);
+
+    // -- everything merged back: each page is one free block again
+    for (uint32_t p = 0; p < allocator.page_count; ++p) {
+        DescriptorHandle whole = descriptor_allocate(&allocator, page_size);
+        TEST_CHECK(DESCRIPTOR_NONE != whole.id && 0 == whole.id % page_size);
+    }
+    descriptor_allocator_print_stats(&allocator);
+    descriptor_allocator_destroy(&allocator);
+    TEST_CHECK(heap.pages_created == heap.pages_destroyed);
+}
+
+int
+main () {
+    test_addressing();
+    test_churn();
+    ::printf("descriptor_allocator: %d failure(s)\n", test_failures);
+    return test_failures ? 1 : 0;
+}
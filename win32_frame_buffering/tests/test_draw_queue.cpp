@@ -0,0 +1,85 @@
+#include "../draw_queue.h"
+#include "test_common.h"
+
+#include <algorithm>
+
+static uint64_t
+next_random (uint64_t * state) {
+    // -- xorshift64, fixed seed so a failure reproduces
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static void
+test_key_packing () {
+    uint64_t key = draw_sort_key_make(0xab, 0x123, 0x45678, 1.0f);
+    TEST_CHECK(0xab == (key >> 56));
+    TEST_CHECK(0x123 == ((key >> 44) & 0xfff));
+    TEST_CHECK(0x45678 == ((key >> 24) & 0xfffff));
+    TEST_CHECK(0xffffff == (key & 0xffffff));
+
+    // -- depth is clamped to [0, 1] and never spills into the material bits
+    TEST_CHECK(0 == (draw_sort_key_make(0, 0, 0, -3.0f) & 0xffffff));
+    TEST_CHECK(0xffffff == draw_sort_key_make(0, 0, 0, 7.0f));
+    TEST_CHECK(draw_sort_key_make(0, 0, 0, 0.25f) < draw_sort_key_make(0, 0, 0, 0.5f));
+
+    // -- field priority: layer, then pso, then material, then depth
+    TEST_CHECK(draw_sort_key_make(1, 0, 0, 0.0f) > draw_sort_key_make(0, 0xfff, 0xfffff, 1.0f));
+    TEST_CHECK(draw_sort_key_make(0, 1, 0, 0.0f) > draw_sort_key_make(0, 0, 0xfffff, 1.0f));
+    TEST_CHECK(draw_sort_key_make(0, 0, 1, 0.0f) > draw_sort_key_make(0, 0, 0, 1.0f));
+}
+
+// -- sorts count random keys with the queue and checks the (key, index) order against std::stable_sort
+static void
+check_sort (uint32_t count, uint32_t thread_count, uint64_t seed, uint64_t key_mask) {
+    DrawQueue queue;
+    draw_queue_init(&queue, count, thread_count);
+    DrawPacket packet = {};
+    uint64_t state = seed;
+    for (uint32_t i = 0; i < count; ++i)
+        draw_queue_push(&queue, next_random(&state) & key_mask, &packet);
+
+    DrawSortItem * expected = reinterpret_cast<DrawSortItem *>(::malloc(sizeof(DrawSortItem) * count));
+    ::memcpy(expected, queue.items, sizeof(DrawSortItem) * count);
+    std::stable_sort(expected, expected + count, [] (DrawSortItem const & a, DrawSortItem const & b) {
+        return a.key < b.key;
+    });
+
+    draw_queue_sort(&queue);
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (queue.items[i].key != expected[i].key || queue.items[i].index != expected[i].index)
+            ++mismatches;
+    }
+    TEST_CHECK(0 == mismatches);
+    if (mismatches)
+        ::printf("\t%u of %u items out of place (%u threads, key mask %016llx)\n", mismatches, count, thread_count, (unsigned long long)key_mask);
+    ::free(expected);
+    draw_queue_destroy(&queue);
+}
+static void
+test_sort () {
+    // -- few distinct keys, so stability is actually exercised; full 64-bit keys; keys that only differ
+    // in a middle byte (the other passes are skipped, and an odd pass count ends in the scratch buffer)
+    uint64_t const key_masks [] = {0x0f000000000000ffull, ~0ull, 0x0000ff0000000000ull};
+    uint32_t const thread_counts [] = {1, 2, 3, DRAW_QUEUE_MAX_THREADS};
+    for (uint64_t key_mask : key_masks) {
+        check_sort(1000, 4, 0x9e3779b97f4a7c15ull, key_mask);   // below the threshold: single thread
+        for (uint32_t thread_count : thread_counts)
+            check_sort(DRAW_QUEUE_PARALLEL_THRESHOLD + 12345, thread_count, 0x2545f4914f6cdd1dull, key_mask);
+    }
+    check_sort(1, 2, 1, ~0ull);
+    check_sort(2, 2, 2, ~0ull);
+}
+
+int
+main () {
+    test_key_packing();
+    test_sort();
+    ::printf("draw_queue: %d failure(s)\n", test_failures);
+    return test_failures ? 1 : 0;
+}
@@ -0,0 +1,130 @@
+#include "../indirect_args.h"
+#include "test_common.h"
+
+#include <initializer_list>
+
+static IndirectArgument
+make_argument (IndirectArgumentKind kind, uint32_t slot_or_root, uint32_t dest_offset = 0, uint32_t value_count = 0, uint32_t root_size = 0) {
+    IndirectArgument ret = {};
+    ret.kind = kind;
+    ret.slot = slot_or_root;
+    ret.root_parameter_index = slot_or_root;
+    ret.dest_offset = dest_offset;
+    ret.value_count = value_count;
+    ret.root_parameter_size = root_size;
+    return ret;
+}
+static char const *
+validate (std::initializer_list<IndirectArgument> arguments, uint32_t byte_stride, IndirectLayout * out = nullptr) {
+    IndirectLayout layout = {};
+    for (IndirectArgument const & arg : arguments)
+        layout.arguments[layout.argument_count++] = arg;
+    char const * ret = indirect_layout_validate(&layout, byte_stride);
+    if (out)
+        *out = layout;
+    return ret;
+}
+
+// -- the layout the sample's command signature uses
+static void
+test_draw_layout () {
+    IndirectLayout layout;
+    indirect_layout_make_draw(&layout, 2);
+    TEST_CHECK(nullptr == indirect_layout_validate(&layout, INDIRECT_DRAW_STRIDE));
+    TEST_CHECK(0 == layout.offsets[0] && 16 == layout.offsets[1] && 32 == layout.offsets[2]);
+    TEST_CHECK(INDIRECT_DRAW_STRIDE == layout.byte_stride);
+    TEST_CHECK(layout.needs_root_signature);
+
+    // -- packed size when no stride is given; padding is allowed, shrinking is not
+    TEST_CHECK(nullptr == indirect_layout_validate(&layout, 0) && 48 == layout.byte_stride);
+    TEST_CHECK(nullptr == indirect_layout_validate(&layout, 64) && 64 == layout.byte_stride);
+    TEST_CHECK(nullptr != indirect_layout_validate(&layout, 44));
+    TEST_CHECK(nullptr != indirect_layout_validate(&layout, 50));
+}
+static void
+test_rules () {
+    IndirectArgument draw = make_argument(IndirectArgument_Draw, 0);
+    IndirectArgument draw_indexed = make_argument(IndirectArgument_DrawIndexed, 0);
+    IndirectArgument vbv0 = make_argument(IndirectArgument_VertexBufferView, 0);
+    IndirectArgument vbv1 = make_argument(IndirectArgument_VertexBufferView, 1);
+    IndirectArgument ibv = make_argument(IndirectArgument_IndexBufferView, 0);
+    IndirectArgument one_constant = make_argument(IndirectArgument_Constant, 1, 0, 1, 4);
+    IndirectArgument cbv = make_argument(IndirectArgument_ConstantBufferView, 3);
+
+    IndirectLayout layout;
+    TEST_CHECK(nullptr == validate({vbv0, vbv1, ibv, draw_indexed}, 0, &layout));
+    TEST_CHECK(16 == layout.offsets[1] && 32 == layout.offsets[2] && 48 == layout.offsets[3] && 68 == layout.byte_stride);
+    TEST_CHECK(!layout.needs_root_signature);
+
+    TEST_CHECK(nullptr != validate({}, 0));
+    TEST_CHECK(nullptr != validate({vbv0}, 0));                                 // no draw
+    TEST_CHECK(nullptr != validate({draw, vbv0}, 0));                           // draw not last
+    TEST_CHECK(nullptr != validate({draw, draw}, 0));
+    TEST_CHECK(nullptr != validate({vbv0, vbv0, draw}, 0));                     // slot twice
+    TEST_CHECK(nullptr != validate({ibv, ibv, draw_indexed}, 0));
+    // -- one 4-byte constant pushes the views off their 8-byte alignment
+    TEST_CHECK(nullptr != validate({one_constant, vbv0, draw}, 0));
+    TEST_CHECK(nullptr != validate({one_constant, ibv, draw_indexed}, 0));
+    TEST_CHECK(nullptr != validate({one_constant, cbv, draw}, 0));
+    TEST_CHECK(nullptr == validate({cbv, one_constant, draw}, 0, &layout) && layout.needs_root_signature);
+    // -- root constants: empty, overflowing and overlapping ranges
+    TEST_CHECK(nullptr != validate({make_argument(IndirectArgument_Constant, 1, 0, 0, 4), draw}, 0));
+    TEST_CHECK(nullptr != validate({make_argument(IndirectArgument_Constant, 1, 3, 2, 4), draw}, 0));
+    TEST_CHECK(nullptr != validate({make_argument(IndirectArgument_Constant, 1, 0, 2, 4), make_argument(IndirectArgument_Constant, 1, 1, 2, 4), draw}, 0));
+    TEST_CHECK(nullptr == validate({make_argument(IndirectArgument_Constant, 1, 0, 2, 4), make_argument(IndirectArgument_Constant, 1, 2, 2, 4), draw}, 0));
+}
+// -- both packers write the same bytes, at the offsets the layout promises
+static void
+test_packing () {
+    IndirectVertexBufferView vb_table [3] = {};
+    for (uint32_t i = 0; i < 3; ++i) {
+        vb_table[i].buffer_location = 0x1000000ull * (i + 1) + 0x10;
+        vb_table[i].size_in_bytes = 4096 * (i + 1);
+        vb_table[i].stride_in_bytes = 20;
+    }
+    IndirectDrawItem items [33] = {};
+    for (uint32_t i = 0; i < ARRAY_COUNT(items); ++i) {
+        items[i].vertex_count_per_instance = 3 * i + 3;
+        items[i].instance_count = 1 + i % 2;
+        items[i].start_vertex = 7 * i;
+        items[i].start_instance = i;
+        for (uint32_t c = 0; c < INDIRECT_ROOT_CONSTANT_COUNT; ++c)
+            items[i].constants[c] = 100 * i + c;
+        items[i].vb_index = i % 3;
+    }
+    alignas(16) uint8_t scalar [ARRAY_COUNT(items) * INDIRECT_DRAW_STRIDE];
+    alignas(16) uint8_t simd [ARRAY_COUNT(items) * INDIRECT_DRAW_STRIDE + 4];
+    indirect_pack_draws_scalar(items, ARRAY_COUNT(items), vb_table, scalar);
+    indirect_pack_draws(items, ARRAY_COUNT(items), vb_table, simd);
+    TEST_CHECK(0 == ::memcmp(scalar, simd, sizeof(scalar)));
+    indirect_pack_draws(items, ARRAY_COUNT(items), vb_table, simd + 4);            // unaligned path
+    TEST_CHECK(0 == ::memcmp(scalar, simd + 4, sizeof(scalar)));
+
+    uint8_t const * cmd = scalar + 5 * INDIRECT_DRAW_STRIDE;
+    uint64_t location = 0;
+    uint32_t draw [4] = {}, constants [INDIRECT_ROOT_CONSTANT_COUNT] = {};
+    ::memcpy(&location, cmd, 8);
+    ::memcpy(constants, cmd + 16, sizeof(constants));
+    ::memcpy(draw, cmd + 32, sizeof(draw));
+    TEST_CHECK(vb_table[2].buffer_location == location);
+    TEST_CHECK(500 == constants[0] && 503 == constants[3]);
+    TEST_CHECK(18 == draw[0] && 2 == draw[1] && 35 == draw[2] && 5 == draw[3]);
+
+    // -- the builder reports how many commands it wrote through the count buffer
+    IndirectDrawBuilder builder;
+    uint32_t count = 0;
+    indirect_builder_begin(&builder, simd, &count, ARRAY_COUNT(items));
+    indirect_builder_add(&builder, items, 10, vb_table);
+    indirect_builder_add(&builder, items + 10, 5, vb_table);
+    TEST_CHECK(15 == indirect_builder_end(&builder) && 15 == count);
+    TEST_CHECK(0 == ::memcmp(scalar, simd, 15 * INDIRECT_DRAW_STRIDE));
+}
+
+int
+main () {
+    test_draw_layout();
+    test_rules();
+    test_packing();
+    ::printf("indirect_args: %d failure(s)\n", test_failures);
+    return test_failures ? 1 : 0;
+}
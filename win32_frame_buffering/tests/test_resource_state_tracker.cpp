@@ -0,0 +1,144 @@
+#include "test_common.h"
+#include "d3d12_host.h"
+#include "../resource_state_tracker.h"
+
+// -- records what the tracker hands to ResourceBarrier
+struct MockCommandList : ID3D12GraphicsCommandList {
+    D3D12_RESOURCE_BARRIER          barriers [STATE_TRACKER_MAX_BARRIERS * 4];
+    UINT                            barrier_count;
+    UINT                            calls;
+
+    void ResourceBarrier (UINT count, D3D12_RESOURCE_BARRIER const * in) override {
+        for (UINT i = 0; i < count; ++i)
+            barriers[barrier_count++] = in[i];
+        ++calls;
+    }
+    void reset () {
+        barrier_count = 0;
+        calls = 0;
+    }
+};
+// -- the tracker only compares resource pointers, any distinct addresses do
+static char fake_resources [4];
+static ID3D12Resource *
+fake_resource (int i) {
+    return reinterpret_cast<ID3D12Resource *>(&fake_resources[i]);
+}
+static bool
+is_transition (
+    D3D12_RESOURCE_BARRIER const * b, ID3D12Resource * resource, UINT subresource,
+    D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after, D3D12_RESOURCE_BARRIER_FLAGS flags
+) {
+    return D3D12_RESOURCE_BARRIER_TYPE_TRANSITION == b->Type && flags == b->Flags &&
+           resource == b->Transition.pResource && subresource == b->Transition.Subresource &&
+           before == b->Transition.StateBefore && after == b->Transition.StateAfter;
+}
+
+static void
+test_skip_and_fold () {
+    ResourceStateTracker tracker;
+    MockCommandList cmd = {};
+    state_tracker_init(&tracker);
+    ID3D12Resource * rt = fake_resource(0);
+    state_tracker_register(&tracker, rt, 1, D3D12_RESOURCE_STATE_PRESENT);
+
+    // -- already there: nothing queued, nothing recorded
+    state_tracker_transition(&tracker, rt, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, D3D12_RESOURCE_STATE_PRESENT);
+    state_tracker_flush(&tracker, &cmd);
+    TEST_CHECK(0 == cmd.calls);
+    TEST_CHECK(1 == tracker.stats.barriers_skipped);
+
+    // -- A->B then B->C in one batch becomes A->C
+    state_tracker_transition(&tracker, rt, 0, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    state_tracker_transition(&tracker, rt, 0, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    state_tracker_flush(&tracker, &cmd);
+    TEST_CHECK(1 == cmd.calls && 1 == cmd.barrier_count);
+    TEST_CHECK(is_transition(&cmd.barriers[0], rt, 0, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_BARRIER_FLAG_NONE));
+    TEST_CHECK(D3D12_RESOURCE_STATE_COPY_SOURCE == state_tracker_get_state(&tracker, rt, 0));
+
+    // -- A->B then B->A in one batch disappears
+    cmd.reset();
+    state_tracker_transition(&tracker, rt, 0, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    state_tracker_transition(&tracker, rt, 0, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    state_tracker_flush(&tracker, &cmd);
+    TEST_CHECK(0 == cmd.calls);
+    TEST_CHECK(2 == tracker.stats.barriers_folded);
+    state_tracker_unregister(&tracker, rt);
+    TEST_CHECK(0 == tracker.resource_count);
+}
+static void
+test_subresources () {
+    ResourceStateTracker tracker;
+    MockCommandList cmd = {};
+    state_tracker_init(&tracker);
+    ID3D12Resource * texture = fake_resource(1);
+    state_tracker_register(&tracker, texture, 4, D3D12_RESOURCE_STATE_COPY_DEST);
+
+    // -- one mip moves: only that subresource changes, the rest stay put
+    state_tracker_transition(&tracker, texture, 2, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    state_tracker_flush(&tracker, &cmd);
+    TEST_CHECK(1 == cmd.barrier_count);
+    TEST_CHECK(is_transition(&cmd.barriers[0], texture, 2, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_BARRIER_FLAG_NONE));
+    TEST_CHECK(D3D12_RESOURCE_STATE_COPY_DEST == state_tracker_get_state(&tracker, texture, 0));
+    TEST_CHECK(D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE == state_tracker_get_state(&tracker, texture, 2));
+
+    // -- whole resource while the subresources disagree: only the three that differ
+    cmd.reset();
+    state_tracker_transition(&tracker, texture, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    state_tracker_flush(&tracker, &cmd);
+    TEST_CHECK(1 == cmd.calls && 3 == cmd.barrier_count);
+    for (UINT i = 0; i < cmd.barrier_count; ++i)
+        TEST_CHECK(2 != cmd.barriers[i].Transition.Subresource);
+    TEST_CHECK(tracker.resources[0].uniform);
+
+    // -- uniform again, so the next whole-resource request is a single barrier
+    cmd.reset();
+    state_tracker_transition(&tracker, texture, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    state_tracker_flush(&tracker, &cmd);
+    TEST_CHECK(1 == cmd.barrier_count);
+    TEST_CHECK(is_transition(&cmd.barriers[0], texture, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_BARRIER_FLAG_NONE));
+}
+static void
+test_split_and_uav () {
+    ResourceStateTracker tracker;
+    MockCommandList cmd = {};
+    state_tracker_init(&tracker);
+    ID3D12Resource * buffer = fake_resource(2);
+    ID3D12Resource * other = fake_resource(3);
+    state_tracker_register(&tracker, buffer, 1, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    state_tracker_register(&tracker, other, 1, D3D12_RESOURCE_STATE_COMMON);
+
+    state_tracker_begin_split(&tracker, buffer, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+    state_tracker_uav_barrier(&tracker, other);
+    state_tracker_flush(&tracker, &cmd);
+    TEST_CHECK(1 == cmd.calls && 2 == cmd.barrier_count);
+    TEST_CHECK(is_transition(&cmd.barriers[0], buffer, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY));
+    TEST_CHECK(D3D12_RESOURCE_BARRIER_TYPE_UAV == cmd.barriers[1].Type && other == cmd.barriers[1].UAV.pResource);
+    // -- state only changes once the split ends
+    TEST_CHECK(D3D12_RESOURCE_STATE_UNORDERED_ACCESS == state_tracker_get_state(&tracker, buffer, 0));
+
+    cmd.reset();
+    state_tracker_end_split(&tracker, buffer);
+    state_tracker_flush(&tracker, &cmd);
+    TEST_CHECK(1 == cmd.barrier_count);
+    TEST_CHECK(is_transition(&cmd.barriers[0], buffer, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, D3D12_RESOURCE_BARRIER_FLAG_END_ONLY));
+    TEST_CHECK(D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT == state_tracker_get_state(&tracker, buffer, 0));
+
+    // -- a split to the current state is a no-op, and ending it records nothing
+    cmd.reset();
+    state_tracker_begin_split(&tracker, buffer, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+    state_tracker_end_split(&tracker, buffer);
+    state_tracker_flush(&tracker, &cmd);
+    TEST_CHECK(0 == cmd.calls);
+    TEST_CHECK(2 == tracker.stats.flushes);
+    state_tracker_print_stats(&tracker);
+}
+
+int
+main () {
+    test_skip_and_fold();
+    test_subresources();
+    test_split_and_uav();
+    ::printf("resource_state_tracker: %d failure(s)\n", test_failures);
+    return test_failures ? 1 : 0;
+}
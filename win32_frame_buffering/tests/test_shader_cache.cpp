@@ -0,0 +1,110 @@
+#include "../shader_cache.h"
+#include "test_common.h"
+
+// -- scratch files live in the build tree (TEST_SCRATCH_DIR comes from cmake)
+#if !defined(TEST_SCRATCH_DIR)
+#define TEST_SCRATCH_DIR       "."
+#endif
+
+static void
+write_text (char const * path, char const * text) {
+    FILE * file = ::fopen(path, "wb");
+    TEST_CHECK(nullptr != file);
+    if (file) {
+        ::fputs(text, file);
+        ::fclose(file);
+    }
+}
+static void
+test_key () {
+    char const * source = TEST_SCRATCH_DIR "/key.hlsl";
+    char const * common = TEST_SCRATCH_DIR "/key_common.hlsli";
+    char const * nested = TEST_SCRATCH_DIR "/key_nested.hlsli";
+    write_text(source, "#include \"key_common.hlsli\"\nfloat4 main () : SV_Target { return k; }\n");
+    write_text(common, "  #  include \"key_nested.hlsli\"\nstatic float4 k = 1;\n");
+    write_text(nested, "// nested\n");
+
+    ShaderCache cache;
+    shader_cache_init(&cache, TEST_SCRATCH_DIR "/cache_key", 10);
+    ShaderCacheDefine defines [] = {{"A", "1"}, {"B", nullptr}, {nullptr, nullptr}};
+    ShaderCacheKey base = shader_cache_key(&cache, source, defines, "main", "ps_5_1", 0);
+    TEST_CHECK(base.valid && 3 == base.file_count);
+    TEST_CHECK(base.hash == shader_cache_key(&cache, source, defines, "main", "ps_5_1", 0).hash);
+
+    // -- each input that can change the output changes the key
+    TEST_CHECK(base.hash != shader_cache_key(&cache, source, defines, "main", "ps_5_0", 0).hash);
+    TEST_CHECK(base.hash != shader_cache_key(&cache, source, defines, "main2", "ps_5_1", 0).hash);
+    TEST_CHECK(base.hash != shader_cache_key(&cache, source, defines, "main", "ps_5_1", 1).hash);
+    TEST_CHECK(base.hash != shader_cache_key(&cache, source, nullptr, "main", "ps_5_1", 0).hash);
+    ShaderCacheDefine empty_define [] = {{"A", "1"}, {"B", ""}, {nullptr, nullptr}};
+    TEST_CHECK(base.hash != shader_cache_key(&cache, source, empty_define, "main", "ps_5_1", 0).hash);
+    ShaderCache other_compiler = cache;
+    other_compiler.compiler_version = 11;
+    TEST_CHECK(base.hash != shader_cache_key(&other_compiler, source, defines, "main", "ps_5_1", 0).hash);
+
+    // -- editing a file two includes deep invalidates it too
+    write_text(nested, "// nested, edited\n");
+    TEST_CHECK(base.hash != shader_cache_key(&cache, source, defines, "main", "ps_5_1", 0).hash);
+
+    // -- a missing include makes the key unusable
+    ::remove(nested);
+    ShaderCacheKey broken = shader_cache_key(&cache, source, defines, "main", "ps_5_1", 0);
+    TEST_CHECK(!broken.valid);
+    size_t size = 0;
+    TEST_CHECK(nullptr == shader_cache_load(&cache, &broken, &size));
+    TEST_CHECK(!shader_cache_store(&cache, &broken, "x", 1));
+    ::remove(common);
+    ::remove(source);
+}
+static void
+test_store_load () {
+    char const * source = TEST_SCRATCH_DIR "/store.hlsl";
+    write_text(source, "float4 main () : SV_Target { return 0; }\n");
+    ShaderCache cache;
+    shader_cache_init(&cache, TEST_SCRATCH_DIR "/cache_store", 10);
+    ShaderCacheKey key = shader_cache_key(&cache, source, nullptr, "main", "ps_5_1", 0);
+
+    // -- clean slate in case a previous run left the entry behind
+    char entry [SHADER_CACHE_ENTRY_PATH_SIZE];
+    TEST_CHECK(shader_cache_entry_path(&cache, &key, entry, sizeof(entry)));
+    ::remove(entry);
+
+    size_t size = 0;
+    TEST_CHECK(nullptr == shader_cache_load(&cache, &key, &size));
+    TEST_CHECK(1 == cache.stats.misses);
+
+    uint8_t bytecode [300];
+    for (uint32_t i = 0; i < sizeof(bytecode); ++i)
+        bytecode[i] = (uint8_t)(i * 7);
+    TEST_CHECK(shader_cache_store(&cache, &key, bytecode, sizeof(bytecode)));
+    void * loaded = shader_cache_load(&cache, &key, &size);
+    TEST_CHECK(loaded && sizeof(bytecode) == size && 0 == ::memcmp(loaded, bytecode, size));
+    ::free(loaded);
+    TEST_CHECK(1 == cache.stats.hits && 1 == cache.stats.stores);
+
+    // -- a truncated entry is ignored, not returned
+    write_text(entry, "SHDC");
+    TEST_CHECK(nullptr == shader_cache_load(&cache, &key, &size));
+    TEST_CHECK(1 == cache.stats.corrupt);
+
+    // -- an entry written for another key is ignored too
+    ShaderCacheKey other = shader_cache_key(&cache, source, nullptr, "main", "vs_5_1", 0);
+    TEST_CHECK(shader_cache_store(&cache, &other, bytecode, sizeof(bytecode)));
+    char other_entry [SHADER_CACHE_ENTRY_PATH_SIZE];
+    TEST_CHECK(shader_cache_entry_path(&cache, &other, other_entry, sizeof(other_entry)));
+    ::remove(entry);
+    TEST_CHECK(0 == ::rename(other_entry, entry));
+    TEST_CHECK(nullptr == shader_cache_load(&cache, &key, &size));
+    TEST_CHECK(2 == cache.stats.corrupt);
+    ::remove(entry);
+    ::remove(source);
+    shader_cache_print_stats(&cache);
+}
+
+int
+main () {
+    test_key();
+    test_store_load();
+    ::printf("shader_cache: %d failure(s)\n", test_failures);
+    return test_failures ? 1 : 0;
+}
@@ -0,0 +1,582 @@
+#pragma once
+
+// NOTE(omid): Quantized vertex formats, to cut vertex fetch bandwidth:
+//   position   R16G16B16A16_UNORM relative to per-mesh bounds (p = min + unorm * scale)
+//   normal     R16G16_SNORM octahedral (unit vector folded onto the |x|+|y|+|z| = 1 octahedron)
+//   uv         R16G16_UNORM when every uv of the mesh is in [0, 1], else R16G16_FLOAT
+//   color      R8G8B8A8_UNORM
+// shaders/vertex_decode.hlsli holds the matching decode functions. The per-mesh
+// bounds travel with the mesh (VertexQuantization) and have to reach the vertex shader.
+//
+// The scalar encoders work on strided float streams, so TextuVertex / ColorVertex /
+// ColladaVertex all go through the same code; they are also the reference. Each
+// packed format also has an SSE2 path, 4 vertices per iteration, which rounds the
+// same way and produces identical bytes: imported meshes go through
+// vertex_compress_mesh_sse2, the sample's quad through vertex_compress_textu_sse2.
+
+#include "collada_loader.h"
+#include "shader_reflection.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <emmintrin.h>
+#include <chrono>
+
+// -- ColladaVertex (32 bytes) packed
+struct PackedMeshVertex {
+    uint16_t                        position [4];   // w = 1.0
+    int16_t                         normal [2];
+    uint16_t                        uv [2];         // unorm16 or half, see VertexQuantization::uv_format
+};
+// -- TextuVertex (20 bytes) packed
+struct PackedTextuVertex {
+    uint16_t                        position [4];
+    uint16_t                        uv [2];
+};
+// -- ColorVertex (28 bytes) packed
+struct PackedColorVertex {
+    uint16_t                        position [4];
+    uint8_t                         color [4];
+};
+static_assert(16 == sizeof(PackedMeshVertex), "PackedMeshVertex layout");
+static_assert(12 == sizeof(PackedTextuVertex), "PackedTextuVertex layout");
+static_assert(12 == sizeof(PackedColorVertex), "PackedColorVertex layout");
+
+// -- what a shader needs to decode one mesh
+struct VertexQuantization {
+    float                           position_min [3];
+    float                           position_scale [3];     // bounds extent (0 extent is stored as 1)
+    DXGI_FORMAT                     uv_format;              // R16G16_UNORM or R16G16_FLOAT
+};
+
+// -- input layouts (shader_reflection.h checks them against the vertex shader)
+static VertexAttribute const packed_mesh_vertex_attributes_unorm_uv [] = {
+    VERTEX_ATTRIBUTE(PackedMeshVertex, position, "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM),
+    VERTEX_ATTRIBUTE(PackedMeshVertex, normal, "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM),
+    VERTEX_ATTRIBUTE(PackedMeshVertex, uv, "TEXCOORD", 0, DXGI_FORMAT_R16G16_UNORM),
+};
+static VertexAttribute const packed_mesh_vertex_attributes_half_uv [] = {
+    VERTEX_ATTRIBUTE(PackedMeshVertex, position, "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM),
+    VERTEX_ATTRIBUTE(PackedMeshVertex, normal, "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM),
+    VERTEX_ATTRIBUTE(PackedMeshVertex, uv, "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT),
+};
+static VertexAttribute const packed_textu_vertex_attributes_unorm_uv [] = {
+    VERTEX_ATTRIBUTE(PackedTextuVertex, position, "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM),
+    VERTEX_ATTRIBUTE(PackedTextuVertex, uv, "TEXCOORD", 0, DXGI_FORMAT_R16G16_UNORM),
+};
+static VertexAttribute const packed_textu_vertex_attributes_half_uv [] = {
+    VERTEX_ATTRIBUTE(PackedTextuVertex, position, "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM),
+    VERTEX_ATTRIBUTE(PackedTextuVertex, uv, "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT),
+};
+static VertexAttribute const packed_color_vertex_attributes [] = {
+    VERTEX_ATTRIBUTE(PackedColorVertex, position, "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM),
+    VERTEX_ATTRIBUTE(PackedColorVertex, color, "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM),
+};
+static VertexLayout const packed_mesh_vertex_layout_unorm_uv = VERTEX_LAYOUT(PackedMeshVertex, packed_mesh_vertex_attributes_unorm_uv);
+static VertexLayout const packed_mesh_vertex_layout_half_uv = VERTEX_LAYOUT(PackedMeshVertex, packed_mesh_vertex_attributes_half_uv);
+static VertexLayout const packed_textu_vertex_layout_unorm_uv = VERTEX_LAYOUT(PackedTextuVertex, packed_textu_vertex_attributes_unorm_uv);
+static VertexLayout const packed_textu_vertex_layout_half_uv = VERTEX_LAYOUT(PackedTextuVertex, packed_textu_vertex_attributes_half_uv);
+static VertexLayout const packed_color_vertex_layout = VERTEX_LAYOUT(PackedColorVertex, packed_color_vertex_attributes);
+
+static VertexLayout const *
+packed_mesh_vertex_layout (VertexQuantization const * q) {
+    return DXGI_FORMAT_R16G16_FLOAT == q->uv_format ? &packed_mesh_vertex_layout_half_uv : &packed_mesh_vertex_layout_unorm_uv;
+}
+static VertexLayout const *
+packed_textu_vertex_layout (VertexQuantization const * q) {
+    return DXGI_FORMAT_R16G16_FLOAT == q->uv_format ? &packed_textu_vertex_layout_half_uv : &packed_textu_vertex_layout_unorm_uv;
+}
+
+// =========================================================================================================
+// -- scalar reference
+
+static float const *
+vertex_stream_at (float const * base, size_t stride, uint32_t i) {
+    return reinterpret_cast<float const *>(reinterpret_cast<uint8_t const *>(base) + i * stride);
+}
+template <typename T> static T *
+vertex_stream_out (T * base, size_t stride, uint32_t i) {
+    return reinterpret_cast<T *>(reinterpret_cast<uint8_t *>(base) + i * stride);
+}
+// -- clamp(v, 0, 1) * 65535, round to nearest (v may be nan: 0)
+static uint16_t
+vertex_unorm16 (float v) {
+    v = v > 0.0f ? v : 0.0f;
+    v = v < 1.0f ? v : 1.0f;
+    return (uint16_t)(int32_t)(v * 65535.0f + 0.5f);
+}
+static int16_t
+vertex_snorm16 (float v) {
+    v = v > -1.0f ? v : -1.0f;
+    v = v < 1.0f ? v : 1.0f;
+    float scaled = v * 32767.0f;
+    return (int16_t)(int32_t)(scaled + (scaled >= 0.0f ? 0.5f : -0.5f));
+}
+static uint8_t
+vertex_unorm8 (float v) {
+    v = v > 0.0f ? v : 0.0f;
+    v = v < 1.0f ? v : 1.0f;
+    return (uint8_t)(int32_t)(v * 255.0f + 0.5f);
+}
+// NOTE(omid): float -> half with round-to-nearest-even, overflow to inf, nan kept
+// (F. Giesen's float_to_half_fast3_rtne); no F16C needed.
+static uint16_t
+vertex_float_to_half (float value) {
+    uint32_t const f16_max = (127 + 16) << 23;
+    uint32_t const denorm_magic_bits = ((127 - 15) + (23 - 10) + 1) << 23;
+    uint32_t f;
+    ::memcpy(&f, &value, sizeof(f));
+    uint32_t sign = f & 0x80000000u;
+    f ^= sign;
+    uint16_t o;
+    if (f >= f16_max) {
+        o = f > 0x7f800000u ? 0x7e00 : 0x7c00;
+    } else if (f < (uint32_t)(127 - 14) << 23) {
+        // -- subnormal (or zero): let the fpu round the mantissa into place
+        float denorm_magic, x;
+        ::memcpy(&denorm_magic, &denorm_magic_bits, sizeof(float));
+        ::memcpy(&x, &f, sizeof(float));
+        x += denorm_magic;
+        ::memcpy(&f, &x, sizeof(float));
+        o = (uint16_t)(f - denorm_magic_bits);
+    } else {
+        uint32_t mantissa_odd = (f >> 13) & 1;
+        f += ((uint32_t)(15 - 127) << 23) + 0xfff;
+        f += mantissa_odd;
+        o = (uint16_t)(f >> 13);
+    }
+    return (uint16_t)(o | (sign >> 16));
+}
+static float
+vertex_half_to_float (uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    float value;
+    if (0 == exponent)
+        value = ::ldexpf((float)mantissa, -24);
+    else if (31 == exponent)
+        value = mantissa ? NAN : INFINITY;
+    else
+        value = ::ldexpf((float)(mantissa | 0x400), (int)exponent - 25);
+    uint32_t bits;
+    ::memcpy(&bits, &value, sizeof(bits));
+    bits |= sign;
+    ::memcpy(&value, &bits, sizeof(bits));
+    return value;
+}
+// -- unit vector -> octahedron in [-1, 1]^2
+static void
+vertex_octahedral (float const * n, float * out) {
+    float l1 = ::fabsf(n[0]) + ::fabsf(n[1]) + ::fabsf(n[2]);
+    float x = l1 > 0.0f ? n[0] / l1 : 0.0f;
+    float y = l1 > 0.0f ? n[1] / l1 : 0.0f;
+    if (n[2] < 0.0f) {
+        float fx = (1.0f - ::fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float fy = (1.0f - ::fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+    out[0] = x;
+    out[1] = y;
+}
+static void
+vertex_octahedral_decode (int16_t const * e, float * out) {
+    float x = (float)e[0] / 32767.0f;
+    float y = (float)e[1] / 32767.0f;
+    x = x > -1.0f ? x : -1.0f;
+    y = y > -1.0f ? y : -1.0f;
+    float z = 1.0f - ::fabsf(x) - ::fabsf(y);
+    if (z < 0.0f) {
+        float fx = (1.0f - ::fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float fy = (1.0f - ::fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+    float l = ::sqrtf(x * x + y * y + z * z);
+    out[0] = x / l;
+    out[1] = y / l;
+    out[2] = z / l;
+}
+
+// -- bounds of a position stream; also picks the uv format when a uv stream is given
+static VertexQuantization
+vertex_quantization (float const * positions, size_t position_stride, float const * uvs, size_t uv_stride, uint32_t count) {
+    VertexQuantization q = {};
+    float max [3] = {};
+    for (uint32_t c = 0; c < 3; ++c)
+        q.position_min[c] = max[c] = count ? positions[c] : 0.0f;
+    bool uv_in_unit = true;
+    for (uint32_t i = 0; i < count; ++i) {
+        float const * p = vertex_stream_at(positions, position_stride, i);
+        for (uint32_t c = 0; c < 3; ++c) {
+            q.position_min[c] = p[c] < q.position_min[c] ? p[c] : q.position_min[c];
+            max[c] = p[c] > max[c] ? p[c] : max[c];
+        }
+        if (uvs) {
+            float const * uv = vertex_stream_at(uvs, uv_stride, i);
+            uv_in_unit = uv_in_unit && uv[0] >= 0.0f && uv[0] <= 1.0f && uv[1] >= 0.0f && uv[1] <= 1.0f;
+        }
+    }
+    for (uint32_t c = 0; c < 3; ++c) {
+        float extent = max[c] - q.position_min[c];
+        q.position_scale[c] = extent > 0.0f ? extent : 1.0f;
+    }
+    q.uv_format = uv_in_unit ? DXGI_FORMAT_R16G16_UNORM : DXGI_FORMAT_R16G16_FLOAT;
+    return q;
+}
+
+static void
+vertex_encode_positions (
+    float const * src, size_t src_stride, uint32_t count, VertexQuantization const * q, uint16_t * dst, size_t dst_stride
+) {
+    for (uint32_t i = 0; i < count; ++i) {
+        float const * p = vertex_stream_at(src, src_stride, i);
+        uint16_t * out = vertex_stream_out(dst, dst_stride, i);
+        for (uint32_t c = 0; c < 3; ++c)
+            out[c] = vertex_unorm16((p[c] - q->position_min[c]) * (1.0f / q->position_scale[c]));
+        out[3] = 0xffff;
+    }
+}
+static void
+vertex_encode_normals (float const * src, size_t src_stride, uint32_t count, int16_t * dst, size_t dst_stride) {
+    for (uint32_t i = 0; i < count; ++i) {
+        float oct [2];
+        vertex_octahedral(vertex_stream_at(src, src_stride, i), oct);
+        int16_t * out = vertex_stream_out(dst, dst_stride, i);
+        out[0] = vertex_snorm16(oct[0]);
+        out[1] = vertex_snorm16(oct[1]);
+    }
+}
+static void
+vertex_encode_uvs (float const * src, size_t src_stride, uint32_t count, DXGI_FORMAT format, uint16_t * dst, size_t dst_stride) {
+    for (uint32_t i = 0; i < count; ++i) {
+        float const * uv = vertex_stream_at(src, src_stride, i);
+        uint16_t * out = vertex_stream_out(dst, dst_stride, i);
+        for (uint32_t c = 0; c < 2; ++c)
+            out[c] = DXGI_FORMAT_R16G16_FLOAT == format ? vertex_float_to_half(uv[c]) : vertex_unorm16(uv[c]);
+    }
+}
+static void
+vertex_encode_colors (float const * src, size_t src_stride, uint32_t count, uint8_t * dst, size_t dst_stride) {
+    for (uint32_t i = 0; i < count; ++i) {
+        float const * color = vertex_stream_at(src, src_stride, i);
+        uint8_t * out = vertex_stream_out(dst, dst_stride, i);
+        for (uint32_t c = 0; c < 4; ++c)
+            out[c] = vertex_unorm8(color[c]);
+    }
+}
+
+static void
+vertex_compress_mesh_scalar (ColladaVertex const * src, uint32_t count, VertexQuantization const * q, PackedMeshVertex * dst) {
+    size_t const in = sizeof(ColladaVertex), out = sizeof(PackedMeshVertex);
+    vertex_encode_positions(src->position, in, count, q, dst->position, out);
+    vertex_encode_normals(src->normal, in, count, dst->normal, out);
+    vertex_encode_uvs(src->uv, in, count, q->uv_format, dst->uv, out);
+}
+// -- TextuVertex / ColorVertex style: both streams interleaved in one vertex of size stride
+static void
+vertex_compress_textu_scalar (
+    float const * positions, float const * uvs, size_t stride, uint32_t count, VertexQuantization const * q, PackedTextuVertex * dst
+) {
+    size_t const out = sizeof(PackedTextuVertex);
+    vertex_encode_positions(positions, stride, count, q, dst->position, out);
+    vertex_encode_uvs(uvs, stride, count, q->uv_format, dst->uv, out);
+}
+static void
+vertex_compress_color_scalar (
+    float const * positions, float const * colors, size_t stride, uint32_t count, VertexQuantization const * q, PackedColorVertex * dst
+) {
+    size_t const out = sizeof(PackedColorVertex);
+    vertex_encode_positions(positions, stride, count, q, dst->position, out);
+    vertex_encode_colors(colors, stride, count, dst->color, out);
+}
+
+// =========================================================================================================
+// -- SSE2
+
+// -- clamp to [0, 1], scale and round half up, like vertex_unorm16 / vertex_unorm8 (nan -> 0)
+static __m128i
+vertex_unorm_sse2 (__m128 v, float scale) {
+    v = _mm_max_ps(v, _mm_setzero_ps());        // max with nan in the first operand picks the second
+    v = _mm_min_ps(v, _mm_set1_ps(1.0f));
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(scale)), _mm_set1_ps(0.5f)));
+}
+static __m128i
+vertex_snorm16_sse2 (__m128 v) {
+    v = _mm_max_ps(v, _mm_set1_ps(-1.0f));
+    v = _mm_min_ps(v, _mm_set1_ps(1.0f));
+    __m128 scaled = _mm_mul_ps(v, _mm_set1_ps(32767.0f));
+    __m128 half = _mm_or_ps(_mm_and_ps(scaled, _mm_set1_ps(-0.0f)), _mm_set1_ps(0.5f));
+    return _mm_cvttps_epi32(_mm_add_ps(scaled, half));
+}
+// -- 4-wide vertex_float_to_half; the half is in the low 16 bits of each lane
+static __m128i
+vertex_float_to_half_sse2 (__m128 f) {
+    __m128i const denorm_magic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    __m128 sign = _mm_and_ps(f, _mm_set1_ps(-0.0f));
+    __m128 abs = _mm_xor_ps(f, sign);
+    __m128i abs_bits = _mm_castps_si128(abs);
+    __m128i is_regular = _mm_cmpgt_epi32(_mm_set1_epi32((127 + 16) << 23), abs_bits);
+    __m128i nan_bit = _mm_and_si128(_mm_castps_si128(_mm_cmpunord_ps(abs, abs)), _mm_set1_epi32(0x200));
+    __m128i inf_or_nan = _mm_or_si128(nan_bit, _mm_set1_epi32(0x7c00));
+    __m128i is_subnormal = _mm_cmpgt_epi32(_mm_set1_epi32((127 - 14) << 23), abs_bits);
+    __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(abs, _mm_castsi128_ps(denorm_magic))), denorm_magic);
+    __m128i mantissa_odd = _mm_srai_epi32(_mm_slli_epi32(abs_bits, 31 - 13), 31);
+    __m128i normal = _mm_add_epi32(abs_bits, _mm_set1_epi32((int)(((uint32_t)(15 - 127) << 23) + 0xfff)));
+    normal = _mm_srli_epi32(_mm_sub_epi32(normal, mantissa_odd), 13);
+    __m128i finite = _mm_or_si128(_mm_and_si128(is_subnormal, subnormal), _mm_andnot_si128(is_subnormal, normal));
+    __m128i joined = _mm_or_si128(_mm_and_si128(is_regular, finite), _mm_andnot_si128(is_regular, inf_or_nan));
+    return _mm_or_si128(joined, _mm_srli_epi32(_mm_castps_si128(sign), 16));
+}
+// -- 16-bit values (low half of each 32-bit lane, signed or not) of two vectors -> 8 x uint16
+static __m128i
+vertex_pack16_sse2 (__m128i lo, __m128i hi) {
+    // -- packs_epi32 saturates signed, so bias into its range and back
+    __m128i const mask = _mm_set1_epi32(0xffff);
+    __m128i const bias = _mm_set1_epi32(0x8000);
+    __m128i packed = _mm_packs_epi32(_mm_sub_epi32(_mm_and_si128(lo, mask), bias), _mm_sub_epi32(_mm_and_si128(hi, mask), bias));
+    return _mm_xor_si128(packed, _mm_set1_epi16((short)0x8000));
+}
+// NOTE(omid): Four vertices per iteration: two loads per ColladaVertex (position +
+// normal.x, normal.yz + uv), transposed so each register holds one channel of four
+// vertices, every channel encoded at once, then transposed back into four 16-byte
+// PackedMeshVertex stores.
+static void
+vertex_compress_mesh_sse2 (ColladaVertex const * src, uint32_t count, VertexQuantization const * q, PackedMeshVertex * dst) {
+    static_assert(32 == sizeof(ColladaVertex) && 12 == offsetof(ColladaVertex, normal), "ColladaVertex layout");
+    __m128 const sign_mask = _mm_set1_ps(-0.0f);
+    __m128 const one = _mm_set1_ps(1.0f);
+    __m128 const zero = _mm_setzero_ps();
+    __m128 const min [3] = {_mm_set1_ps(q->position_min[0]), _mm_set1_ps(q->position_min[1]), _mm_set1_ps(q->position_min[2])};
+    __m128 const inv [3] = {
+        _mm_set1_ps(1.0f / q->position_scale[0]), _mm_set1_ps(1.0f / q->position_scale[1]), _mm_set1_ps(1.0f / q->position_scale[2])
+    };
+    bool half_uv = DXGI_FORMAT_R16G16_FLOAT == q->uv_format;
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        ColladaVertex const * v = src + i;
+        __m128 px = _mm_loadu_ps(v[0].position), py = _mm_loadu_ps(v[1].position);
+        __m128 pz = _mm_loadu_ps(v[2].position), nx = _mm_loadu_ps(v[3].position);
+        __m128 ny = _mm_loadu_ps(v[0].normal + 1), nz = _mm_loadu_ps(v[1].normal + 1);
+        __m128 tu = _mm_loadu_ps(v[2].normal + 1), tv = _mm_loadu_ps(v[3].normal + 1);
+        _MM_TRANSPOSE4_PS(px, py, pz, nx);
+        _MM_TRANSPOSE4_PS(ny, nz, tu, tv);
+
+        __m128i ex = vertex_unorm_sse2(_mm_mul_ps(_mm_sub_ps(px, min[0]), inv[0]), 65535.0f);
+        __m128i ey = vertex_unorm_sse2(_mm_mul_ps(_mm_sub_ps(py, min[1]), inv[1]), 65535.0f);
+        __m128i ez = vertex_unorm_sse2(_mm_mul_ps(_mm_sub_ps(pz, min[2]), inv[2]), 65535.0f);
+
+        // -- octahedral, as vertex_octahedral (sign(0) counts as +1)
+        __m128 l1 = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(sign_mask, nx), _mm_andnot_ps(sign_mask, ny)), _mm_andnot_ps(sign_mask, nz));
+        __m128 nonzero = _mm_cmpgt_ps(l1, zero);
+        __m128 ox = _mm_and_ps(nonzero, _mm_div_ps(nx, l1));
+        __m128 oy = _mm_and_ps(nonzero, _mm_div_ps(ny, l1));
+        __m128 x_sign = _mm_or_ps(_mm_and_ps(_mm_cmplt_ps(ox, zero), sign_mask), one);
+        __m128 y_sign = _mm_or_ps(_mm_and_ps(_mm_cmplt_ps(oy, zero), sign_mask), one);
+        __m128 fx = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(sign_mask, oy)), x_sign);
+        __m128 fy = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(sign_mask, ox)), y_sign);
+        __m128 lower = _mm_cmplt_ps(nz, zero);
+        __m128i enx = vertex_snorm16_sse2(_mm_or_ps(_mm_and_ps(lower, fx), _mm_andnot_ps(lower, ox)));
+        __m128i eny = vertex_snorm16_sse2(_mm_or_ps(_mm_and_ps(lower, fy), _mm_andnot_ps(lower, oy)));
+
+        __m128i eu = half_uv ? vertex_float_to_half_sse2(tu) : vertex_unorm_sse2(tu, 65535.0f);
+        __m128i ev = half_uv ? vertex_float_to_half_sse2(tv) : vertex_unorm_sse2(tv, 65535.0f);
+
+        // -- channel-major 16-bit rows back to one 16-byte vertex per store
+        __m128i xy = vertex_pack16_sse2(ex, ey);                    // x0..x3 y0..y3
+        __m128i zw = vertex_pack16_sse2(ez, _mm_set1_epi32(0xffff));
+        __m128i nn = vertex_pack16_sse2(enx, eny);
+        __m128i uv = vertex_pack16_sse2(eu, ev);
+        __m128i xz = _mm_unpacklo_epi16(xy, zw), yw = _mm_unpackhi_epi16(xy, zw);      // x0 z0 x1 z1 .. / y0 w0 ..
+        __m128i nu = _mm_unpacklo_epi16(nn, uv), nv = _mm_unpackhi_epi16(nn, uv);
+        __m128i p01 = _mm_unpacklo_epi16(xz, yw), p23 = _mm_unpackhi_epi16(xz, yw);    // x0 y0 z0 w0 x1 y1 z1 w1 ..
+        __m128i a01 = _mm_unpacklo_epi16(nu, nv), a23 = _mm_unpackhi_epi16(nu, nv);
+        __m128i * out = reinterpret_cast<__m128i *>(dst + i);
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi64(p01, a01));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi64(p01, a01));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi64(p23, a23));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi64(p23, a23));
+    }
+    vertex_compress_mesh_scalar(src + i, count - i, q, dst + i);
+}
+
+// -- positions of four strided vertices encoded and packed: two vertices (x y z w) per register.
+// Each load takes 16 bytes, so the vertex has to hold something after its position.
+static void
+vertex_positions_sse2 (float const * positions, size_t stride, VertexQuantization const * q, __m128i * p01, __m128i * p23) {
+    __m128 px = _mm_loadu_ps(vertex_stream_at(positions, stride, 0)), py = _mm_loadu_ps(vertex_stream_at(positions, stride, 1));
+    __m128 pz = _mm_loadu_ps(vertex_stream_at(positions, stride, 2)), pw = _mm_loadu_ps(vertex_stream_at(positions, stride, 3));
+    _MM_TRANSPOSE4_PS(px, py, pz, pw);
+    __m128i ex = vertex_unorm_sse2(_mm_mul_ps(_mm_sub_ps(px, _mm_set1_ps(q->position_min[0])), _mm_set1_ps(1.0f / q->position_scale[0])), 65535.0f);
+    __m128i ey = vertex_unorm_sse2(_mm_mul_ps(_mm_sub_ps(py, _mm_set1_ps(q->position_min[1])), _mm_set1_ps(1.0f / q->position_scale[1])), 65535.0f);
+    __m128i ez = vertex_unorm_sse2(_mm_mul_ps(_mm_sub_ps(pz, _mm_set1_ps(q->position_min[2])), _mm_set1_ps(1.0f / q->position_scale[2])), 65535.0f);
+    __m128i xy = vertex_pack16_sse2(ex, ey);
+    __m128i zw = vertex_pack16_sse2(ez, _mm_set1_epi32(0xffff));
+    __m128i xz = _mm_unpacklo_epi16(xy, zw), yw = _mm_unpackhi_epi16(xy, zw);
+    *p01 = _mm_unpacklo_epi16(xz, yw);
+    *p23 = _mm_unpackhi_epi16(xz, yw);
+}
+// -- four 12-byte vertices (8 bytes of position, one 32-bit attribute per lane of a) as three stores
+static void
+vertex_store12_sse2 (__m128i p01, __m128i p23, __m128i a, void * dst) {
+    __m128 p0 = _mm_castsi128_ps(p01), p1 = _mm_castsi128_ps(p23), at = _mm_castsi128_ps(a);
+    __m128 t0 = _mm_shuffle_ps(at, p0, _MM_SHUFFLE(2, 2, 0, 0));    // a0 a0 p1.x p1.x
+    __m128 t1 = _mm_shuffle_ps(p0, at, _MM_SHUFFLE(1, 1, 3, 3));    // p1.y p1.y a1 a1
+    __m128 t2 = _mm_shuffle_ps(at, p1, _MM_SHUFFLE(2, 2, 2, 2));    // a2 a2 p3.x p3.x
+    __m128 t3 = _mm_shuffle_ps(p1, at, _MM_SHUFFLE(3, 3, 3, 3));    // p3.y p3.y a3 a3
+    float * out = reinterpret_cast<float *>(dst);
+    _mm_storeu_ps(out + 0, _mm_shuffle_ps(p0, t0, _MM_SHUFFLE(2, 0, 1, 0)));
+    _mm_storeu_ps(out + 4, _mm_shuffle_ps(t1, p1, _MM_SHUFFLE(1, 0, 2, 0)));
+    _mm_storeu_ps(out + 8, _mm_shuffle_ps(t2, t3, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+static void
+vertex_compress_textu_sse2 (
+    float const * positions, float const * uvs, size_t stride, uint32_t count, VertexQuantization const * q, PackedTextuVertex * dst
+) {
+    bool half_uv = DXGI_FORMAT_R16G16_FLOAT == q->uv_format;
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float const * p = vertex_stream_at(positions, stride, i);
+        float const * t = vertex_stream_at(uvs, stride, i);
+        __m128i p01, p23;
+        vertex_positions_sse2(p, stride, q, &p01, &p23);
+
+        // -- u0 v0 u1 v1 / u2 v2 u3 v3 -> one channel per register
+        __m128 uv01 = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<__m64 const *>(t)),
+            reinterpret_cast<__m64 const *>(vertex_stream_at(t, stride, 1)));
+        __m128 uv23 = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<__m64 const *>(vertex_stream_at(t, stride, 2))),
+            reinterpret_cast<__m64 const *>(vertex_stream_at(t, stride, 3)));
+        __m128 tu = _mm_shuffle_ps(uv01, uv23, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 tv = _mm_shuffle_ps(uv01, uv23, _MM_SHUFFLE(3, 1, 3, 1));
+        __m128i eu = half_uv ? vertex_float_to_half_sse2(tu) : vertex_unorm_sse2(tu, 65535.0f);
+        __m128i ev = half_uv ? vertex_float_to_half_sse2(tv) : vertex_unorm_sse2(tv, 65535.0f);
+        __m128i uv = vertex_pack16_sse2(eu, ev);                     // u0..u3 v0..v3
+        uv = _mm_unpacklo_epi16(uv, _mm_unpackhi_epi64(uv, uv));     // u0 v0 u1 v1 ..
+
+        vertex_store12_sse2(p01, p23, uv, dst + i);
+    }
+    vertex_compress_textu_scalar(
+        vertex_stream_at(positions, stride, i), vertex_stream_at(uvs, stride, i), stride, count - i, q, dst + i
+    );
+}
+static void
+vertex_compress_color_sse2 (
+    float const * positions, float const * colors, size_t stride, uint32_t count, VertexQuantization const * q, PackedColorVertex * dst
+) {
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float const * p = vertex_stream_at(positions, stride, i);
+        float const * c = vertex_stream_at(colors, stride, i);
+        __m128i p01, p23;
+        vertex_positions_sse2(p, stride, q, &p01, &p23);
+
+        __m128 r = _mm_loadu_ps(c), g = _mm_loadu_ps(vertex_stream_at(c, stride, 1));
+        __m128 b = _mm_loadu_ps(vertex_stream_at(c, stride, 2)), a = _mm_loadu_ps(vertex_stream_at(c, stride, 3));
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+        // -- every channel is in [0, 255], so shifting them into place packs r g b a bytes per lane
+        __m128i rgba = _mm_or_si128(
+            _mm_or_si128(vertex_unorm_sse2(r, 255.0f), _mm_slli_epi32(vertex_unorm_sse2(g, 255.0f), 8)),
+            _mm_or_si128(_mm_slli_epi32(vertex_unorm_sse2(b, 255.0f), 16), _mm_slli_epi32(vertex_unorm_sse2(a, 255.0f), 24))
+        );
+        vertex_store12_sse2(p01, p23, rgba, dst + i);
+    }
+    vertex_compress_color_scalar(
+        vertex_stream_at(positions, stride, i), vertex_stream_at(colors, stride, i), stride, count - i, q, dst + i
+    );
+}
+
+// =========================================================================================================
+// -- scene
+
+struct PackedScene {
+    PackedMeshVertex *              vertices;       // parallel to ColladaScene::vertices
+    uint32_t                        vertex_count;
+    VertexQuantization *            meshes;         // parallel to ColladaScene::meshes
+    uint32_t                        mesh_count;
+};
+static void
+packed_scene_destroy (PackedScene * packed) {
+    ::free(packed->vertices);
+    ::free(packed->meshes);
+    ::memset(packed, 0, sizeof(*packed));
+}
+// NOTE(omid): Packs every mesh of the scene, timing the scalar reference against
+// the SSE2 path, and prints bytes per vertex, encode throughput and the worst
+// position / normal / uv error after decoding.
+static bool
+packed_scene_create (ColladaScene const * scene, PackedScene * packed) {
+    ::memset(packed, 0, sizeof(*packed));
+    if (0 == scene->vertex_count)
+        return false;
+    packed->vertices = reinterpret_cast<PackedMeshVertex *>(::malloc(scene->vertex_count * sizeof(PackedMeshVertex)));
+    packed->meshes = reinterpret_cast<VertexQuantization *>(::calloc(scene->mesh_count, sizeof(VertexQuantization)));
+    if (!packed->vertices || !packed->meshes) {
+        packed_scene_destroy(packed);
+        return false;
+    }
+    packed->vertex_count = scene->vertex_count;
+    packed->mesh_count = scene->mesh_count;
+
+    uint32_t half_uv_meshes = 0;
+    for (uint32_t m = 0; m < scene->mesh_count; ++m) {
+        ColladaMesh const * mesh = &scene->meshes[m];
+        ColladaVertex const * src = scene->vertices + mesh->first_vertex;
+        packed->meshes[m] = vertex_quantization(src->position, sizeof(ColladaVertex), src->uv, sizeof(ColladaVertex), mesh->vertex_count);
+        half_uv_meshes += DXGI_FORMAT_R16G16_FLOAT == packed->meshes[m].uv_format ? 1 : 0;
+    }
+    double ms [2] = {};
+    for (uint32_t pass = 0; pass < 2; ++pass) {
+        // -- scalar first, then sse2 (whose output is kept)
+        auto begin = std::chrono::steady_clock::now();
+        for (uint32_t m = 0; m < scene->mesh_count; ++m) {
+            ColladaMesh const * mesh = &scene->meshes[m];
+            ColladaVertex const * src = scene->vertices + mesh->first_vertex;
+            if (0 == pass)
+                vertex_compress_mesh_scalar(src, mesh->vertex_count, &packed->meshes[m], packed->vertices + mesh->first_vertex);
+            else
+                vertex_compress_mesh_sse2(src, mesh->vertex_count, &packed->meshes[m], packed->vertices + mesh->first_vertex);
+        }
+        ms[pass] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+    float position_error = 0.0f, normal_error_deg = 0.0f, uv_error = 0.0f;
+    for (uint32_t m = 0; m < scene->mesh_count; ++m) {
+        ColladaMesh const * mesh = &scene->meshes[m];
+        VertexQuantization const * q = &packed->meshes[m];
+        for (uint32_t v = mesh->first_vertex; v < mesh->first_vertex + mesh->vertex_count; ++v) {
+            ColladaVertex const * src = &scene->vertices[v];
+            PackedMeshVertex const * dst = &packed->vertices[v];
+            for (uint32_t c = 0; c < 3; ++c) {
+                float p = q->position_min[c] + (float)dst->position[c] / 65535.0f * q->position_scale[c];
+                position_error = ::fmaxf(position_error, ::fabsf(p - src->position[c]));
+            }
+            float n [3];
+            vertex_octahedral_decode(dst->normal, n);
+            float length = ::sqrtf(src->normal[0] * src->normal[0] + src->normal[1] * src->normal[1] + src->normal[2] * src->normal[2]);
+            if (length > 0.0f) {
+                float d = (n[0] * src->normal[0] + n[1] * src->normal[1] + n[2] * src->normal[2]) / length;
+                d = d < 1.0f ? d : 1.0f;
+                normal_error_deg = ::fmaxf(normal_error_deg, ::acosf(d) * 57.2957795f);
+            }
+            for (uint32_t c = 0; c < 2; ++c) {
+                float uv = DXGI_FORMAT_R16G16_FLOAT == q->uv_format ? vertex_half_to_float(dst->uv[c]) : (float)dst->uv[c] / 65535.0f;
+                uv_error = ::fmaxf(uv_error, ::fabsf(uv - src->uv[c]));
+            }
+        }
+    }
+    double mb = (double)scene->vertex_count * sizeof(ColladaVertex) / (1024.0 * 1024.0);
+    ::printf(
+        "Vertex compression: %u vertices, %u -> %u bytes/vertex (%.1f KiB saved), uv unorm16 in %u meshes / half in %u\n",
+        scene->vertex_count, (uint32_t)sizeof(ColladaVertex), (uint32_t)sizeof(PackedMeshVertex),
+        (double)scene->vertex_count * (sizeof(ColladaVertex) - sizeof(PackedMeshVertex)) / 1024.0,
+        scene->mesh_count - half_uv_meshes, half_uv_meshes
+    );
+    ::printf(
+        "Vertex compression: encode scalar %.3f ms (%.0f MiB/s), sse2 %.3f ms (%.0f MiB/s); max error position %g, normal %.4f deg, uv %g\n",
+        ms[0], ms[0] > 0.0 ? mb / (ms[0] * 1e-3) : 0.0, ms[1], ms[1] > 0.0 ? mb / (ms[1] * 1e-3) : 0.0,
+        position_error, normal_error_deg, uv_error
+    );
+    return true;
+}
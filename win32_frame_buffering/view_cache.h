@@ -0,0 +1,253 @@
+#pragma once
+
+// NOTE(omid): Deduplicates shader resource / constant buffer views. A view is
+// keyed by a hash of (kind, resource, view desc); asking for a view that already
+// exists returns the same descriptor and bumps its refcount instead of spending
+// another slot and another Create*View call. When the last reference goes away
+// the descriptor may still be read by in-flight frames, so it is only returned
+// to the DescriptorAllocator once the fence of that release has completed; a
+// view requested again before then is simply revived.
+// An SRV entry holds a reference on its resource for as long as the entry lives,
+// so the resource's address (part of the key) can't be reused by a new resource
+// while a stale view is still cached. CBVs are keyed by gpu address and size
+// only, which fully describe the view, so a reused address still gets a correct
+// descriptor.
+
+#include "descriptor_allocator.h"
+
+#define VIEW_CACHE_CAPACITY         1024
+#define VIEW_CACHE_SLOT_COUNT       (2 * VIEW_CACHE_CAPACITY)   // must be power of two
+#define VIEW_CACHE_EMPTY_SLOT       0xffffffff
+
+enum ViewKind : UINT {
+    ViewKind_SRV = 0,
+    ViewKind_CBV,
+};
+struct ViewKey {
+    ViewKind                        kind;
+    UINT                            has_desc;           // srv with null desc = default view
+    ID3D12Resource *                resource;           // null for cbvs (the desc holds the address); the entry holds a ref
+    union {
+        D3D12_SHADER_RESOURCE_VIEW_DESC     srv;
+        D3D12_CONSTANT_BUFFER_VIEW_DESC     cbv;
+    } desc;
+};
+struct ViewCacheEntry {
+    ViewKey                         key;
+    UINT64                          hash;
+    DescriptorHandle                handle;
+    UINT                            ref_count;
+    UINT64                          release_fence_value;    // valid once ref_count is 0
+    bool                            used;
+};
+struct ViewCacheStats {
+    UINT64                          requests;
+    UINT64                          hits;
+    UINT64                          revived;            // hits on views waiting for release
+    UINT64                          create_calls;       // Create*View calls issued
+    UINT64                          freed;
+    UINT                            live;               // descriptors held by the cache
+    UINT                            live_high_water;
+};
+struct ViewCache {
+    ID3D12Device *                  device;
+    DescriptorAllocator *           allocator;
+    UINT *                          entry_of_descriptor;    // descriptor id -> entry index
+
+    ViewCacheEntry                  entries [VIEW_CACHE_CAPACITY];
+    UINT                            slots [VIEW_CACHE_SLOT_COUNT];     // hash -> entry index (open addressing)
+    UINT                            pending_release_count;
+    ViewCacheStats                  stats;
+};
+
+// -- keys are zeroed before filling so padding bytes hash deterministically
+static UINT64
+view_key_hash (ViewKey const * key) {
+    return fnv1a_64(key, sizeof(*key), FNV1A_64_SEED);
+}
+static void
+view_cache_init (ViewCache * cache, ID3D12Device * device, DescriptorAllocator * allocator) {
+    ::memset(cache, 0, sizeof(*cache));
+    cache->device = device;
+    cache->allocator = allocator;
+    size_t id_count = (size_t)allocator->max_pages * allocator->page_size;
+    cache->entry_of_descriptor = reinterpret_cast<UINT *>(::malloc(sizeof(UINT) * id_count));
+    SIMPLE_ASSERT(cache->entry_of_descriptor);
+    ::memset(cache->entry_of_descriptor, 0xff, sizeof(UINT) * id_count);
+    for (UINT i = 0; i < VIEW_CACHE_SLOT_COUNT; ++i)
+        cache->slots[i] = VIEW_CACHE_EMPTY_SLOT;
+}
+static void
+view_cache_rebuild_slots (ViewCache * cache) {
+    for (UINT i = 0; i < VIEW_CACHE_SLOT_COUNT; ++i)
+        cache->slots[i] = VIEW_CACHE_EMPTY_SLOT;
+    for (UINT e = 0; e < VIEW_CACHE_CAPACITY; ++e) {
+        if (!cache->entries[e].used)
+            continue;
+        UINT slot = (UINT)(cache->entries[e].hash & (VIEW_CACHE_SLOT_COUNT - 1));
+        while (cache->slots[slot] != VIEW_CACHE_EMPTY_SLOT)
+            slot = (slot + 1) & (VIEW_CACHE_SLOT_COUNT - 1);
+        cache->slots[slot] = e;
+    }
+}
+static UINT
+view_cache_find (ViewCache * cache, ViewKey const * key, UINT64 hash) {
+    UINT slot = (UINT)(hash & (VIEW_CACHE_SLOT_COUNT - 1));
+    while (cache->slots[slot] != VIEW_CACHE_EMPTY_SLOT) {
+        ViewCacheEntry * entry = &cache->entries[cache->slots[slot]];
+        if (entry->hash == hash && 0 == ::memcmp(&entry->key, key, sizeof(*key)))
+            return cache->slots[slot];
+        slot = (slot + 1) & (VIEW_CACHE_SLOT_COUNT - 1);
+    }
+    return VIEW_CACHE_EMPTY_SLOT;
+}
+static DescriptorHandle
+view_cache_get (ViewCache * cache, ViewKey const * key) {
+    ++cache->stats.requests;
+    UINT64 hash = view_key_hash(key);
+    UINT entry_index = view_cache_find(cache, key, hash);
+    if (entry_index != VIEW_CACHE_EMPTY_SLOT) {
+        ViewCacheEntry * entry = &cache->entries[entry_index];
+        ++cache->stats.hits;
+        if (0 == entry->ref_count) {
+            ++cache->stats.revived;
+            --cache->pending_release_count;
+        }
+        ++entry->ref_count;
+        return entry->handle;
+    }
+
+    // -- miss: find a free entry and a descriptor, then create the view
+    DescriptorHandle ret = {};
+    ret.id = DESCRIPTOR_NONE;
+    for (UINT e = 0; e < VIEW_CACHE_CAPACITY; ++e) {
+        if (cache->entries[e].used)
+            continue;
+        entry_index = e;
+        break;
+    }
+    if (VIEW_CACHE_EMPTY_SLOT == entry_index)
+        return ret;
+    ret = descriptor_allocate(cache->allocator, 1);
+    if (DESCRIPTOR_NONE == ret.id)
+        return ret;
+
+    D3D12_CPU_DESCRIPTOR_HANDLE cpu_handle = {};
+    cpu_handle.ptr = (SIZE_T)ret.cpu;
+    switch (key->kind) {
+        case ViewKind_SRV: {
+            cache->device->CreateShaderResourceView(key->resource, key->has_desc ? &key->desc.srv : nullptr, cpu_handle);
+        } break;
+        case ViewKind_CBV: {
+            cache->device->CreateConstantBufferView(&key->desc.cbv, cpu_handle);
+        } break;
+        default: {
+            SIMPLE_ASSERT(false);
+        } break;
+    }
+    ++cache->stats.create_calls;
+    if (key->resource)
+        key->resource->AddRef();
+
+    ViewCacheEntry * entry = &cache->entries[entry_index];
+    entry->key = *key;
+    entry->hash = hash;
+    entry->handle = ret;
+    entry->ref_count = 1;
+    entry->release_fence_value = 0;
+    entry->used = true;
+    cache->entry_of_descriptor[ret.id] = entry_index;
+
+    UINT slot = (UINT)(hash & (VIEW_CACHE_SLOT_COUNT - 1));
+    while (cache->slots[slot] != VIEW_CACHE_EMPTY_SLOT)
+        slot = (slot + 1) & (VIEW_CACHE_SLOT_COUNT - 1);
+    cache->slots[slot] = entry_index;
+
+    ++cache->stats.live;
+    if (cache->stats.live > cache->stats.live_high_water)
+        cache->stats.live_high_water = cache->stats.live;
+    return ret;
+}
+// -- desc may be null for the resource's default view
+static DescriptorHandle
+view_cache_get_srv (ViewCache * cache, ID3D12Resource * resource, D3D12_SHADER_RESOURCE_VIEW_DESC const * desc) {
+    ViewKey key;
+    ::memset(&key, 0, sizeof(key));
+    key.kind = ViewKind_SRV;
+    key.resource = resource;
+    if (desc) {
+        key.has_desc = 1;
+        key.desc.srv = *desc;
+    }
+    return view_cache_get(cache, &key);
+}
+static DescriptorHandle
+view_cache_get_cbv (ViewCache * cache, D3D12_CONSTANT_BUFFER_VIEW_DESC const * desc) {
+    ViewKey key;
+    ::memset(&key, 0, sizeof(key));
+    key.kind = ViewKind_CBV;
+    key.has_desc = 1;
+    key.desc.cbv = *desc;
+    return view_cache_get(cache, &key);
+}
+// -- fence_value: signaled after the last submission that may read the descriptor
+static void
+view_cache_release (ViewCache * cache, DescriptorHandle * handle, UINT64 fence_value) {
+    if (DESCRIPTOR_NONE == handle->id)
+        return;
+    UINT entry_index = cache->entry_of_descriptor[handle->id];
+    SIMPLE_ASSERT(entry_index < VIEW_CACHE_CAPACITY);
+    ViewCacheEntry * entry = &cache->entries[entry_index];
+    SIMPLE_ASSERT(entry->used && entry->ref_count > 0);
+    if (0 == --entry->ref_count) {
+        entry->release_fence_value = fence_value;
+        ++cache->pending_release_count;
+    }
+    handle->id = DESCRIPTOR_NONE;
+    handle->count = 0;
+}
+// -- give descriptors of unreferenced views back once the gpu is done with them
+static void
+view_cache_collect (ViewCache * cache, UINT64 completed_fence_value) {
+    if (0 == cache->pending_release_count)
+        return;
+    bool removed = false;
+    for (UINT e = 0; e < VIEW_CACHE_CAPACITY; ++e) {
+        ViewCacheEntry * entry = &cache->entries[e];
+        if (!entry->used || entry->ref_count > 0 || entry->release_fence_value > completed_fence_value)
+            continue;
+        cache->entry_of_descriptor[entry->handle.id] = VIEW_CACHE_EMPTY_SLOT;
+        descriptor_free(cache->allocator, &entry->handle);
+        if (entry->key.resource)
+            entry->key.resource->Release();
+        ::memset(entry, 0, sizeof(*entry));
+        --cache->pending_release_count;
+        --cache->stats.live;
+        ++cache->stats.freed;
+        removed = true;
+    }
+    if (removed)
+        view_cache_rebuild_slots(cache);
+}
+static void
+view_cache_print_stats (ViewCache const * cache) {
+    ViewCacheStats const * s = &cache->stats;
+    ::printf(
+        "View cache: %llu requests, %llu hits (%llu revived), %llu Create*View calls, %llu freed, %u live (high water %u)\n",
+        s->requests, s->hits, s->revived, s->create_calls, s->freed, s->live, s->live_high_water
+    );
+}
+// -- assumes the gpu is idle
+static void
+view_cache_destroy (ViewCache * cache) {
+    for (UINT e = 0; e < VIEW_CACHE_CAPACITY; ++e) {
+        ViewCacheEntry * entry = &cache->entries[e];
+        if (!entry->used)
+            continue;
+        descriptor_free(cache->allocator, &entry->handle);
+        if (entry->key.resource)
+            entry->key.resource->Release();
+    }
+    ::free(cache->entry_of_descriptor);
+    ::memset(cache, 0, sizeof(*cache));
+}